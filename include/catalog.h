@@ -0,0 +1,18 @@
+#ifndef __CATALOG_H_
+#define __CATALOG_H_
+
+#include <glib-2.0/glib.h>
+
+#define CATALOG_PITCH_FRAME 4096
+#define CATALOG_BAND_FRAME 2048
+#define CATALOG_LOW_FREQ_START 20.0
+#define CATALOG_MEDIUM_FREQ_START 250.0
+#define CATALOG_HIGH_FREQ_START 4000.0
+
+/*Analyses every audio file below directory on jobs worker threads (0 uses every core)
+  and writes one JSON line per track to output_path, stdout when it is NULL.
+  cache_path is optional.*/
+int catalog_analyse_directory(const gchar *directory, const gchar *output_path,
+                                const gchar *cache_path, guint jobs);
+
+#endif
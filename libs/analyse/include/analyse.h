@@ -3,18 +3,39 @@
 
 #include <gst/gst.h>
 #include <glib-2.0/glib.h>
+#include "band_volume.h"
+#include "analyse_cache.h"
+#include "bpm_stats.h"
 
-#define PROB_NUM 100
+#define PROB_NUM BPM_STATS_WINDOW
+/*Analysis stops once the estimate moved less than the tolerance for BPM_STABLE_WINDOW tags*/
+#define BPM_TOLERANCE_DEFAULT 0.5
+#define BPM_STABLE_WINDOW_DEFAULT 10
 
 #define AUDIO_FREQUENCY 44100
 
+/*Sampled analysis, windows spread over the song without the intro and outro*/
+#define SAMPLE_WINDOWS_DEFAULT 3
+#define SAMPLE_WINDOW_S_DEFAULT 15.0
+#define SAMPLE_SKIP_DEFAULT 0.1
+#define SAMPLE_MIN_CONFIDENCE_DEFAULT 0.5
+/*Window tempos within this fraction of the median agree*/
+#define SAMPLE_BPM_AGREEMENT 0.02
+
 typedef enum _BPMDataAlgo
 {
     LAST = 0,
     MEDIUM = 1,
-    MEDIANA = 2
+    MEDIANA = 2,
+    HISTOGRAM = 3   /*octave folded tempo vote, see bpm_stats.h*/
 }BPMDataAlgo;
 
+typedef enum _BPMDetector
+{
+    BPM_DETECTOR_BPMDETECT = 0, /*gstreamer bpmdetect element*/
+    BPM_DETECTOR_NATIVE = 1     /*onset envelope + autocorrelation, see tempo.h*/
+}BPMDetector;
+
 typedef enum _PitchDataAlgo
 {
     CEPSTRUM = 0,
@@ -27,13 +48,22 @@ typedef enum _PitchDataAlgo
 typedef struct _BPMData
 {
     BPMDataAlgo algo;
+    BPMDetector detector;
     GstElement *pipeline;
     GstElement *audio_source;
+    GstElement *audio_decoder;         /*NULL when the direct chain is used*/
     GstElement *audio_convert;
     GstElement *caps_filter;
     GstElement *bpm_detector;
     GstElement *fakesink;
     gfloat bpm_data[PROB_NUM];
+    u_int32_t bpm_num;          /*number of received tags, bpm_data is used as ring buffer*/
+    gfloat bpm_estimate;
+    gfloat tolerance;
+    u_int32_t stable_window;
+    u_int32_t stable_count;
+    BPMStats stats;             /*running statistics of the tags in bpm_data*/
+    gfloat confidence;          /*native detector score, or share of tags voting for the HISTOGRAM tempo*/
 }BPMData; 
 
 typedef struct _PitchData
@@ -45,7 +75,9 @@ typedef struct _PitchData
     GstElement   *fft_spectrum;
     GstElement   *fakesink;
     u_int32_t     audio_frequency;
-    u_int32_t     spect_bands;
+    u_int32_t     spect_bands;    /*frame size of the analysis, rounded up to a power of two*/
+    gfloat        pitch;
+    gfloat        confidence;
 }PitchData;
 
 typedef struct _FrequencyVolData
@@ -59,11 +91,35 @@ typedef struct _FrequencyVolData
     gdouble high_freq_start;
     u_int32_t audio_frequency;
     u_int32_t spect_bands;
-    
+    BandVolume volume[BAND_NUM];    /*filled by analyse_get_song_frequency_volume*/
 }FrequencyVolData;
 
+typedef struct _AnalyseResult
+{
+    gfloat bpm;
+    gfloat bpm_confidence;
+    gfloat pitch;
+    gfloat pitch_confidence;
+    BandVolume volume[BAND_NUM];
+    gfloat duration;            /*seconds, 0.0 when unknown*/
+    gboolean sampled;           /*TRUE when only the sampled windows were analysed*/
+    gfloat bpm_spread;          /*standard deviation of the window tempos*/
+}AnalyseResult;
+
+typedef struct _AnalyseSampling
+{
+    u_int32_t windows;
+    gdouble window_seconds;
+    gdouble skip;               /*fraction of the song skipped at each end*/
+    gfloat min_confidence;      /*below it the whole song is analysed*/
+}AnalyseSampling;
+
 int analyse_init_bpm_data(BPMData *bpm_data, BPMDataAlgo bpm_algo);
 
+int analyse_set_bpm_detector(BPMData *bpm_data, BPMDetector detector);
+
+int analyse_set_bpm_convergence(BPMData *bpm_data, gfloat tolerance, u_int32_t stable_window);
+
 int analyse_init_pitch_data(PitchData *pitch_data, 
                             PitchDataAlgo pitch_algo, 
                             u_int32_t audio_frequency,
@@ -76,11 +132,33 @@ int analyse_init_freq_vol_data(FrequencyVolData *freq_vol_data,
                                 u_int32_t audio_frequency,
                                 u_int32_t spect_bands);
 
+/*Every analyse_get_song_* and analyse_song consult the cache first and store new results in it.
+  The cache must stay open while analyses run, NULL disables it.*/
+int analyse_set_cache(AnalyseCache *cache);
+
 float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path);
 
 
 float analyse_get_song_pitch(PitchData *pitch_data, gchar * song_path);
 
-float analyse_get_song_frequency_volume(FrequencyVolData *freq_vol_data, gchar *song_path);
+/*Measures all bands in one decode pass, the result is stored in freq_vol_data->volume*/
+int analyse_get_song_frequency_volume(FrequencyVolData *freq_vol_data, gchar *song_path);
+
+/*Decodes the song once and runs all requested analyses on the same samples.
+  Any of the data structs can be NULL to skip that analysis. BPM always uses the
+  native detector. Pitch and band volume must agree on the audio frequency.*/
+int analyse_song(gchar *song_path, BPMData *bpm_data, PitchData *pitch_data,
+                    FrequencyVolData *freq_vol_data, AnalyseResult *result);
+
+int analyse_init_sampling(AnalyseSampling *sampling,
+                            u_int32_t windows,
+                            gdouble window_seconds,
+                            gdouble skip,
+                            gfloat min_confidence);
+
+/*Estimates BPM (native detector) and band volume from a few seeked windows only.
+  Falls back to analyse_song when the song is too short or the windows disagree.*/
+int analyse_song_sampled(gchar *song_path, BPMData *bpm_data, FrequencyVolData *freq_vol_data,
+                            const AnalyseSampling *sampling, AnalyseResult *result);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef _ANALYSE_CACHE_H_
+#define _ANALYSE_CACHE_H_
+
+#include <stdio.h>
+#include <glib-2.0/glib.h>
+#include "band_volume.h"
+#include "arena.h"
+
+/*Bump whenever an estimator changes its results, older records are ignored*/
+#define ANALYSE_CACHE_VERSION 3
+#define ANALYSE_CACHE_MAGIC 0x4341434eu     /*"NCAC"*/
+/*Bytes hashed at the start and at the end of the file*/
+#define ANALYSE_CACHE_HASH_BYTES (1024 * 1024)
+
+typedef enum _AnalyseCacheFlags
+{
+    CACHE_HAS_BPM = 1 << 0,
+    CACHE_HAS_PITCH = 1 << 1,
+    CACHE_HAS_VOLUME = 1 << 2
+}AnalyseCacheFlags;
+
+typedef struct _AnalyseFingerprint
+{
+    guint64 size;
+    gint64 mtime;
+    guint64 hash;       /*FNV-1a of the first and last ANALYSE_CACHE_HASH_BYTES*/
+}AnalyseFingerprint;
+
+/*Fixed size record, the file is a header followed by an array of these in host byte order.
+  Records are only appended, a later record for the same fingerprint replaces earlier ones.*/
+typedef struct _AnalyseCacheRecord
+{
+    AnalyseFingerprint key;
+    guint32 version;
+    guint32 flags;
+    guint32 bpm_config;     /*hash of the settings each value was computed with*/
+    guint32 pitch_config;
+    guint32 volume_config;
+    gfloat bpm;
+    gfloat bpm_confidence;
+    gfloat pitch;
+    gfloat pitch_confidence;
+    BandVolume volume[BAND_NUM];
+    gfloat duration;        /*seconds, 0.0 when unknown*/
+}AnalyseCacheRecord;
+
+typedef struct _AnalyseCacheHeader
+{
+    guint32 magic;
+    guint32 record_size;
+}AnalyseCacheHeader;
+
+typedef struct _AnalyseCache
+{
+    FILE *file;
+    GHashTable *index;      /*AnalyseFingerprint -> AnalyseCacheRecord*/
+    Pool records;           /*storage of the indexed records*/
+    GMutex lock;
+}AnalyseCache;
+
+/*Loads an existing index or creates a new one, an incompatible file is rewritten.
+  A torn last record is cut off so new records append on the record grid.*/
+int analyse_cache_open(AnalyseCache *cache, const gchar *path);
+
+void analyse_cache_close(AnalyseCache *cache);
+
+int analyse_cache_fingerprint(const gchar *song_path, AnalyseFingerprint *fingerprint);
+
+/*Copies the record for the fingerprint, FALSE if there is none for the current version*/
+gboolean analyse_cache_lookup(AnalyseCache *cache, const AnalyseFingerprint *fingerprint, AnalyseCacheRecord *record);
+
+/*Merges the flagged values of record into the stored one and appends the result*/
+int analyse_cache_store(AnalyseCache *cache, const AnalyseCacheRecord *record);
+
+guint32 analyse_cache_config_hash(const void *data, gsize size);
+
+#endif
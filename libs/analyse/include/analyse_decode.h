@@ -0,0 +1,39 @@
+#ifndef _ANALYSE_DECODE_H_
+#define _ANALYSE_DECODE_H_
+
+#include <gst/gst.h>
+#include <glib-2.0/glib.h>
+
+/*Called for every decoded buffer, samples are interleaved and only valid during the call*/
+typedef void (*DecodeCallback)(const gfloat *samples, gsize num_frames, gpointer user_data);
+
+/*Growing interleaved sample buffer for collecting a decoded song*/
+typedef struct _DecodeBuffer
+{
+    gfloat *samples;
+    gsize allocated;
+    gsize used;
+    guint channels;
+}DecodeBuffer;
+
+void analyse_decode_buffer_append(DecodeBuffer *buffer, const gfloat *samples, gsize num_frames);
+
+/*Decodes the song buffer by buffer without keeping it in memory. Returns FALSE on error.*/
+gboolean analyse_decode_song_stream(const gchar *song_path, guint rate, guint channels,
+                                    DecodeCallback callback, gpointer user_data);
+
+typedef void (*DecodeWindowCallback)(guint window, const gfloat *samples, gsize num_frames, gpointer user_data);
+
+/*Seeks to num_windows windows of window_seconds spread evenly over the song,
+  skip is the fraction of the song ignored at each end (intro and outro).
+  Returns 0 on success, -1 on error and -2 when the song is too short or can't seek,
+  a full decode should be used then.*/
+int analyse_decode_song_windows(const gchar *song_path, guint rate, guint channels,
+                                guint num_windows, gdouble window_seconds, gdouble skip,
+                                DecodeWindowCallback callback, gpointer user_data);
+
+/*Decodes whole song into interleaved float samples at the given rate.
+  Returned buffer must be freed with g_free, NULL on error.*/
+gfloat *analyse_decode_song(const gchar *song_path, guint rate, guint channels, gsize *num_frames);
+
+#endif
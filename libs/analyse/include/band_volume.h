@@ -0,0 +1,54 @@
+#ifndef _BAND_VOLUME_H_
+#define _BAND_VOLUME_H_
+
+#include <glib-2.0/glib.h>
+#include "stft.h"
+
+typedef enum _FrequencyBand
+{
+    BAND_LOW = 0,
+    BAND_MEDIUM = 1,
+    BAND_HIGH = 2,
+    BAND_NUM = 3
+}FrequencyBand;
+
+typedef struct _BandVolume
+{
+    gfloat rms;         /*linear, full scale sine in the band gives 0.707*/
+    gfloat peak;        /*loudest frame RMS*/
+    gfloat rms_db;
+    gfloat peak_db;
+}BandVolume;
+
+/*Streaming STFT band energy, samples can be pushed in chunks of any size*/
+typedef struct _BandVolumeState
+{
+    guint frame_size;
+    guint hop;
+    guint band_start[BAND_NUM];     /*first FFT bin of each band*/
+    guint band_end[BAND_NUM];       /*one past the last bin*/
+    gfloat scale;                   /*power spectrum to mean square*/
+    Stft stft;
+    gdouble energy_sum[BAND_NUM];
+    gdouble energy_peak[BAND_NUM];
+    guint64 frames;
+}BandVolumeState;
+
+/*Bands start in increasing order and the high one below Nyquist of rate.
+  -2 for a negative start, -3 for bands out of order or not fitting.*/
+int band_volume_check_bands(guint rate, gdouble low_start, gdouble medium_start, gdouble high_start);
+
+int band_volume_init(BandVolumeState *state, guint rate, guint frame_size,
+                        gdouble low_start, gdouble medium_start, gdouble high_start);
+
+void band_volume_process(BandVolumeState *state, const gfloat *samples, gsize num_samples);
+
+/*Drops the partial frame, used between discontinuous chunks of a song*/
+void band_volume_flush(BandVolumeState *state);
+
+/*Fills one BandVolume per band, the partial last frame is dropped*/
+void band_volume_finish(BandVolumeState *state, BandVolume volumes[BAND_NUM]);
+
+void band_volume_free(BandVolumeState *state);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _BPM_STATS_H_
+#define _BPM_STATS_H_
+
+#include <glib-2.0/glib.h>
+
+/*Number of most recent tags the statistics are taken over*/
+#define BPM_STATS_WINDOW 100
+/*Tags are folded by octaves into [BPM_FOLD_LOW, 2 * BPM_FOLD_LOW) for the histogram,
+  centered on the tempo prior so half and double tempo tags vote together*/
+#define BPM_FOLD_LOW 92.0
+#define BPM_HISTOGRAM_RESOLUTION 0.5
+#define BPM_HISTOGRAM_BINS 184
+
+/*Sliding window mean, median and tempo histogram, every tag is O(log n).
+  The median keeps the lower half of the window in a max heap and the upper half
+  in a min heap, each slot remembers its heap position so the oldest tag can be
+  removed when the window is full.*/
+typedef struct _BPMStats
+{
+    gfloat values[BPM_STATS_WINDOW];        /*ring buffer in order of arrival*/
+    guint16 position[BPM_STATS_WINDOW];     /*heap index of every slot*/
+    guint8 upper[BPM_STATS_WINDOW];         /*slot lives in the min heap*/
+    guint16 low[BPM_STATS_WINDOW];          /*max heap of slots*/
+    guint16 high[BPM_STATS_WINDOW];         /*min heap of slots*/
+    guint low_size;
+    guint high_size;
+    guint count;                            /*tags in the window*/
+    guint next;                             /*slot of the next tag*/
+    gdouble sum;
+    guint16 histogram[BPM_HISTOGRAM_BINS];
+}BPMStats;
+
+void bpm_stats_init(BPMStats *stats);
+
+void bpm_stats_add(BPMStats *stats, gfloat bpm);
+
+/*Every getter returns -1 with an empty window*/
+gfloat bpm_stats_last(const BPMStats *stats);
+
+gfloat bpm_stats_mean(const BPMStats *stats);
+
+gfloat bpm_stats_median(const BPMStats *stats);
+
+/*Folded tempo with most votes, refined by the neighbouring bins.
+  agreement is the share of tags voting for it, can be NULL.*/
+gfloat bpm_stats_histogram(const BPMStats *stats, gfloat *agreement);
+
+/*Moves bpm by octaves into the histogram range*/
+gfloat bpm_stats_fold(gfloat bpm);
+
+#endif
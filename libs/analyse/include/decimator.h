@@ -0,0 +1,52 @@
+#ifndef _DECIMATOR_H_
+#define _DECIMATOR_H_
+
+#include <glib-2.0/glib.h>
+
+#define DECIMATOR_MAX_FACTOR 8
+/*Anti-alias filter length per polyphase branch, the filter has factor times as many taps*/
+#define DECIMATOR_TAPS_PER_PHASE 32
+/*Passband edge as a fraction of the output Nyquist frequency*/
+#define DECIMATOR_CUTOFF 0.84
+/*Input frames downmixed and filtered per step*/
+#define DECIMATOR_BLOCK 4096
+
+/*Same layout as DecodeCallback, decimated samples are mono*/
+typedef void (*DecimatorCallback)(const gfloat *samples, gsize num_samples, gpointer user_data);
+
+/*Downmixes interleaved input to mono, low-pass filters it and keeps every factor-th sample.
+  Only the kept outputs are filtered, so the cost per input sample is DECIMATOR_TAPS_PER_PHASE
+  multiply-adds whatever the factor. Output is delayed by (taps - 1) / 2 input samples.*/
+typedef struct _Decimator
+{
+    guint factor;               /*1, 2, 4 or 8*/
+    guint channels;
+    guint taps;
+    gfloat *coeffs;
+    gfloat *line;               /*taps - 1 samples of history followed by the current block*/
+    guint phase;                /*block position of the next kept sample*/
+    gfloat *output;             /*decimated block for decimator_push*/
+}Decimator;
+
+/*Largest supported factor that keeps rate / factor at or above target_rate*/
+guint decimator_factor(guint rate, guint target_rate);
+
+int decimator_init(Decimator *decimator, guint factor, guint channels);
+
+void decimator_free(Decimator *decimator);
+
+/*Clears the filter history, used between discontinuous chunks of a signal*/
+void decimator_reset(Decimator *decimator);
+
+/*Decimates num_frames interleaved frames into output, which must hold
+  num_frames / factor + 1 samples. Returns the number of samples written.*/
+gsize decimator_process(Decimator *decimator, const gfloat *samples, gsize num_frames, gfloat *output);
+
+/*Decimates num_frames interleaved frames and hands the result to callback block by block*/
+void decimator_push(Decimator *decimator, const gfloat *samples, gsize num_frames,
+                    DecimatorCallback callback, gpointer user_data);
+
+/*Decimates a whole signal. Returned buffer must be freed with g_free, NULL on error.*/
+gfloat *decimator_run(const gfloat *samples, gsize num_frames, guint channels, guint factor, gsize *num_samples);
+
+#endif
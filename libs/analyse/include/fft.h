@@ -0,0 +1,45 @@
+#ifndef _FFT_H_
+#define _FFT_H_
+
+#include <glib-2.0/glib.h>
+
+/*Radix-2 complex FFT on split real/imaginary arrays, the tables are computed once per size*/
+typedef struct _FFTPlan
+{
+    guint n;
+    guint log2n;
+    guint *bitrev;
+    /*Twiddles of the stage with butterflies half apart at [half, 2 * half), contiguous so
+      the butterflies of a stage vectorise*/
+    gfloat *twiddle_re;
+    gfloat *twiddle_im;
+}FFTPlan;
+
+#define FFT_MAX_LOG2 24
+
+int fft_plan_init(FFTPlan *plan, guint n);
+
+/*Shared plan for a power of two size, built on first use and kept for the lifetime
+  of the process. Safe to call from several threads, NULL for invalid sizes.*/
+const FFTPlan *fft_plan_get(guint n);
+
+void fft_plan_free(FFTPlan *plan);
+
+void fft_forward(const FFTPlan *plan, gfloat *re, gfloat *im);
+
+/*Inverse transform, scaled by 1/n*/
+void fft_inverse(const FFTPlan *plan, gfloat *re, gfloat *im);
+
+/*count transforms of plan->n values stored back to back*/
+void fft_forward_batch(const FFTPlan *plan, gfloat *re, gfloat *im, guint count);
+
+void fft_inverse_batch(const FFTPlan *plan, gfloat *re, gfloat *im, guint count);
+
+guint fft_next_pow2(guint n);
+
+/*Zeroed work buffer aligned for vector loads, free with fft_buffer_free*/
+gfloat *fft_buffer_new(guint n);
+
+void fft_buffer_free(gfloat *buffer);
+
+#endif
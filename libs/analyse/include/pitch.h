@@ -0,0 +1,59 @@
+#ifndef _PITCH_H_
+#define _PITCH_H_
+
+#include <glib-2.0/glib.h>
+#include "stft.h"
+
+#define PITCH_MIN_HZ 50.0
+#define PITCH_MAX_HZ 1000.0
+/*Frames quieter than this RMS are skipped*/
+#define PITCH_SILENCE_RMS 1e-3
+/*Per frame estimates within this many semitones of the song pitch count as agreeing*/
+#define PITCH_AGREE_SEMITONES 1.0
+/*YIN absolute threshold on the cumulative mean normalised difference*/
+#define PITCH_YIN_THRESHOLD 0.15
+
+typedef struct _PitchResult
+{
+    gfloat pitch;       /*Hz, 0.0 when no frame was voiced*/
+    gfloat confidence;  /*0.0 - 1.0*/
+}PitchResult;
+
+/*Plan and work buffers for one frame size, reused for every frame of a song*/
+typedef struct _PitchWorkspace
+{
+    guint frame_size;
+    guint rate;
+    guint min_lag;
+    guint max_lag;
+    const FFTPlan *plan;        /*shared, see fft_plan_get*/
+    const gfloat *window;
+    gfloat *re;
+    gfloat *im;
+    gfloat *diff;       /*YIN difference function, max_lag + 2 values*/
+}PitchWorkspace;
+
+typedef gfloat (*PitchFrameFunc)(PitchWorkspace *workspace, const gfloat *frame);
+
+int pitch_workspace_init(PitchWorkspace *workspace, guint frame_size, guint rate);
+
+void pitch_workspace_free(PitchWorkspace *workspace);
+
+/*Returns the frame pitch in Hz or 0.0 for silent or unvoiced frames*/
+gfloat pitch_cepstrum_frame(PitchWorkspace *workspace, const gfloat *frame);
+
+/*YIN with the difference function computed through the FFT, same return values*/
+gfloat pitch_yin_frame(PitchWorkspace *workspace, const gfloat *frame);
+
+/*Frames a mono signal with frame_size / 2 hop and aggregates per frame estimates.
+  Frames are split between worker threads, each with its own workspace.*/
+int pitch_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                    guint frame_size, PitchFrameFunc frame_func, PitchResult *result);
+
+int pitch_cepstrum_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                            guint frame_size, PitchResult *result);
+
+int pitch_yin_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                        guint frame_size, PitchResult *result);
+
+#endif
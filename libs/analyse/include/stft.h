@@ -0,0 +1,55 @@
+#ifndef _STFT_H_
+#define _STFT_H_
+
+#include <glib-2.0/glib.h>
+#include "fft.h"
+
+typedef enum _StftWindow
+{
+    STFT_WINDOW_HANN = 0,
+    STFT_WINDOW_HAMMING = 1,
+    STFT_WINDOW_BLACKMAN = 2,
+    STFT_WINDOW_NUM = 3
+}StftWindow;
+
+/*Streaming short-time FFT over a ring buffer, optionally resynthesised by overlap-add*/
+typedef struct _Stft
+{
+    guint frame_size;
+    guint hop;
+    const FFTPlan *plan;        /*shared, see fft_plan_get*/
+    const gfloat *window;       /*shared, see stft_window_get*/
+    gfloat *ring;               /*last frame_size input samples*/
+    guint ring_pos;             /*next write position*/
+    guint ring_fill;
+    guint since_frame;          /*samples pushed since the last frame*/
+    gfloat *re;
+    gfloat *im;
+    gfloat *overlap;            /*overlap-add accumulator*/
+    gfloat synthesis_gain;
+}Stft;
+
+typedef void (*StftFrameCallback)(gfloat *re, gfloat *im, gpointer user_data);
+
+/*Periodic window of a power of two size, computed once and shared, NULL for invalid sizes*/
+const gfloat *stft_window_get(StftWindow type, guint n);
+
+/*frame_size must be a power of two, hop at most frame_size*/
+int stft_init(Stft *stft, guint frame_size, guint hop, StftWindow window);
+
+void stft_free(Stft *stft);
+
+/*Buffers samples and calls callback with the spectrum of every complete frame*/
+void stft_push(Stft *stft, const gfloat *samples, gsize num_samples, StftFrameCallback callback, gpointer user_data);
+
+/*Drops the partial frame, used between discontinuous chunks of a signal*/
+void stft_reset(Stft *stft);
+
+/*Windows a frame into re/im and transforms it, for callers that frame the signal themselves*/
+void stft_analyse_frame(Stft *stft, const gfloat *frame);
+
+/*Inverse transforms re/im in place, adds the windowed frame to the overlap buffer
+  and writes the hop samples that are complete to output*/
+void stft_overlap_add(Stft *stft, gfloat *re, gfloat *im, gfloat *output);
+
+#endif
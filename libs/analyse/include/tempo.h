@@ -0,0 +1,48 @@
+#ifndef _TEMPO_H_
+#define _TEMPO_H_
+
+#include <glib-2.0/glib.h>
+#include "arena.h"
+
+#define TEMPO_MIN_BPM 50.0
+#define TEMPO_MAX_BPM 220.0
+/*Octave errors are resolved towards this tempo*/
+#define TEMPO_PRIOR_BPM 130.0
+/*Onsets need only a few kHz of bandwidth, higher rates are decimated down to it*/
+#define TEMPO_ANALYSIS_RATE 11025
+
+typedef struct _TempoResult
+{
+    gfloat bpm;
+    gfloat confidence;  /*0.0 - 1.0*/
+}TempoResult;
+
+/*Onset envelope + autocorrelation tempo estimation on a mono signal*/
+int tempo_estimate(const gfloat *samples, gsize num_samples, guint rate, TempoResult *result);
+
+/*tempo_estimate queued on the shared tempo workers*/
+typedef struct _TempoJob
+{
+    const gfloat *samples;
+    gsize num_samples;
+    guint rate;
+    TempoResult result;
+    int error;
+    gboolean done;
+    GMutex lock;
+    GCond cond;
+}TempoJob;
+
+/*The workers live as long as the process, so the scratch arena of tempo_estimate is
+  reused by every song instead of being freed with a thread per song.
+  samples must stay valid until tempo_job_wait. Runs on the calling thread when no
+  worker can be started.*/
+int tempo_job_start(TempoJob *job, const gfloat *samples, gsize num_samples, guint rate);
+
+/*Returns what tempo_estimate returned*/
+int tempo_job_wait(TempoJob *job, TempoResult *result);
+
+/*Allocation counters of every job the workers ran so far*/
+void tempo_worker_stats(ArenaStats *stats);
+
+#endif
@@ -1,5 +1,14 @@
 #include "analyse.h"
+#include "analyse_decode.h"
+#include "tempo.h"
+#include "pitch.h"
+#include "band_volume.h"
+#include "analyse_cache.h"
+#include "decimator.h"
+#include "decode_chain.h"
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 #ifdef NIGHTCORE_DEBUG
     #define DEBUG_PRINT(X) X;
@@ -9,207 +18,436 @@
 
 #define DEFAULT_BPM -1.0
 
-static void merge(float array[], int left, int mid, int right);
+static void bpm_process_data(BPMData *bpm_data, gfloat bpm_value);
 
-static void merge_sort(float array[], int left, int right);
+static float bpm_native(BPMData *bpm_data, gchar *song_path);
 
-static float calculate_medium(float array[], int num);
+static float bpm_analyse(BPMData *bpm_data, gchar *song_path);
 
+static void bpm_pad_added_handler(GstElement *src, GstPad *new_pad, BPMData *bpm_data);
 
-static float calculate_max(float array[], int num)
+static int compare_floats(const void *a, const void *b);
+
+static float pitch_cerpstrum(PitchData *pitch_data, gchar *song_path);
+
+static float pitch_autocorelation(PitchData *pitch_data, gchar *song_path);
+
+static float pitch_from_song(PitchData *pitch_data, gchar *song_path, PitchFrameFunc frame_func);
+
+static float pitch_analyse(PitchData *pitch_data, gchar *song_path);
+
+static int freq_vol_analyse(FrequencyVolData *freq_vol_data, gchar *song_path);
+
+static void freq_vol_process(const gfloat *samples, gsize num_frames, gpointer user_data);
+
+typedef struct _AnalysePass
+{
+    DecodeBuffer buffer;
+    gboolean keep_samples;      /*only pitch needs the whole song at full rate*/
+    BandVolumeState *band_volume;
+    guint rate;
+    guint64 frames;
+    Decimator *decimator;       /*tempo input, decimated while decoding*/
+    DecodeBuffer tempo_buffer;
+}AnalysePass;
+
+static void analyse_buffer_append(const gfloat *samples, gsize num_samples, gpointer user_data);
+
+static void analyse_pass_process(const gfloat *samples, gsize num_frames, gpointer user_data);
+
+static int analyse_song_pass(gchar *song_path, BPMData *bpm_data, PitchData *pitch_data,
+                                FrequencyVolData *freq_vol_data, AnalyseResult *result);
+
+static int analyse_song_keyed(gchar *song_path, AnalyseCacheRecord *record, gboolean fingerprinted,
+                                BPMData *bpm_data, PitchData *pitch_data,
+                                FrequencyVolData *freq_vol_data, AnalyseResult *result);
+
+typedef struct _SampledPass
+{
+    DecodeBuffer buffer;        /*decimated samples of the current window*/
+    guint current;
+    guint rate;
+    gboolean tempo;
+    Decimator decimator;
+    BandVolumeState *band_volume;
+    TempoResult *window_tempo;
+}SampledPass;
+
+static void sampled_process(guint window, const gfloat *samples, gsize num_frames, gpointer user_data);
+
+static void sampled_finish_window(SampledPass *pass);
+
+static gboolean sampled_tempo(const TempoResult *window_tempo, guint windows, AnalyseResult *result);
+
+/*Shared by every analysis in the process, NULL disables caching*/
+static AnalyseCache *analyse_cache = NULL;
+
+
+int analyse_init_bpm_data(BPMData *bpm_data, BPMDataAlgo bpm_algo)
+{
+    if(bpm_data == NULL)
+    {
+        return -1;
+    }
+    bpm_data->algo = bpm_algo;
+    bpm_data->detector = BPM_DETECTOR_BPMDETECT;
+    bpm_data->confidence = 0.0;
+    bpm_data->bpm_num = 0;
+    bpm_data->bpm_estimate = DEFAULT_BPM;
+    bpm_data->stable_count = 0;
+    bpm_stats_init(&bpm_data->stats);
+    bpm_data->tolerance = BPM_TOLERANCE_DEFAULT;
+    bpm_data->stable_window = BPM_STABLE_WINDOW_DEFAULT;
+    return 0;
+}
+
+int analyse_set_bpm_detector(BPMData *bpm_data, BPMDetector detector)
 {
-    float min_candidate;
-    if(num <= 0)
+    if(bpm_data == NULL)
     {
         return -1;
     }
-    min_candidate = array[0];
-    for(int i = 1; i < num;i++)
+    if(detector != BPM_DETECTOR_BPMDETECT && detector != BPM_DETECTOR_NATIVE)
     {
-        if(array[i] < min_candidate)
-        {
-            min_candidate = array[i];
-        }
+        return -2;
     }
-    return min_candidate;
+    bpm_data->detector = detector;
+    return 0;
 }
 
-static float calculate_min(float array[], int num)
+int analyse_set_bpm_convergence(BPMData *bpm_data, gfloat tolerance, u_int32_t stable_window)
 {
-    float min_candidate;
-    if(num <= 0)
+    if(bpm_data == NULL)
     {
         return -1;
     }
-    min_candidate = array[0];
-    for(int i = 1; i < num;i++)
+    if(tolerance < 0 || stable_window == 0 || stable_window > PROB_NUM)
     {
-        if(array[i] < min_candidate)
-        {
-            min_candidate = array[i];
-        }
+        return -2;
     }
-    return min_candidate;
+    bpm_data->tolerance = tolerance;
+    bpm_data->stable_window = stable_window;
+    return 0;
 }
 
-static float calculate_mediana(float array[], int num, int already_sorted){
-    if(already_sorted == 0)
+int analyse_init_pitch_data(PitchData *pitch_data, 
+                            PitchDataAlgo pitch_algo, 
+                            u_int32_t audio_frequency,
+                            u_int32_t spect_bands)
+{
+    if(pitch_data == NULL)
     {
-        merge_sort(array, 0, (num - 1));
+        return -1;
     }
-    if(num == 0)
+    if(audio_frequency == 0)
     {
-        return -1.0;
+        return -2;
     }
-    if(num == 1)
+    pitch_data->algo = pitch_algo;
+    pitch_data->audio_frequency = audio_frequency;
+    pitch_data->spect_bands = spect_bands;
+    pitch_data->pitch = 0.0;
+    pitch_data->confidence = 0.0;
+    return 0;
+}
+int analyse_init_freq_vol_data(FrequencyVolData *freq_vol_data, 
+                                gdouble low_freq_start, 
+                                gdouble medium_freq_start, 
+                                gdouble high_freq_start,
+                                u_int32_t audio_frequency,
+                                u_int32_t spect_bands)
+{
+    int ret;
+
+    if(freq_vol_data == NULL)
     {
-        return array[num];
+        return -1;
     }
-    if(num % 2)
+    ret = band_volume_check_bands(audio_frequency, low_freq_start, medium_freq_start, high_freq_start);
+    if(ret != 0)
     {
-        return array[(num/2)];
+        return ret;
     }
-    else
+    freq_vol_data->low_freq_start = low_freq_start;
+    freq_vol_data->medium_freq_start = medium_freq_start;
+    freq_vol_data->high_freq_start = high_freq_start;
+    freq_vol_data->audio_frequency = audio_frequency;
+    freq_vol_data->spect_bands = spect_bands;
+    memset(freq_vol_data->volume, 0, sizeof(freq_vol_data->volume));
+    return 0;
+}
+
+int analyse_set_cache(AnalyseCache *cache)
+{
+    analyse_cache = cache;
+    return 0;
+}
+
+/*Keyed on the detector that produced the value, the combined and sampled passes always
+  run the native one whatever bpm_data->detector says. The native detector ignores the
+  tag policy.*/
+static guint32 bpm_config(const BPMData *bpm_data, BPMDetector detector)
+{
+    gdouble params[4] = {detector, 0.0, 0.0, 0.0};
+    if(detector == BPM_DETECTOR_BPMDETECT)
     {
-        return (array[num/2] + array[num/2 - 1]) / 2;
+        params[1] = bpm_data->algo;
+        params[2] = bpm_data->tolerance;
+        params[3] = bpm_data->stable_window;
     }
+    return analyse_cache_config_hash(params, sizeof(params));
 }
 
-static void merge(float array[], int left, int mid, int right)
+static guint32 pitch_config(const PitchData *pitch_data)
 {
-    int n1 = mid - left + 1; // Size of the left subarray
-    int n2 = right - mid;    // Size of the right subarray
-
-    // Temporary arrays to hold the subarrays
-    int* leftArray = (int*)malloc(n1 * sizeof(int));
-    int* rightArray = (int*)malloc(n2 * sizeof(int));
+    gdouble params[3] = {pitch_data->algo, pitch_data->audio_frequency, pitch_data->spect_bands};
+    return analyse_cache_config_hash(params, sizeof(params));
+}
 
-    // Copy data to temporary arrays
-    for (int i = 0; i < n1; i++)
-        leftArray[i] = array[left + i];
-    for (int j = 0; j < n2; j++)
-        rightArray[j] = array[mid + 1 + j];
+static guint32 freq_vol_config(const FrequencyVolData *freq_vol_data)
+{
+    gdouble params[5] = {freq_vol_data->low_freq_start, freq_vol_data->medium_freq_start, freq_vol_data->high_freq_start,
+                            freq_vol_data->audio_frequency, freq_vol_data->spect_bands};
+    return analyse_cache_config_hash(params, sizeof(params));
+}
 
-    // Merge the temporary arrays back into the original array
-    int i = 0, j = 0, k = left;
-    while (i < n1 && j < n2) {
-        if (leftArray[i] <= rightArray[j]) {
-            array[k] = leftArray[i];
-            i++;
-        } else {
-            array[k] = rightArray[j];
-            j++;
-        }
-        k++;
+/*FALSE when there is no cache or the song can't be fingerprinted, record->flags tells what is cached*/
+static gboolean cache_find(gchar *song_path, AnalyseCacheRecord *record)
+{
+    memset(record, 0, sizeof(AnalyseCacheRecord));
+    if(analyse_cache == NULL || analyse_cache_fingerprint(song_path, &record->key) != 0)
+    {
+        return FALSE;
+    }
+    if(!analyse_cache_lookup(analyse_cache, &record->key, record))
+    {
+        record->flags = 0;
     }
+    return TRUE;
+}
 
-    // Copy any remaining elements of leftArray
-    while (i < n1) {
-        array[k] = leftArray[i];
-        i++;
-        k++;
+static gboolean cache_get_bpm(const AnalyseCacheRecord *record, BPMData *bpm_data, BPMDetector detector)
+{
+    if(!(record->flags & CACHE_HAS_BPM) || record->bpm_config != bpm_config(bpm_data, detector))
+    {
+        return FALSE;
     }
+    bpm_data->bpm_data[0] = record->bpm;
+    bpm_data->bpm_num = 1;
+    bpm_data->bpm_estimate = record->bpm;
+    bpm_data->confidence = record->bpm_confidence;
+    return TRUE;
+}
 
-    // Copy any remaining elements of rightArray
-    while (j < n2) {
-        array[k] = rightArray[j];
-        j++;
-        k++;
+static gboolean cache_get_pitch(const AnalyseCacheRecord *record, PitchData *pitch_data)
+{
+    if(!(record->flags & CACHE_HAS_PITCH) || record->pitch_config != pitch_config(pitch_data))
+    {
+        return FALSE;
     }
+    pitch_data->pitch = record->pitch;
+    pitch_data->confidence = record->pitch_confidence;
+    return TRUE;
+}
 
-    // Free the temporary arrays
-    free(leftArray);
-    free(rightArray);
+static gboolean cache_get_freq_vol(const AnalyseCacheRecord *record, FrequencyVolData *freq_vol_data)
+{
+    if(!(record->flags & CACHE_HAS_VOLUME) || record->volume_config != freq_vol_config(freq_vol_data))
+    {
+        return FALSE;
+    }
+    memcpy(freq_vol_data->volume, record->volume, sizeof(freq_vol_data->volume));
+    return TRUE;
 }
 
-static void merge_sort(float array[], int left, int right)
-{    
-    if(left < right){
-        int mid = (left + (left - right) + 1) / 2;
-        merge_sort(array, left, mid);
-        merge_sort(array, mid + 1, right);
+static void cache_set_bpm(AnalyseCacheRecord *record, const BPMData *bpm_data, BPMDetector detector)
+{
+    record->flags |= CACHE_HAS_BPM;
+    record->bpm_config = bpm_config(bpm_data, detector);
+    record->bpm = bpm_data->bpm_estimate;
+    record->bpm_confidence = bpm_data->confidence;
+}
 
-        merge(array, left, mid, right);
-    }
+static void cache_set_pitch(AnalyseCacheRecord *record, const PitchData *pitch_data)
+{
+    record->flags |= CACHE_HAS_PITCH;
+    record->pitch_config = pitch_config(pitch_data);
+    record->pitch = pitch_data->pitch;
+    record->pitch_confidence = pitch_data->confidence;
 }
 
-static u_int32_t pitch_cerpstrum(PitchData *pitch_data);
+static void cache_set_freq_vol(AnalyseCacheRecord *record, const FrequencyVolData *freq_vol_data)
+{
+    record->flags |= CACHE_HAS_VOLUME;
+    record->volume_config = freq_vol_config(freq_vol_data);
+    memcpy(record->volume, freq_vol_data->volume, sizeof(record->volume));
+}
 
-static u_int32_t pitch_autocorelation(PitchData *pitch_data);
+float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
+{
+    AnalyseCacheRecord record;
+    gboolean fingerprinted;
+    float bpm;
 
+    if(bpm_data == NULL || song_path == NULL)
+    {
+        return bpm_analyse(bpm_data, song_path);
+    }
+    fingerprinted = cache_find(song_path, &record);
+    if(fingerprinted && cache_get_bpm(&record, bpm_data, bpm_data->detector))
+    {
+        return bpm_data->bpm_estimate;
+    }
+    bpm = bpm_analyse(bpm_data, song_path);
+    if(fingerprinted && bpm > 0)
+    {
+        record.flags = 0;
+        cache_set_bpm(&record, bpm_data, bpm_data->detector);
+        analyse_cache_store(analyse_cache, &record);
+    }
+    return bpm;
+}
 
-int analyse_init_bpm_data(BPMData *bpm_data, BPMDataAlgo bpm_algo)
+float analyse_get_song_pitch(PitchData *pitch_data, gchar * song_path)
 {
-    if(bpm_data == NULL)
+    AnalyseCacheRecord record;
+    gboolean fingerprinted;
+    float pitch;
+
+    if(pitch_data == NULL || song_path == NULL)
     {
-        return -1;
+        return pitch_analyse(pitch_data, song_path);
     }
-    bpm_data->algo = bpm_algo;
-    return 0;
+    fingerprinted = cache_find(song_path, &record);
+    if(fingerprinted && cache_get_pitch(&record, pitch_data))
+    {
+        return pitch_data->pitch;
+    }
+    pitch = pitch_analyse(pitch_data, song_path);
+    if(fingerprinted && pitch >= 0)
+    {
+        record.flags = 0;
+        cache_set_pitch(&record, pitch_data);
+        analyse_cache_store(analyse_cache, &record);
+    }
+    return pitch;
 }
 
-int analyse_init_pitch_data(PitchData *pitch_data, 
-                            PitchDataAlgo pitch_algo, 
-                            u_int32_t audio_frequency,
-                            u_int32_t spect_bands)
+int analyse_get_song_frequency_volume(FrequencyVolData *freq_vol_data, gchar *song_path)
 {
-    if(pitch_data == NULL)
+    AnalyseCacheRecord record;
+    gboolean fingerprinted;
+    int error;
+
+    if(freq_vol_data == NULL || song_path == NULL)
     {
-        return -1;
+        return freq_vol_analyse(freq_vol_data, song_path);
     }
-    pitch_data->algo = pitch_algo;
-    pitch_data->audio_frequency = audio_frequency;
-    pitch_data->spect_bands = spect_bands;
-    return 0;
+    fingerprinted = cache_find(song_path, &record);
+    if(fingerprinted && cache_get_freq_vol(&record, freq_vol_data))
+    {
+        return 0;
+    }
+    error = freq_vol_analyse(freq_vol_data, song_path);
+    if(fingerprinted && error == 0)
+    {
+        record.flags = 0;
+        cache_set_freq_vol(&record, freq_vol_data);
+        analyse_cache_store(analyse_cache, &record);
+    }
+    return error;
 }
-int analyse_init_freq_vol_data(FrequencyVolData *freq_vol_data, 
-                                gdouble low_freq_start, 
-                                gdouble medium_freq_start, 
-                                gdouble high_freq_start,
-                                u_int32_t audio_frequency,
-                                u_int32_t spect_bands)
+
+int analyse_song(gchar *song_path, BPMData *bpm_data, PitchData *pitch_data,
+                    FrequencyVolData *freq_vol_data, AnalyseResult *result)
 {
-    if(freq_vol_data == NULL)
+    AnalyseCacheRecord record;
+    gboolean fingerprinted;
+
+    if(song_path == NULL || result == NULL)
     {
         return -1;
     }
-    if(low_freq_start < 0)
+    fingerprinted = cache_find(song_path, &record);
+    return analyse_song_keyed(song_path, &record, fingerprinted, bpm_data, pitch_data, freq_vol_data, result);
+}
+
+/*analyse_song with the cache lookup already done, the song is hashed only once*/
+static int analyse_song_keyed(gchar *song_path, AnalyseCacheRecord *record, gboolean fingerprinted,
+                                BPMData *bpm_data, PitchData *pitch_data,
+                                FrequencyVolData *freq_vol_data, AnalyseResult *result)
+{
+    BPMData *bpm_todo = bpm_data;
+    PitchData *pitch_todo = pitch_data;
+    FrequencyVolData *freq_vol_todo = freq_vol_data;
+    int error = 0;
+
+    memset(result, 0, sizeof(AnalyseResult));
+    if(fingerprinted)
     {
-        return -2;
+        if(bpm_data != NULL && cache_get_bpm(record, bpm_data, BPM_DETECTOR_NATIVE))
+        {
+            bpm_todo = NULL;
+        }
+        if(pitch_data != NULL && cache_get_pitch(record, pitch_data))
+        {
+            pitch_todo = NULL;
+        }
+        if(freq_vol_data != NULL && cache_get_freq_vol(record, freq_vol_data))
+        {
+            freq_vol_todo = NULL;
+        }
     }
-    if(medium_freq_start < 0)
+    if(bpm_todo != NULL || pitch_todo != NULL || freq_vol_todo != NULL)
     {
-        return -2;
+        error = analyse_song_pass(song_path, bpm_todo, pitch_todo, freq_vol_todo, result);
+        if(fingerprinted && error == 0)
+        {
+            record->flags = 0;
+            record->duration = result->duration;
+            if(bpm_todo != NULL)
+            {
+                cache_set_bpm(record, bpm_todo, BPM_DETECTOR_NATIVE);
+            }
+            if(pitch_todo != NULL)
+            {
+                cache_set_pitch(record, pitch_todo);
+            }
+            if(freq_vol_todo != NULL)
+            {
+                cache_set_freq_vol(record, freq_vol_todo);
+            }
+            analyse_cache_store(analyse_cache, record);
+        }
     }
-    if(high_freq_start < 0)
+    /*Cached values were not touched by the pass*/
+    if(result->duration <= 0)
     {
-        return -2;
+        result->duration = record->duration;
     }
-    if(low_freq_start >= medium_freq_start)
+    if(bpm_data != NULL && bpm_todo == NULL)
     {
-        return -3;
+        result->bpm = bpm_data->bpm_estimate;
+        result->bpm_confidence = bpm_data->confidence;
     }
-    if(medium_freq_start >= high_freq_start)
+    if(pitch_data != NULL && pitch_todo == NULL)
     {
-        return -3;
+        result->pitch = pitch_data->pitch;
+        result->pitch_confidence = pitch_data->confidence;
     }
-    if(high_freq_start > audio_frequency)
+    if(freq_vol_data != NULL && freq_vol_todo == NULL)
     {
-        return -3;
+        memcpy(result->volume, freq_vol_data->volume, sizeof(result->volume));
     }
-    freq_vol_data->low_freq_start = low_freq_start;
-    freq_vol_data->medium_freq_start = medium_freq_start;
-    freq_vol_data->high_freq_start = high_freq_start;
-    freq_vol_data->audio_frequency = audio_frequency;
-    freq_vol_data->spect_bands = spect_bands;
-    return 0;
+    return error;
 }
 
-float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
+static float bpm_analyse(BPMData *bpm_data, gchar *song_path)
 {
     GstBus *bus;
     GstCaps *caps;
     GstMessage *msg;
+    GstStateChangeReturn ret;
     gboolean terminate = FALSE;
 
     if(bpm_data == NULL)
@@ -221,14 +459,24 @@ float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
         g_printerr("Song path is NULL");
         return -1.0;
     }
+    bpm_data->bpm_num = 0;
+    bpm_data->bpm_estimate = DEFAULT_BPM;
+    bpm_data->stable_count = 0;
+    bpm_data->confidence = 0.0;
+    bpm_stats_init(&bpm_data->stats);
+    if(bpm_data->detector == BPM_DETECTOR_NATIVE)
+    {
+        return bpm_native(bpm_data, song_path);
+    }
     bpm_data->pipeline = gst_pipeline_new("BPMPipeline");
     bpm_data->audio_source = gst_element_factory_make("filesrc", "audio_file_src");
+    bpm_data->audio_decoder = NULL;
     bpm_data->audio_convert = gst_element_factory_make("audioconvert", "audio_converter");
     bpm_data->caps_filter = gst_element_factory_make("capsfilter", "caps_filter");
     bpm_data->bpm_detector = gst_element_factory_make("bpmdetect", "bpm_detector");
     bpm_data->fakesink = gst_element_factory_make("fakesink", "sink");
-    if(!bpm_data->pipeline || !bpm_data->audio_source || !bpm_data->audio_convert || !bpm_data->caps_filter || 
-        !bpm_data->bpm_detector || !bpm_data->fakesink)
+    if(!bpm_data->pipeline || !bpm_data->audio_source || !bpm_data->audio_convert || 
+        !bpm_data->caps_filter || !bpm_data->bpm_detector || !bpm_data->fakesink)
     {
         g_printerr("ERROR: One or more element cant be created!\n");
         return -1.0;
@@ -236,15 +484,38 @@ float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
     /*bpmdetect works good only with one channel*/
     caps = gst_caps_from_string("audio/x-raw,channels=1");
     g_object_set(bpm_data->caps_filter, "caps", caps, NULL);
+    gst_caps_unref(caps);
     g_object_set(bpm_data->audio_source, "location", song_path, NULL);
 
-    gst_bin_add_many(GST_BIN(bpm_data->pipeline), bpm_data->audio_source, bpm_data->audio_convert, bpm_data->caps_filter, 
-                        bpm_data->bpm_detector, bpm_data->fakesink, NULL);
+    gst_bin_add_many(GST_BIN(bpm_data->pipeline), bpm_data->audio_source, bpm_data->audio_convert, 
+                        bpm_data->caps_filter, bpm_data->bpm_detector, bpm_data->fakesink, NULL);
 
-    if(!gst_element_link_many(bpm_data->audio_source, bpm_data->audio_convert, bpm_data->caps_filter, bpm_data->bpm_detector, 
+    if(!gst_element_link_many(bpm_data->audio_convert, bpm_data->caps_filter, bpm_data->bpm_detector, 
                                 bpm_data->fakesink, NULL))
     {  
         g_printerr("ERROR: One or more element cant be linked!\n");
+        gst_object_unref(bpm_data->pipeline);
+        return -1.0;
+    }
+    /*decodebin only for formats without a direct chain*/
+    if(!decode_chain_link_file(GST_BIN(bpm_data->pipeline), bpm_data->audio_source, bpm_data->audio_convert, song_path))
+    {
+        bpm_data->audio_decoder = gst_element_factory_make("decodebin", "audio_decoder");
+        if(!bpm_data->audio_decoder || !gst_bin_add(GST_BIN(bpm_data->pipeline), bpm_data->audio_decoder) ||
+            !gst_element_link(bpm_data->audio_source, bpm_data->audio_decoder))
+        {
+            g_printerr("ERROR: One or more element cant be linked!\n");
+            gst_object_unref(bpm_data->pipeline);
+            return -1.0;
+        }
+        g_signal_connect(bpm_data->audio_decoder, "pad-added", G_CALLBACK(bpm_pad_added_handler), bpm_data);
+    }
+
+    ret = gst_element_set_state(bpm_data->pipeline, GST_STATE_PLAYING);
+    if(ret == GST_STATE_CHANGE_FAILURE)
+    {
+        g_printerr("ERROR: Unable to set the BPM pipeline to the playing state.\n");
+        gst_object_unref(bpm_data->pipeline);
         return -1.0;
     }
 
@@ -252,11 +523,13 @@ float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
     do
     {
         msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
-            GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_TAG);
+            GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_TAG);
         if(msg!=NULL)
         {
             GError *err;
             gchar *debug_info;
+            GstTagList *tag_list;
+            gdouble bpm;
             switch(GST_MESSAGE_TYPE(msg))
             {
                 case GST_MESSAGE_ERROR:
@@ -268,44 +541,39 @@ float analyse_get_song_bpm(BPMData *bpm_data, gchar * song_path)
                     terminate = TRUE;
                     break;
                 case GST_MESSAGE_TAG:
-                    GstTagList *tag_list;
                     gst_message_parse_tag(msg, &tag_list);
-                    const GValue *val = gst_tag_list_get_value_index(tag_list, "beats-per-minute", 0);
-                    if(val == NULL)
-                    {
-                        g_printerr("[ERROR] BPM value is NULL");
-                        break;
-                    }
-                    
-                    gfloat bpm = g_value_get_float(val);
-                    if(bpm > 0)
+                    if(gst_tag_list_get_double(tag_list, GST_TAG_BEATS_PER_MINUTE, &bpm) && bpm > 0)
                     {
-                        if(bpm_data->algo == MEDIUM || bpm_data->algo == MEDIANA)
+                        bpm_process_data(bpm_data, (gfloat)bpm);
+                        /*Estimate is stable, no need to decode the rest of the song*/
+                        if(bpm_data->stable_count >= bpm_data->stable_window)
                         {
-                            bpm_data->bpm_data[0] = bpm;
-                        }
-                        else if(bpm_data->algo == LAST)
-                        {
-                            bpm_data->bpm_data[0] = bpm;
+                            DEBUG_PRINT(g_print("BPM converged after %u tags\n", bpm_data->bpm_num))
+                            terminate = TRUE;
                         }
                     }
+                    gst_tag_list_unref(tag_list);
                     break;
                 case GST_MESSAGE_EOS:
-                    g_print ("End-Of-Stream reached.\n");
+                    DEBUG_PRINT(g_print ("End-Of-Stream reached.\n"))
                     terminate = TRUE;
                     break;
                 default:
                     break;
             }
+            gst_message_unref(msg);
         }
         
     } while (!terminate);
     
-    
-    return -1.0;
+    gst_object_unref(bus);
+    gst_element_set_state(bpm_data->pipeline, GST_STATE_NULL);
+    gst_object_unref(bpm_data->pipeline);
+    bpm_data->pipeline = NULL;
+    return bpm_data->bpm_estimate;
 }
 
-float analyse_get_song_pitch(PitchData *pitch_data, gchar * song_path)
+static float pitch_analyse(PitchData *pitch_data, gchar *song_path)
 {
     if(pitch_data == NULL)
     {
@@ -319,9 +587,9 @@ float analyse_get_song_pitch(PitchData *pitch_data, gchar * song_path)
     switch(pitch_data->algo)
     {
         case(CEPSTRUM):
-            return pitch_cerpstrum(pitch_data);
+            return pitch_cerpstrum(pitch_data, song_path);
         case(AUTOCORELATION):
-            return pitch_autocorelation(pitch_data);
+            return pitch_autocorelation(pitch_data, song_path);
         default:
             g_printerr("Unknown pitch algorithm\n");
             return -1.0;
@@ -329,28 +597,495 @@ float analyse_get_song_pitch(PitchData *pitch_data, gchar * song_path)
     return -1.0;
 }
 
-static u_int32_t pitch_cerpstrum(PitchData *pitch_data)
+static float pitch_cerpstrum(PitchData *pitch_data, gchar *song_path)
+{
+    return pitch_from_song(pitch_data, song_path, pitch_cepstrum_frame);
+}
+
+/*YIN, the difference function is computed through the FFT*/
+static float pitch_autocorelation(PitchData *pitch_data, gchar *song_path)
+{
+    return pitch_from_song(pitch_data, song_path, pitch_yin_frame);
+}
+
+static float pitch_from_song(PitchData *pitch_data, gchar *song_path, PitchFrameFunc frame_func)
+{
+    PitchResult result;
+    gsize num_samples;
+    int error;
+    gfloat *samples = analyse_decode_song(song_path, pitch_data->audio_frequency, 1, &num_samples);
+    if(samples == NULL)
+    {
+        return -1.0;
+    }
+    error = pitch_estimate(samples, num_samples, pitch_data->audio_frequency,
+                            pitch_data->spect_bands, frame_func, &result);
+    g_free(samples);
+    if(error != 0)
+    {
+        g_printerr("Pitch estimation failed: %d\n", error);
+        return -1.0;
+    }
+    pitch_data->pitch = result.pitch;
+    pitch_data->confidence = result.confidence;
+    return result.pitch;
+}
+
+
+static int freq_vol_analyse(FrequencyVolData *freq_vol_data, gchar *song_path)
 {
+    BandVolumeState state;
+    int error;
+
+    if(freq_vol_data == NULL)
+    {
+        return -1;
+    }
+    if(song_path == NULL)
+    {
+        g_printerr("Song path is NULL");
+        return -1;
+    }
+    error = band_volume_init(&state, freq_vol_data->audio_frequency, freq_vol_data->spect_bands,
+                                freq_vol_data->low_freq_start, freq_vol_data->medium_freq_start,
+                                freq_vol_data->high_freq_start);
+    if(error != 0)
+    {
+        return -2;
+    }
+    /*Streams the song, only one frame is kept in memory*/
+    if(!analyse_decode_song_stream(song_path, freq_vol_data->audio_frequency, 1, freq_vol_process, &state))
+    {
+        band_volume_free(&state);
+        return -3;
+    }
+    band_volume_finish(&state, freq_vol_data->volume);
+    band_volume_free(&state);
     return 0;
 }
 
-static u_int32_t pitch_autocorelation(PitchData *pitch_data)
+static void freq_vol_process(const gfloat *samples, gsize num_frames, gpointer user_data)
+{
+    band_volume_process((BandVolumeState *)user_data, samples, num_frames);
+}
+
+static int analyse_song_pass(gchar *song_path, BPMData *bpm_data, PitchData *pitch_data,
+                                FrequencyVolData *freq_vol_data, AnalyseResult *result)
+{
+    AnalysePass pass;
+    BandVolumeState band_volume;
+    Decimator decimator;
+    TempoJob tempo_job;
+    TempoResult tempo;
+    PitchResult pitch;
+    int error = 0;
+
+    if(pitch_data != NULL && freq_vol_data != NULL &&
+        pitch_data->audio_frequency != freq_vol_data->audio_frequency)
+    {
+        g_printerr("Pitch and band volume analysis need the same audio frequency\n");
+        return -2;
+    }
+    memset(&pass, 0, sizeof(AnalysePass));
+    pass.buffer.channels = 1;
+    pass.tempo_buffer.channels = 1;
+    pass.keep_samples = pitch_data != NULL;
+    pass.rate = AUDIO_FREQUENCY;
+    if(pitch_data != NULL)
+    {
+        pass.rate = pitch_data->audio_frequency;
+    }
+    if(freq_vol_data != NULL)
+    {
+        pass.rate = freq_vol_data->audio_frequency;
+        if(band_volume_init(&band_volume, pass.rate, freq_vol_data->spect_bands, freq_vol_data->low_freq_start,
+                            freq_vol_data->medium_freq_start, freq_vol_data->high_freq_start) != 0)
+        {
+            return -2;
+        }
+        pass.band_volume = &band_volume;
+    }
+    if(bpm_data != NULL)
+    {
+        decimator_init(&decimator, decimator_factor(pass.rate, TEMPO_ANALYSIS_RATE), 1);
+        pass.decimator = &decimator;
+    }
+    /*Band volume and decimation run while decoding, the rest needs the whole song*/
+    if(!analyse_decode_song_stream(song_path, pass.rate, 1, analyse_pass_process, &pass))
+    {
+        error = -3;
+        goto exit;
+    }
+    result->duration = (gfloat)pass.frames / pass.rate;
+    if(pass.band_volume != NULL)
+    {
+        band_volume_finish(pass.band_volume, freq_vol_data->volume);
+        memcpy(result->volume, freq_vol_data->volume, sizeof(result->volume));
+    }
+    if(bpm_data != NULL)
+    {
+        /*Tempo runs beside pitch on a shared worker*/
+        tempo_job_start(&tempo_job, pass.tempo_buffer.samples, pass.tempo_buffer.used, pass.rate / decimator.factor);
+    }
+    if(pitch_data != NULL)
+    {
+        PitchFrameFunc frame_func = pitch_data->algo == AUTOCORELATION ? pitch_yin_frame : pitch_cepstrum_frame;
+        if(pitch_estimate(pass.buffer.samples, pass.buffer.used, pass.rate, pitch_data->spect_bands,
+                            frame_func, &pitch) == 0)
+        {
+            pitch_data->pitch = pitch.pitch;
+            pitch_data->confidence = pitch.confidence;
+            result->pitch = pitch.pitch;
+            result->pitch_confidence = pitch.confidence;
+        }
+        else
+        {
+            error = -4;
+        }
+    }
+    if(bpm_data != NULL)
+    {
+        if(tempo_job_wait(&tempo_job, &tempo) == 0)
+        {
+            bpm_data->bpm_data[0] = tempo.bpm;
+            bpm_data->bpm_num = 1;
+            bpm_data->bpm_estimate = tempo.bpm;
+            bpm_data->confidence = tempo.confidence;
+            result->bpm = tempo.bpm;
+            result->bpm_confidence = tempo.confidence;
+        }
+        else
+        {
+            error = -4;
+        }
+    }
+
+exit:
+    if(pass.band_volume != NULL)
+    {
+        band_volume_free(pass.band_volume);
+    }
+    if(pass.decimator != NULL)
+    {
+        decimator_free(pass.decimator);
+    }
+    g_free(pass.buffer.samples);
+    g_free(pass.tempo_buffer.samples);
+    return error;
+}
+
+static void analyse_pass_process(const gfloat *samples, gsize num_frames, gpointer user_data)
+{
+    AnalysePass *pass = user_data;
+    pass->frames += num_frames;
+    if(pass->keep_samples)
+    {
+        analyse_decode_buffer_append(&pass->buffer, samples, num_frames);
+    }
+    if(pass->decimator != NULL)
+    {
+        decimator_push(pass->decimator, samples, num_frames, analyse_buffer_append, &pass->tempo_buffer);
+    }
+    if(pass->band_volume != NULL)
+    {
+        band_volume_process(pass->band_volume, samples, num_frames);
+    }
+}
+
+static void analyse_buffer_append(const gfloat *samples, gsize num_samples, gpointer user_data)
+{
+    analyse_decode_buffer_append((DecodeBuffer *)user_data, samples, num_samples);
+}
+
+int analyse_init_sampling(AnalyseSampling *sampling,
+                            u_int32_t windows,
+                            gdouble window_seconds,
+                            gdouble skip,
+                            gfloat min_confidence)
 {
+    if(sampling == NULL)
+    {
+        return -1;
+    }
+    if(windows == 0 || window_seconds <= 0)
+    {
+        return -2;
+    }
+    if(skip < 0 || skip >= 0.5)
+    {
+        return -3;
+    }
+    sampling->windows = windows;
+    sampling->window_seconds = window_seconds;
+    sampling->skip = skip;
+    sampling->min_confidence = CLAMP(min_confidence, 0.0, 1.0);
+    return 0;
+}
+
+int analyse_song_sampled(gchar *song_path, BPMData *bpm_data, FrequencyVolData *freq_vol_data,
+                            const AnalyseSampling *sampling, AnalyseResult *result)
+{
+    AnalyseCacheRecord record;
+    gboolean fingerprinted;
+    SampledPass pass;
+    BandVolumeState band_volume;
+    int error;
+
+    if(song_path == NULL || sampling == NULL || result == NULL)
+    {
+        return -1;
+    }
+    memset(result, 0, sizeof(AnalyseResult));
+    /*Cached full results beat sampled ones*/
+    fingerprinted = cache_find(song_path, &record);
+    if(fingerprinted &&
+        (bpm_data == NULL || cache_get_bpm(&record, bpm_data, BPM_DETECTOR_NATIVE)) &&
+        (freq_vol_data == NULL || cache_get_freq_vol(&record, freq_vol_data)))
+    {
+        return analyse_song_keyed(song_path, &record, fingerprinted, bpm_data, NULL, freq_vol_data, result);
+    }
+    memset(&pass, 0, sizeof(SampledPass));
+    pass.buffer.channels = 1;
+    pass.tempo = bpm_data != NULL;
+    pass.rate = freq_vol_data != NULL ? freq_vol_data->audio_frequency : AUDIO_FREQUENCY;
+    pass.window_tempo = g_new0(TempoResult, sampling->windows);
+    decimator_init(&pass.decimator, decimator_factor(pass.rate, TEMPO_ANALYSIS_RATE), 1);
+    if(freq_vol_data != NULL)
+    {
+        if(band_volume_init(&band_volume, pass.rate, freq_vol_data->spect_bands, freq_vol_data->low_freq_start,
+                            freq_vol_data->medium_freq_start, freq_vol_data->high_freq_start) != 0)
+        {
+            decimator_free(&pass.decimator);
+            g_free(pass.window_tempo);
+            return -2;
+        }
+        pass.band_volume = &band_volume;
+    }
+    error = analyse_decode_song_windows(song_path, pass.rate, 1, sampling->windows, sampling->window_seconds,
+                                        sampling->skip, sampled_process, &pass);
+    if(error == 0)
+    {
+        sampled_finish_window(&pass);
+        result->sampled = TRUE;
+        if(pass.band_volume != NULL)
+        {
+            band_volume_finish(pass.band_volume, freq_vol_data->volume);
+            memcpy(result->volume, freq_vol_data->volume, sizeof(result->volume));
+        }
+        if(pass.tempo)
+        {
+            if(sampled_tempo(pass.window_tempo, sampling->windows, result) &&
+                result->bpm_confidence >= sampling->min_confidence)
+            {
+                bpm_data->bpm_data[0] = result->bpm;
+                bpm_data->bpm_num = 1;
+                bpm_data->bpm_estimate = result->bpm;
+                bpm_data->confidence = result->bpm_confidence;
+            }
+            else
+            {
+                result->sampled = FALSE;
+            }
+        }
+    }
+    if(pass.band_volume != NULL)
+    {
+        band_volume_free(pass.band_volume);
+    }
+    decimator_free(&pass.decimator);
+    g_free(pass.buffer.samples);
+    g_free(pass.window_tempo);
+    if(error == -1)
+    {
+        return -3;
+    }
+    if(!result->sampled)
+    {
+        DEBUG_PRINT(g_print("Sampled analysis not reliable for %s, analysing the whole song\n", song_path))
+        return analyse_song_keyed(song_path, &record, fingerprinted, bpm_data, NULL, freq_vol_data, result);
+    }
     return 0;
 }
 
+static void sampled_process(guint window, const gfloat *samples, gsize num_frames, gpointer user_data)
+{
+    SampledPass *pass = user_data;
+    if(window != pass->current)
+    {
+        sampled_finish_window(pass);
+        pass->current = window;
+    }
+    if(pass->tempo)
+    {
+        decimator_push(&pass->decimator, samples, num_frames, analyse_buffer_append, &pass->buffer);
+    }
+    if(pass->band_volume != NULL)
+    {
+        band_volume_process(pass->band_volume, samples, num_frames);
+    }
+}
+
+static void sampled_finish_window(SampledPass *pass)
+{
+    if(pass->band_volume != NULL)
+    {
+        band_volume_flush(pass->band_volume);
+    }
+    if(pass->tempo && pass->buffer.used > 0 &&
+        tempo_estimate(pass->buffer.samples, pass->buffer.used, pass->rate / pass->decimator.factor,
+                        &pass->window_tempo[pass->current]) != 0)
+    {
+        pass->window_tempo[pass->current].bpm = 0.0;
+    }
+    pass->buffer.used = 0;
+    decimator_reset(&pass->decimator);
+}
+
+/*Median of the window tempos, confidence drops with the windows that disagree*/
+static gboolean sampled_tempo(const TempoResult *window_tempo, guint windows, AnalyseResult *result)
+{
+    gfloat *bpm = g_new(gfloat, windows);
+    gfloat confidence = 0.0, median;
+    gdouble variance = 0.0;
+    guint valid = 0, agree = 0;
+
+    for(guint i = 0; i < windows; i++)
+    {
+        if(window_tempo[i].bpm > 0)
+        {
+            bpm[valid++] = window_tempo[i].bpm;
+            confidence += window_tempo[i].confidence;
+        }
+    }
+    if(valid == 0)
+    {
+        g_free(bpm);
+        return FALSE;
+    }
+    qsort(bpm, valid, sizeof(gfloat), compare_floats);
+    median = valid % 2 ? bpm[valid / 2] : 0.5 * (bpm[valid / 2 - 1] + bpm[valid / 2]);
+    for(guint i = 0; i < valid; i++)
+    {
+        variance += (bpm[i] - median) * (bpm[i] - median);
+        if(fabs(bpm[i] - median) <= SAMPLE_BPM_AGREEMENT * median)
+        {
+            agree++;
+        }
+    }
+    result->bpm = median;
+    result->bpm_spread = sqrt(variance / valid);
+    result->bpm_confidence = confidence / valid * agree / windows;
+    g_free(bpm);
+    return TRUE;
+}
 
 static void bpm_process_data(BPMData *bpm_data, gfloat bpm_value)
 {
-    
+    gfloat estimate;
+
+    bpm_data->bpm_data[bpm_data->bpm_num % PROB_NUM] = bpm_value;
+    bpm_data->bpm_num++;
+    bpm_stats_add(&bpm_data->stats, bpm_value);
+    switch(bpm_data->algo)
+    {
+        case MEDIUM:
+            estimate = bpm_stats_mean(&bpm_data->stats);
+            break;
+        case MEDIANA:
+            estimate = bpm_stats_median(&bpm_data->stats);
+            break;
+        case HISTOGRAM:
+            estimate = bpm_stats_histogram(&bpm_data->stats, &bpm_data->confidence);
+            break;
+        case LAST:
+        default:
+            estimate = bpm_value;
+            break;
+    }
+    if(bpm_data->bpm_num > 1 && fabsf(estimate - bpm_data->bpm_estimate) <= bpm_data->tolerance)
+    {
+        bpm_data->stable_count++;
+    }
+    else
+    {
+        bpm_data->stable_count = 0;
+    }
+    bpm_data->bpm_estimate = estimate;
+}
+
+static void bpm_native_process(const gfloat *samples, gsize num_frames, gpointer user_data)
+{
+    AnalysePass *pass = user_data;
+    decimator_push(pass->decimator, samples, num_frames, analyse_buffer_append, &pass->tempo_buffer);
+}
+
+/*Only the decimated song is kept in memory*/
+static float bpm_native(BPMData *bpm_data, gchar *song_path)
+{
+    AnalysePass pass;
+    Decimator decimator;
+    TempoResult tempo;
+    gboolean decoded;
+    int error;
+
+    memset(&pass, 0, sizeof(AnalysePass));
+    pass.tempo_buffer.channels = 1;
+    decimator_init(&decimator, decimator_factor(AUDIO_FREQUENCY, TEMPO_ANALYSIS_RATE), 1);
+    pass.decimator = &decimator;
+    decoded = analyse_decode_song_stream(song_path, AUDIO_FREQUENCY, 1, bpm_native_process, &pass);
+    error = decoded ? tempo_estimate(pass.tempo_buffer.samples, pass.tempo_buffer.used,
+                                        AUDIO_FREQUENCY / decimator.factor, &tempo) : -1;
+    decimator_free(&decimator);
+    g_free(pass.tempo_buffer.samples);
+    if(!decoded)
+    {
+        return DEFAULT_BPM;
+    }
+    if(error != 0)
+    {
+        g_printerr("Song is too short for tempo estimation\n");
+        return DEFAULT_BPM;
+    }
+    /*One estimate for the whole song, every policy gives the same result*/
+    bpm_data->bpm_data[0] = tempo.bpm;
+    bpm_data->bpm_num = 1;
+    bpm_data->bpm_estimate = tempo.bpm;
+    bpm_data->confidence = tempo.confidence;
+    return tempo.bpm;
 }
 
+static int compare_floats(const void *a, const void *b)
+{
+    gfloat fa = *(const gfloat *)a;
+    gfloat fb = *(const gfloat *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static void bpm_pad_added_handler(GstElement *src, GstPad *new_pad, BPMData *bpm_data)
+{
+    GstPad *sink_pad = gst_element_get_static_pad(bpm_data->audio_convert, "sink");
+    GstCaps *new_pad_caps = NULL;
+    const gchar *new_pad_type = NULL;
+
+    if(gst_pad_is_linked(sink_pad))
+    {
+        goto exit;
+    }
+    new_pad_caps = gst_pad_get_current_caps(new_pad);
+    new_pad_type = gst_structure_get_name(gst_caps_get_structure(new_pad_caps, 0));
+    if(!g_str_has_prefix(new_pad_type, "audio/x-raw"))
+    {
+        goto exit;
+    }
+    if(GST_PAD_LINK_FAILED(gst_pad_link(new_pad, sink_pad)))
+    {
+        DEBUG_PRINT(g_printerr("Type is '%s' but link failed.\n", new_pad_type))
+    }
 
-static float calculate_medium(float array[], int num){
-    float medium = 0.0;
-    for(int i = 0; i<num;i++)
+exit:
+    if(new_pad_caps != NULL)
     {
-        medium += array[i];
+        gst_caps_unref(new_pad_caps);
     }
-    return medium;
+    gst_object_unref(sink_pad);
 }
\ No newline at end of file
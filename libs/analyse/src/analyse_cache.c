@@ -0,0 +1,276 @@
+#include "analyse_cache.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+#define CACHE_READ_CHUNK 65536
+
+static guint64 fnv1a(guint64 hash, const guchar *data, gsize size)
+{
+    for(gsize i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static guint fingerprint_hash(gconstpointer key)
+{
+    const AnalyseFingerprint *fingerprint = key;
+    return (guint)(fingerprint->hash ^ (fingerprint->hash >> 32) ^ fingerprint->size);
+}
+
+static gboolean fingerprint_equal(gconstpointer a, gconstpointer b)
+{
+    const AnalyseFingerprint *fa = a;
+    const AnalyseFingerprint *fb = b;
+    return fa->size == fb->size && fa->mtime == fb->mtime && fa->hash == fb->hash;
+}
+
+static void cache_index_record(AnalyseCache *cache, const AnalyseCacheRecord *record)
+{
+    AnalyseCacheRecord *copy = g_hash_table_lookup(cache->index, &record->key);
+    /*A newer record for the same fingerprint is written over the old one, the key stays equal*/
+    if(copy != NULL)
+    {
+        memcpy(copy, record, sizeof(AnalyseCacheRecord));
+        return;
+    }
+    copy = pool_alloc(&cache->records);
+    memcpy(copy, record, sizeof(AnalyseCacheRecord));
+    /*The key lives inside the record*/
+    g_hash_table_insert(cache->index, &copy->key, copy);
+}
+
+/*valid_length is set to the end of the last complete record*/
+static gboolean cache_load(AnalyseCache *cache, const gchar *path, off_t *valid_length)
+{
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+    const AnalyseCacheHeader *header;
+    const gchar *contents;
+    gsize length, count;
+
+    if(mapped == NULL)
+    {
+        return FALSE;
+    }
+    contents = g_mapped_file_get_contents(mapped);
+    length = g_mapped_file_get_length(mapped);
+    header = (const AnalyseCacheHeader *)contents;
+    if(length < sizeof(AnalyseCacheHeader) || header->magic != ANALYSE_CACHE_MAGIC ||
+        header->record_size != sizeof(AnalyseCacheRecord))
+    {
+        g_mapped_file_unref(mapped);
+        return FALSE;
+    }
+    /*A torn last record from an interrupted write is skipped*/
+    count = (length - sizeof(AnalyseCacheHeader)) / sizeof(AnalyseCacheRecord);
+    *valid_length = (off_t)(sizeof(AnalyseCacheHeader) + count * sizeof(AnalyseCacheRecord));
+    for(gsize i = 0; i < count; i++)
+    {
+        AnalyseCacheRecord record;
+        memcpy(&record, contents + sizeof(AnalyseCacheHeader) + i * sizeof(AnalyseCacheRecord), sizeof(record));
+        if(record.version == ANALYSE_CACHE_VERSION)
+        {
+            cache_index_record(cache, &record);
+        }
+    }
+    g_mapped_file_unref(mapped);
+    return TRUE;
+}
+
+int analyse_cache_open(AnalyseCache *cache, const gchar *path)
+{
+    off_t valid_length = 0;
+
+    if(cache == NULL || path == NULL)
+    {
+        return -1;
+    }
+    /*Records are taken from the pool a block at a time, big libraries load without a malloc per song*/
+    cache->index = g_hash_table_new(fingerprint_hash, fingerprint_equal);
+    pool_init(&cache->records, sizeof(AnalyseCacheRecord), 0);
+    g_mutex_init(&cache->lock);
+    if(cache_load(cache, path, &valid_length))
+    {
+        /*Appending after a torn record would shift every later one off the record grid*/
+        cache->file = fopen(path, "ab");
+        if(cache->file != NULL && ftruncate(fileno(cache->file), valid_length) != 0)
+        {
+            fclose(cache->file);
+            cache->file = NULL;
+        }
+    }
+    else
+    {
+        AnalyseCacheHeader header = {ANALYSE_CACHE_MAGIC, sizeof(AnalyseCacheRecord)};
+        cache->file = fopen(path, "wb");
+        if(cache->file != NULL && fwrite(&header, sizeof(header), 1, cache->file) != 1)
+        {
+            fclose(cache->file);
+            cache->file = NULL;
+        }
+    }
+    if(cache->file == NULL)
+    {
+        g_printerr("Unable to open analysis cache %s\n", path);
+        g_hash_table_destroy(cache->index);
+        pool_free(&cache->records);
+        g_mutex_clear(&cache->lock);
+        return -2;
+    }
+    return 0;
+}
+
+void analyse_cache_close(AnalyseCache *cache)
+{
+    if(cache == NULL || cache->file == NULL)
+    {
+        return;
+    }
+    fclose(cache->file);
+    g_hash_table_destroy(cache->index);
+    pool_free(&cache->records);
+    g_mutex_clear(&cache->lock);
+    cache->file = NULL;
+    cache->index = NULL;
+}
+
+static gboolean hash_range(FILE *file, off_t offset, gsize size, guint64 *hash)
+{
+    guchar chunk[CACHE_READ_CHUNK];
+    if(fseeko(file, offset, SEEK_SET) != 0)
+    {
+        return FALSE;
+    }
+    while(size > 0)
+    {
+        gsize read = fread(chunk, 1, MIN(size, sizeof(chunk)), file);
+        if(read == 0)
+        {
+            return FALSE;
+        }
+        *hash = fnv1a(*hash, chunk, read);
+        size -= read;
+    }
+    return TRUE;
+}
+
+int analyse_cache_fingerprint(const gchar *song_path, AnalyseFingerprint *fingerprint)
+{
+    struct stat info;
+    FILE *file;
+    guint64 hash = FNV_OFFSET;
+    gsize head;
+    gboolean success;
+
+    if(song_path == NULL || fingerprint == NULL)
+    {
+        return -1;
+    }
+    if(stat(song_path, &info) != 0)
+    {
+        return -2;
+    }
+    file = fopen(song_path, "rb");
+    if(file == NULL)
+    {
+        return -2;
+    }
+    fingerprint->size = (guint64)info.st_size;
+    fingerprint->mtime = (gint64)info.st_mtime;
+    head = (gsize)MIN(fingerprint->size, ANALYSE_CACHE_HASH_BYTES);
+    success = hash_range(file, 0, head, &hash);
+    /*The tail only adds the part not already covered by the head*/
+    if(success && fingerprint->size > head)
+    {
+        gsize tail = (gsize)MIN(fingerprint->size - head, ANALYSE_CACHE_HASH_BYTES);
+        success = hash_range(file, (off_t)(fingerprint->size - tail), tail, &hash);
+    }
+    fclose(file);
+    if(!success)
+    {
+        return -3;
+    }
+    fingerprint->hash = hash;
+    return 0;
+}
+
+gboolean analyse_cache_lookup(AnalyseCache *cache, const AnalyseFingerprint *fingerprint, AnalyseCacheRecord *record)
+{
+    AnalyseCacheRecord *found;
+    if(cache == NULL || cache->index == NULL || fingerprint == NULL || record == NULL)
+    {
+        return FALSE;
+    }
+    g_mutex_lock(&cache->lock);
+    found = g_hash_table_lookup(cache->index, fingerprint);
+    if(found != NULL)
+    {
+        memcpy(record, found, sizeof(AnalyseCacheRecord));
+    }
+    g_mutex_unlock(&cache->lock);
+    return found != NULL;
+}
+
+int analyse_cache_store(AnalyseCache *cache, const AnalyseCacheRecord *record)
+{
+    AnalyseCacheRecord merged;
+    AnalyseCacheRecord *found;
+    int error = 0;
+
+    if(cache == NULL || cache->file == NULL || record == NULL)
+    {
+        return -1;
+    }
+    g_mutex_lock(&cache->lock);
+    found = g_hash_table_lookup(cache->index, &record->key);
+    if(found != NULL)
+    {
+        memcpy(&merged, found, sizeof(merged));
+    }
+    else
+    {
+        memset(&merged, 0, sizeof(merged));
+        merged.key = record->key;
+    }
+    merged.version = ANALYSE_CACHE_VERSION;
+    merged.flags |= record->flags;
+    if(record->flags & CACHE_HAS_BPM)
+    {
+        merged.bpm_config = record->bpm_config;
+        merged.bpm = record->bpm;
+        merged.bpm_confidence = record->bpm_confidence;
+    }
+    if(record->flags & CACHE_HAS_PITCH)
+    {
+        merged.pitch_config = record->pitch_config;
+        merged.pitch = record->pitch;
+        merged.pitch_confidence = record->pitch_confidence;
+    }
+    if(record->duration > 0)
+    {
+        merged.duration = record->duration;
+    }
+    if(record->flags & CACHE_HAS_VOLUME)
+    {
+        merged.volume_config = record->volume_config;
+        memcpy(merged.volume, record->volume, sizeof(merged.volume));
+    }
+    if(fwrite(&merged, sizeof(merged), 1, cache->file) != 1 || fflush(cache->file) != 0)
+    {
+        error = -2;
+    }
+    cache_index_record(cache, &merged);
+    g_mutex_unlock(&cache->lock);
+    return error;
+}
+
+guint32 analyse_cache_config_hash(const void *data, gsize size)
+{
+    guint64 hash = fnv1a(FNV_OFFSET, data, size);
+    return (guint32)(hash ^ (hash >> 32));
+}
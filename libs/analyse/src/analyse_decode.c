@@ -0,0 +1,320 @@
+#include "analyse_decode.h"
+#include "decode_chain.h"
+#include "mapped_source.h"
+#include <gst/app/gstappsink.h>
+#include <string.h>
+
+#define DECODE_APPSINK_MAX_BUFFERS 8
+#define DECODE_PULL_TIMEOUT (100 * GST_MSECOND)
+#define DECODE_PREROLL_TIMEOUT (5 * GST_SECOND)
+
+typedef struct _DecodePipeline
+{
+    GstElement *pipeline;
+    GstElement *audio_source;
+    GstElement *audio_decoder;     /*NULL when the direct chain is used*/
+    GstElement *audio_convert;
+    GstElement *audio_resample;
+    GstElement *caps_filter;
+    GstElement *app_sink;
+}DecodePipeline;
+
+static void decode_pad_added_handler(GstElement *src, GstPad *new_pad, DecodePipeline *decode);
+
+static gboolean decode_pipeline_build(DecodePipeline *decode, const gchar *song_path, guint rate, guint channels);
+
+static gboolean decode_pipeline_build(DecodePipeline *decode, const gchar *song_path, guint rate, guint channels)
+{
+    GstCaps *caps;
+    gboolean mapped;
+
+    decode->pipeline = gst_pipeline_new("DecodePipeline");
+    /*PCM WAV is pushed straight from the mapped file, no parser and no read copies*/
+    decode->audio_source = mapped_source_new(song_path);
+    mapped = decode->audio_source != NULL;
+    if(!mapped)
+    {
+        decode->audio_source = gst_element_factory_make("filesrc", "audio_file_src");
+    }
+    decode->audio_decoder = NULL;
+    decode->audio_convert = gst_element_factory_make("audioconvert", "audio_converter");
+    decode->audio_resample = gst_element_factory_make("audioresample", "audio_resampler");
+    decode->caps_filter = gst_element_factory_make("capsfilter", "caps_filter");
+    decode->app_sink = gst_element_factory_make("appsink", "app_sink");
+    if(!decode->pipeline || !decode->audio_source || !decode->audio_convert ||
+        !decode->audio_resample || !decode->caps_filter || !decode->app_sink)
+    {
+        g_printerr("ERROR: One or more element cant be created!\n");
+        return FALSE;
+    }
+    caps = gst_caps_new_simple("audio/x-raw",
+                                "format", G_TYPE_STRING, "F32LE",
+                                "layout", G_TYPE_STRING, "interleaved",
+                                "rate", G_TYPE_INT, (gint)rate,
+                                "channels", G_TYPE_INT, (gint)channels, NULL);
+    g_object_set(decode->caps_filter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+    if(!mapped)
+    {
+        g_object_set(decode->audio_source, "location", song_path, NULL);
+    }
+    /*Pull as fast as possible, but keep only a few buffers in flight*/
+    g_object_set(decode->app_sink, "sync", FALSE, "max-buffers", DECODE_APPSINK_MAX_BUFFERS, "drop", FALSE, NULL);
+
+    gst_bin_add_many(GST_BIN(decode->pipeline), decode->audio_source, decode->audio_convert,
+                        decode->audio_resample, decode->caps_filter, decode->app_sink, NULL);
+    if(!gst_element_link_many(decode->audio_convert, decode->audio_resample, decode->caps_filter, decode->app_sink, NULL) ||
+        (mapped && !gst_element_link(decode->audio_source, decode->audio_convert)))
+    {
+        g_printerr("ERROR: One or more element cant be linked!\n");
+        gst_object_unref(decode->pipeline);
+        return FALSE;
+    }
+    /*Known formats skip decodebin typefinding*/
+    if(mapped || decode_chain_link_file(GST_BIN(decode->pipeline), decode->audio_source, decode->audio_convert, song_path))
+    {
+        return TRUE;
+    }
+    decode->audio_decoder = gst_element_factory_make("decodebin", "audio_decoder");
+    if(!decode->audio_decoder || !gst_bin_add(GST_BIN(decode->pipeline), decode->audio_decoder) ||
+        !gst_element_link(decode->audio_source, decode->audio_decoder))
+    {
+        g_printerr("ERROR: One or more element cant be linked!\n");
+        gst_object_unref(decode->pipeline);
+        return FALSE;
+    }
+    g_signal_connect(decode->audio_decoder, "pad-added", G_CALLBACK(decode_pad_added_handler), decode);
+    return TRUE;
+}
+
+/*Waits for the next decoded sample. Returns 1 with a sample, 0 at the end of the song, -1 on error.*/
+static int decode_pull(DecodePipeline *decode, GstBus *bus, GstSample **sample)
+{
+    GstMessage *msg;
+    while(TRUE)
+    {
+        *sample = gst_app_sink_try_pull_sample(GST_APP_SINK(decode->app_sink), DECODE_PULL_TIMEOUT);
+        if(*sample != NULL)
+        {
+            return 1;
+        }
+        /*Either the end of the song or an error that will never let the appsink reach EOS*/
+        if(gst_app_sink_is_eos(GST_APP_SINK(decode->app_sink)))
+        {
+            return 0;
+        }
+        msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+        if(msg != NULL)
+        {
+            GError *err;
+            gchar *debug_info;
+            gst_message_parse_error(msg, &err, &debug_info);
+            g_printerr("Error received from element %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+            g_clear_error(&err);
+            g_free(debug_info);
+            gst_message_unref(msg);
+            return -1;
+        }
+    }
+}
+
+gboolean analyse_decode_song_stream(const gchar *song_path, guint rate, guint channels,
+                                    DecodeCallback callback, gpointer user_data)
+{
+    DecodePipeline decode;
+    GstBus *bus;
+    GstSample *sample;
+    int pulled;
+
+    if(song_path == NULL || callback == NULL || rate == 0 || channels == 0)
+    {
+        return FALSE;
+    }
+    if(!decode_pipeline_build(&decode, song_path, rate, channels))
+    {
+        return FALSE;
+    }
+    if(gst_element_set_state(decode.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        g_printerr("ERROR: Unable to set the decode pipeline to the playing state.\n");
+        gst_object_unref(decode.pipeline);
+        return FALSE;
+    }
+    bus = gst_element_get_bus(decode.pipeline);
+    while((pulled = decode_pull(&decode, bus, &sample)) == 1)
+    {
+        GstBuffer *buffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if(buffer != NULL && gst_buffer_map(buffer, &map, GST_MAP_READ))
+        {
+            callback((const gfloat *)map.data, map.size / (sizeof(gfloat) * channels), user_data);
+            gst_buffer_unmap(buffer, &map);
+        }
+        gst_sample_unref(sample);
+    }
+    gst_object_unref(bus);
+    gst_element_set_state(decode.pipeline, GST_STATE_NULL);
+    gst_object_unref(decode.pipeline);
+    return pulled == 0;
+}
+
+int analyse_decode_song_windows(const gchar *song_path, guint rate, guint channels,
+                                guint num_windows, gdouble window_seconds, gdouble skip,
+                                DecodeWindowCallback callback, gpointer user_data)
+{
+    DecodePipeline decode;
+    GstBus *bus;
+    gint64 duration = 0;
+    gint64 window_length = (gint64)(window_seconds * GST_SECOND);
+    gint64 span, first, step;
+    int error = 0;
+
+    if(song_path == NULL || callback == NULL || rate == 0 || channels == 0 || num_windows == 0 ||
+        window_seconds <= 0 || skip < 0 || skip >= 0.5)
+    {
+        return -1;
+    }
+    if(!decode_pipeline_build(&decode, song_path, rate, channels))
+    {
+        return -1;
+    }
+    /*Preroll so the duration is known and the pipeline can seek*/
+    if(gst_element_set_state(decode.pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+        gst_element_get_state(decode.pipeline, NULL, NULL, DECODE_PREROLL_TIMEOUT) != GST_STATE_CHANGE_SUCCESS)
+    {
+        g_printerr("ERROR: Unable to preroll the decode pipeline.\n");
+        gst_element_set_state(decode.pipeline, GST_STATE_NULL);
+        gst_object_unref(decode.pipeline);
+        return -1;
+    }
+    span = 0;
+    if(gst_element_query_duration(decode.pipeline, GST_FORMAT_TIME, &duration) && duration > 0)
+    {
+        span = (gint64)(duration * (1.0 - 2.0 * skip));
+    }
+    /*Unknown length or too short for separate windows, the caller should decode everything*/
+    if(span < window_length * num_windows)
+    {
+        gst_element_set_state(decode.pipeline, GST_STATE_NULL);
+        gst_object_unref(decode.pipeline);
+        return -2;
+    }
+    first = (gint64)(duration * skip);
+    step = num_windows > 1 ? (span - window_length) / (num_windows - 1) : 0;
+    bus = gst_element_get_bus(decode.pipeline);
+    for(guint window = 0; window < num_windows && error == 0; window++)
+    {
+        gint64 start = first + step * window;
+        gsize remaining = (gsize)(window_seconds * rate);
+        GstSample *sample;
+        int pulled = 1;
+
+        if(!gst_element_seek_simple(decode.pipeline, GST_FORMAT_TIME,
+                                    GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, start))
+        {
+            error = -2;
+            break;
+        }
+        if(window == 0 && gst_element_set_state(decode.pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+        {
+            error = -1;
+            break;
+        }
+        while(remaining > 0 && (pulled = decode_pull(&decode, bus, &sample)) == 1)
+        {
+            GstBuffer *buffer = gst_sample_get_buffer(sample);
+            GstMapInfo map;
+            if(buffer != NULL && gst_buffer_map(buffer, &map, GST_MAP_READ))
+            {
+                gsize frames = map.size / (sizeof(gfloat) * channels);
+                gsize skipped = 0;
+                /*Buffers still in flight from before the seek are dropped,
+                  one straddling the window start loses the frames before it*/
+                if(GST_CLOCK_TIME_IS_VALID(GST_BUFFER_PTS(buffer)) && (gint64)GST_BUFFER_PTS(buffer) < start)
+                {
+                    guint64 late = start - GST_BUFFER_PTS(buffer);
+                    guint64 length = GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) :
+                                        gst_util_uint64_scale(frames, GST_SECOND, rate);
+                    skipped = length <= late ? frames : MIN(gst_util_uint64_scale(late, rate, GST_SECOND), frames);
+                }
+                frames = MIN(frames - skipped, remaining);
+                if(frames > 0)
+                {
+                    callback(window, (const gfloat *)map.data + skipped * channels, frames, user_data);
+                    remaining -= frames;
+                }
+                gst_buffer_unmap(buffer, &map);
+            }
+            gst_sample_unref(sample);
+        }
+        if(remaining > 0 && pulled < 0)
+        {
+            error = -1;
+        }
+    }
+    gst_object_unref(bus);
+    gst_element_set_state(decode.pipeline, GST_STATE_NULL);
+    gst_object_unref(decode.pipeline);
+    return error;
+}
+
+void analyse_decode_buffer_append(DecodeBuffer *buffer, const gfloat *samples, gsize num_frames)
+{
+    gsize count = num_frames * buffer->channels;
+    if(buffer->used + count > buffer->allocated)
+    {
+        buffer->allocated = MAX(buffer->allocated * 2, buffer->used + count);
+        buffer->samples = g_renew(gfloat, buffer->samples, buffer->allocated);
+    }
+    memcpy(buffer->samples + buffer->used, samples, count * sizeof(gfloat));
+    buffer->used += count;
+}
+
+static void decode_accumulate(const gfloat *samples, gsize num_frames, gpointer user_data)
+{
+    analyse_decode_buffer_append((DecodeBuffer *)user_data, samples, num_frames);
+}
+
+gfloat *analyse_decode_song(const gchar *song_path, guint rate, guint channels, gsize *num_frames)
+{
+    DecodeBuffer accumulator = {NULL, 0, 0, channels};
+
+    if(num_frames == NULL)
+    {
+        return NULL;
+    }
+    *num_frames = 0;
+    if(!analyse_decode_song_stream(song_path, rate, channels, decode_accumulate, &accumulator))
+    {
+        g_free(accumulator.samples);
+        return NULL;
+    }
+    *num_frames = accumulator.used / MAX(channels, 1);
+    return accumulator.samples;
+}
+
+static void decode_pad_added_handler(GstElement *src, GstPad *new_pad, DecodePipeline *decode)
+{
+    GstPad *sink_pad = gst_element_get_static_pad(decode->audio_convert, "sink");
+    GstCaps *new_pad_caps = NULL;
+    const gchar *new_pad_type = NULL;
+
+    if(gst_pad_is_linked(sink_pad))
+    {
+        goto exit;
+    }
+    new_pad_caps = gst_pad_get_current_caps(new_pad);
+    new_pad_type = gst_structure_get_name(gst_caps_get_structure(new_pad_caps, 0));
+    if(!g_str_has_prefix(new_pad_type, "audio/x-raw"))
+    {
+        goto exit;
+    }
+    gst_pad_link(new_pad, sink_pad);
+
+exit:
+    if(new_pad_caps != NULL)
+    {
+        gst_caps_unref(new_pad_caps);
+    }
+    gst_object_unref(sink_pad);
+}
@@ -0,0 +1,126 @@
+#include "band_volume.h"
+#include <math.h>
+#include <string.h>
+
+#define BAND_VOLUME_MIN_FRAME 256
+#define BAND_VOLUME_FLOOR_DB -120.0f
+
+static guint band_bin(gdouble freq, guint rate, guint frame_size)
+{
+    gdouble bin = ceil(freq * frame_size / rate);
+    return (guint)CLAMP(bin, 1.0, frame_size / 2.0);
+}
+
+int band_volume_check_bands(guint rate, gdouble low_start, gdouble medium_start, gdouble high_start)
+{
+    if(low_start < 0 || medium_start < 0 || high_start < 0)
+    {
+        return -2;
+    }
+    /*The high band needs at least one bin below Nyquist*/
+    if(low_start >= medium_start || medium_start >= high_start || high_start >= rate / 2.0)
+    {
+        return -3;
+    }
+    return 0;
+}
+
+int band_volume_init(BandVolumeState *state, guint rate, guint frame_size,
+                        gdouble low_start, gdouble medium_start, gdouble high_start)
+{
+    gdouble window_power = 0.0;
+    int ret;
+
+    if(state == NULL || rate == 0)
+    {
+        return -1;
+    }
+    ret = band_volume_check_bands(rate, low_start, medium_start, high_start);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    memset(state, 0, sizeof(BandVolumeState));
+    frame_size = fft_next_pow2(MAX(frame_size, BAND_VOLUME_MIN_FRAME));
+    state->frame_size = frame_size;
+    state->hop = frame_size / 2;
+    /*DC is never part of a band, the high band runs up to Nyquist*/
+    state->band_start[BAND_LOW] = band_bin(low_start, rate, frame_size);
+    state->band_start[BAND_MEDIUM] = band_bin(medium_start, rate, frame_size);
+    state->band_start[BAND_HIGH] = band_bin(high_start, rate, frame_size);
+    state->band_end[BAND_LOW] = state->band_start[BAND_MEDIUM];
+    state->band_end[BAND_MEDIUM] = state->band_start[BAND_HIGH];
+    state->band_end[BAND_HIGH] = frame_size / 2;
+    if(stft_init(&state->stft, frame_size, state->hop, STFT_WINDOW_HANN) != 0)
+    {
+        return -1;
+    }
+    for(guint i = 0; i < frame_size; i++)
+    {
+        window_power += state->stft.window[i] * state->stft.window[i];
+    }
+    /*Parseval, one sided spectrum counts every bin twice*/
+    state->scale = (gfloat)(2.0 / (frame_size * window_power));
+    return 0;
+}
+
+static gfloat band_power(const gfloat *restrict re, const gfloat *restrict im, guint start, guint end)
+{
+    gfloat sum = 0.0f;
+    for(guint k = start; k < end; k++)
+    {
+        sum += re[k] * re[k] + im[k] * im[k];
+    }
+    return sum;
+}
+
+static void band_volume_frame(gfloat *re, gfloat *im, gpointer user_data)
+{
+    BandVolumeState *state = user_data;
+    for(guint band = 0; band < BAND_NUM; band++)
+    {
+        gdouble energy = state->scale * band_power(re, im, state->band_start[band], state->band_end[band]);
+        state->energy_sum[band] += energy;
+        state->energy_peak[band] = MAX(state->energy_peak[band], energy);
+    }
+    state->frames++;
+}
+
+void band_volume_process(BandVolumeState *state, const gfloat *samples, gsize num_samples)
+{
+    stft_push(&state->stft, samples, num_samples, band_volume_frame, state);
+}
+
+void band_volume_flush(BandVolumeState *state)
+{
+    stft_reset(&state->stft);
+}
+
+static gfloat to_db(gfloat value)
+{
+    if(value <= 0.0f)
+    {
+        return BAND_VOLUME_FLOOR_DB;
+    }
+    return MAX(20.0f * log10f(value), BAND_VOLUME_FLOOR_DB);
+}
+
+void band_volume_finish(BandVolumeState *state, BandVolume volumes[BAND_NUM])
+{
+    for(guint band = 0; band < BAND_NUM; band++)
+    {
+        volumes[band].rms = state->frames ? (gfloat)sqrt(state->energy_sum[band] / state->frames) : 0.0f;
+        volumes[band].peak = (gfloat)sqrt(state->energy_peak[band]);
+        volumes[band].rms_db = to_db(volumes[band].rms);
+        volumes[band].peak_db = to_db(volumes[band].peak);
+    }
+}
+
+void band_volume_free(BandVolumeState *state)
+{
+    if(state == NULL)
+    {
+        return;
+    }
+    stft_free(&state->stft);
+}
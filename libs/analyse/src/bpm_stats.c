@@ -0,0 +1,214 @@
+#include "bpm_stats.h"
+#include <string.h>
+
+void bpm_stats_init(BPMStats *stats)
+{
+    memset(stats, 0, sizeof(BPMStats));
+}
+
+gfloat bpm_stats_fold(gfloat bpm)
+{
+    if(bpm <= 0)
+    {
+        return bpm;
+    }
+    while(bpm < BPM_FOLD_LOW)
+    {
+        bpm *= 2.0f;
+    }
+    while(bpm >= 2.0 * BPM_FOLD_LOW)
+    {
+        bpm /= 2.0f;
+    }
+    return bpm;
+}
+
+static guint histogram_bin(gfloat bpm)
+{
+    guint bin = (guint)((bpm_stats_fold(bpm) - BPM_FOLD_LOW) / BPM_HISTOGRAM_RESOLUTION);
+    return MIN(bin, BPM_HISTOGRAM_BINS - 1);
+}
+
+/*Heap helpers, the max heap compares with the sign flipped*/
+static gboolean heap_before(const BPMStats *stats, gboolean upper, guint16 a, guint16 b)
+{
+    return upper ? stats->values[a] < stats->values[b] : stats->values[a] > stats->values[b];
+}
+
+static void heap_set(BPMStats *stats, guint16 *heap, guint index, guint16 slot)
+{
+    heap[index] = slot;
+    stats->position[slot] = (guint16)index;
+}
+
+static void heap_sift_up(BPMStats *stats, gboolean upper, guint index)
+{
+    guint16 *heap = upper ? stats->high : stats->low;
+    guint16 slot = heap[index];
+    while(index > 0)
+    {
+        guint parent = (index - 1) / 2;
+        if(!heap_before(stats, upper, slot, heap[parent]))
+        {
+            break;
+        }
+        heap_set(stats, heap, index, heap[parent]);
+        index = parent;
+    }
+    heap_set(stats, heap, index, slot);
+}
+
+static void heap_sift_down(BPMStats *stats, gboolean upper, guint index)
+{
+    guint16 *heap = upper ? stats->high : stats->low;
+    guint size = upper ? stats->high_size : stats->low_size;
+    guint16 slot = heap[index];
+    while(2 * index + 1 < size)
+    {
+        guint child = 2 * index + 1;
+        if(child + 1 < size && heap_before(stats, upper, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        if(!heap_before(stats, upper, heap[child], slot))
+        {
+            break;
+        }
+        heap_set(stats, heap, index, heap[child]);
+        index = child;
+    }
+    heap_set(stats, heap, index, slot);
+}
+
+static void heap_push(BPMStats *stats, gboolean upper, guint16 slot)
+{
+    guint *size = upper ? &stats->high_size : &stats->low_size;
+    stats->upper[slot] = upper;
+    heap_set(stats, upper ? stats->high : stats->low, *size, slot);
+    (*size)++;
+    heap_sift_up(stats, upper, *size - 1);
+}
+
+static void heap_remove(BPMStats *stats, guint16 slot)
+{
+    gboolean upper = stats->upper[slot];
+    guint16 *heap = upper ? stats->high : stats->low;
+    guint *size = upper ? &stats->high_size : &stats->low_size;
+    guint index = stats->position[slot];
+    guint16 moved;
+
+    (*size)--;
+    if(index == *size)
+    {
+        return;
+    }
+    /*The last element fills the hole and may have to move either way*/
+    moved = heap[*size];
+    heap_set(stats, heap, index, moved);
+    heap_sift_up(stats, upper, index);
+    heap_sift_down(stats, upper, stats->position[moved]);
+}
+
+static guint16 heap_pop(BPMStats *stats, gboolean upper)
+{
+    guint16 slot = upper ? stats->high[0] : stats->low[0];
+    heap_remove(stats, slot);
+    return slot;
+}
+
+/*Lower half holds the extra element of an odd window*/
+static void heaps_balance(BPMStats *stats)
+{
+    if(stats->low_size > stats->high_size + 1)
+    {
+        heap_push(stats, TRUE, heap_pop(stats, FALSE));
+    }
+    else if(stats->high_size > stats->low_size)
+    {
+        heap_push(stats, FALSE, heap_pop(stats, TRUE));
+    }
+}
+
+void bpm_stats_add(BPMStats *stats, gfloat bpm)
+{
+    guint16 slot = (guint16)stats->next;
+
+    if(stats->count == BPM_STATS_WINDOW)
+    {
+        /*Oldest tag leaves the window*/
+        heap_remove(stats, slot);
+        stats->sum -= stats->values[slot];
+        stats->histogram[histogram_bin(stats->values[slot])]--;
+        stats->count--;
+    }
+    stats->values[slot] = bpm;
+    stats->sum += bpm;
+    stats->histogram[histogram_bin(bpm)]++;
+    stats->count++;
+    stats->next = (stats->next + 1) % BPM_STATS_WINDOW;
+    heap_push(stats, stats->low_size > 0 && bpm > stats->values[stats->low[0]], slot);
+    heaps_balance(stats);
+}
+
+gfloat bpm_stats_last(const BPMStats *stats)
+{
+    if(stats->count == 0)
+    {
+        return -1.0f;
+    }
+    return stats->values[(stats->next + BPM_STATS_WINDOW - 1) % BPM_STATS_WINDOW];
+}
+
+gfloat bpm_stats_mean(const BPMStats *stats)
+{
+    if(stats->count == 0)
+    {
+        return -1.0f;
+    }
+    return (gfloat)(stats->sum / stats->count);
+}
+
+gfloat bpm_stats_median(const BPMStats *stats)
+{
+    if(stats->count == 0)
+    {
+        return -1.0f;
+    }
+    if(stats->low_size > stats->high_size)
+    {
+        return stats->values[stats->low[0]];
+    }
+    return 0.5f * (stats->values[stats->low[0]] + stats->values[stats->high[0]]);
+}
+
+gfloat bpm_stats_histogram(const BPMStats *stats, gfloat *agreement)
+{
+    guint best = 0, best_votes = 0;
+    gdouble weighted = 0.0;
+
+    if(stats->count == 0)
+    {
+        return -1.0f;
+    }
+    /*Votes of the neighbouring bins count too, tags jitter around the true tempo*/
+    for(guint i = 0; i < BPM_HISTOGRAM_BINS; i++)
+    {
+        guint votes = stats->histogram[i];
+        votes += i > 0 ? stats->histogram[i - 1] : 0;
+        votes += i + 1 < BPM_HISTOGRAM_BINS ? stats->histogram[i + 1] : 0;
+        if(votes > best_votes)
+        {
+            best_votes = votes;
+            best = i;
+        }
+    }
+    for(gint i = MAX((gint)best - 1, 0); i <= MIN((gint)best + 1, BPM_HISTOGRAM_BINS - 1); i++)
+    {
+        weighted += stats->histogram[i] * (BPM_FOLD_LOW + (i + 0.5) * BPM_HISTOGRAM_RESOLUTION);
+    }
+    if(agreement != NULL)
+    {
+        *agreement = (gfloat)best_votes / stats->count;
+    }
+    return (gfloat)(weighted / best_votes);
+}
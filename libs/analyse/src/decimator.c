@@ -0,0 +1,192 @@
+#include "decimator.h"
+#include "utils.h"
+#include <math.h>
+#include <string.h>
+
+/*Independent partial sums so the dot product vectorises without reassociating floats*/
+#define DECIMATOR_LANES 8
+
+guint decimator_factor(guint rate, guint target_rate)
+{
+    guint factor = DECIMATOR_MAX_FACTOR;
+    while(factor > 1 && (guint64)target_rate * factor > rate)
+    {
+        factor /= 2;
+    }
+    return factor;
+}
+
+/*Blackman windowed sinc, unity gain at DC. The transition band ends at the
+  output Nyquist frequency, everything folded back is at least 60 dB down.*/
+static void design_lowpass(gfloat *coeffs, guint taps, guint factor)
+{
+    const gdouble cutoff = DECIMATOR_CUTOFF * 0.5 / factor;
+    const gdouble center = (taps - 1) / 2.0;
+    gdouble sum = 0.0;
+
+    if(taps == 1)
+    {
+        coeffs[0] = 1.0f;
+        return;
+    }
+    for(guint i = 0; i < taps; i++)
+    {
+        gdouble x = i - center;
+        gdouble phase = 2.0 * M_PI * i / (taps - 1);
+        gdouble sinc = fabs(x) < 1e-9 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        gdouble window = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+        coeffs[i] = (gfloat)(sinc * window);
+        sum += coeffs[i];
+    }
+    for(guint i = 0; i < taps; i++)
+    {
+        coeffs[i] = (gfloat)(coeffs[i] / sum);
+    }
+}
+
+int decimator_init(Decimator *decimator, guint factor, guint channels)
+{
+    if(decimator == NULL)
+    {
+        return -1;
+    }
+    if(channels == 0 || factor == 0 || factor > DECIMATOR_MAX_FACTOR || (factor & (factor - 1)) != 0)
+    {
+        return -2;
+    }
+    memset(decimator, 0, sizeof(Decimator));
+    decimator->factor = factor;
+    decimator->channels = channels;
+    decimator->taps = factor == 1 ? 1 : factor * DECIMATOR_TAPS_PER_PHASE;
+    decimator->coeffs = g_new(gfloat, decimator->taps);
+    decimator->line = g_new0(gfloat, decimator->taps - 1 + DECIMATOR_BLOCK);
+    decimator->output = g_new(gfloat, DECIMATOR_BLOCK / factor + 1);
+    design_lowpass(decimator->coeffs, decimator->taps, factor);
+    return 0;
+}
+
+void decimator_free(Decimator *decimator)
+{
+    if(decimator == NULL)
+    {
+        return;
+    }
+    g_free(decimator->coeffs);
+    g_free(decimator->line);
+    g_free(decimator->output);
+    decimator->coeffs = NULL;
+    decimator->line = NULL;
+    decimator->output = NULL;
+}
+
+void decimator_reset(Decimator *decimator)
+{
+    memset(decimator->line, 0, (decimator->taps - 1) * sizeof(gfloat));
+    decimator->phase = 0;
+}
+
+static void downmix(const gfloat *restrict samples, gfloat *restrict mono, gsize num_frames, guint channels)
+{
+    const gfloat scale = 1.0f / channels;
+    if(channels == 1)
+    {
+        memcpy(mono, samples, num_frames * sizeof(gfloat));
+        return;
+    }
+    for(gsize i = 0; i < num_frames; i++)
+    {
+        gfloat sum = 0.0f;
+        for(guint c = 0; c < channels; c++)
+        {
+            sum += samples[i * channels + c];
+        }
+        mono[i] = sum * scale;
+    }
+}
+
+/*The filter is symmetric, so output i is a plain dot product over line[i .. i + taps)*/
+UTILS_TARGET_CLONES
+static gsize filter_block(const gfloat *restrict coeffs, guint taps, const gfloat *restrict line,
+                            guint first, guint count, guint factor, gfloat *restrict output)
+{
+    gsize written = 0;
+    const guint vector_taps = taps - taps % DECIMATOR_LANES;
+    for(guint i = first; i < count; i += factor)
+    {
+        const gfloat *window = line + i;
+        gfloat lanes[DECIMATOR_LANES] = {0};
+        gfloat sum = 0.0f;
+        for(guint k = 0; k < vector_taps; k += DECIMATOR_LANES)
+        {
+            for(guint l = 0; l < DECIMATOR_LANES; l++)
+            {
+                lanes[l] += coeffs[k + l] * window[k + l];
+            }
+        }
+        for(guint k = vector_taps; k < taps; k++)
+        {
+            sum += coeffs[k] * window[k];
+        }
+        for(guint l = 0; l < DECIMATOR_LANES; l++)
+        {
+            sum += lanes[l];
+        }
+        output[written++] = sum;
+    }
+    return written;
+}
+
+gsize decimator_process(Decimator *decimator, const gfloat *samples, gsize num_frames, gfloat *output)
+{
+    const guint history = decimator->taps - 1;
+    gsize written = 0;
+
+    while(num_frames > 0)
+    {
+        guint count = (guint)MIN(num_frames, DECIMATOR_BLOCK);
+        downmix(samples, decimator->line + history, count, decimator->channels);
+        written += filter_block(decimator->coeffs, decimator->taps, decimator->line,
+                                decimator->phase, count, decimator->factor, output + written);
+        /*Kept samples continue at the same spacing in the next block*/
+        if(decimator->phase < count)
+        {
+            decimator->phase += ((count - decimator->phase + decimator->factor - 1) / decimator->factor) * decimator->factor;
+        }
+        decimator->phase -= count;
+        memmove(decimator->line, decimator->line + count, history * sizeof(gfloat));
+        samples += (gsize)count * decimator->channels;
+        num_frames -= count;
+    }
+    return written;
+}
+
+void decimator_push(Decimator *decimator, const gfloat *samples, gsize num_frames,
+                    DecimatorCallback callback, gpointer user_data)
+{
+    while(num_frames > 0)
+    {
+        guint count = (guint)MIN(num_frames, DECIMATOR_BLOCK);
+        gsize written = decimator_process(decimator, samples, count, decimator->output);
+        if(written > 0)
+        {
+            callback(decimator->output, written, user_data);
+        }
+        samples += (gsize)count * decimator->channels;
+        num_frames -= count;
+    }
+}
+
+gfloat *decimator_run(const gfloat *samples, gsize num_frames, guint channels, guint factor, gsize *num_samples)
+{
+    Decimator decimator;
+    gfloat *output;
+
+    if(samples == NULL || num_samples == NULL || decimator_init(&decimator, factor, channels) != 0)
+    {
+        return NULL;
+    }
+    output = g_new(gfloat, num_frames / factor + 1);
+    *num_samples = decimator_process(&decimator, samples, num_frames, output);
+    decimator_free(&decimator);
+    return output;
+}
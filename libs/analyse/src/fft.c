@@ -0,0 +1,209 @@
+#include "fft.h"
+#include "utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*Cache line, also enough for AVX-512 loads*/
+#define FFT_BUFFER_ALIGN 64
+
+static FFTPlan *plan_cache[FFT_MAX_LOG2 + 1];
+static GMutex plan_cache_lock;
+
+guint fft_next_pow2(guint n)
+{
+    guint result = 1;
+    while(result < n)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+gfloat *fft_buffer_new(guint n)
+{
+    void *buffer = NULL;
+    if(posix_memalign(&buffer, FFT_BUFFER_ALIGN, MAX(n, 1) * sizeof(gfloat)) != 0)
+    {
+        return NULL;
+    }
+    memset(buffer, 0, MAX(n, 1) * sizeof(gfloat));
+    return buffer;
+}
+
+void fft_buffer_free(gfloat *buffer)
+{
+    free(buffer);
+}
+
+int fft_plan_init(FFTPlan *plan, guint n)
+{
+    if(plan == NULL)
+    {
+        return -1;
+    }
+    if(n < 2 || (n & (n - 1)) != 0)
+    {
+        return -2;
+    }
+    plan->n = n;
+    plan->log2n = 0;
+    while((1u << plan->log2n) < n)
+    {
+        plan->log2n++;
+    }
+    plan->bitrev = g_new(guint, n);
+    plan->twiddle_re = g_new(gfloat, n);
+    plan->twiddle_im = g_new(gfloat, n);
+    for(guint i = 0; i < n; i++)
+    {
+        guint reversed = 0;
+        for(guint bit = 0; bit < plan->log2n; bit++)
+        {
+            reversed |= ((i >> bit) & 1u) << (plan->log2n - 1 - bit);
+        }
+        plan->bitrev[i] = reversed;
+    }
+    plan->twiddle_re[0] = 0.0f;
+    plan->twiddle_im[0] = 0.0f;
+    for(guint half = 1; half < n; half <<= 1)
+    {
+        for(guint k = 0; k < half; k++)
+        {
+            plan->twiddle_re[half + k] = (gfloat)cos(M_PI * k / half);
+            plan->twiddle_im[half + k] = (gfloat)-sin(M_PI * k / half);
+        }
+    }
+    return 0;
+}
+
+void fft_plan_free(FFTPlan *plan)
+{
+    if(plan == NULL)
+    {
+        return;
+    }
+    g_free(plan->bitrev);
+    g_free(plan->twiddle_re);
+    g_free(plan->twiddle_im);
+    plan->bitrev = NULL;
+    plan->twiddle_re = NULL;
+    plan->twiddle_im = NULL;
+}
+
+const FFTPlan *fft_plan_get(guint n)
+{
+    guint log2n = 0;
+    FFTPlan *plan;
+
+    if(n < 2 || (n & (n - 1)) != 0)
+    {
+        return NULL;
+    }
+    while((1u << log2n) < n)
+    {
+        log2n++;
+    }
+    if(log2n > FFT_MAX_LOG2)
+    {
+        return NULL;
+    }
+    g_mutex_lock(&plan_cache_lock);
+    if(plan_cache[log2n] == NULL)
+    {
+        plan = g_new(FFTPlan, 1);
+        fft_plan_init(plan, n);
+        plan_cache[log2n] = plan;
+    }
+    plan = plan_cache[log2n];
+    g_mutex_unlock(&plan_cache_lock);
+    return plan;
+}
+
+/*The butterflies of one group, the halves are disjoint so the loop vectorises without
+  runtime overlap checks*/
+static inline void fft_butterflies(gfloat *restrict re_a, gfloat *restrict im_a,
+                                    gfloat *restrict re_b, gfloat *restrict im_b,
+                                    const gfloat *restrict wr, const gfloat *restrict wi,
+                                    gfloat direction, guint half)
+{
+    for(guint k = 0; k < half; k++)
+    {
+        gfloat w_im = direction * wi[k];
+        gfloat tr = re_b[k] * wr[k] - im_b[k] * w_im;
+        gfloat ti = re_b[k] * w_im + im_b[k] * wr[k];
+        re_b[k] = re_a[k] - tr;
+        im_b[k] = im_a[k] - ti;
+        re_a[k] += tr;
+        im_a[k] += ti;
+    }
+}
+
+UTILS_TARGET_CLONES
+static void fft_run(const FFTPlan *plan, gfloat *re, gfloat *im, gfloat direction)
+{
+    const guint n = plan->n;
+    for(guint i = 0; i < n; i++)
+    {
+        guint j = plan->bitrev[i];
+        if(j > i)
+        {
+            gfloat tmp = re[i];
+            re[i] = re[j];
+            re[j] = tmp;
+            tmp = im[i];
+            im[i] = im[j];
+            im[j] = tmp;
+        }
+    }
+    /*The first stage has only unit twiddles*/
+    for(guint a = 0; a < n; a += 2)
+    {
+        gfloat tr = re[a + 1], ti = im[a + 1];
+        re[a + 1] = re[a] - tr;
+        im[a + 1] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+    }
+    for(guint half = 2; half < n; half <<= 1)
+    {
+        const gfloat *wr = plan->twiddle_re + half;
+        const gfloat *wi = plan->twiddle_im + half;
+        for(guint start = 0; start < n; start += 2 * half)
+        {
+            fft_butterflies(re + start, im + start, re + start + half, im + start + half, wr, wi, direction, half);
+        }
+    }
+}
+
+void fft_forward(const FFTPlan *plan, gfloat *re, gfloat *im)
+{
+    fft_run(plan, re, im, 1.0f);
+}
+
+void fft_forward_batch(const FFTPlan *plan, gfloat *re, gfloat *im, guint count)
+{
+    for(guint i = 0; i < count; i++)
+    {
+        fft_run(plan, re + (gsize)i * plan->n, im + (gsize)i * plan->n, 1.0f);
+    }
+}
+
+void fft_inverse_batch(const FFTPlan *plan, gfloat *re, gfloat *im, guint count)
+{
+    for(guint i = 0; i < count; i++)
+    {
+        fft_inverse(plan, re + (gsize)i * plan->n, im + (gsize)i * plan->n);
+    }
+}
+
+void fft_inverse(const FFTPlan *plan, gfloat *re, gfloat *im)
+{
+    const gfloat scale = 1.0f / plan->n;
+    fft_run(plan, re, im, -1.0f);
+    for(guint i = 0; i < plan->n; i++)
+    {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
@@ -0,0 +1,396 @@
+#include "pitch.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define PITCH_MIN_FRAME 256
+/*Cepstral peak needed for a frame to count as voiced*/
+#define PITCH_CEPSTRUM_THRESHOLD 0.06f
+#define PITCH_LOG_FLOOR 1e-6f
+/*A peak at a fraction of the best lag this strong wins, guards against subharmonics*/
+#define PITCH_SUBHARMONIC_RATIO 0.5f
+#define PITCH_MAX_DIVISOR 4
+/*Below this many frames per worker a thread costs more than it saves*/
+#define PITCH_FRAMES_PER_THREAD 64
+#define PITCH_FRAME_SILENT -1.0f
+
+typedef struct _PitchJob
+{
+    const gfloat *samples;
+    gsize first;
+    gsize last;
+    gsize hop;
+    guint rate;
+    guint frame_size;
+    PitchFrameFunc frame_func;
+    gfloat *frame_pitch;    /*per frame estimate, PITCH_FRAME_SILENT for skipped frames*/
+    int error;
+}PitchJob;
+
+static int compare_pitch(const void *a, const void *b)
+{
+    gfloat fa = *(const gfloat *)a;
+    gfloat fb = *(const gfloat *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+int pitch_workspace_init(PitchWorkspace *workspace, guint frame_size, guint rate)
+{
+    if(workspace == NULL || rate == 0)
+    {
+        return -1;
+    }
+    frame_size = fft_next_pow2(MAX(frame_size, PITCH_MIN_FRAME));
+    workspace->frame_size = frame_size;
+    workspace->rate = rate;
+    workspace->min_lag = MAX((guint)(rate / PITCH_MAX_HZ), 2);
+    /*A few periods must fit in a frame, small frames lose the lowest pitches*/
+    workspace->max_lag = MIN((guint)(rate / PITCH_MIN_HZ), frame_size / 4);
+    if(workspace->max_lag <= workspace->min_lag)
+    {
+        return -2;
+    }
+    workspace->plan = fft_plan_get(frame_size);
+    workspace->window = stft_window_get(STFT_WINDOW_HANN, frame_size);
+    if(workspace->plan == NULL || workspace->window == NULL)
+    {
+        return -2;
+    }
+    workspace->re = fft_buffer_new(frame_size);
+    workspace->im = fft_buffer_new(frame_size);
+    workspace->diff = fft_buffer_new(workspace->max_lag + 2);
+    return 0;
+}
+
+void pitch_workspace_free(PitchWorkspace *workspace)
+{
+    if(workspace == NULL)
+    {
+        return;
+    }
+    fft_buffer_free(workspace->re);
+    fft_buffer_free(workspace->im);
+    fft_buffer_free(workspace->diff);
+    workspace->re = NULL;
+    workspace->im = NULL;
+    workspace->diff = NULL;
+}
+
+static gfloat frame_rms(const gfloat *restrict frame, guint n)
+{
+    gfloat sum = 0.0f;
+    for(guint i = 0; i < n; i++)
+    {
+        sum += frame[i] * frame[i];
+    }
+    return sqrtf(sum / n);
+}
+
+static void window_frame(const gfloat *restrict frame, const gfloat *restrict window,
+                            gfloat *restrict re, gfloat *restrict im, guint n)
+{
+    for(guint i = 0; i < n; i++)
+    {
+        re[i] = frame[i] * window[i];
+        im[i] = 0.0f;
+    }
+}
+
+static void log_spectrum(gfloat *restrict re, gfloat *restrict im, guint n)
+{
+    for(guint i = 0; i < n; i++)
+    {
+        re[i] = logf(sqrtf(re[i] * re[i] + im[i] * im[i]) + PITCH_LOG_FLOOR);
+        im[i] = 0.0f;
+    }
+}
+
+/*Parabolic interpolation of a peak, returns the fractional offset*/
+static gfloat peak_offset(gfloat left, gfloat center, gfloat right)
+{
+    gfloat denominator = left - 2.0f * center + right;
+    if(denominator >= 0.0f)
+    {
+        return 0.0f;
+    }
+    return CLAMP(0.5f * (left - right) / denominator, -0.5f, 0.5f);
+}
+
+gfloat pitch_cepstrum_frame(PitchWorkspace *workspace, const gfloat *frame)
+{
+    const guint n = workspace->frame_size;
+    gfloat *re = workspace->re;
+    gfloat *im = workspace->im;
+    guint best_lag = 0;
+    gfloat best = PITCH_CEPSTRUM_THRESHOLD;
+
+    if(frame_rms(frame, n) < PITCH_SILENCE_RMS)
+    {
+        return 0.0f;
+    }
+    window_frame(frame, workspace->window, re, im, n);
+    fft_forward(workspace->plan, re, im);
+    log_spectrum(re, im, n);
+    fft_inverse(workspace->plan, re, im);
+    /*Real cepstrum, the period shows up as a peak at its quefrency*/
+    for(guint lag = workspace->min_lag; lag <= workspace->max_lag; lag++)
+    {
+        if(re[lag] > best && re[lag] >= re[lag - 1] && re[lag] >= re[lag + 1])
+        {
+            best = re[lag];
+            best_lag = lag;
+        }
+    }
+    if(best_lag == 0)
+    {
+        return 0.0f;
+    }
+    for(guint divisor = PITCH_MAX_DIVISOR; divisor >= 2; divisor--)
+    {
+        guint center = (best_lag + divisor / 2) / divisor;
+        guint candidate = center;
+        if(center <= workspace->min_lag)
+        {
+            continue;
+        }
+        if(re[center - 1] > re[candidate])
+        {
+            candidate = center - 1;
+        }
+        if(re[center + 1] > re[candidate])
+        {
+            candidate = center + 1;
+        }
+        if(re[candidate] >= PITCH_SUBHARMONIC_RATIO * best)
+        {
+            best_lag = candidate;
+            break;
+        }
+    }
+    return workspace->rate / (best_lag + peak_offset(re[best_lag - 1], re[best_lag], re[best_lag + 1]));
+}
+
+/*Cross correlation of the first half of the frame with the whole frame.
+  Both real inputs go through one complex FFT and are separated afterwards.*/
+static void yin_correlation(PitchWorkspace *workspace, const gfloat *frame)
+{
+    const guint n = workspace->frame_size;
+    const guint half = n / 2;
+    gfloat *re = workspace->re;
+    gfloat *im = workspace->im;
+
+    for(guint i = 0; i < n; i++)
+    {
+        re[i] = i < half ? frame[i] : 0.0f;
+        im[i] = frame[i];
+    }
+    fft_forward(workspace->plan, re, im);
+    for(guint k = 0; k <= half; k++)
+    {
+        guint m = (n - k) & (n - 1);
+        gfloat a_re = 0.5f * (re[k] + re[m]);
+        gfloat a_im = 0.5f * (im[k] - im[m]);
+        gfloat b_re = 0.5f * (im[k] + im[m]);
+        gfloat b_im = -0.5f * (re[k] - re[m]);
+        gfloat p_re = a_re * b_re + a_im * b_im;
+        gfloat p_im = a_re * b_im - a_im * b_re;
+        re[k] = p_re;
+        im[k] = p_im;
+        re[m] = p_re;
+        im[m] = -p_im;
+    }
+    fft_inverse(workspace->plan, re, im);
+}
+
+/*Cumulative mean normalised difference d'(lag), d'(0) = 1*/
+static void yin_difference(PitchWorkspace *workspace, const gfloat *frame)
+{
+    const guint half = workspace->frame_size / 2;
+    const guint last = workspace->max_lag + 1;
+    const gfloat *correlation = workspace->re;
+    gfloat *diff = workspace->diff;
+    gdouble energy = 0.0, shifted, sum = 0.0;
+
+    for(guint i = 0; i < half; i++)
+    {
+        energy += frame[i] * frame[i];
+    }
+    shifted = energy;
+    diff[0] = 1.0f;
+    for(guint lag = 1; lag <= last; lag++)
+    {
+        gdouble value;
+        shifted += (gdouble)frame[lag + half - 1] * frame[lag + half - 1] - (gdouble)frame[lag - 1] * frame[lag - 1];
+        value = MAX(energy + shifted - 2.0 * correlation[lag], 0.0);
+        sum += value;
+        diff[lag] = sum > 0.0 ? (gfloat)(value * lag / sum) : 1.0f;
+    }
+}
+
+gfloat pitch_yin_frame(PitchWorkspace *workspace, const gfloat *frame)
+{
+    const gfloat *diff = workspace->diff;
+    guint lag;
+
+    if(frame_rms(frame, workspace->frame_size) < PITCH_SILENCE_RMS)
+    {
+        return 0.0f;
+    }
+    yin_correlation(workspace, frame);
+    yin_difference(workspace, frame);
+    for(lag = workspace->min_lag; lag <= workspace->max_lag; lag++)
+    {
+        if(diff[lag] < PITCH_YIN_THRESHOLD)
+        {
+            while(lag < workspace->max_lag && diff[lag + 1] < diff[lag])
+            {
+                lag++;
+            }
+            break;
+        }
+    }
+    if(lag > workspace->max_lag)
+    {
+        return 0.0f;
+    }
+    return workspace->rate / (lag + peak_offset(-diff[lag - 1], -diff[lag], -diff[lag + 1]));
+}
+
+/*Median over voiced frames, confidence is the share of analysed frames agreeing with it*/
+static void pitch_aggregate(const gfloat *frame_pitch, gsize frames, PitchResult *result)
+{
+    gfloat *estimates = g_new(gfloat, MAX(frames, 1));
+    gfloat median;
+    gsize voiced = 0, analysed = 0, agree = 0;
+
+    result->pitch = 0.0f;
+    result->confidence = 0.0f;
+    for(gsize i = 0; i < frames; i++)
+    {
+        if(frame_pitch[i] == PITCH_FRAME_SILENT)
+        {
+            continue;
+        }
+        analysed++;
+        if(frame_pitch[i] > 0.0f)
+        {
+            estimates[voiced++] = frame_pitch[i];
+        }
+    }
+    if(voiced == 0)
+    {
+        g_free(estimates);
+        return;
+    }
+    qsort(estimates, voiced, sizeof(gfloat), compare_pitch);
+    median = voiced % 2 ? estimates[voiced / 2] : 0.5f * (estimates[voiced / 2 - 1] + estimates[voiced / 2]);
+    for(gsize i = 0; i < voiced; i++)
+    {
+        if(fabsf(12.0f * log2f(estimates[i] / median)) <= PITCH_AGREE_SEMITONES)
+        {
+            agree++;
+        }
+    }
+    result->pitch = median;
+    result->confidence = (gfloat)agree / analysed;
+    g_free(estimates);
+}
+
+static gpointer pitch_worker(gpointer data)
+{
+    PitchJob *job = data;
+    PitchWorkspace workspace;
+
+    if(pitch_workspace_init(&workspace, job->frame_size, job->rate) != 0)
+    {
+        job->error = -1;
+        return NULL;
+    }
+    for(gsize frame = job->first; frame < job->last; frame++)
+    {
+        const gfloat *input = job->samples + frame * job->hop;
+        if(frame_rms(input, workspace.frame_size) < PITCH_SILENCE_RMS)
+        {
+            job->frame_pitch[frame] = PITCH_FRAME_SILENT;
+            continue;
+        }
+        job->frame_pitch[frame] = job->frame_func(&workspace, input);
+    }
+    pitch_workspace_free(&workspace);
+    return NULL;
+}
+
+int pitch_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                    guint frame_size, PitchFrameFunc frame_func, PitchResult *result)
+{
+    PitchJob *jobs;
+    GThread **threads;
+    gfloat *frame_pitch;
+    gsize frames, hop, per_thread;
+    guint num_threads;
+    int error = 0;
+
+    if(samples == NULL || result == NULL || frame_func == NULL || rate == 0)
+    {
+        return -1;
+    }
+    frame_size = fft_next_pow2(MAX(frame_size, PITCH_MIN_FRAME));
+    if(num_samples < frame_size)
+    {
+        return -2;
+    }
+    hop = frame_size / 2;
+    frames = (num_samples - frame_size) / hop + 1;
+    frame_pitch = g_new(gfloat, frames);
+    num_threads = (guint)CLAMP(frames / PITCH_FRAMES_PER_THREAD, 1, g_get_num_processors());
+    per_thread = (frames + num_threads - 1) / num_threads;
+    jobs = g_new0(PitchJob, num_threads);
+    threads = g_new0(GThread *, num_threads);
+    for(guint i = 0; i < num_threads; i++)
+    {
+        jobs[i].samples = samples;
+        jobs[i].first = MIN(i * per_thread, frames);
+        jobs[i].last = MIN((i + 1) * per_thread, frames);
+        jobs[i].hop = hop;
+        jobs[i].rate = rate;
+        jobs[i].frame_size = frame_size;
+        jobs[i].frame_func = frame_func;
+        jobs[i].frame_pitch = frame_pitch;
+        /*The calling thread takes the first share*/
+        if(i > 0)
+        {
+            threads[i] = g_thread_new("pitch", pitch_worker, &jobs[i]);
+        }
+    }
+    pitch_worker(&jobs[0]);
+    for(guint i = 0; i < num_threads; i++)
+    {
+        if(threads[i] != NULL)
+        {
+            g_thread_join(threads[i]);
+        }
+        if(jobs[i].error != 0)
+        {
+            error = jobs[i].error;
+        }
+    }
+    if(error == 0)
+    {
+        pitch_aggregate(frame_pitch, frames, result);
+    }
+    g_free(threads);
+    g_free(jobs);
+    g_free(frame_pitch);
+    return error;
+}
+
+int pitch_cepstrum_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                            guint frame_size, PitchResult *result)
+{
+    return pitch_estimate(samples, num_samples, rate, frame_size, pitch_cepstrum_frame, result);
+}
+
+int pitch_yin_estimate(const gfloat *samples, gsize num_samples, guint rate,
+                        guint frame_size, PitchResult *result)
+{
+    return pitch_estimate(samples, num_samples, rate, frame_size, pitch_yin_frame, result);
+}
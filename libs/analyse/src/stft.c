@@ -0,0 +1,182 @@
+#include "stft.h"
+#include <math.h>
+#include <string.h>
+
+static gfloat *window_cache[STFT_WINDOW_NUM][FFT_MAX_LOG2 + 1];
+static GMutex window_cache_lock;
+
+static gfloat window_value(StftWindow type, guint i, guint n)
+{
+    gdouble phase = 2.0 * M_PI * i / n;
+    switch(type)
+    {
+        case STFT_WINDOW_HAMMING:
+            return (gfloat)(0.54 - 0.46 * cos(phase));
+        case STFT_WINDOW_BLACKMAN:
+            return (gfloat)(0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase));
+        case STFT_WINDOW_HANN:
+        default:
+            return (gfloat)(0.5 - 0.5 * cos(phase));
+    }
+}
+
+const gfloat *stft_window_get(StftWindow type, guint n)
+{
+    guint log2n = 0;
+    gfloat *window;
+
+    if(type >= STFT_WINDOW_NUM || n < 2 || (n & (n - 1)) != 0)
+    {
+        return NULL;
+    }
+    while((1u << log2n) < n)
+    {
+        log2n++;
+    }
+    if(log2n > FFT_MAX_LOG2)
+    {
+        return NULL;
+    }
+    g_mutex_lock(&window_cache_lock);
+    if(window_cache[type][log2n] == NULL)
+    {
+        window = fft_buffer_new(n);
+        for(guint i = 0; i < n; i++)
+        {
+            window[i] = window_value(type, i, n);
+        }
+        window_cache[type][log2n] = window;
+    }
+    window = window_cache[type][log2n];
+    g_mutex_unlock(&window_cache_lock);
+    return window;
+}
+
+int stft_init(Stft *stft, guint frame_size, guint hop, StftWindow window)
+{
+    gdouble power = 0.0;
+
+    if(stft == NULL)
+    {
+        return -1;
+    }
+    if(hop == 0 || hop > frame_size)
+    {
+        return -2;
+    }
+    memset(stft, 0, sizeof(Stft));
+    stft->plan = fft_plan_get(frame_size);
+    stft->window = stft_window_get(window, frame_size);
+    if(stft->plan == NULL || stft->window == NULL)
+    {
+        return -2;
+    }
+    stft->frame_size = frame_size;
+    stft->hop = hop;
+    stft->ring = fft_buffer_new(frame_size);
+    stft->re = fft_buffer_new(frame_size);
+    stft->im = fft_buffer_new(frame_size);
+    stft->overlap = fft_buffer_new(frame_size);
+    /*Every output sample is covered by frame_size / hop windowed frames*/
+    for(guint i = 0; i < frame_size; i++)
+    {
+        power += stft->window[i] * stft->window[i];
+    }
+    stft->synthesis_gain = power > 0.0 ? (gfloat)(hop / power) : 1.0f;
+    return 0;
+}
+
+void stft_free(Stft *stft)
+{
+    if(stft == NULL)
+    {
+        return;
+    }
+    fft_buffer_free(stft->ring);
+    fft_buffer_free(stft->re);
+    fft_buffer_free(stft->im);
+    fft_buffer_free(stft->overlap);
+    stft->ring = NULL;
+    stft->re = NULL;
+    stft->im = NULL;
+    stft->overlap = NULL;
+}
+
+void stft_reset(Stft *stft)
+{
+    stft->ring_pos = 0;
+    stft->ring_fill = 0;
+    stft->since_frame = 0;
+}
+
+static void window_segment(const gfloat *restrict input, const gfloat *restrict window,
+                            gfloat *restrict re, gfloat *restrict im, guint n)
+{
+    for(guint i = 0; i < n; i++)
+    {
+        re[i] = input[i] * window[i];
+        im[i] = 0.0f;
+    }
+}
+
+void stft_analyse_frame(Stft *stft, const gfloat *frame)
+{
+    window_segment(frame, stft->window, stft->re, stft->im, stft->frame_size);
+    fft_forward(stft->plan, stft->re, stft->im);
+}
+
+/*The oldest sample sits at ring_pos, the frame is unrolled in two pieces*/
+static void stft_ring_frame(Stft *stft)
+{
+    const guint n = stft->frame_size;
+    const guint first = n - stft->ring_pos;
+    window_segment(stft->ring + stft->ring_pos, stft->window, stft->re, stft->im, first);
+    window_segment(stft->ring, stft->window + first, stft->re + first, stft->im + first, stft->ring_pos);
+    fft_forward(stft->plan, stft->re, stft->im);
+}
+
+void stft_push(Stft *stft, const gfloat *samples, gsize num_samples, StftFrameCallback callback, gpointer user_data)
+{
+    const guint n = stft->frame_size;
+    while(num_samples > 0)
+    {
+        /*Stop at the end of the ring and at the next frame boundary*/
+        guint until_frame = stft->ring_fill < n ? n - stft->ring_fill : stft->hop - stft->since_frame;
+        guint count = (guint)MIN(num_samples, (gsize)MIN(n - stft->ring_pos, until_frame));
+        memcpy(stft->ring + stft->ring_pos, samples, count * sizeof(gfloat));
+        stft->ring_pos = (stft->ring_pos + count) & (n - 1);
+        stft->ring_fill = MIN(stft->ring_fill + count, n);
+        stft->since_frame += count;
+        samples += count;
+        num_samples -= count;
+        if(stft->ring_fill == n && stft->since_frame >= stft->hop)
+        {
+            stft_ring_frame(stft);
+            stft->since_frame = 0;
+            callback(stft->re, stft->im, user_data);
+        }
+    }
+}
+
+static void overlap_accumulate(gfloat *restrict overlap, const gfloat *restrict frame,
+                                const gfloat *restrict window, guint n)
+{
+    for(guint i = 0; i < n; i++)
+    {
+        overlap[i] += frame[i] * window[i];
+    }
+}
+
+void stft_overlap_add(Stft *stft, gfloat *re, gfloat *im, gfloat *output)
+{
+    const guint n = stft->frame_size;
+    const guint hop = stft->hop;
+    fft_inverse(stft->plan, re, im);
+    overlap_accumulate(stft->overlap, re, stft->window, n);
+    for(guint i = 0; i < hop; i++)
+    {
+        output[i] = stft->overlap[i] * stft->synthesis_gain;
+    }
+    memmove(stft->overlap, stft->overlap + hop, (n - hop) * sizeof(gfloat));
+    memset(stft->overlap + n - hop, 0, hop * sizeof(gfloat));
+}
@@ -0,0 +1,383 @@
+#include "tempo.h"
+#include "stft.h"
+#include "decimator.h"
+#include "arena.h"
+#include <math.h>
+#include <string.h>
+
+#define TEMPO_FRAME 512
+#define TEMPO_HOP 128
+#define TEMPO_LOG_COMPRESSION 100.0f
+#define TEMPO_LOCAL_MEAN_S 0.5
+#define TEMPO_SMOOTH_FRAMES 7
+#define TEMPO_HARMONICS 4
+#define TEMPO_BPM_STEP 0.25
+#define TEMPO_PRIOR_OCTAVES 0.7
+/*The other octave of a pair has to be this much more likely to replace the comb pick*/
+#define TEMPO_OCTAVE_MARGIN 2.0f
+/*At least a few beats are needed for the autocorrelation*/
+#define TEMPO_MIN_SECONDS 4
+
+/*Shared by every analysis in the process, started with the first job*/
+static GMutex tempo_pool_lock;
+static GThreadPool *tempo_pool = NULL;
+static ArenaStats tempo_stats;
+
+static void log_magnitude(const gfloat *restrict re, const gfloat *restrict im, gfloat *restrict mag, guint n)
+{
+    for(guint i = 0; i < n; i++)
+    {
+        mag[i] = logf(1.0f + TEMPO_LOG_COMPRESSION * sqrtf(re[i] * re[i] + im[i] * im[i]));
+    }
+}
+
+static gfloat positive_flux(const gfloat *restrict current, const gfloat *restrict previous, guint n)
+{
+    gfloat flux = 0.0f;
+    for(guint i = 0; i < n; i++)
+    {
+        gfloat diff = current[i] - previous[i];
+        flux += diff > 0.0f ? diff : 0.0f;
+    }
+    return flux;
+}
+
+/*Spectral flux onset envelope, one value per hop*/
+static gfloat *onset_envelope(Arena *arena, const gfloat *samples, gsize num_samples, gsize *num_frames)
+{
+    const guint bins = TEMPO_FRAME / 2 + 1;
+    const FFTPlan *plan = fft_plan_get(TEMPO_FRAME);
+    const gfloat *window = stft_window_get(STFT_WINDOW_HANN, TEMPO_FRAME);
+    gfloat re[TEMPO_FRAME], im[TEMPO_FRAME];
+    gfloat *magnitude, *previous;
+    gfloat *envelope;
+    gsize frames;
+
+    if(num_samples < TEMPO_FRAME)
+    {
+        *num_frames = 0;
+        return NULL;
+    }
+    frames = (num_samples - TEMPO_FRAME) / TEMPO_HOP + 1;
+    magnitude = arena_new0(arena, gfloat, bins);
+    previous = arena_new0(arena, gfloat, bins);
+    envelope = arena_new(arena, gfloat, frames);
+    for(gsize frame = 0; frame < frames; frame++)
+    {
+        const gfloat *input = samples + frame * TEMPO_HOP;
+        gfloat *tmp;
+        for(guint i = 0; i < TEMPO_FRAME; i++)
+        {
+            re[i] = input[i] * window[i];
+            im[i] = 0.0f;
+        }
+        fft_forward(plan, re, im);
+        log_magnitude(re, im, magnitude, bins);
+        envelope[frame] = frame == 0 ? 0.0f : positive_flux(magnitude, previous, bins);
+        tmp = previous;
+        previous = magnitude;
+        magnitude = tmp;
+    }
+    *num_frames = frames;
+    return envelope;
+}
+
+/*Removes the slowly varying part, only the peaks carry the rhythm*/
+static void envelope_normalise(Arena *arena, gfloat *envelope, gsize frames, guint half_window)
+{
+    gfloat *local = arena_new(arena, gfloat, frames);
+    gdouble sum = 0.0;
+    gsize count = 0;
+    gsize head = 0, tail = 0;
+    for(gsize i = 0; i < frames; i++)
+    {
+        gsize end = MIN(frames, i + half_window + 1);
+        gsize start = i > half_window ? i - half_window : 0;
+        while(head < end)
+        {
+            sum += envelope[head++];
+            count++;
+        }
+        while(tail < start)
+        {
+            sum -= envelope[tail++];
+            count--;
+        }
+        local[i] = (gfloat)(sum / count);
+    }
+    for(gsize i = 0; i < frames; i++)
+    {
+        gfloat value = envelope[i] - local[i];
+        envelope[i] = value > 0.0f ? value : 0.0f;
+    }
+}
+
+/*Short low-pass so the autocorrelation peaks are wide enough for fractional lags*/
+static void envelope_smooth(Arena *arena, gfloat *envelope, gsize frames)
+{
+    gfloat kernel[TEMPO_SMOOTH_FRAMES];
+    gfloat kernel_sum = 0.0f;
+    gfloat *copy = arena_new(arena, gfloat, frames);
+    const gint half = TEMPO_SMOOTH_FRAMES / 2;
+    memcpy(copy, envelope, frames * sizeof(gfloat));
+    for(guint i = 0; i < TEMPO_SMOOTH_FRAMES; i++)
+    {
+        kernel[i] = 0.5f - 0.5f * cosf(2.0f * (gfloat)M_PI * (i + 1) / (TEMPO_SMOOTH_FRAMES + 1));
+        kernel_sum += kernel[i];
+    }
+    for(gsize i = 0; i < frames; i++)
+    {
+        gfloat acc = 0.0f;
+        for(gint k = -half; k <= half; k++)
+        {
+            gint64 index = (gint64)i + k;
+            if(index >= 0 && index < (gint64)frames)
+            {
+                acc += kernel[k + half] * copy[index];
+            }
+        }
+        envelope[i] = acc / kernel_sum;
+    }
+}
+
+static gfloat *autocorrelation(Arena *arena, const gfloat *envelope, gsize frames, guint *length)
+{
+    guint n = fft_next_pow2((guint)frames * 2);
+    const FFTPlan *plan = fft_plan_get(n);
+    gfloat *re = arena_new0(arena, gfloat, n);
+    gfloat *im = arena_new0(arena, gfloat, n);
+    memcpy(re, envelope, frames * sizeof(gfloat));
+    fft_forward(plan, re, im);
+    for(guint i = 0; i < n; i++)
+    {
+        re[i] = re[i] * re[i] + im[i] * im[i];
+        im[i] = 0.0f;
+    }
+    fft_inverse(plan, re, im);
+    *length = (guint)frames;
+    return re;
+}
+
+static gfloat lag_value(const gfloat *acf, guint length, gdouble lag)
+{
+    guint index = (guint)lag;
+    gdouble frac = lag - index;
+    if(index + 1 >= length)
+    {
+        return 0.0f;
+    }
+    return (gfloat)((1.0 - frac) * acf[index] + frac * acf[index + 1]);
+}
+
+/*Comb filter over the harmonics of the beat period*/
+static gfloat comb_score(const gfloat *acf, guint length, gdouble envelope_rate, gdouble bpm)
+{
+    gdouble lag = 60.0 * envelope_rate / bpm;
+    gfloat score = 0.0f;
+    for(guint k = 1; k <= TEMPO_HARMONICS; k++)
+    {
+        score += lag_value(acf, length, lag * k);
+    }
+    return score;
+}
+
+/*Share of the pulse at fast_bpm that is not also a pulse at half of it: onsets of the
+  slower tempo line up with even multiples of the fast period only, so the odd ones
+  carry the evidence for the faster octave. 0.0 - 1.0*/
+static gfloat octave_evidence(const gfloat *acf, guint length, gdouble envelope_rate, gdouble fast_bpm)
+{
+    gdouble lag = 60.0 * envelope_rate / fast_bpm;
+    gfloat odd = lag_value(acf, length, lag) + lag_value(acf, length, 3.0 * lag);
+    gfloat even = lag_value(acf, length, 2.0 * lag) + lag_value(acf, length, 4.0 * lag);
+    if(even <= 0.0f)
+    {
+        return 0.0f;
+    }
+    return CLAMP(odd / even, 0.0f, 1.0f);
+}
+
+static gfloat tempo_prior(gdouble bpm)
+{
+    gdouble octaves = log2(bpm / TEMPO_PRIOR_BPM) / TEMPO_PRIOR_OCTAVES;
+    return (gfloat)exp(-0.5 * octaves * octaves);
+}
+
+int tempo_estimate(const gfloat *samples, gsize num_samples, guint rate, TempoResult *result)
+{
+    /*Every frame buffer lives until the end of the estimate, the blocks are reused by the next song*/
+    Arena *arena = arena_scratch();
+    ArenaMark mark;
+    guint factor;
+    gsize decimated_num, frames;
+    gfloat *decimated, *envelope, *acf;
+    guint acf_length;
+    gdouble envelope_rate;
+    gdouble best_bpm = 0.0;
+    gfloat best_score = -1.0f, min_score = G_MAXFLOAT, sum_score = 0.0f;
+    guint num_scores = 0;
+
+    if(samples == NULL || result == NULL || rate == 0)
+    {
+        return -1;
+    }
+    if(num_samples < (gsize)rate * TEMPO_MIN_SECONDS)
+    {
+        return -2;
+    }
+    mark = arena_mark(arena);
+    /*Callers that decimated while decoding pass the reduced rate*/
+    factor = decimator_factor(rate, TEMPO_ANALYSIS_RATE);
+    if(factor > 1)
+    {
+        decimated = decimator_run(samples, num_samples, 1, factor, &decimated_num);
+        envelope = onset_envelope(arena, decimated, decimated_num, &frames);
+        g_free(decimated);
+    }
+    else
+    {
+        envelope = onset_envelope(arena, samples, num_samples, &frames);
+    }
+    if(envelope == NULL)
+    {
+        arena_release(arena, mark);
+        return -2;
+    }
+    envelope_rate = (gdouble)rate / factor / TEMPO_HOP;
+    envelope_normalise(arena, envelope, frames, (guint)(TEMPO_LOCAL_MEAN_S * envelope_rate / 2));
+    envelope_smooth(arena, envelope, frames);
+    acf = autocorrelation(arena, envelope, frames, &acf_length);
+
+    for(gdouble bpm = TEMPO_MIN_BPM; bpm <= TEMPO_MAX_BPM; bpm += TEMPO_BPM_STEP)
+    {
+        gfloat score = comb_score(acf, acf_length, envelope_rate, bpm);
+        gfloat weighted = score * tempo_prior(bpm);
+        if(weighted > best_score)
+        {
+            best_score = weighted;
+            best_bpm = bpm;
+        }
+        min_score = MIN(min_score, weighted);
+        sum_score += weighted;
+        num_scores++;
+    }
+    /*Octave folding. The prior weighted comb doubles half-time songs with nothing on the
+      off beats, so each octave pair is decided again on whether the faster pulse is
+      really there, weighted by the same prior.*/
+    if(best_bpm / 2.0 >= TEMPO_MIN_BPM &&
+        TEMPO_OCTAVE_MARGIN * octave_evidence(acf, acf_length, envelope_rate, best_bpm) * tempo_prior(best_bpm) <
+        tempo_prior(best_bpm / 2.0))
+    {
+        best_bpm /= 2.0;
+    }
+    else if(best_bpm * 2.0 <= TEMPO_MAX_BPM &&
+            octave_evidence(acf, acf_length, envelope_rate, best_bpm * 2.0) * tempo_prior(best_bpm * 2.0) >
+            TEMPO_OCTAVE_MARGIN * tempo_prior(best_bpm))
+    {
+        best_bpm *= 2.0;
+    }
+    /*Parabolic refinement around the grid maximum*/
+    {
+        gfloat left = comb_score(acf, acf_length, envelope_rate, best_bpm - TEMPO_BPM_STEP);
+        gfloat center = comb_score(acf, acf_length, envelope_rate, best_bpm);
+        gfloat right = comb_score(acf, acf_length, envelope_rate, best_bpm + TEMPO_BPM_STEP);
+        gfloat denominator = left - 2.0f * center + right;
+        if(denominator < 0.0f)
+        {
+            gfloat offset = 0.5f * (left - right) / denominator;
+            best_bpm += CLAMP(offset, -0.5f, 0.5f) * TEMPO_BPM_STEP;
+        }
+    }
+    arena_release(arena, mark);
+
+    result->bpm = (gfloat)best_bpm;
+    result->confidence = 0.0f;
+    if(best_score > min_score)
+    {
+        gfloat mean = sum_score / num_scores;
+        result->confidence = CLAMP((best_score - mean) / (best_score - min_score), 0.0f, 1.0f);
+    }
+    return 0;
+}
+
+static void tempo_job_done(TempoJob *job)
+{
+    g_mutex_lock(&job->lock);
+    job->done = TRUE;
+    g_cond_signal(&job->cond);
+    g_mutex_unlock(&job->lock);
+}
+
+static void tempo_worker(gpointer data, gpointer user_data)
+{
+    TempoJob *job = data;
+    Arena *arena = arena_scratch();
+    ArenaStats before = arena->stats;
+
+    job->error = tempo_estimate(job->samples, job->num_samples, job->rate, &job->result);
+    g_mutex_lock(&tempo_pool_lock);
+    tempo_stats.allocations += arena->stats.allocations - before.allocations;
+    tempo_stats.mallocs += arena->stats.mallocs - before.mallocs;
+    tempo_stats.capacity += arena->stats.capacity - before.capacity;
+    tempo_stats.peak = MAX(tempo_stats.peak, arena->stats.peak);
+    g_mutex_unlock(&tempo_pool_lock);
+    tempo_job_done(job);
+}
+
+int tempo_job_start(TempoJob *job, const gfloat *samples, gsize num_samples, guint rate)
+{
+    GThreadPool *pool;
+
+    if(job == NULL)
+    {
+        return -1;
+    }
+    memset(job, 0, sizeof(TempoJob));
+    job->samples = samples;
+    job->num_samples = num_samples;
+    job->rate = rate;
+    g_mutex_init(&job->lock);
+    g_cond_init(&job->cond);
+
+    g_mutex_lock(&tempo_pool_lock);
+    if(tempo_pool == NULL)
+    {
+        /*Exclusive threads are never stopped while idle*/
+        tempo_pool = g_thread_pool_new(tempo_worker, NULL, (gint)g_get_num_processors(), TRUE, NULL);
+    }
+    pool = tempo_pool;
+    g_mutex_unlock(&tempo_pool_lock);
+    if(pool == NULL || !g_thread_pool_push(pool, job, NULL))
+    {
+        job->error = tempo_estimate(samples, num_samples, rate, &job->result);
+        tempo_job_done(job);
+    }
+    return 0;
+}
+
+int tempo_job_wait(TempoJob *job, TempoResult *result)
+{
+    if(job == NULL)
+    {
+        return -1;
+    }
+    g_mutex_lock(&job->lock);
+    while(!job->done)
+    {
+        g_cond_wait(&job->cond, &job->lock);
+    }
+    g_mutex_unlock(&job->lock);
+    g_mutex_clear(&job->lock);
+    g_cond_clear(&job->cond);
+    if(result != NULL)
+    {
+        *result = job->result;
+    }
+    return job->error;
+}
+
+void tempo_worker_stats(ArenaStats *stats)
+{
+    g_mutex_lock(&tempo_pool_lock);
+    *stats = tempo_stats;
+    g_mutex_unlock(&tempo_pool_lock);
+}
\ No newline at end of file
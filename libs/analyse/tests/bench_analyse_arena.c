@@ -0,0 +1,123 @@
+#include "analyse_cache.h"
+#include "tempo.h"
+#include "utils.h"
+#include "arena.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define BENCH_TRACKS 10000
+#define BENCH_SECONDS 4
+/*Loudness frames sorted per track for the percentiles*/
+#define BENCH_FRAMES 4096
+
+/*Clicks at bpm over noise at TEMPO_ANALYSIS_RATE*/
+static gfloat *bench_track(gdouble bpm, guint32 *state, gsize *num_samples)
+{
+    gsize n = TEMPO_ANALYSIS_RATE * BENCH_SECONDS;
+    gfloat *samples = g_new(gfloat, n);
+    gdouble period = 60.0 / bpm * TEMPO_ANALYSIS_RATE;
+
+    for(gsize i = 0; i < n; i++)
+    {
+        samples[i] = 0.01f * test_signed_uniform(state);
+    }
+    for(guint beat = 0; beat * period < n; beat++)
+    {
+        gsize start = (gsize)(beat * period);
+        for(gsize k = 0; k < 400 && start + k < n; k++)
+        {
+            samples[start + k] += 0.8f * expf(-(gfloat)k / 60.0f) * test_signed_uniform(state);
+        }
+    }
+    *num_samples = n;
+    return samples;
+}
+
+static void bench_print_stats(const gchar *name, const ArenaStats *stats)
+{
+    printf("%-14s %9" G_GUINT64_FORMAT " allocations  %6" G_GUINT64_FORMAT " mallocs  %9" G_GUINT64_FORMAT
+            " avoided  peak %8" G_GSIZE_FORMAT " B  held %8" G_GSIZE_FORMAT " B\n",
+            name, stats->allocations, stats->mallocs, stats->allocations - stats->mallocs, stats->peak, stats->capacity);
+}
+
+/*Every track goes through tempo estimation, a sort of its loudness frames and a cache
+  store, the same allocation pattern as an analysis run over a library*/
+int main(void)
+{
+    gchar *directory = g_dir_make_tmp("bench_analyse_arena_XXXXXX", NULL);
+    gchar *cache_path;
+    gfloat *samples[4];
+    gfloat *frames = g_new(gfloat, BENCH_FRAMES);
+    const gdouble tempos[] = {90.0, 120.0, 128.0, 174.0};
+    gsize num_samples = 0;
+    guint32 state = 7;
+    AnalyseCache cache;
+    gint64 start, elapsed;
+
+    if(directory == NULL)
+    {
+        g_printerr("Cannot make a temporary directory\n");
+        return 1;
+    }
+    cache_path = g_build_filename(directory, "cache.idx", NULL);
+    if(analyse_cache_open(&cache, cache_path) != 0)
+    {
+        g_printerr("Cannot open the cache\n");
+        return 1;
+    }
+    for(guint i = 0; i < G_N_ELEMENTS(samples); i++)
+    {
+        samples[i] = bench_track(tempos[i], &state, &num_samples);
+    }
+
+    start = g_get_monotonic_time();
+    for(guint track = 0; track < BENCH_TRACKS; track++)
+    {
+        AnalyseCacheRecord record;
+        TempoResult tempo;
+
+        if(tempo_estimate(samples[track % G_N_ELEMENTS(samples)], num_samples, TEMPO_ANALYSIS_RATE, &tempo) != 0)
+        {
+            g_printerr("tempo failed\n");
+            return 1;
+        }
+        for(guint i = 0; i < BENCH_FRAMES; i++)
+        {
+            frames[i] = -60.0f + 30.0f * test_signed_uniform(&state);
+        }
+        utils_float_sort(frames, BENCH_FRAMES);
+
+        memset(&record, 0, sizeof(AnalyseCacheRecord));
+        record.key.size = track;
+        record.key.hash = track * 0x9e3779b97f4a7c15ull;
+        record.flags = CACHE_HAS_BPM;
+        record.bpm = tempo.bpm;
+        record.bpm_confidence = tempo.confidence;
+        if(analyse_cache_store(&cache, &record) != 0)
+        {
+            g_printerr("cache store failed\n");
+            return 1;
+        }
+    }
+    elapsed = g_get_monotonic_time() - start;
+
+    printf("%d tracks analysed in %.3f s, %.3f ms per track\n", BENCH_TRACKS, elapsed / 1e6, elapsed / 1000.0 / BENCH_TRACKS);
+    bench_print_stats("scratch arena", &arena_scratch()->stats);
+    bench_print_stats("cache pool", &cache.records.stats);
+
+    analyse_cache_close(&cache);
+    for(guint i = 0; i < G_N_ELEMENTS(samples); i++)
+    {
+        g_free(samples[i]);
+    }
+    g_free(frames);
+    remove(cache_path);
+    rmdir(directory);
+    g_free(cache_path);
+    g_free(directory);
+    return 0;
+}
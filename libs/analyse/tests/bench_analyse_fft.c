@@ -0,0 +1,143 @@
+#include "fft.h"
+#include "stft.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define BENCH_MIN_LOG2 6
+#define BENCH_MAX_LOG2 12
+#define BENCH_BATCH 64
+#define BENCH_RATE 44100
+#define BENCH_SECONDS 30
+
+/*Direct O(n^2) transform in double, the reference for correctness*/
+static void naive_dft(const gfloat *in_re, const gfloat *in_im, gdouble *out_re, gdouble *out_im, guint n)
+{
+    for(guint k = 0; k < n; k++)
+    {
+        gdouble sum_re = 0.0, sum_im = 0.0;
+        for(guint t = 0; t < n; t++)
+        {
+            gdouble angle = -2.0 * G_PI * (gdouble)((guint64)k * t % n) / n;
+            gdouble c = cos(angle), s = sin(angle);
+            sum_re += in_re[t] * c - in_im[t] * s;
+            sum_im += in_re[t] * s + in_im[t] * c;
+        }
+        out_re[k] = sum_re;
+        out_im[k] = sum_im;
+    }
+}
+
+static void bench_size(guint n, guint32 *state)
+{
+    const FFTPlan *plan = fft_plan_get(n);
+    gfloat *in_re = g_new(gfloat, n), *in_im = g_new(gfloat, n);
+    gfloat *re = fft_buffer_new(n * BENCH_BATCH), *im = fft_buffer_new(n * BENCH_BATCH);
+    gdouble *ref_re = g_new(gdouble, n), *ref_im = g_new(gdouble, n);
+    gdouble error = 0.0, scale = 0.0, round_trip = 0.0;
+    gint64 start, naive_time, fft_time = G_MAXINT64, batch_time;
+    guint repeats = MAX(4096 / n, 8);
+
+    for(guint i = 0; i < n; i++)
+    {
+        in_re[i] = test_signed_uniform(state);
+        in_im[i] = test_signed_uniform(state);
+    }
+    start = g_get_monotonic_time();
+    naive_dft(in_re, in_im, ref_re, ref_im, n);
+    naive_time = g_get_monotonic_time() - start;
+
+    for(guint r = 0; r < repeats; r++)
+    {
+        memcpy(re, in_re, n * sizeof(gfloat));
+        memcpy(im, in_im, n * sizeof(gfloat));
+        start = g_get_monotonic_time();
+        fft_forward(plan, re, im);
+        fft_time = MIN(fft_time, g_get_monotonic_time() - start);
+    }
+    for(guint k = 0; k < n; k++)
+    {
+        error = MAX(error, hypot(re[k] - ref_re[k], im[k] - ref_im[k]));
+        scale = MAX(scale, hypot(ref_re[k], ref_im[k]));
+    }
+    fft_inverse(plan, re, im);
+    for(guint i = 0; i < n; i++)
+    {
+        round_trip = MAX(round_trip, hypot(re[i] - in_re[i], im[i] - in_im[i]));
+    }
+
+    for(guint b = 0; b < BENCH_BATCH; b++)
+    {
+        memcpy(re + b * n, in_re, n * sizeof(gfloat));
+        memcpy(im + b * n, in_im, n * sizeof(gfloat));
+    }
+    start = g_get_monotonic_time();
+    fft_forward_batch(plan, re, im, BENCH_BATCH);
+    batch_time = g_get_monotonic_time() - start;
+
+    printf("n %5u  naive dft %10.3f ms  fft %8.3f us  batched %8.3f us  speedup %9.1fx  "
+            "max error %.2e  inverse round trip %.2e\n",
+            n, naive_time / 1000.0, (gdouble)fft_time, (gdouble)batch_time / BENCH_BATCH,
+            (gdouble)naive_time / MAX(fft_time, 1), error / scale, round_trip);
+    g_free(in_re);
+    g_free(in_im);
+    g_free(ref_re);
+    g_free(ref_im);
+    fft_buffer_free(re);
+    fft_buffer_free(im);
+}
+
+/*Analysis and overlap-add resynthesis of 30 s of noise, which must come back unchanged*/
+static void bench_stft(guint frame_size, guint hop, guint32 *state)
+{
+    gsize num_samples = (gsize)BENCH_RATE * BENCH_SECONDS;
+    gfloat *input = g_new(gfloat, num_samples);
+    gfloat *output = g_new0(gfloat, num_samples + frame_size);
+    gsize written = 0;
+    gdouble error = 0.0;
+    gint64 start, elapsed;
+    Stft stft;
+
+    for(gsize i = 0; i < num_samples; i++)
+    {
+        input[i] = test_signed_uniform(state);
+    }
+    if(stft_init(&stft, frame_size, hop, STFT_WINDOW_HANN) != 0)
+    {
+        g_printerr("stft init failed\n");
+        exit(1);
+    }
+    start = g_get_monotonic_time();
+    for(gsize offset = 0; offset + frame_size <= num_samples; offset += hop)
+    {
+        stft_analyse_frame(&stft, input + offset);
+        stft_overlap_add(&stft, stft.re, stft.im, output + written);
+        written += hop;
+    }
+    elapsed = g_get_monotonic_time() - start;
+    /*Every hop is complete once the frames starting on it were added, skip the fade in*/
+    for(gsize i = frame_size; i < written; i++)
+    {
+        error = MAX(error, fabs(output[i] - input[i]));
+    }
+    printf("stft %u/%u  analysis + overlap-add %8.3f ms  %7.1fx realtime  resynthesis error %.2e\n",
+            frame_size, hop, elapsed / 1000.0, BENCH_SECONDS / (elapsed / 1e6), error);
+    stft_free(&stft);
+    g_free(input);
+    g_free(output);
+}
+
+int main(void)
+{
+    guint32 state = 3;
+
+    for(guint log2n = BENCH_MIN_LOG2; log2n <= BENCH_MAX_LOG2; log2n++)
+    {
+        bench_size(1u << log2n, &state);
+    }
+    bench_stft(1024, 256, &state);
+    bench_stft(4096, 1024, &state);
+    return 0;
+}
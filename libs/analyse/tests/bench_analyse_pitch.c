@@ -0,0 +1,124 @@
+#include "pitch.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <math.h>
+
+#define BENCH_RATE 44100
+#define BENCH_SECONDS 30
+#define BENCH_FRAME 4096
+#define BENCH_REPEATS 3
+
+/*The time domain YIN the FFT path replaced, O(frame * max_lag) per frame*/
+static gfloat naive_yin_frame(PitchWorkspace *workspace, const gfloat *frame)
+{
+    const guint half = workspace->frame_size / 2;
+    gfloat *diff = workspace->diff;
+    gdouble sum = 0.0;
+    guint lag;
+
+    diff[0] = 1.0f;
+    for(lag = 1; lag <= workspace->max_lag + 1; lag++)
+    {
+        gdouble value = 0.0;
+        for(guint i = 0; i < half; i++)
+        {
+            gdouble delta = frame[i] - frame[i + lag];
+            value += delta * delta;
+        }
+        sum += value;
+        diff[lag] = sum > 0.0 ? (gfloat)(value * lag / sum) : 1.0f;
+    }
+    for(lag = workspace->min_lag; lag <= workspace->max_lag; lag++)
+    {
+        if(diff[lag] < PITCH_YIN_THRESHOLD)
+        {
+            while(lag < workspace->max_lag && diff[lag + 1] < diff[lag])
+            {
+                lag++;
+            }
+            break;
+        }
+    }
+    return lag > workspace->max_lag ? 0.0f : (gfloat)workspace->rate / lag;
+}
+
+/*Five harmonics with falling amplitude*/
+static gfloat *bench_tone(gdouble pitch, gsize num_samples)
+{
+    gfloat *samples = g_new(gfloat, num_samples);
+
+    for(gsize i = 0; i < num_samples; i++)
+    {
+        gdouble value = 0.0;
+        for(guint h = 1; h <= 5; h++)
+        {
+            value += 0.3 / h * sin(2.0 * G_PI * pitch * h * i / BENCH_RATE);
+        }
+        samples[i] = (gfloat)value;
+    }
+    return samples;
+}
+
+/*Best of BENCH_REPEATS full song estimates in seconds*/
+static gdouble bench_song(const gfloat *samples, gsize num_samples, PitchFrameFunc frame_func, PitchResult *result)
+{
+    gint64 best = G_MAXINT64;
+
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        gint64 start = g_get_monotonic_time();
+        if(pitch_estimate(samples, num_samples, BENCH_RATE, BENCH_FRAME, frame_func, result) != 0)
+        {
+            g_printerr("pitch estimate failed\n");
+            exit(1);
+        }
+        best = MIN(best, g_get_monotonic_time() - start);
+    }
+    return best / 1e6;
+}
+
+/*Microseconds per frame on one core*/
+static gdouble bench_frame(PitchWorkspace *workspace, const gfloat *samples, gsize frames, PitchFrameFunc frame_func)
+{
+    gint64 start = g_get_monotonic_time();
+    volatile gfloat sink = 0.0f;
+
+    for(gsize f = 0; f < frames; f++)
+    {
+        sink += frame_func(workspace, samples + f * BENCH_FRAME / 2);
+    }
+    (void)sink;
+    return (gdouble)(g_get_monotonic_time() - start) / frames;
+}
+
+int main(void)
+{
+    const gdouble pitches[] = {82.4, 110.0, 220.0, 440.0, 900.0};
+    const gsize num_samples = (gsize)BENCH_RATE * BENCH_SECONDS;
+    const gsize frames = 200;
+    PitchWorkspace workspace;
+
+    if(pitch_workspace_init(&workspace, BENCH_FRAME, BENCH_RATE) != 0)
+    {
+        g_printerr("workspace init failed\n");
+        return 1;
+    }
+    for(guint p = 0; p < G_N_ELEMENTS(pitches); p++)
+    {
+        gfloat *samples = bench_tone(pitches[p], num_samples);
+        PitchResult yin, cepstrum;
+        gdouble yin_time = bench_song(samples, num_samples, pitch_yin_frame, &yin);
+        gdouble cepstrum_time = bench_song(samples, num_samples, pitch_cepstrum_frame, &cepstrum);
+        gdouble yin_frame = bench_frame(&workspace, samples, frames, pitch_yin_frame);
+        gdouble cepstrum_frame = bench_frame(&workspace, samples, frames, pitch_cepstrum_frame);
+        gdouble naive_frame = bench_frame(&workspace, samples, frames, naive_yin_frame);
+
+        printf("%6.1f Hz  yin %7.2f Hz %6.1fx realtime  cepstrum %7.2f Hz %6.1fx realtime  "
+                "per frame: yin %7.1f us  cepstrum %7.1f us  naive yin %8.1f us (%5.1fx)\n",
+                pitches[p], yin.pitch, BENCH_SECONDS / yin_time, cepstrum.pitch, BENCH_SECONDS / cepstrum_time,
+                yin_frame, cepstrum_frame, naive_frame, naive_frame / yin_frame);
+        g_free(samples);
+    }
+    pitch_workspace_free(&workspace);
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "analyse.h"
+#include "tempo.h"
+#include "arena.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <gst/gst.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
+#define BENCH_SONGS 200
+#define BENCH_SECONDS 30
+/*Songs decoded through analyse_song, each is a WAV file*/
+#define BENCH_FILES 20
+#define BENCH_FILE_RATE 44100
+
+typedef struct _BenchThread
+{
+    const gfloat *samples;
+    gsize num_samples;
+    TempoResult result;
+    ArenaStats stats;
+}BenchThread;
+
+/*Clicks at bpm over noise*/
+static gfloat *bench_track(gdouble bpm, guint rate, guint32 *state, gsize *num_samples)
+{
+    gsize n = (gsize)rate * BENCH_SECONDS;
+    gfloat *samples = g_new(gfloat, n);
+    gdouble period = 60.0 / bpm * rate;
+
+    for(gsize i = 0; i < n; i++)
+    {
+        samples[i] = 0.01f * test_signed_uniform(state);
+    }
+    for(guint beat = 0; beat * period < n; beat++)
+    {
+        gsize start = (gsize)(beat * period);
+        for(gsize k = 0; k < rate / 25 && start + k < n; k++)
+        {
+            samples[start + k] += 0.8f * expf(-(gfloat)k * 200.0f / rate) * test_signed_uniform(state);
+        }
+    }
+    *num_samples = n;
+    return samples;
+}
+
+/*The old way, one thread per song, its scratch arena goes with it*/
+static gpointer bench_thread(gpointer data)
+{
+    BenchThread *job = data;
+    tempo_estimate(job->samples, job->num_samples, TEMPO_ANALYSIS_RATE, &job->result);
+    job->stats = arena_scratch()->stats;
+    return NULL;
+}
+
+static void bench_print_stats(const gchar *name, gint64 elapsed, guint songs, const ArenaStats *stats)
+{
+    printf("%-18s %8.3f ms per song  %8" G_GUINT64_FORMAT " allocations  %6" G_GUINT64_FORMAT " mallocs  %8"
+            G_GSIZE_FORMAT " B taken from the system\n",
+            name, elapsed / 1000.0 / songs, stats->allocations, stats->mallocs, stats->capacity);
+}
+
+static gboolean bench_write_wav(const gchar *path, const gfloat *samples, gsize num_samples)
+{
+    guint32 data_bytes = (guint32)(num_samples * 2);
+    guchar *data = g_malloc(TEST_WAV_HEADER_BYTES + data_bytes);
+    gboolean written;
+
+    test_wav_header(data, BENCH_FILE_RATE, 1, data_bytes);
+    for(gsize i = 0; i < num_samples; i++)
+    {
+        test_put_le(data + TEST_WAV_HEADER_BYTES + 2 * i, (guint16)(gint16)(CLAMP(samples[i], -1.0f, 1.0f) * 32000.0f), 2);
+    }
+    written = g_file_set_contents(path, (const gchar *)data, TEST_WAV_HEADER_BYTES + data_bytes, NULL);
+    g_free(data);
+    return written;
+}
+
+static gboolean bench_have_elements(const gchar *const *names, guint num)
+{
+    for(guint i = 0; i < num; i++)
+    {
+        GstElementFactory *factory = gst_element_factory_find(names[i]);
+        if(factory == NULL)
+        {
+            return FALSE;
+        }
+        gst_object_unref(factory);
+    }
+    return TRUE;
+}
+
+/*Whole songs through analyse_song, tempo runs on the shared workers beside the decode*/
+static void bench_analyse_song(guint32 *state)
+{
+    const gchar *const elements[] = {"audioconvert", "audioresample", "capsfilter", "appsink"};
+    gchar *directory;
+    gchar *paths[BENCH_FILES];
+    ArenaStats before, after;
+    gint64 start, elapsed;
+    guint failed = 0;
+
+    if(!bench_have_elements(elements, G_N_ELEMENTS(elements)))
+    {
+        printf("analyse_song skipped, audioconvert, audioresample or appsink is not installed\n");
+        return;
+    }
+    directory = g_dir_make_tmp("bench_analyse_tempo_XXXXXX", NULL);
+    if(directory == NULL)
+    {
+        g_printerr("Cannot make a temporary directory\n");
+        exit(1);
+    }
+    for(guint i = 0; i < BENCH_FILES; i++)
+    {
+        gsize num_samples;
+        gfloat *samples = bench_track(90.0 + 5.0 * i, BENCH_FILE_RATE, state, &num_samples);
+        gchar *name = g_strdup_printf("song%02u.wav", i);
+
+        paths[i] = g_build_filename(directory, name, NULL);
+        if(!bench_write_wav(paths[i], samples, num_samples))
+        {
+            g_printerr("Cannot write the test file\n");
+            exit(1);
+        }
+        g_free(name);
+        g_free(samples);
+    }
+    tempo_worker_stats(&before);
+    start = g_get_monotonic_time();
+    for(guint i = 0; i < BENCH_FILES; i++)
+    {
+        BPMData bpm_data;
+        AnalyseResult result;
+
+        analyse_init_bpm_data(&bpm_data, MEDIANA);
+        analyse_set_bpm_detector(&bpm_data, BPM_DETECTOR_NATIVE);
+        if(analyse_song(paths[i], &bpm_data, NULL, NULL, &result) != 0)
+        {
+            failed++;
+        }
+    }
+    elapsed = g_get_monotonic_time() - start;
+    tempo_worker_stats(&after);
+    after.allocations -= before.allocations;
+    after.mallocs -= before.mallocs;
+    after.capacity -= before.capacity;
+    bench_print_stats("analyse_song", elapsed, BENCH_FILES, &after);
+    if(failed > 0)
+    {
+        printf("%u of %u songs failed\n", failed, BENCH_FILES);
+    }
+    for(guint i = 0; i < BENCH_FILES; i++)
+    {
+        remove(paths[i]);
+        g_free(paths[i]);
+    }
+    rmdir(directory);
+    g_free(directory);
+}
+
+/*Arena counters of tempo estimation with a thread per song against the shared workers*/
+int main(int argc, char *argv[])
+{
+    const gdouble tempos[] = {90.0, 120.0, 128.0, 174.0};
+    gfloat *samples[G_N_ELEMENTS(tempos)];
+    ArenaStats threads = {0}, workers;
+    gsize num_samples = 0;
+    guint32 state = 9;
+    gint64 start, elapsed;
+
+    gst_init(&argc, &argv);
+    for(guint i = 0; i < G_N_ELEMENTS(tempos); i++)
+    {
+        samples[i] = bench_track(tempos[i], TEMPO_ANALYSIS_RATE, &state, &num_samples);
+    }
+
+    start = g_get_monotonic_time();
+    for(guint song = 0; song < BENCH_SONGS; song++)
+    {
+        BenchThread job = {samples[song % G_N_ELEMENTS(tempos)], num_samples, {0}, {0}};
+        g_thread_join(g_thread_new("tempo", bench_thread, &job));
+        threads.allocations += job.stats.allocations;
+        threads.mallocs += job.stats.mallocs;
+        threads.capacity += job.stats.capacity;
+    }
+    elapsed = g_get_monotonic_time() - start;
+    bench_print_stats("thread per song", elapsed, BENCH_SONGS, &threads);
+
+    start = g_get_monotonic_time();
+    for(guint song = 0; song < BENCH_SONGS; song++)
+    {
+        TempoJob job;
+        tempo_job_start(&job, samples[song % G_N_ELEMENTS(tempos)], num_samples, TEMPO_ANALYSIS_RATE);
+        tempo_job_wait(&job, NULL);
+    }
+    elapsed = g_get_monotonic_time() - start;
+    tempo_worker_stats(&workers);
+    bench_print_stats("shared workers", elapsed, BENCH_SONGS, &workers);
+
+    bench_analyse_song(&state);
+    for(guint i = 0; i < G_N_ELEMENTS(tempos); i++)
+    {
+        g_free(samples[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "analyse_cache.h"
+#include <glib-2.0/glib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+
+static void test_cache_store_bpm(AnalyseCache *cache, const gchar *song_path, gfloat bpm)
+{
+    AnalyseCacheRecord record;
+
+    memset(&record, 0, sizeof(AnalyseCacheRecord));
+    g_assert_cmpint(analyse_cache_fingerprint(song_path, &record.key), ==, 0);
+    record.flags = CACHE_HAS_BPM;
+    record.bpm = bpm;
+    g_assert_cmpint(analyse_cache_store(cache, &record), ==, 0);
+}
+
+static gfloat test_cache_lookup_bpm(AnalyseCache *cache, const gchar *song_path)
+{
+    AnalyseCacheRecord record;
+    AnalyseFingerprint key;
+
+    g_assert_cmpint(analyse_cache_fingerprint(song_path, &key), ==, 0);
+    if(!analyse_cache_lookup(cache, &key, &record) || !(record.flags & CACHE_HAS_BPM))
+    {
+        return -1.0f;
+    }
+    return record.bpm;
+}
+
+/*A record appended after a crash mid write has to land on the record grid*/
+static void test_cache_torn_tail(void)
+{
+    gchar *directory = g_dir_make_tmp("analyse_cache_XXXXXX", NULL);
+    gchar *cache_path = g_build_filename(directory, "cache.idx", NULL);
+    gchar *first_song = g_build_filename(directory, "first.wav", NULL);
+    gchar *second_song = g_build_filename(directory, "second.wav", NULL);
+    const gsize complete = sizeof(AnalyseCacheHeader) + sizeof(AnalyseCacheRecord);
+    AnalyseCache cache;
+    struct stat info;
+    FILE *file;
+    guchar torn[sizeof(AnalyseCacheRecord) / 2];
+
+    g_assert_nonnull(directory);
+    g_assert_true(g_file_set_contents(first_song, "first song", -1, NULL));
+    g_assert_true(g_file_set_contents(second_song, "second song", -1, NULL));
+
+    g_assert_cmpint(analyse_cache_open(&cache, cache_path), ==, 0);
+    test_cache_store_bpm(&cache, first_song, 140.0f);
+    analyse_cache_close(&cache);
+
+    file = fopen(cache_path, "ab");
+    g_assert_nonnull(file);
+    memset(torn, 0xab, sizeof(torn));
+    g_assert_cmpuint(fwrite(torn, sizeof(torn), 1, file), ==, 1);
+    fclose(file);
+
+    g_assert_cmpint(analyse_cache_open(&cache, cache_path), ==, 0);
+    g_assert_cmpfloat(test_cache_lookup_bpm(&cache, first_song), ==, 140.0f);
+    g_assert_cmpint(stat(cache_path, &info), ==, 0);
+    g_assert_cmpuint(info.st_size, ==, complete);
+    test_cache_store_bpm(&cache, second_song, 172.5f);
+    analyse_cache_close(&cache);
+
+    g_assert_cmpint(stat(cache_path, &info), ==, 0);
+    g_assert_cmpuint(info.st_size, ==, complete + sizeof(AnalyseCacheRecord));
+    g_assert_cmpint(analyse_cache_open(&cache, cache_path), ==, 0);
+    g_assert_cmpfloat(test_cache_lookup_bpm(&cache, first_song), ==, 140.0f);
+    g_assert_cmpfloat(test_cache_lookup_bpm(&cache, second_song), ==, 172.5f);
+    analyse_cache_close(&cache);
+
+    remove(cache_path);
+    remove(first_song);
+    remove(second_song);
+    rmdir(directory);
+    g_free(cache_path);
+    g_free(first_song);
+    g_free(second_song);
+    g_free(directory);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/analyse/cache/torn_tail", test_cache_torn_tail);
+    return g_test_run();
+}
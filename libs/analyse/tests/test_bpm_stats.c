@@ -0,0 +1,188 @@
+#include "bpm_stats.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define TEST_RANDOM_TAGS 200000
+
+static int test_float_compare(const void *a, const void *b)
+{
+    gfloat x = *(const gfloat *)a, y = *(const gfloat *)b;
+    return (x > y) - (x < y);
+}
+
+/*Median of the window sorted from scratch*/
+static gfloat test_reference_median(const BPMStats *stats)
+{
+    gfloat sorted[BPM_STATS_WINDOW];
+
+    memcpy(sorted, stats->values, stats->count * sizeof(gfloat));
+    qsort(sorted, stats->count, sizeof(gfloat), test_float_compare);
+    if(stats->count % 2 == 1)
+    {
+        return sorted[stats->count / 2];
+    }
+    return 0.5f * (sorted[stats->count / 2 - 1] + sorted[stats->count / 2]);
+}
+
+/*Heap order, the position index, the split between the halves and their sizes*/
+static void test_check_heaps(const BPMStats *stats)
+{
+    g_assert_cmpuint(stats->low_size + stats->high_size, ==, stats->count);
+    g_assert_cmpuint(stats->low_size, >=, stats->high_size);
+    g_assert_cmpuint(stats->low_size, <=, stats->high_size + 1);
+    for(guint i = 0; i < stats->low_size; i++)
+    {
+        g_assert_cmpuint(stats->position[stats->low[i]], ==, i);
+        g_assert_false(stats->upper[stats->low[i]]);
+        if(i > 0)
+        {
+            g_assert_cmpfloat(stats->values[stats->low[i]], <=, stats->values[stats->low[(i - 1) / 2]]);
+        }
+    }
+    for(guint i = 0; i < stats->high_size; i++)
+    {
+        g_assert_cmpuint(stats->position[stats->high[i]], ==, i);
+        g_assert_true(stats->upper[stats->high[i]]);
+        if(i > 0)
+        {
+            g_assert_cmpfloat(stats->values[stats->high[i]], >=, stats->values[stats->high[(i - 1) / 2]]);
+        }
+    }
+    if(stats->high_size > 0)
+    {
+        g_assert_cmpfloat(stats->values[stats->low[0]], <=, stats->values[stats->high[0]]);
+    }
+}
+
+static void test_bpm_stats_check(const BPMStats *stats)
+{
+    gdouble sum = 0.0;
+
+    for(guint i = 0; i < stats->count; i++)
+    {
+        sum += stats->values[i];
+    }
+    test_check_heaps(stats);
+    g_assert_cmpfloat(bpm_stats_median(stats), ==, test_reference_median(stats));
+    g_assert_cmpfloat_with_epsilon(bpm_stats_mean(stats), sum / stats->count, 1e-2);
+}
+
+static void test_bpm_stats_empty(void)
+{
+    BPMStats stats;
+
+    bpm_stats_init(&stats);
+    g_assert_cmpfloat(bpm_stats_last(&stats), ==, -1.0f);
+    g_assert_cmpfloat(bpm_stats_mean(&stats), ==, -1.0f);
+    g_assert_cmpfloat(bpm_stats_median(&stats), ==, -1.0f);
+    g_assert_cmpfloat(bpm_stats_histogram(&stats, NULL), ==, -1.0f);
+}
+
+/*Random tags with many repeats, the window is full for nearly all of them*/
+static void test_bpm_stats_random(void)
+{
+    BPMStats stats;
+    guint32 state = 5;
+
+    bpm_stats_init(&stats);
+    for(guint i = 0; i < TEST_RANDOM_TAGS; i++)
+    {
+        /*Every other tag lands on a 1 bpm grid so equal values meet in the heaps*/
+        gfloat bpm = 60.0f + 140.0f * test_uniform(&state);
+        if(i % 2 == 0)
+        {
+            bpm = floorf(bpm);
+        }
+        bpm_stats_add(&stats, bpm);
+        g_assert_cmpfloat(bpm_stats_last(&stats), ==, bpm);
+        test_bpm_stats_check(&stats);
+    }
+    g_assert_cmpuint(stats.count, ==, BPM_STATS_WINDOW);
+}
+
+/*Rising tags evict the oldest from the lower heap, falling ones from the upper heap,
+  both times the halves have to be rebalanced afterwards*/
+static void test_bpm_stats_eviction(void)
+{
+    for(gint direction = -1; direction <= 1; direction += 2)
+    {
+        gboolean evicted_upper = direction < 0;
+        guint evictions = 0;
+        BPMStats stats;
+
+        bpm_stats_init(&stats);
+        for(guint i = 0; i < 3 * BPM_STATS_WINDOW; i++)
+        {
+            if(stats.count == BPM_STATS_WINDOW)
+            {
+                g_assert_cmpint(stats.upper[stats.next], ==, evicted_upper);
+                evictions++;
+            }
+            bpm_stats_add(&stats, 120.0f + direction * 0.25f * i);
+            test_bpm_stats_check(&stats);
+        }
+        g_assert_cmpuint(evictions, ==, 2 * BPM_STATS_WINDOW);
+        /*The window holds the last BPM_STATS_WINDOW tags only*/
+        g_assert_cmpfloat(bpm_stats_median(&stats), ==, 120.0f + direction * 0.25f * (2.5f * BPM_STATS_WINDOW - 0.5f));
+    }
+}
+
+static void test_bpm_stats_fold(void)
+{
+    g_assert_cmpfloat(bpm_stats_fold(65.0f), ==, 130.0f);
+    g_assert_cmpfloat(bpm_stats_fold(260.0f), ==, 130.0f);
+    g_assert_cmpfloat(bpm_stats_fold(520.0f), ==, 130.0f);
+    g_assert_cmpfloat(bpm_stats_fold((gfloat)BPM_FOLD_LOW), ==, (gfloat)BPM_FOLD_LOW);
+    g_assert_cmpfloat(bpm_stats_fold(2.0f * (gfloat)BPM_FOLD_LOW), ==, (gfloat)BPM_FOLD_LOW);
+    g_assert_cmpfloat(bpm_stats_fold(0.0f), ==, 0.0f);
+}
+
+/*Half and double tempo tags vote for the same bin, old votes leave with their tags*/
+static void test_bpm_stats_histogram(void)
+{
+    const gfloat octaves[] = {65.0f, 130.0f, 260.0f};
+    gfloat agreement = 0.0f;
+    guint votes = 0;
+    BPMStats stats;
+
+    bpm_stats_init(&stats);
+    for(guint i = 0; i < BPM_STATS_WINDOW; i++)
+    {
+        bpm_stats_add(&stats, octaves[i % G_N_ELEMENTS(octaves)]);
+    }
+    g_assert_cmpfloat_with_epsilon(bpm_stats_histogram(&stats, &agreement), 130.0, BPM_HISTOGRAM_RESOLUTION);
+    g_assert_cmpfloat(agreement, ==, 1.0f);
+
+    /*A different tempo takes over once it fills the window*/
+    for(guint i = 0; i < BPM_STATS_WINDOW; i++)
+    {
+        bpm_stats_add(&stats, i % 2 == 0 ? 50.0f : 200.0f);
+    }
+    g_assert_cmpfloat_with_epsilon(bpm_stats_histogram(&stats, &agreement), 100.0, BPM_HISTOGRAM_RESOLUTION);
+    g_assert_cmpfloat(agreement, ==, 1.0f);
+    for(guint i = 0; i < BPM_HISTOGRAM_BINS; i++)
+    {
+        votes += stats.histogram[i];
+    }
+    g_assert_cmpuint(votes, ==, BPM_STATS_WINDOW);
+
+    /*Both ends of the range land inside the histogram*/
+    bpm_stats_init(&stats);
+    bpm_stats_add(&stats, 2.0f * (gfloat)BPM_FOLD_LOW - 0.01f);
+    g_assert_cmpuint(stats.histogram[BPM_HISTOGRAM_BINS - 1], ==, 1);
+    bpm_stats_add(&stats, (gfloat)BPM_FOLD_LOW / 4.0f);
+    g_assert_cmpuint(stats.histogram[0], ==, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/analyse/bpm_stats/empty", test_bpm_stats_empty);
+    g_test_add_func("/analyse/bpm_stats/random", test_bpm_stats_random);
+    g_test_add_func("/analyse/bpm_stats/eviction", test_bpm_stats_eviction);
+    g_test_add_func("/analyse/bpm_stats/fold", test_bpm_stats_fold);
+    g_test_add_func("/analyse/bpm_stats/histogram", test_bpm_stats_histogram);
+    return g_test_run();
+}
@@ -0,0 +1,117 @@
+#include "decimator.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_RATE 44100
+/*Tones stepped across the stopband, as a fraction of the output Nyquist frequency*/
+#define TEST_TONE_STEP 0.02
+#define TEST_STOPBAND_DB -60.0
+
+/*Output power of a unit sine relative to the input, the filter delay is skipped*/
+static gdouble test_tone_gain_db(guint factor, gdouble frequency)
+{
+    gsize num_frames = TEST_RATE;
+    gfloat *samples = g_new(gfloat, num_frames);
+    gfloat *output;
+    gsize num_samples;
+    gdouble power = 0.0;
+    gsize count = 0;
+
+    for(gsize i = 0; i < num_frames; i++)
+    {
+        samples[i] = (gfloat)sin(2.0 * G_PI * frequency * i / TEST_RATE);
+    }
+    output = decimator_run(samples, num_frames, 1, factor, &num_samples);
+    g_assert_nonnull(output);
+    for(gsize i = num_samples / 4; i < num_samples; i++)
+    {
+        power += output[i] * output[i];
+        count++;
+    }
+    g_free(samples);
+    g_free(output);
+    return 10.0 * log10(power / count / 0.5);
+}
+
+/*Everything from the output Nyquist frequency up folds back into the band, it has to be gone*/
+static void test_decimator_stopband(void)
+{
+    for(guint factor = 2; factor <= DECIMATOR_MAX_FACTOR; factor *= 2)
+    {
+        gdouble nyquist = TEST_RATE / 2.0 / factor;
+
+        for(gdouble frequency = nyquist; frequency < TEST_RATE / 2.0; frequency += nyquist * TEST_TONE_STEP)
+        {
+            gdouble gain = test_tone_gain_db(factor, frequency);
+            if(gain > TEST_STOPBAND_DB)
+            {
+                g_test_message("factor %u: %.0f Hz only %.1f dB down", factor, frequency, -gain);
+            }
+            g_assert_cmpfloat(gain, <=, TEST_STOPBAND_DB);
+        }
+        g_assert_cmpfloat_with_epsilon(test_tone_gain_db(factor, nyquist / 2.0), 0.0, 0.05);
+    }
+}
+
+static void test_decimator_collect(const gfloat *samples, gsize num_samples, gpointer user_data)
+{
+    g_array_append_vals(user_data, samples, num_samples);
+}
+
+/*Chunk sizes that are not multiples of the factor move the kept sample phase across calls*/
+static void test_decimator_chunked(void)
+{
+    const gsize chunks[] = {1, 3, 5, 1000, DECIMATOR_BLOCK - 1, DECIMATOR_BLOCK + 1, 13};
+    const guint channels = 2;
+    const gsize num_frames = 3 * DECIMATOR_BLOCK + 777;
+    gfloat *samples = g_new(gfloat, num_frames * channels);
+    guint32 state = 11;
+
+    for(gsize i = 0; i < num_frames * channels; i++)
+    {
+        samples[i] = test_signed_uniform(&state);
+    }
+    for(guint factor = 1; factor <= DECIMATOR_MAX_FACTOR; factor *= 2)
+    {
+        Decimator whole, chunked, pushed;
+        gfloat *expected = g_new(gfloat, num_frames / factor + 1);
+        gfloat *output = g_new(gfloat, num_frames / factor + 1);
+        GArray *collected = g_array_new(FALSE, FALSE, sizeof(gfloat));
+        gsize expected_count, count = 0;
+
+        g_assert_cmpint(decimator_init(&whole, factor, channels), ==, 0);
+        g_assert_cmpint(decimator_init(&chunked, factor, channels), ==, 0);
+        g_assert_cmpint(decimator_init(&pushed, factor, channels), ==, 0);
+        expected_count = decimator_process(&whole, samples, num_frames, expected);
+        g_assert_cmpuint(expected_count, ==, (num_frames + factor - 1) / factor);
+
+        for(gsize offset = 0, c = 0; offset < num_frames; c++)
+        {
+            gsize size = MIN(chunks[c % G_N_ELEMENTS(chunks)], num_frames - offset);
+            count += decimator_process(&chunked, samples + offset * channels, size, output + count);
+            decimator_push(&pushed, samples + offset * channels, size, test_decimator_collect, collected);
+            offset += size;
+        }
+        g_assert_cmpuint(count, ==, expected_count);
+        g_assert_cmpmem(output, count * sizeof(gfloat), expected, expected_count * sizeof(gfloat));
+        g_assert_cmpmem(collected->data, collected->len * sizeof(gfloat), expected, expected_count * sizeof(gfloat));
+
+        decimator_free(&whole);
+        decimator_free(&chunked);
+        decimator_free(&pushed);
+        g_array_free(collected, TRUE);
+        g_free(expected);
+        g_free(output);
+    }
+    g_free(samples);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/analyse/decimator/stopband", test_decimator_stopband);
+    g_test_add_func("/analyse/decimator/chunked", test_decimator_chunked);
+    return g_test_run();
+}
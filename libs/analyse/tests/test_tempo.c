@@ -0,0 +1,77 @@
+#include "tempo.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <math.h>
+
+#define TEST_RATE 11025
+#define TEST_SECONDS 30
+
+/*Kick and snare alternating every beat of slow_bpm, with hats of the given
+  amplitude on the off beats. Without hats the pattern is a half-time groove*/
+static gfloat test_tempo_groove(gdouble slow_bpm, gfloat hat)
+{
+    gsize num_samples = TEST_RATE * TEST_SECONDS;
+    gfloat *samples = g_new(gfloat, num_samples);
+    gdouble period = 60.0 / slow_bpm * TEST_RATE;
+    guint32 state = 5;
+    TempoResult result;
+
+    for(gsize i = 0; i < num_samples; i++)
+    {
+        samples[i] = 0.01f * test_signed_uniform(&state);
+    }
+    for(guint beat = 0; beat * period < num_samples; beat++)
+    {
+        gsize start = (gsize)(beat * period);
+        gsize offbeat = start + (gsize)(period / 2.0);
+
+        for(gsize k = 0; k < 2000 && start + k < num_samples; k++)
+        {
+            gdouble decay = exp(-(gdouble)k / 300.0);
+
+            if(beat % 2 == 0)
+            {
+                samples[start + k] += 0.8 * decay * sin(2.0 * G_PI * 60.0 * k / TEST_RATE) +
+                                      0.3 * exp(-(gdouble)k / 30.0) * test_signed_uniform(&state);
+            }
+            else
+            {
+                samples[start + k] += 0.4 * decay * test_signed_uniform(&state);
+            }
+        }
+        for(gsize k = 0; k < 300 && offbeat + k < num_samples; k++)
+        {
+            samples[offbeat + k] += hat * exp(-(gdouble)k / 40.0) * test_signed_uniform(&state);
+        }
+    }
+
+    g_assert_cmpint(tempo_estimate(samples, num_samples, TEST_RATE, &result), ==, 0);
+    g_free(samples);
+    return result.bpm;
+}
+
+/*The comb alone reads these as 120 - 140 BPM*/
+static void test_tempo_half_time(void)
+{
+    g_assert_cmpfloat_with_epsilon(test_tempo_groove(60.0, 0.0f), 60.0, 0.5);
+    g_assert_cmpfloat_with_epsilon(test_tempo_groove(70.0, 0.0f), 70.0, 0.5);
+}
+
+static void test_tempo_off_beat_hats(void)
+{
+    g_assert_cmpfloat_with_epsilon(test_tempo_groove(70.0, 0.2f), 140.0, 1.0);
+}
+
+static void test_tempo_plain_beat(void)
+{
+    g_assert_cmpfloat_with_epsilon(test_tempo_groove(100.0, 0.0f), 100.0, 0.5);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/analyse/tempo/half_time", test_tempo_half_time);
+    g_test_add_func("/analyse/tempo/off_beat_hats", test_tempo_off_beat_hats);
+    g_test_add_func("/analyse/tempo/plain_beat", test_tempo_plain_beat);
+    return g_test_run();
+}
@@ -10,6 +10,13 @@ typedef struct Queue_{
     
 }Queue;
 
+/* Counter based random stream, value n is a hash of the key and n */
+typedef struct MLRandom_
+{
+    uint64_t key; /*seed and stream mixed*/
+    uint64_t counter; /*values drawn so far*/
+}MLRandom;
+
 typedef struct VectorFloatND_
 {
     float *vector; /*vector*/
@@ -31,14 +38,24 @@ typedef struct LinearRegressionData_
     float r_squared; /*r squared value*/
 }LinearRegressionData;
 
+typedef struct MultiLinearRegressionData_
+{
+    uint32_t num_features; /*inputs per sample*/
+    float *coefficients; /*intercept first, then one weight per feature*/
+    float r_squared; /*r squared on the training data*/
+    uint32_t num_training_samples; /*rows of the last fit*/
+}MultiLinearRegressionData;
+
 
 typedef struct PolyRegressionData_
 {
     VectorFloatND *x; /*x vector*/
     VectorFloatND *y; /*y vector*/
-    float *coefficients; /*coefficients of the polynomial*/
+    float *coefficients; /*coefficients of the polynomial in t, lowest power first*/
     uint32_t degree; /*degree of the polynomial*/
     float r_squared; /*r squared value*/
+    float x_offset; /*t = (x - x_offset) * x_scale maps the training range to [-1, 1]*/
+    float x_scale;
 }PolyRegressionData;
 
 typedef struct LogisticRegressionData_
@@ -63,6 +80,7 @@ typedef struct DecisionTreeNode_ {
     /* For internal nodes */
     uint32_t feature_index;     /* Index of the feature to split on */
     float threshold;            /* Threshold value for the split */
+    uint8_t split_bin;          /* Highest bin code going left, the same split on binned features */
     struct DecisionTreeNode_ *left_child;   /* Left child (feature <= threshold) */
     struct DecisionTreeNode_ *right_child;  /* Right child (feature > threshold) */
     
@@ -89,7 +107,7 @@ typedef enum SplitCriterion_ {
 } SplitCriterion;
 
 typedef struct DecisionTree_ {
-    DecisionTreeNode *root;     /* Root node of the tree */
+    DecisionTreeNode *root;     /* Root node of the tree, first entry of the node array */
     TreeType tree_type;         /* Classification or regression */
     SplitCriterion criterion;   /* Splitting criterion */
     
@@ -99,6 +117,9 @@ typedef struct DecisionTree_ {
     uint32_t min_samples_leaf;  /* Minimum samples required in a leaf node */
     float min_impurity_decrease; /* Minimum impurity decrease to make a split */
     
+    uint32_t max_features;      /* Features tried at each split, 0 tries all of them */
+    MLRandom random;            /* Stream the tried features are drawn from */
+    
     /* Training data info */
     uint32_t num_features;      /* Number of features in the dataset */
     uint32_t num_classes;       /* Number of classes (for classification) */
@@ -108,8 +129,22 @@ typedef struct DecisionTree_ {
     uint32_t num_nodes;         /* Total number of nodes in the tree */
     uint32_t actual_depth;      /* Actual depth of the trained tree */
     float training_accuracy;    /* Training accuracy/R² score */
+    float *feature_importance;  /* Impurity decrease of every feature, sums to 1 */
 } DecisionTree;
 
+/* Features quantised once for tree training, every tree of a forest shares them */
+typedef struct BinnedDataset_ {
+    uint8_t *codes;             /* Bin of every sample, feature major */
+    float *bin_edges;           /* Upper edge of every bin, 256 per feature. Values <= edge fall in the bin */
+    uint16_t *num_bins;         /* Bins used by every feature */
+    float *targets;             /* Target value or class of every sample */
+    uint32_t *class_labels;     /* Class of every sample as an integer (for classification) */
+    TreeType tree_type;         /* Classification or regression */
+    uint32_t num_samples;       /* Number of samples */
+    uint32_t num_features;      /* Number of features */
+    uint32_t num_classes;       /* Number of classes (for classification) */
+} BinnedDataset;
+
 typedef struct RandomForest_ {
     DecisionTree **trees;       /* Array of decision trees */
     uint32_t num_trees;         /* Number of trees in the forest */
@@ -144,6 +179,7 @@ typedef struct RandomForest_ {
     
     /* Random state for reproducibility */
     uint32_t random_seed;       /* Seed for random number generation */
+    uint32_t num_threads;       /* Workers training trees, 0 uses every core */
 } RandomForest;
 
 typedef struct BootstrapSample_ {
@@ -271,23 +307,22 @@ typedef struct Neighbor_ {
     float weight;               /* Weight based on distance */
 } Neighbor;
 
+/* Trees live in one node array, root first and the children of a node next to each other.
+   Every node covers a range of the training points, which are stored in tree order. */
 typedef struct KDTreeNode_ {
-    VectorFloatND *point;       /* Point stored in this node */
-    float target_value;         /* Target value for this point */
+    uint32_t start;             /* First point of the node */
+    uint32_t end;               /* One past the last point of the node */
     uint32_t split_dimension;   /* Dimension used for splitting */
-    float split_value;          /* Value used for splitting */
-    struct KDTreeNode_ *left;   /* Left child (values <= split_value) */
-    struct KDTreeNode_ *right;  /* Right child (values > split_value) */
+    float split_value;          /* Median, left points are <= split_value, right ones >= */
+    uint32_t left;              /* Index of the left child, the right child follows it */
     uint8_t is_leaf;           /* Flag indicating if this is a leaf node */
 } KDTreeNode;
 
 typedef struct BallTreeNode_ {
-    VectorFloatND *centroid;    /* Centroid of the ball */
-    float radius;               /* Radius of the ball */
-    VectorFloatND **points;     /* Points contained in this ball */
-    uint32_t num_points;        /* Number of points in this ball */
-    struct BallTreeNode_ *left; /* Left child */
-    struct BallTreeNode_ *right; /* Right child */
+    uint32_t start;             /* First point of the node */
+    uint32_t end;               /* One past the last point of the node */
+    float radius;               /* Radius of the ball around the node centroid */
+    uint32_t left;              /* Index of the left child, the right child follows it */
     uint8_t is_leaf;           /* Flag indicating if this is a leaf node */
 } BallTreeNode;
 
@@ -303,7 +338,9 @@ typedef struct KNN_ {
     float gaussian_sigma;       /* Sigma parameter for Gaussian weights */
     
     /* Training data */
-    VectorFloatND **X_train;    /* Training feature vectors */
+    float *points;              /* Training features, feature major and in index order */
+    uint32_t *point_indices;    /* Training index of every point in index order */
+    float *point_norms;         /* Norm of every point in index order, cosine distance only */
     VectorFloatND *y_train;     /* Training target values */
     uint32_t *class_labels;     /* Class labels for classification */
     uint32_t num_training_samples; /* Number of training samples */
@@ -314,8 +351,11 @@ typedef struct KNN_ {
     uint32_t num_classes;       /* Number of classes (for classification) */
     
     /* Tree structures for fast search */
-    KDTreeNode *kd_tree_root;   /* Root of k-d tree */
-    BallTreeNode *ball_tree_root; /* Root of ball tree */
+    KNNAlgorithm index_algorithm; /* Algorithm picked by the fit, never AUTO_ALGORITHM */
+    KDTreeNode *kd_tree;        /* k-d tree nodes, root first */
+    BallTreeNode *ball_tree;    /* Ball tree nodes, root first */
+    float *ball_centroids;      /* num_features values per ball tree node */
+    uint32_t num_tree_nodes;    /* Nodes in the tree in use */
     
     /* Feature scaling parameters */
     VectorFloatND *feature_means; /* Mean values for feature scaling */
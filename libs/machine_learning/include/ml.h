@@ -1,13 +1,62 @@
 #ifndef ML_H
 #define ML_H
 #include "data_structures.h"
+#include "arena.h"
+#include "ml_knn.h"
+#include "ml_tree.h"
+#include "ml_forest.h"
 #include <stdlib.h>
 
+/*Every (seed, stream) pair is its own sequence. Values depend only on the key and how
+  many were drawn before, so a stream gives the same numbers in any thread.*/
+void ml_random_init(MLRandom *random, uint64_t seed, uint64_t stream);
+
+uint64_t ml_random_next(MLRandom *random);
+
+/*Uniform in [0, bound)*/
+uint32_t ml_random_below(MLRandom *random, uint32_t bound);
+
+/*Vector with its values in the same allocation. From an arena it lives until the
+  arena is reset, with a NULL arena it is released by ml_vector_float_free.*/
+VectorFloatND *ml_vector_float_new(Arena *arena, uint32_t n);
+
+void ml_vector_float_free(VectorFloatND *vector);
+
+/*Copies x and y, ml_linear_regression_data_free releases them*/
 int ml_linear_regression_data_init(LinearRegressionData *linear_regression_data, double x[], double y[], unsigned int n);
 
 int ml_linear_regression_model_learn(LinearRegressionData *linear_regression_data);
 
-double* ml_linear_regression_predict(LinearRegressionData *linear_regression_data, double inputs[]);
+/*Returns n predictions the caller frees*/
+double* ml_linear_regression_predict(LinearRegressionData *linear_regression_data, double inputs[], unsigned int n);
+
+int ml_linear_regression_data_free(LinearRegressionData *linear_regression_data);
+
+/*Least squares over num_features inputs. The normal equations of the centred features are
+  solved with a Cholesky factorisation, collinear features get a small ridge instead of failing.*/
+int ml_multi_linear_regression_init(MultiLinearRegressionData *model, uint32_t num_features);
+
+/*x holds n rows of num_features values. Returns -2 with no more rows than features
+  and -3 when the features are too dependent to solve.*/
+int ml_multi_linear_regression_learn(MultiLinearRegressionData *model, const float *x, const float *y, uint32_t n);
+
+/*One output per row of x*/
+int ml_multi_linear_regression_predict(const MultiLinearRegressionData *model, const float *x, float *outputs, uint32_t n);
+
+int ml_multi_linear_regression_free(MultiLinearRegressionData *model);
+
+/*Copies x and y, ml_poly_regression_data_free releases them*/
+int ml_poly_regression_data_init(PolyRegressionData *poly_regression_data, double x[], double y[], unsigned int n, uint32_t degree);
+
+/*Least squares by Householder QR on monomials of x mapped to [-1, 1], the normal equations
+  of a Vandermonde matrix lose all precision at high degrees. Returns -2 without more
+  samples than coefficients and -3 when x has too few distinct values for the degree.*/
+int ml_poly_regression_model_learn(PolyRegressionData *poly_regression_data);
+
+/*Horner evaluation over n inputs at once*/
+int ml_poly_regression_predict(const PolyRegressionData *poly_regression_data, const float *inputs, float *outputs, uint32_t n);
+
+int ml_poly_regression_data_free(PolyRegressionData *poly_regression_data);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef ML_FOREST_H
+#define ML_FOREST_H
+#include "data_structures.h"
+#include <stdlib.h>
+
+#define ML_FOREST_DEFAULT_TREES 100
+
+/*Majority vote for classification and mean for regression, bootstrap samples as large as
+  the training set, every core and the tree defaults of ml_decision_tree_init.
+  Change the fields before ml_random_forest_fit to use something else.*/
+int ml_random_forest_init(RandomForest *forest, uint32_t num_trees, TreeType forest_type);
+
+/*Trains the trees on a pool of num_threads workers over features binned once for all of
+  them. Tree i draws its bootstrap sample and split features from its own stream of
+  random_seed, so the forest is the same for any number of threads.
+  max_features 0 tries sqrt(num_features) features per split for classification and a
+  third of them for regression. Out of bag predictions and feature importance are merged
+  in tree order as trees finish, which keeps oob_score bit identical as well.*/
+int ml_random_forest_fit(RandomForest *forest, const float *x, const float *y, uint32_t n, uint32_t num_features);
+
+/*Class or value of one row, voted as voting_method says*/
+float ml_random_forest_predict_one(const RandomForest *forest, const float *row);
+
+/*One output per row of x*/
+int ml_random_forest_predict(const RandomForest *forest, const float *x, float *outputs, uint32_t n);
+
+int ml_random_forest_free(RandomForest *forest);
+
+#endif
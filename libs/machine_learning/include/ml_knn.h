@@ -0,0 +1,35 @@
+#ifndef ML_KNN_H
+#define ML_KNN_H
+#include "data_structures.h"
+#include <stdlib.h>
+
+#define ML_KNN_DEFAULT_K 5
+#define ML_KNN_DEFAULT_LEAF_SIZE 32
+/*Below this many points scanning the whole matrix beats building and walking a tree*/
+#define ML_KNN_BRUTE_MAX_SAMPLES 1024
+/*Split planes prune best up to here, past it balls around clusters prune better.
+  bench_ml_knn has the ball tree ahead from 8 dimensions on.*/
+#define ML_KNN_KD_MAX_DIMENSIONS 4
+/*Above this even ball trees visit most leaves*/
+#define ML_KNN_BALL_MAX_DIMENSIONS 64
+
+/*Euclidean distance, uniform weights, AUTO_ALGORITHM and ML_KNN_DEFAULT_LEAF_SIZE.
+  Change the fields before ml_knn_fit to use something else.*/
+int ml_knn_init(KNN *knn, uint32_t k, uint8_t is_classifier);
+
+/*x holds n rows of num_features values, y the target of every row or its class as a whole
+  number. Both are copied, features are standardised first when is_scaled is set.
+  Builds the index knn->algorithm asks for. AUTO_ALGORITHM scans the matrix for few points
+  or many dimensions and builds a k-d tree or ball tree otherwise. Cosine and Hamming
+  distance and Minkowski with p < 1 can't be pruned and always scan.*/
+int ml_knn_fit(KNN *knn, const float *x, const float *y, uint32_t n, uint32_t num_features);
+
+/*Up to k training indices and distances, nearest first. Returns how many were found.*/
+int ml_knn_query(const KNN *knn, const float *query, uint32_t indices[], float distances[]);
+
+/*Weighted mean of the neighbour targets or the class with most weight, one output per row of x*/
+int ml_knn_predict(const KNN *knn, const float *x, float *outputs, uint32_t n);
+
+int ml_knn_free(KNN *knn);
+
+#endif
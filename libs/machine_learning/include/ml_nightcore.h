@@ -31,6 +31,17 @@ typedef struct _MLNightcoreData
     char *artist; /* Artist of the music */
 }MLNightcoreData;
 
+/*Analysed inputs the models learn from: origin BPM, input pitch and input bass*/
+#define ML_NIGHTCORE_NUM_FEATURES 3
+
+/*Nightcore parameter a model predicts*/
+typedef enum _MLNightcoreTarget{
+    ML_TARGET_OUTPUT_BPM = 0,
+    ML_TARGET_PITCH = 1,
+    ML_TARGET_OUTPUT_SPEED = 2,
+    ML_TARGET_BASS_BOOST = 3,
+}MLNightcoreTarget;
+
 int ml_nightcore_data_init(MLNightcoreData *ml_nightcore_data, float origin_bpm, float output_bpm, 
                             float pitch, float output_speed, float input_bass, float output_bass, 
                             float bass_boost, bool is_reverb, 
@@ -48,21 +59,38 @@ gchar* ml_nightcore_file_to_json(const char *file_path);
 
 int ml_nightcore_linear_regresion(LinearRegressionData *linear_regression_data, MLNightcoreData *ml_nightcore_data[], unsigned int n);
 
+/*Fills the ML_NIGHTCORE_NUM_FEATURES inputs of one song*/
+int ml_nightcore_features(const MLNightcoreData *ml_nightcore_data, float features[]);
+
+float ml_nightcore_target(const MLNightcoreData *ml_nightcore_data, MLNightcoreTarget target);
+
+/*Fits target from the features of n songs, model is initialised here and freed again on failure*/
+int ml_nightcore_multi_linear_regression(MultiLinearRegressionData *model, MLNightcoreData *ml_nightcore_data[],
+                                            unsigned int n, MLNightcoreTarget target);
+
+/*Predicts the target of n songs in one batch*/
+int ml_nightcore_multi_linear_regression_predict(const MultiLinearRegressionData *model, MLNightcoreData *ml_nightcore_data[],
+                                                    unsigned int n, float outputs[]);
+
+/*Fits output BPM over origin BPM with the degree already set in poly_regression_data*/
 int ml_polynomial_regression(PolyRegressionData *poly_regression_data, MLNightcoreData *ml_nightcore_data[], unsigned int n);
 
 int ml_nightcore_svm(SVM *svm, MLNightcoreData *ml_nightcore_data[], unsigned int n);
 
 int ml_nightcore_svm_free(SVM *svm);
 
-int ml_nightcore_knn(KNN *knn, MLNightcoreData *ml_nightcore_data[], unsigned int n);
+/*knn has to be set up with ml_knn_init, the songs are indexed by their features*/
+int ml_nightcore_knn(KNN *knn, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target);
 
 int ml_nightcore_knn_free(KNN *knn);
 
-int ml_nightcore_decision_tree(DecisionTree *tree, MLNightcoreData *ml_nightcore_data[], unsigned int n);
+/*tree has to be set up with ml_decision_tree_init, regression trees fit target directly*/
+int ml_nightcore_decision_tree(DecisionTree *tree, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target);
 
 int ml_nightcore_decision_tree_free(DecisionTree *tree);
 
-int ml_nightcore_random_forest(RandomForest *forest, MLNightcoreData *ml_nightcore_data[], unsigned int n);
+/*forest has to be set up with ml_random_forest_init*/
+int ml_nightcore_random_forest(RandomForest *forest, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target);
 
 int ml_nightcore_random_forest_free(RandomForest *forest);
 
@@ -0,0 +1,47 @@
+#ifndef ML_TREE_H
+#define ML_TREE_H
+#include "data_structures.h"
+#include <stdlib.h>
+
+/*Features are quantised to at most this many bins, codes fit in a byte*/
+#define ML_TREE_MAX_BINS 256
+/*Depth limit when max_depth is 0, also bounds the recursion of training*/
+#define ML_TREE_MAX_DEPTH 64
+
+/*Bins every feature at its quantiles and copies the targets. y holds classes as whole
+  numbers for classification. Returns -2 for negative or fractional classes.*/
+int ml_binned_dataset_init(BinnedDataset *data, const float *x, const float *y, uint32_t n, uint32_t num_features, TreeType tree_type);
+
+int ml_binned_dataset_free(BinnedDataset *data);
+
+/*GINI for classification and MSE for regression, no depth limit, min_samples_split 2 and
+  min_samples_leaf 1. Change the fields before training to use something else.*/
+int ml_decision_tree_init(DecisionTree *tree, TreeType tree_type);
+
+/*Trains on n rows of num_features values, see ml_binned_dataset_init for y*/
+int ml_decision_tree_fit(DecisionTree *tree, const float *x, const float *y, uint32_t n, uint32_t num_features);
+
+/*Trains on the listed samples of data, a sample may be listed more than once.
+  Splits are searched on per node histograms of the bin codes, O(bins) per feature instead
+  of sorting the samples, and only the smaller child gets a new histogram. The other one
+  is its parent minus the smaller one. With max_features set every split tries that many
+  features drawn from tree->random.*/
+int ml_decision_tree_fit_binned(DecisionTree *tree, const BinnedDataset *data, const uint32_t *samples, uint32_t num_samples);
+
+/*Leaf a row ends up in*/
+const DecisionTreeNode *ml_decision_tree_leaf(const DecisionTree *tree, const float *row);
+
+const DecisionTreeNode *ml_decision_tree_leaf_binned(const DecisionTree *tree, const BinnedDataset *data, uint32_t sample);
+
+/*Class or value of one row*/
+float ml_decision_tree_predict_one(const DecisionTree *tree, const float *row);
+
+/*Same as ml_decision_tree_predict_one for a sample of binned data, with the bins it was trained on*/
+float ml_decision_tree_predict_binned(const DecisionTree *tree, const BinnedDataset *data, uint32_t sample);
+
+/*One output per row of x*/
+int ml_decision_tree_predict(const DecisionTree *tree, const float *x, float *outputs, uint32_t n);
+
+int ml_decision_tree_free(DecisionTree *tree);
+
+#endif
@@ -0,0 +1,629 @@
+#include "ml.h"
+#include "utils.h"
+#include <math.h>
+#include <string.h>
+
+/*Independent partial sums so the dot products vectorise without reassociating*/
+#define ML_LANES 8
+/*Ridge put on the Gram diagonal when features are collinear, relative to its mean.
+  Every retry makes it 100 times bigger.*/
+#define ML_CHOLESKY_JITTER 1e-10
+#define ML_CHOLESKY_RETRIES 4
+/*2^64 divided by the golden ratio, the SplitMix64 increment*/
+#define ML_RANDOM_GOLDEN 0x9e3779b97f4a7c15ULL
+
+/*SplitMix64 finaliser, a bijection that spreads every input bit over the output*/
+static uint64_t ml_mix64(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+void ml_random_init(MLRandom *random, uint64_t seed, uint64_t stream)
+{
+    random->key = ml_mix64(seed ^ ml_mix64(stream + ML_RANDOM_GOLDEN));
+    random->counter = 0;
+}
+
+uint64_t ml_random_next(MLRandom *random)
+{
+    return ml_mix64(random->key + ++random->counter * ML_RANDOM_GOLDEN);
+}
+
+uint32_t ml_random_below(MLRandom *random, uint32_t bound)
+{
+    /*Multiply and shift, no value is off from uniform by more than bound / 2^32*/
+    return (uint32_t)(((ml_random_next(random) >> 32) * bound) >> 32);
+}
+
+VectorFloatND *ml_vector_float_new(Arena *arena, uint32_t n)
+{
+    size_t size = sizeof(VectorFloatND) + (size_t)n * sizeof(float);
+    VectorFloatND *vector = arena != NULL ? arena_alloc0(arena, size) : calloc(1, size);
+
+    if(vector == NULL)
+    {
+        return NULL;
+    }
+    vector->vector = (float *)(vector + 1);
+    vector->n = n;
+    return vector;
+}
+
+void ml_vector_float_free(VectorFloatND *vector)
+{
+    free(vector);
+}
+
+/*Accumulates in double, the Gram matrix of a long history loses too much in float*/
+UTILS_TARGET_CLONES
+static double ml_dot(const float *restrict a, const float *restrict b, uint32_t n)
+{
+    const uint32_t vector_n = n - n % ML_LANES;
+    double lanes[ML_LANES] = {0};
+    double sum = 0.0;
+
+    for(uint32_t i = 0; i < vector_n; i += ML_LANES)
+    {
+        for(uint32_t l = 0; l < ML_LANES; l++)
+        {
+            lanes[l] += (double)a[i + l] * b[i + l];
+        }
+    }
+    for(uint32_t i = vector_n; i < n; i++)
+    {
+        sum += (double)a[i] * b[i];
+    }
+    for(uint32_t l = 0; l < ML_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+UTILS_TARGET_CLONES
+static double ml_dot_double(const double *restrict a, const double *restrict b, uint32_t n)
+{
+    const uint32_t vector_n = n - n % ML_LANES;
+    double lanes[ML_LANES] = {0};
+    double sum = 0.0;
+
+    for(uint32_t i = 0; i < vector_n; i += ML_LANES)
+    {
+        for(uint32_t l = 0; l < ML_LANES; l++)
+        {
+            lanes[l] += a[i + l] * b[i + l];
+        }
+    }
+    for(uint32_t i = vector_n; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    for(uint32_t l = 0; l < ML_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+/*y += alpha * x*/
+UTILS_TARGET_CLONES
+static void ml_axpy_double(double alpha, const double *restrict x, double *restrict y, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+/*In place on the lower triangle of the p x p matrix a.
+  Returns -3 when a isn't positive definite.*/
+static int ml_cholesky(double *a, uint32_t p)
+{
+    for(uint32_t j = 0; j < p; j++)
+    {
+        double diagonal = a[j * p + j];
+        double d = diagonal;
+        for(uint32_t k = 0; k < j; k++)
+        {
+            d -= a[j * p + k] * a[j * p + k];
+        }
+        /*What is left of the diagonal is rounding noise for a dependent column*/
+        if(d <= diagonal * 1e-12 || d <= 0.0)
+        {
+            return -3;
+        }
+        a[j * p + j] = sqrt(d);
+        for(uint32_t i = j + 1; i < p; i++)
+        {
+            double sum = a[i * p + j];
+            for(uint32_t k = 0; k < j; k++)
+            {
+                sum -= a[i * p + k] * a[j * p + k];
+            }
+            a[i * p + j] = sum / a[j * p + j];
+        }
+    }
+    return 0;
+}
+
+/*Solves L L^T x = b with the factor from ml_cholesky, b is passed in x*/
+static void ml_cholesky_solve(const double *l, uint32_t p, double *x)
+{
+    for(uint32_t i = 0; i < p; i++)
+    {
+        for(uint32_t k = 0; k < i; k++)
+        {
+            x[i] -= l[i * p + k] * x[k];
+        }
+        x[i] /= l[i * p + i];
+    }
+    for(uint32_t i = p; i-- > 0;)
+    {
+        for(uint32_t k = i + 1; k < p; k++)
+        {
+            x[i] -= l[k * p + i] * x[k];
+        }
+        x[i] /= l[i * p + i];
+    }
+}
+
+/*Least squares fit of y on x, n rows of p features. The features are centred and stored
+  feature major, so every entry of the Gram matrix is one contiguous dot product and
+  the intercept drops out of the system. coefficients gets the intercept first.*/
+static int ml_least_squares(const float *x, const float *y, uint32_t n, uint32_t p,
+                            float *coefficients, float *r_squared)
+{
+    Arena *scratch = arena_scratch();
+    ArenaMark mark = arena_mark(scratch);
+    float *columns = arena_new(scratch, float, (size_t)n * (p + 1));
+    double *means = arena_new0(scratch, double, p + 1);
+    double *gram = arena_new0(scratch, double, (size_t)p * p);
+    double *factor = arena_new(scratch, double, (size_t)p * p);
+    double *xty = arena_new(scratch, double, p);
+    double *weights = arena_new(scratch, double, p);
+    float *y_centred;
+    double trace = 0.0, ridge = 0.0, fit = 0.0, total;
+    double intercept;
+
+    if(columns == NULL || means == NULL || gram == NULL || factor == NULL || xty == NULL || weights == NULL)
+    {
+        arena_release(scratch, mark);
+        return -1;
+    }
+    y_centred = columns + (size_t)n * p;
+    for(uint32_t i = 0; i < n; i++)
+    {
+        for(uint32_t j = 0; j < p; j++)
+        {
+            means[j] += x[(size_t)i * p + j];
+        }
+        means[p] += y[i];
+    }
+    for(uint32_t j = 0; j <= p; j++)
+    {
+        means[j] /= n;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        for(uint32_t j = 0; j < p; j++)
+        {
+            columns[(size_t)j * n + i] = (float)(x[(size_t)i * p + j] - means[j]);
+        }
+        y_centred[i] = (float)(y[i] - means[p]);
+    }
+
+    for(uint32_t j = 0; j < p; j++)
+    {
+        for(uint32_t k = 0; k <= j; k++)
+        {
+            gram[j * p + k] = ml_dot(columns + (size_t)j * n, columns + (size_t)k * n, n);
+        }
+        xty[j] = ml_dot(columns + (size_t)j * n, y_centred, n);
+        trace += gram[j * p + j];
+    }
+    total = ml_dot(y_centred, y_centred, n);
+
+    for(uint32_t attempt = 0; ; attempt++)
+    {
+        memcpy(factor, gram, (size_t)p * p * sizeof(double));
+        for(uint32_t j = 0; j < p; j++)
+        {
+            factor[j * p + j] += ridge;
+        }
+        if(ml_cholesky(factor, p) == 0)
+        {
+            break;
+        }
+        if(attempt == ML_CHOLESKY_RETRIES || trace <= 0.0)
+        {
+            arena_release(scratch, mark);
+            return -3;
+        }
+        ridge = ridge == 0.0 ? ML_CHOLESKY_JITTER * trace / p : ridge * 100.0;
+    }
+    memcpy(weights, xty, p * sizeof(double));
+    ml_cholesky_solve(factor, p, weights);
+
+    intercept = means[p];
+    for(uint32_t j = 0; j < p; j++)
+    {
+        fit += weights[j] * xty[j];
+        intercept -= weights[j] * means[j];
+        coefficients[j + 1] = (float)weights[j];
+    }
+    coefficients[0] = (float)intercept;
+    /*Explained over total sum of squares, the residual is orthogonal to the fit*/
+    *r_squared = total > 0.0 ? (float)(fit / total) : 1.0f;
+    arena_release(scratch, mark);
+    return 0;
+}
+
+UTILS_TARGET_CLONES
+static void ml_linear_predict(const float *restrict x, const float *restrict coefficients,
+                                uint32_t n, uint32_t p, float *restrict outputs)
+{
+    for(uint32_t i = 0; i < n; i++)
+    {
+        const float *row = x + (size_t)i * p;
+        float sum = coefficients[0];
+        for(uint32_t j = 0; j < p; j++)
+        {
+            sum += coefficients[j + 1] * row[j];
+        }
+        outputs[i] = sum;
+    }
+}
+
+int ml_linear_regression_data_init(LinearRegressionData *linear_regression_data, double x[], double y[], unsigned int n)
+{
+    if(linear_regression_data == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n < 2)
+    {
+        return -2;
+    }
+    memset(linear_regression_data, 0, sizeof(LinearRegressionData));
+    linear_regression_data->x = ml_vector_float_new(NULL, n);
+    linear_regression_data->y = ml_vector_float_new(NULL, n);
+    if(linear_regression_data->x == NULL || linear_regression_data->y == NULL)
+    {
+        ml_linear_regression_data_free(linear_regression_data);
+        return -1;
+    }
+    for(unsigned int i = 0; i < n; i++)
+    {
+        linear_regression_data->x->vector[i] = (float)x[i];
+        linear_regression_data->y->vector[i] = (float)y[i];
+    }
+    return 0;
+}
+
+int ml_linear_regression_model_learn(LinearRegressionData *linear_regression_data)
+{
+    float coefficients[2];
+    int ret;
+
+    if(linear_regression_data == NULL || linear_regression_data->x == NULL || linear_regression_data->y == NULL)
+    {
+        return -1;
+    }
+    ret = ml_least_squares(linear_regression_data->x->vector, linear_regression_data->y->vector,
+                            linear_regression_data->x->n, 1, coefficients, &linear_regression_data->r_squared);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    linear_regression_data->intercept = coefficients[0];
+    linear_regression_data->slope = coefficients[1];
+    return 0;
+}
+
+double* ml_linear_regression_predict(LinearRegressionData *linear_regression_data, double inputs[], unsigned int n)
+{
+    double *outputs;
+
+    if(linear_regression_data == NULL || inputs == NULL || n == 0)
+    {
+        return NULL;
+    }
+    outputs = malloc(n * sizeof(double));
+    if(outputs == NULL)
+    {
+        return NULL;
+    }
+    for(unsigned int i = 0; i < n; i++)
+    {
+        outputs[i] = linear_regression_data->intercept + linear_regression_data->slope * inputs[i];
+    }
+    return outputs;
+}
+
+int ml_linear_regression_data_free(LinearRegressionData *linear_regression_data)
+{
+    if(linear_regression_data == NULL)
+    {
+        return -1;
+    }
+    ml_vector_float_free(linear_regression_data->x);
+    ml_vector_float_free(linear_regression_data->y);
+    linear_regression_data->x = NULL;
+    linear_regression_data->y = NULL;
+    return 0;
+}
+
+int ml_multi_linear_regression_init(MultiLinearRegressionData *model, uint32_t num_features)
+{
+    if(model == NULL)
+    {
+        return -1;
+    }
+    if(num_features == 0)
+    {
+        return -2;
+    }
+    memset(model, 0, sizeof(MultiLinearRegressionData));
+    model->coefficients = calloc(num_features + 1, sizeof(float));
+    if(model->coefficients == NULL)
+    {
+        return -1;
+    }
+    model->num_features = num_features;
+    return 0;
+}
+
+int ml_multi_linear_regression_learn(MultiLinearRegressionData *model, const float *x, const float *y, uint32_t n)
+{
+    int ret;
+
+    if(model == NULL || model->coefficients == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n <= model->num_features)
+    {
+        return -2;
+    }
+    ret = ml_least_squares(x, y, n, model->num_features, model->coefficients, &model->r_squared);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    model->num_training_samples = n;
+    return 0;
+}
+
+int ml_multi_linear_regression_predict(const MultiLinearRegressionData *model, const float *x, float *outputs, uint32_t n)
+{
+    if(model == NULL || model->coefficients == NULL || x == NULL || outputs == NULL)
+    {
+        return -1;
+    }
+    ml_linear_predict(x, model->coefficients, n, model->num_features, outputs);
+    return 0;
+}
+
+int ml_multi_linear_regression_free(MultiLinearRegressionData *model)
+{
+    if(model == NULL)
+    {
+        return -1;
+    }
+    free(model->coefficients);
+    model->coefficients = NULL;
+    return 0;
+}
+
+/*Reflects the columns of the n x m column major matrix a and b so a becomes R, column j
+  keeps its Householder vector below the diagonal and r_diagonal gets R_jj.
+  Returns -3 when a column is dependent on the ones before it.*/
+static int ml_householder_qr(double *a, uint32_t n, uint32_t m, double *b, double *r_diagonal)
+{
+    for(uint32_t j = 0; j < m; j++)
+    {
+        double *v = a + (size_t)j * n + j;
+        uint32_t length = n - j;
+        double norm = sqrt(ml_dot_double(v, v, length));
+        double alpha, v_norm2;
+
+        /*A whole column of the scaled basis has norm sqrt(n), anything far below is rounding*/
+        if(norm <= 1e-10 * sqrt((double)n))
+        {
+            return -3;
+        }
+        alpha = v[0] > 0.0 ? -norm : norm;
+        v[0] -= alpha;
+        v_norm2 = ml_dot_double(v, v, length);
+        for(uint32_t k = j + 1; k < m; k++)
+        {
+            double *column = a + (size_t)k * n + j;
+            ml_axpy_double(-2.0 * ml_dot_double(v, column, length) / v_norm2, v, column, length);
+        }
+        ml_axpy_double(-2.0 * ml_dot_double(v, b + j, length) / v_norm2, v, b + j, length);
+        r_diagonal[j] = alpha;
+    }
+    return 0;
+}
+
+/*Horner on ML_LANES inputs at a time, each lane runs its own recurrence*/
+UTILS_TARGET_CLONES
+static void ml_horner(const float *restrict coefficients, uint32_t degree, float offset, float scale,
+                        const float *restrict inputs, float *restrict outputs, uint32_t n)
+{
+    const uint32_t vector_n = n - n % ML_LANES;
+
+    for(uint32_t i = 0; i < vector_n; i += ML_LANES)
+    {
+        float t[ML_LANES], sum[ML_LANES];
+        for(uint32_t l = 0; l < ML_LANES; l++)
+        {
+            t[l] = (inputs[i + l] - offset) * scale;
+            sum[l] = coefficients[degree];
+        }
+        for(uint32_t k = degree; k-- > 0;)
+        {
+            for(uint32_t l = 0; l < ML_LANES; l++)
+            {
+                sum[l] = sum[l] * t[l] + coefficients[k];
+            }
+        }
+        for(uint32_t l = 0; l < ML_LANES; l++)
+        {
+            outputs[i + l] = sum[l];
+        }
+    }
+    for(uint32_t i = vector_n; i < n; i++)
+    {
+        float t = (inputs[i] - offset) * scale;
+        float sum = coefficients[degree];
+        for(uint32_t k = degree; k-- > 0;)
+        {
+            sum = sum * t + coefficients[k];
+        }
+        outputs[i] = sum;
+    }
+}
+
+int ml_poly_regression_data_init(PolyRegressionData *poly_regression_data, double x[], double y[], unsigned int n, uint32_t degree)
+{
+    if(poly_regression_data == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n == 0)
+    {
+        return -2;
+    }
+    memset(poly_regression_data, 0, sizeof(PolyRegressionData));
+    poly_regression_data->x = ml_vector_float_new(NULL, n);
+    poly_regression_data->y = ml_vector_float_new(NULL, n);
+    poly_regression_data->coefficients = calloc(degree + 1, sizeof(float));
+    if(poly_regression_data->x == NULL || poly_regression_data->y == NULL || poly_regression_data->coefficients == NULL)
+    {
+        ml_poly_regression_data_free(poly_regression_data);
+        return -1;
+    }
+    for(unsigned int i = 0; i < n; i++)
+    {
+        poly_regression_data->x->vector[i] = (float)x[i];
+        poly_regression_data->y->vector[i] = (float)y[i];
+    }
+    poly_regression_data->degree = degree;
+    poly_regression_data->x_scale = 1.0f;
+    return 0;
+}
+
+int ml_poly_regression_model_learn(PolyRegressionData *poly_regression_data)
+{
+    Arena *scratch;
+    ArenaMark mark;
+    const float *x, *y;
+    uint32_t n, m;
+    double *a, *b, *r_diagonal;
+    double minimum, maximum, offset, scale, mean = 0.0, total = 0.0, residual;
+    int ret;
+
+    if(poly_regression_data == NULL || poly_regression_data->x == NULL || poly_regression_data->y == NULL ||
+        poly_regression_data->coefficients == NULL)
+    {
+        return -1;
+    }
+    x = poly_regression_data->x->vector;
+    y = poly_regression_data->y->vector;
+    n = poly_regression_data->x->n;
+    m = poly_regression_data->degree + 1;
+    if(n <= poly_regression_data->degree)
+    {
+        return -2;
+    }
+
+    minimum = maximum = x[0];
+    for(uint32_t i = 1; i < n; i++)
+    {
+        minimum = MIN(minimum, x[i]);
+        maximum = MAX(maximum, x[i]);
+    }
+    offset = (minimum + maximum) / 2.0;
+    scale = maximum > minimum ? 2.0 / (maximum - minimum) : 1.0;
+
+    scratch = arena_scratch();
+    mark = arena_mark(scratch);
+    a = arena_new(scratch, double, (size_t)n * m);
+    b = arena_new(scratch, double, n);
+    r_diagonal = arena_new(scratch, double, m);
+    if(a == NULL || b == NULL || r_diagonal == NULL)
+    {
+        arena_release(scratch, mark);
+        return -1;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        double t = (x[i] - offset) * scale;
+        double power = 1.0;
+        for(uint32_t k = 0; k < m; k++)
+        {
+            a[(size_t)k * n + i] = power;
+            power *= t;
+        }
+        b[i] = y[i];
+        mean += y[i];
+    }
+    mean /= n;
+    for(uint32_t i = 0; i < n; i++)
+    {
+        total += (y[i] - mean) * (y[i] - mean);
+    }
+
+    ret = ml_householder_qr(a, n, m, b, r_diagonal);
+    if(ret != 0)
+    {
+        arena_release(scratch, mark);
+        return ret;
+    }
+    /*Q^T y below the first m rows is the residual*/
+    residual = ml_dot_double(b + m, b + m, n - m);
+    for(uint32_t j = m; j-- > 0;)
+    {
+        double sum = b[j];
+        for(uint32_t k = j + 1; k < m; k++)
+        {
+            sum -= a[(size_t)k * n + j] * b[k];
+        }
+        b[j] = sum / r_diagonal[j];
+        poly_regression_data->coefficients[j] = (float)b[j];
+    }
+    poly_regression_data->x_offset = (float)offset;
+    poly_regression_data->x_scale = (float)scale;
+    poly_regression_data->r_squared = total > 0.0 ? (float)(1.0 - residual / total) : 1.0f;
+    arena_release(scratch, mark);
+    return 0;
+}
+
+int ml_poly_regression_predict(const PolyRegressionData *poly_regression_data, const float *inputs, float *outputs, uint32_t n)
+{
+    if(poly_regression_data == NULL || poly_regression_data->coefficients == NULL || inputs == NULL || outputs == NULL)
+    {
+        return -1;
+    }
+    ml_horner(poly_regression_data->coefficients, poly_regression_data->degree, poly_regression_data->x_offset,
+                poly_regression_data->x_scale, inputs, outputs, n);
+    return 0;
+}
+
+int ml_poly_regression_data_free(PolyRegressionData *poly_regression_data)
+{
+    if(poly_regression_data == NULL)
+    {
+        return -1;
+    }
+    ml_vector_float_free(poly_regression_data->x);
+    ml_vector_float_free(poly_regression_data->y);
+    free(poly_regression_data->coefficients);
+    poly_regression_data->x = NULL;
+    poly_regression_data->y = NULL;
+    poly_regression_data->coefficients = NULL;
+    return 0;
+}
@@ -0,0 +1,428 @@
+#include "ml.h"
+#include <math.h>
+#include <string.h>
+
+/*Shared by the workers of one ml_random_forest_fit*/
+typedef struct ForestTraining_
+{
+    RandomForest *forest;
+    const BinnedDataset *data;
+    uint32_t max_features;
+    uint32_t bootstrap_size;
+    GMutex lock;
+    /*Held per tree from the end of its training until it is merged*/
+    uint8_t **in_bag;
+    float **oob_predictions;
+    uint8_t *finished;
+    uint32_t next_merge;
+    /*Out of bag accumulators, per sample*/
+    uint32_t *oob_counts;
+    double *oob_sums;           /*regression*/
+    uint32_t *oob_votes;        /*num_classes per sample for classification*/
+    double *importance;
+    int error;
+}ForestTraining;
+
+int ml_random_forest_init(RandomForest *forest, uint32_t num_trees, TreeType forest_type)
+{
+    if(forest == NULL)
+    {
+        return -1;
+    }
+    memset(forest, 0, sizeof(RandomForest));
+    forest->num_trees = num_trees > 0 ? num_trees : ML_FOREST_DEFAULT_TREES;
+    forest->forest_type = forest_type;
+    forest->bootstrap_ratio = 1.0f;
+    forest->min_samples_split = 2;
+    forest->min_samples_leaf = 1;
+    forest->voting_method = forest_type == CLASSIFICATION_TREE ? 0 : 2;
+    return 0;
+}
+
+/*Adds the out of bag predictions and importance of tree t, called in tree order*/
+static void ml_forest_merge(ForestTraining *training, uint32_t t)
+{
+    const RandomForest *forest = training->forest;
+    const DecisionTree *tree = forest->trees[t];
+    const uint8_t *in_bag = training->in_bag[t];
+    const float *predictions = training->oob_predictions[t];
+
+    if(in_bag != NULL && predictions != NULL && tree->root != NULL)
+    {
+        for(uint32_t s = 0; s < training->data->num_samples; s++)
+        {
+            if(in_bag[s])
+            {
+                continue;
+            }
+            training->oob_counts[s]++;
+            if(forest->forest_type == CLASSIFICATION_TREE)
+            {
+                training->oob_votes[(size_t)s * forest->num_classes + (uint32_t)predictions[s]]++;
+            }
+            else
+            {
+                training->oob_sums[s] += predictions[s];
+            }
+        }
+        for(uint32_t j = 0; j < forest->num_features; j++)
+        {
+            training->importance[j] += tree->feature_importance[j];
+        }
+    }
+    free(training->in_bag[t]);
+    free(training->oob_predictions[t]);
+    training->in_bag[t] = NULL;
+    training->oob_predictions[t] = NULL;
+}
+
+/*Trains the tree whose index + 1 is in data*/
+static void ml_forest_worker(gpointer data, gpointer user_data)
+{
+    ForestTraining *training = (ForestTraining *)user_data;
+    RandomForest *forest = training->forest;
+    const BinnedDataset *set = training->data;
+    const uint32_t t = GPOINTER_TO_UINT(data) - 1;
+    const uint32_t n = set->num_samples;
+    DecisionTree *tree = forest->trees[t];
+    Arena *scratch = arena_scratch();
+    ArenaMark mark = arena_mark(scratch);
+    uint32_t *samples = arena_new(scratch, uint32_t, training->bootstrap_size);
+    uint8_t *in_bag = calloc(n, sizeof(uint8_t));
+    float *predictions = malloc(n * sizeof(float));
+    int ret = -1;
+
+    if(samples != NULL && in_bag != NULL && predictions != NULL)
+    {
+        ml_decision_tree_init(tree, forest->forest_type);
+        tree->max_depth = forest->max_depth;
+        tree->min_samples_split = forest->min_samples_split;
+        tree->min_samples_leaf = forest->min_samples_leaf;
+        tree->min_impurity_decrease = forest->min_impurity_decrease;
+        tree->max_features = training->max_features;
+        /*Bootstrap and split features come from the stream of this tree only*/
+        ml_random_init(&tree->random, forest->random_seed, t);
+        for(uint32_t k = 0; k < training->bootstrap_size; k++)
+        {
+            samples[k] = ml_random_below(&tree->random, n);
+            in_bag[samples[k]] = 1;
+        }
+        ret = ml_decision_tree_fit_binned(tree, set, samples, training->bootstrap_size);
+        for(uint32_t s = 0; s < n && ret == 0; s++)
+        {
+            if(!in_bag[s])
+            {
+                predictions[s] = ml_decision_tree_predict_binned(tree, set, s);
+            }
+        }
+    }
+    arena_release(scratch, mark);
+
+    g_mutex_lock(&training->lock);
+    training->in_bag[t] = in_bag;
+    training->oob_predictions[t] = predictions;
+    training->finished[t] = 1;
+    if(ret != 0 && training->error == 0)
+    {
+        training->error = ret;
+    }
+    /*Whoever finishes the next tree in order merges it and every finished one after it*/
+    while(training->next_merge < forest->num_trees && training->finished[training->next_merge])
+    {
+        ml_forest_merge(training, training->next_merge++);
+    }
+    g_mutex_unlock(&training->lock);
+}
+
+static void ml_forest_vote(const RandomForest *forest, const DecisionTreeNode *leaf, double *votes, double *sum)
+{
+    if(forest->forest_type == CLASSIFICATION_TREE)
+    {
+        votes[leaf->class_label] += forest->voting_method == 1 ? leaf->confidence : 1.0;
+    }
+    else
+    {
+        *sum += leaf->prediction;
+    }
+}
+
+static float ml_forest_result(const RandomForest *forest, const double *votes, double sum)
+{
+    uint32_t label = 0;
+
+    if(forest->forest_type != CLASSIFICATION_TREE)
+    {
+        return (float)(sum / forest->num_trees);
+    }
+    for(uint32_t c = 1; c < forest->num_classes; c++)
+    {
+        if(votes[c] > votes[label])
+        {
+            label = c;
+        }
+    }
+    return (float)label;
+}
+
+/*Out of bag score, training score and importance once every tree is merged*/
+static void ml_forest_scores(RandomForest *forest, const ForestTraining *training, double *votes)
+{
+    const BinnedDataset *data = training->data;
+    const uint32_t n = data->num_samples;
+    double importance_sum = 0.0;
+    double correct = 0.0, oob_correct = 0.0, mean = 0.0, oob_mean = 0.0;
+    double residual = 0.0, total = 0.0, oob_residual = 0.0, oob_total = 0.0;
+    uint32_t oob_samples = 0;
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        mean += data->targets[s];
+        if(training->oob_counts[s] > 0)
+        {
+            oob_mean += data->targets[s];
+            oob_samples++;
+        }
+    }
+    mean /= n;
+    oob_mean = oob_samples > 0 ? oob_mean / oob_samples : 0.0;
+
+    for(uint32_t s = 0; s < n; s++)
+    {
+        double y = data->targets[s];
+        double sum = 0.0;
+        float prediction;
+        if(forest->forest_type == CLASSIFICATION_TREE)
+        {
+            memset(votes, 0, forest->num_classes * sizeof(double));
+        }
+        for(uint32_t t = 0; t < forest->num_trees; t++)
+        {
+            ml_forest_vote(forest, ml_decision_tree_leaf_binned(forest->trees[t], data, s), votes, &sum);
+        }
+        prediction = ml_forest_result(forest, votes, sum);
+        correct += prediction == y;
+        residual += (prediction - y) * (prediction - y);
+        total += (y - mean) * (y - mean);
+
+        if(training->oob_counts[s] == 0)
+        {
+            continue;
+        }
+        if(forest->forest_type == CLASSIFICATION_TREE)
+        {
+            const uint32_t *oob_votes = training->oob_votes + (size_t)s * forest->num_classes;
+            uint32_t label = 0;
+            for(uint32_t c = 1; c < forest->num_classes; c++)
+            {
+                if(oob_votes[c] > oob_votes[label])
+                {
+                    label = c;
+                }
+            }
+            oob_correct += label == data->class_labels[s];
+        }
+        else
+        {
+            double oob_prediction = training->oob_sums[s] / training->oob_counts[s];
+            oob_residual += (oob_prediction - y) * (oob_prediction - y);
+            oob_total += (y - oob_mean) * (y - oob_mean);
+        }
+    }
+    /*Accuracy for classification, r squared for regression*/
+    if(forest->forest_type == CLASSIFICATION_TREE)
+    {
+        forest->training_accuracy = (float)(correct / n);
+        forest->oob_score = oob_samples > 0 ? (float)(oob_correct / oob_samples) : 0.0f;
+    }
+    else
+    {
+        forest->training_accuracy = total > 0.0 ? (float)(1.0 - residual / total) : 1.0f;
+        forest->oob_score = oob_total > 0.0 ? (float)(1.0 - oob_residual / oob_total) : 0.0f;
+    }
+
+    for(uint32_t j = 0; j < forest->num_features; j++)
+    {
+        importance_sum += training->importance[j];
+    }
+    for(uint32_t j = 0; j < forest->num_features; j++)
+    {
+        forest->feature_importance[j] = importance_sum > 0.0 ? (float)(training->importance[j] / importance_sum) : 0.0f;
+    }
+}
+
+int ml_random_forest_fit(RandomForest *forest, const float *x, const float *y, uint32_t n, uint32_t num_features)
+{
+    ForestTraining training;
+    BinnedDataset data;
+    GThreadPool *pool;
+    GError *error = NULL;
+    double *votes;
+    uint32_t num_threads;
+    int ret;
+
+    if(forest == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n == 0 || num_features == 0 || forest->num_trees == 0 || forest->bootstrap_ratio <= 0.0f)
+    {
+        return -2;
+    }
+    ml_random_forest_free(forest);
+    ret = ml_binned_dataset_init(&data, x, y, n, num_features, forest->forest_type);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    forest->num_features = num_features;
+    forest->num_classes = data.num_classes;
+    forest->num_training_samples = n;
+
+    memset(&training, 0, sizeof(ForestTraining));
+    training.forest = forest;
+    training.data = &data;
+    if(forest->max_features > 0)
+    {
+        training.max_features = MIN(forest->max_features, num_features);
+    }
+    else if(forest->forest_type == CLASSIFICATION_TREE)
+    {
+        training.max_features = MAX((uint32_t)sqrtf((float)num_features), 1);
+    }
+    else
+    {
+        training.max_features = MAX(num_features / 3, 1);
+    }
+    training.bootstrap_size = MAX((uint32_t)(forest->bootstrap_ratio * n + 0.5f), 1);
+    g_mutex_init(&training.lock);
+
+    forest->trees = calloc(forest->num_trees, sizeof(DecisionTree *));
+    forest->feature_importance = calloc(num_features, sizeof(float));
+    training.in_bag = calloc(forest->num_trees, sizeof(uint8_t *));
+    training.oob_predictions = calloc(forest->num_trees, sizeof(float *));
+    training.finished = calloc(forest->num_trees, sizeof(uint8_t));
+    training.oob_counts = calloc(n, sizeof(uint32_t));
+    training.importance = calloc(num_features, sizeof(double));
+    if(forest->forest_type == CLASSIFICATION_TREE)
+    {
+        training.oob_votes = calloc((size_t)n * data.num_classes, sizeof(uint32_t));
+    }
+    else
+    {
+        training.oob_sums = calloc(n, sizeof(double));
+    }
+    votes = calloc(MAX(data.num_classes, 1), sizeof(double));
+    ret = forest->trees == NULL || forest->feature_importance == NULL || training.in_bag == NULL ||
+            training.oob_predictions == NULL || training.finished == NULL || training.oob_counts == NULL ||
+            training.importance == NULL || votes == NULL ||
+            (training.oob_votes == NULL && training.oob_sums == NULL) ? -1 : 0;
+    for(uint32_t t = 0; t < forest->num_trees && ret == 0; t++)
+    {
+        forest->trees[t] = calloc(1, sizeof(DecisionTree));
+        if(forest->trees[t] == NULL)
+        {
+            ret = -1;
+        }
+    }
+
+    if(ret == 0)
+    {
+        num_threads = forest->num_threads > 0 ? forest->num_threads : g_get_num_processors();
+        num_threads = MIN(num_threads, forest->num_trees);
+        pool = g_thread_pool_new(ml_forest_worker, &training, (gint)num_threads, TRUE, &error);
+        if(pool == NULL)
+        {
+            /*Same forest, just slower*/
+            g_printerr("Could not start forest workers: %s\n", error->message);
+            g_clear_error(&error);
+            for(uint32_t t = 0; t < forest->num_trees; t++)
+            {
+                ml_forest_worker(GUINT_TO_POINTER(t + 1), &training);
+            }
+        }
+        else
+        {
+            for(uint32_t t = 0; t < forest->num_trees; t++)
+            {
+                g_thread_pool_push(pool, GUINT_TO_POINTER(t + 1), NULL);
+            }
+            /*Waits for every queued tree*/
+            g_thread_pool_free(pool, FALSE, TRUE);
+        }
+        ret = training.error;
+    }
+    if(ret == 0)
+    {
+        ml_forest_scores(forest, &training, votes);
+    }
+
+    g_mutex_clear(&training.lock);
+    free(training.in_bag);
+    free(training.oob_predictions);
+    free(training.finished);
+    free(training.oob_counts);
+    free(training.oob_sums);
+    free(training.oob_votes);
+    free(training.importance);
+    free(votes);
+    ml_binned_dataset_free(&data);
+    if(ret != 0)
+    {
+        ml_random_forest_free(forest);
+    }
+    return ret;
+}
+
+float ml_random_forest_predict_one(const RandomForest *forest, const float *row)
+{
+    Arena *scratch = arena_scratch();
+    ArenaMark mark = arena_mark(scratch);
+    double *votes = arena_new0(scratch, double, MAX(forest->num_classes, 1));
+    double sum = 0.0;
+    float prediction = 0.0f;
+
+    if(votes != NULL)
+    {
+        for(uint32_t t = 0; t < forest->num_trees; t++)
+        {
+            ml_forest_vote(forest, ml_decision_tree_leaf(forest->trees[t], row), votes, &sum);
+        }
+        prediction = ml_forest_result(forest, votes, sum);
+    }
+    arena_release(scratch, mark);
+    return prediction;
+}
+
+int ml_random_forest_predict(const RandomForest *forest, const float *x, float *outputs, uint32_t n)
+{
+    if(forest == NULL || forest->trees == NULL || x == NULL || outputs == NULL)
+    {
+        return -1;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        outputs[i] = ml_random_forest_predict_one(forest, x + (size_t)i * forest->num_features);
+    }
+    return 0;
+}
+
+int ml_random_forest_free(RandomForest *forest)
+{
+    if(forest == NULL)
+    {
+        return -1;
+    }
+    for(uint32_t t = 0; forest->trees != NULL && t < forest->num_trees; t++)
+    {
+        if(forest->trees[t] != NULL)
+        {
+            ml_decision_tree_free(forest->trees[t]);
+            free(forest->trees[t]);
+        }
+    }
+    free(forest->trees);
+    free(forest->feature_importance);
+    forest->trees = NULL;
+    forest->feature_importance = NULL;
+    return 0;
+}
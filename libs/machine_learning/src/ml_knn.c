@@ -0,0 +1,799 @@
+#include "ml.h"
+#include "utils.h"
+#include <math.h>
+#include <string.h>
+
+/*Points whose distances are computed in one pass over the columns*/
+#define ML_KNN_BLOCK 256
+
+/*k best points so far, a max heap on the reduced distance*/
+typedef struct KNNHeap_
+{
+    float *distances;
+    uint32_t *positions; /*positions in index order*/
+    uint32_t size;
+    uint32_t k;
+}KNNHeap;
+
+/*Trees need a metric where a single coordinate difference bounds the distance*/
+static int ml_knn_metric_prunes(const KNN *knn)
+{
+    switch(knn->distance_metric)
+    {
+        case EUCLIDEAN_DISTANCE:
+        case MANHATTAN_DISTANCE:
+        case CHEBYSHEV_DISTANCE:
+            return 1;
+        case MINKOWSKI_DISTANCE:
+            return knn->minkowski_p >= 1.0f;
+        default:
+            return 0;
+    }
+}
+
+/*Distances are compared without their final root*/
+static float ml_knn_reduce(const KNN *knn, float distance)
+{
+    switch(knn->distance_metric)
+    {
+        case EUCLIDEAN_DISTANCE:
+            return distance * distance;
+        case MINKOWSKI_DISTANCE:
+            return powf(distance, knn->minkowski_p);
+        default:
+            return distance;
+    }
+}
+
+static float ml_knn_finish(const KNN *knn, float reduced)
+{
+    switch(knn->distance_metric)
+    {
+        case EUCLIDEAN_DISTANCE:
+            return sqrtf(reduced);
+        case MINKOWSKI_DISTANCE:
+            return powf(reduced, 1.0f / knn->minkowski_p);
+        default:
+            return reduced;
+    }
+}
+
+/*Reduced distance between two rows, only for metrics that prune*/
+static float ml_knn_point_distance(const KNN *knn, const float *a, const float *b)
+{
+    float sum = 0.0f;
+    for(uint32_t j = 0; j < knn->num_features; j++)
+    {
+        float d = fabsf(a[j] - b[j]);
+        switch(knn->distance_metric)
+        {
+            case EUCLIDEAN_DISTANCE:
+                sum += d * d;
+                break;
+            case MINKOWSKI_DISTANCE:
+                sum += powf(d, knn->minkowski_p);
+                break;
+            case CHEBYSHEV_DISTANCE:
+                sum = fmaxf(sum, d);
+                break;
+            default:
+                sum += d;
+                break;
+        }
+    }
+    return sum;
+}
+
+/*Reduced distances from query to count points starting at start. The points are feature
+  major, so every dimension is one contiguous pass over the block.*/
+UTILS_TARGET_CLONES
+static void ml_knn_block_distances(const KNN *knn, const float *query, float query_norm,
+                                    uint32_t start, uint32_t count, float *restrict distances)
+{
+    const uint32_t n = knn->num_training_samples;
+
+    memset(distances, 0, count * sizeof(float));
+    for(uint32_t j = 0; j < knn->num_features; j++)
+    {
+        const float *restrict column = knn->points + (size_t)j * n + start;
+        const float q = query[j];
+        switch(knn->distance_metric)
+        {
+            case EUCLIDEAN_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    float d = column[i] - q;
+                    distances[i] += d * d;
+                }
+                break;
+            case MANHATTAN_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    distances[i] += fabsf(column[i] - q);
+                }
+                break;
+            case MINKOWSKI_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    distances[i] += powf(fabsf(column[i] - q), knn->minkowski_p);
+                }
+                break;
+            case COSINE_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    distances[i] += column[i] * q;
+                }
+                break;
+            case HAMMING_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    distances[i] += column[i] != q;
+                }
+                break;
+            case CHEBYSHEV_DISTANCE:
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    distances[i] = fmaxf(distances[i], fabsf(column[i] - q));
+                }
+                break;
+        }
+    }
+    if(knn->distance_metric == COSINE_DISTANCE)
+    {
+        for(uint32_t i = 0; i < count; i++)
+        {
+            float denominator = query_norm * knn->point_norms[start + i];
+            distances[i] = denominator > 0.0f ? 1.0f - distances[i] / denominator : 1.0f;
+        }
+    }
+}
+
+static void ml_knn_heap_sift_down(KNNHeap *heap, uint32_t size, float distance, uint32_t position)
+{
+    uint32_t i = 0;
+    for(;;)
+    {
+        uint32_t child = 2 * i + 1;
+        if(child >= size)
+        {
+            break;
+        }
+        if(child + 1 < size && heap->distances[child + 1] > heap->distances[child])
+        {
+            child++;
+        }
+        if(heap->distances[child] <= distance)
+        {
+            break;
+        }
+        heap->distances[i] = heap->distances[child];
+        heap->positions[i] = heap->positions[child];
+        i = child;
+    }
+    heap->distances[i] = distance;
+    heap->positions[i] = position;
+}
+
+static void ml_knn_heap_push(KNNHeap *heap, float distance, uint32_t position)
+{
+    uint32_t i;
+
+    if(heap->size == heap->k)
+    {
+        if(distance < heap->distances[0])
+        {
+            ml_knn_heap_sift_down(heap, heap->size, distance, position);
+        }
+        return;
+    }
+    i = heap->size++;
+    while(i > 0 && heap->distances[(i - 1) / 2] < distance)
+    {
+        heap->distances[i] = heap->distances[(i - 1) / 2];
+        heap->positions[i] = heap->positions[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->distances[i] = distance;
+    heap->positions[i] = position;
+}
+
+static float ml_knn_heap_worst(const KNNHeap *heap)
+{
+    return heap->size < heap->k ? INFINITY : heap->distances[0];
+}
+
+/*Heap sort in place, nearest first*/
+static void ml_knn_heap_sort(KNNHeap *heap)
+{
+    for(uint32_t end = heap->size; end-- > 1;)
+    {
+        float distance = heap->distances[end];
+        uint32_t position = heap->positions[end];
+        heap->distances[end] = heap->distances[0];
+        heap->positions[end] = heap->positions[0];
+        ml_knn_heap_sift_down(heap, end, distance, position);
+    }
+}
+
+static void ml_knn_scan(const KNN *knn, const float *query, float query_norm, uint32_t start, uint32_t end,
+                        KNNHeap *heap, float *block)
+{
+    while(start < end)
+    {
+        uint32_t count = MIN(end - start, ML_KNN_BLOCK);
+        ml_knn_block_distances(knn, query, query_norm, start, count, block);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            ml_knn_heap_push(heap, block[i], start + i);
+        }
+        start += count;
+    }
+}
+
+static void ml_knn_kd_search(const KNN *knn, uint32_t node_index, const float *query, KNNHeap *heap, float *block)
+{
+    const KDTreeNode *node = knn->kd_tree + node_index;
+    float diff;
+
+    if(node->is_leaf)
+    {
+        ml_knn_scan(knn, query, 0.0f, node->start, node->end, heap, block);
+        return;
+    }
+    diff = query[node->split_dimension] - node->split_value;
+    ml_knn_kd_search(knn, diff < 0.0f ? node->left : node->left + 1, query, heap, block);
+    /*Everything on the far side is at least the distance to the split plane away*/
+    if(ml_knn_reduce(knn, fabsf(diff)) < ml_knn_heap_worst(heap))
+    {
+        ml_knn_kd_search(knn, diff < 0.0f ? node->left + 1 : node->left, query, heap, block);
+    }
+}
+
+static float ml_knn_centroid_distance(const KNN *knn, uint32_t node_index, const float *query)
+{
+    const float *centroid = knn->ball_centroids + (size_t)node_index * knn->num_features;
+    return ml_knn_finish(knn, ml_knn_point_distance(knn, query, centroid));
+}
+
+/*distance is the true distance from query to the centroid of the node*/
+static void ml_knn_ball_search(const KNN *knn, uint32_t node_index, float distance, const float *query,
+                                KNNHeap *heap, float *block)
+{
+    const BallTreeNode *node = knn->ball_tree + node_index;
+    float bound = distance - node->radius;
+    float left, right;
+
+    if(bound > 0.0f && ml_knn_reduce(knn, bound) >= ml_knn_heap_worst(heap))
+    {
+        return;
+    }
+    if(node->is_leaf)
+    {
+        ml_knn_scan(knn, query, 0.0f, node->start, node->end, heap, block);
+        return;
+    }
+    left = ml_knn_centroid_distance(knn, node->left, query);
+    right = ml_knn_centroid_distance(knn, node->left + 1, query);
+    if(left <= right)
+    {
+        ml_knn_ball_search(knn, node->left, left, query, heap, block);
+        ml_knn_ball_search(knn, node->left + 1, right, query, heap, block);
+    }
+    else
+    {
+        ml_knn_ball_search(knn, node->left + 1, right, query, heap, block);
+        ml_knn_ball_search(knn, node->left, left, query, heap, block);
+    }
+}
+
+/*Nearest points of query, sorted, as training indices and true distances.
+  Temporaries come from scratch, the caller releases them.*/
+static uint32_t ml_knn_find(const KNN *knn, Arena *scratch, const float *query, uint32_t indices[], float distances[])
+{
+    const uint32_t p = knn->num_features;
+    float *scaled = arena_new(scratch, float, p);
+    float *block = arena_new(scratch, float, ML_KNN_BLOCK);
+    KNNHeap heap = {arena_new(scratch, float, knn->k), arena_new(scratch, uint32_t, knn->k), 0, knn->k};
+    float query_norm = 0.0f;
+
+    if(scaled == NULL || block == NULL || heap.distances == NULL || heap.positions == NULL)
+    {
+        return 0;
+    }
+    for(uint32_t j = 0; j < p; j++)
+    {
+        scaled[j] = knn->is_scaled ? (query[j] - knn->feature_means->vector[j]) / knn->feature_stds->vector[j] : query[j];
+        query_norm += scaled[j] * scaled[j];
+    }
+    query_norm = sqrtf(query_norm);
+
+    switch(knn->index_algorithm)
+    {
+        case KD_TREE:
+            ml_knn_kd_search(knn, 0, scaled, &heap, block);
+            break;
+        case BALL_TREE:
+            ml_knn_ball_search(knn, 0, ml_knn_centroid_distance(knn, 0, scaled), scaled, &heap, block);
+            break;
+        default:
+            ml_knn_scan(knn, scaled, query_norm, 0, knn->num_training_samples, &heap, block);
+            break;
+    }
+    ml_knn_heap_sort(&heap);
+    for(uint32_t i = 0; i < heap.size; i++)
+    {
+        indices[i] = knn->point_indices[heap.positions[i]];
+        distances[i] = ml_knn_finish(knn, heap.distances[i]);
+    }
+    return heap.size;
+}
+
+/*Moves the nth smallest value of dimension to indices[nth], smaller ones before it and larger ones after*/
+static void ml_knn_select(const float *x, uint32_t p, uint32_t dimension, uint32_t *indices, uint32_t n, uint32_t nth)
+{
+    int64_t low = 0, high = (int64_t)n - 1;
+
+    while(low < high)
+    {
+        float pivot = x[(size_t)indices[low + (high - low) / 2] * p + dimension];
+        int64_t i = low, j = high;
+        while(i <= j)
+        {
+            while(x[(size_t)indices[i] * p + dimension] < pivot)
+            {
+                i++;
+            }
+            while(x[(size_t)indices[j] * p + dimension] > pivot)
+            {
+                j--;
+            }
+            if(i <= j)
+            {
+                uint32_t temp = indices[i];
+                indices[i] = indices[j];
+                indices[j] = temp;
+                i++;
+                j--;
+            }
+        }
+        if((int64_t)nth <= j)
+        {
+            high = j;
+        }
+        else if((int64_t)nth >= i)
+        {
+            low = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/*Dimension with the widest range over indices[start, end), or p when all points are equal*/
+static uint32_t ml_knn_spread_dimension(const float *x, uint32_t p, const uint32_t *indices, uint32_t start, uint32_t end)
+{
+    uint32_t dimension = p;
+    float widest = 0.0f;
+
+    for(uint32_t j = 0; j < p; j++)
+    {
+        float low = INFINITY, high = -INFINITY;
+        for(uint32_t i = start; i < end; i++)
+        {
+            float value = x[(size_t)indices[i] * p + j];
+            low = fminf(low, value);
+            high = fmaxf(high, value);
+        }
+        if(high - low > widest)
+        {
+            widest = high - low;
+            dimension = j;
+        }
+    }
+    return dimension;
+}
+
+/*Median split of indices[start, end) into node, children are appended to the node array*/
+static void ml_knn_build_node(KNN *knn, const float *x, uint32_t *indices, uint32_t node_index, uint32_t start, uint32_t end)
+{
+    const uint32_t p = knn->num_features;
+    uint32_t dimension = ml_knn_spread_dimension(x, p, indices, start, end);
+    uint32_t middle = start + (end - start) / 2;
+    uint8_t is_leaf = end - start <= knn->leaf_size || dimension == p;
+    uint32_t left = knn->num_tree_nodes;
+
+    if(knn->index_algorithm == BALL_TREE)
+    {
+        BallTreeNode *node = knn->ball_tree + node_index;
+        float *centroid = knn->ball_centroids + (size_t)node_index * p;
+        float radius = 0.0f;
+        for(uint32_t j = 0; j < p; j++)
+        {
+            double sum = 0.0;
+            for(uint32_t i = start; i < end; i++)
+            {
+                sum += x[(size_t)indices[i] * p + j];
+            }
+            centroid[j] = (float)(sum / (end - start));
+        }
+        for(uint32_t i = start; i < end; i++)
+        {
+            radius = fmaxf(radius, ml_knn_point_distance(knn, x + (size_t)indices[i] * p, centroid));
+        }
+        node->start = start;
+        node->end = end;
+        node->radius = ml_knn_finish(knn, radius);
+        node->left = is_leaf ? 0 : left;
+        node->is_leaf = is_leaf;
+    }
+    else
+    {
+        KDTreeNode *node = knn->kd_tree + node_index;
+        node->start = start;
+        node->end = end;
+        node->left = is_leaf ? 0 : left;
+        node->is_leaf = is_leaf;
+        if(!is_leaf)
+        {
+            ml_knn_select(x, p, dimension, indices + start, end - start, middle - start);
+            node->split_dimension = dimension;
+            node->split_value = x[(size_t)indices[middle] * p + dimension];
+        }
+    }
+    if(is_leaf)
+    {
+        return;
+    }
+    if(knn->index_algorithm == BALL_TREE)
+    {
+        ml_knn_select(x, p, dimension, indices + start, end - start, middle - start);
+    }
+    knn->num_tree_nodes += 2;
+    ml_knn_build_node(knn, x, indices, left, start, middle);
+    ml_knn_build_node(knn, x, indices, left + 1, middle, end);
+}
+
+static KNNAlgorithm ml_knn_pick(const KNN *knn)
+{
+    if(!ml_knn_metric_prunes(knn) || knn->algorithm == BRUTE_FORCE)
+    {
+        return BRUTE_FORCE;
+    }
+    if(knn->algorithm != AUTO_ALGORITHM)
+    {
+        return knn->algorithm;
+    }
+    if(knn->num_training_samples < ML_KNN_BRUTE_MAX_SAMPLES || knn->num_features > ML_KNN_BALL_MAX_DIMENSIONS)
+    {
+        return BRUTE_FORCE;
+    }
+    return knn->num_features <= ML_KNN_KD_MAX_DIMENSIONS ? KD_TREE : BALL_TREE;
+}
+
+/*Standardises the rows of x in place and keeps the scaling for queries*/
+static int ml_knn_scale(KNN *knn, float *x, uint32_t n)
+{
+    const uint32_t p = knn->num_features;
+
+    knn->feature_means = ml_vector_float_new(NULL, p);
+    knn->feature_stds = ml_vector_float_new(NULL, p);
+    if(knn->feature_means == NULL || knn->feature_stds == NULL)
+    {
+        return -1;
+    }
+    for(uint32_t j = 0; j < p; j++)
+    {
+        double sum = 0.0, squares = 0.0, mean, variance;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            sum += x[(size_t)i * p + j];
+        }
+        mean = sum / n;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            double d = x[(size_t)i * p + j] - mean;
+            squares += d * d;
+        }
+        variance = squares / n;
+        knn->feature_means->vector[j] = (float)mean;
+        /*A constant feature is left as it is*/
+        knn->feature_stds->vector[j] = variance > 0.0 ? (float)sqrt(variance) : 1.0f;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            x[(size_t)i * p + j] = (x[(size_t)i * p + j] - knn->feature_means->vector[j]) / knn->feature_stds->vector[j];
+        }
+    }
+    return 0;
+}
+
+int ml_knn_init(KNN *knn, uint32_t k, uint8_t is_classifier)
+{
+    if(knn == NULL)
+    {
+        return -1;
+    }
+    memset(knn, 0, sizeof(KNN));
+    knn->k = k > 0 ? k : ML_KNN_DEFAULT_K;
+    knn->distance_metric = EUCLIDEAN_DISTANCE;
+    knn->weight_function = UNIFORM_WEIGHTS;
+    knn->algorithm = AUTO_ALGORITHM;
+    knn->index_algorithm = BRUTE_FORCE;
+    knn->minkowski_p = 2.0f;
+    knn->gaussian_sigma = 1.0f;
+    knn->is_classifier = is_classifier;
+    knn->leaf_size = ML_KNN_DEFAULT_LEAF_SIZE;
+    return 0;
+}
+
+int ml_knn_fit(KNN *knn, const float *x, const float *y, uint32_t n, uint32_t num_features)
+{
+    Arena *scratch;
+    ArenaMark mark;
+    float *rows;
+    uint32_t *indices;
+    int ret = 0;
+
+    if(knn == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n == 0 || num_features == 0 || knn->k == 0 || knn->leaf_size == 0 ||
+        (knn->distance_metric == MINKOWSKI_DISTANCE && knn->minkowski_p <= 0.0f))
+    {
+        return -2;
+    }
+    ml_knn_free(knn);
+    knn->num_training_samples = n;
+    knn->num_features = num_features;
+
+    knn->y_train = ml_vector_float_new(NULL, n);
+    if(knn->y_train == NULL)
+    {
+        return -1;
+    }
+    memcpy(knn->y_train->vector, y, n * sizeof(float));
+    if(knn->is_classifier)
+    {
+        knn->class_labels = malloc(n * sizeof(uint32_t));
+        if(knn->class_labels == NULL)
+        {
+            ml_knn_free(knn);
+            return -1;
+        }
+        knn->num_classes = 0;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            if(y[i] < 0.0f || y[i] != floorf(y[i]))
+            {
+                ml_knn_free(knn);
+                return -2;
+            }
+            knn->class_labels[i] = (uint32_t)y[i];
+            knn->num_classes = MAX(knn->num_classes, knn->class_labels[i] + 1);
+        }
+    }
+
+    scratch = arena_scratch();
+    mark = arena_mark(scratch);
+    rows = arena_new(scratch, float, (size_t)n * num_features);
+    indices = malloc(n * sizeof(uint32_t));
+    knn->point_indices = indices;
+    if(rows == NULL || indices == NULL)
+    {
+        ret = -1;
+        goto done;
+    }
+    memcpy(rows, x, (size_t)n * num_features * sizeof(float));
+    if(knn->is_scaled && ml_knn_scale(knn, rows, n) != 0)
+    {
+        ret = -1;
+        goto done;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        indices[i] = i;
+    }
+
+    knn->index_algorithm = ml_knn_pick(knn);
+    if(knn->index_algorithm != BRUTE_FORCE)
+    {
+        /*Every leaf keeps at least one point, so a tree has fewer than 2n nodes*/
+        if(knn->index_algorithm == KD_TREE)
+        {
+            knn->kd_tree = malloc(2 * (size_t)n * sizeof(KDTreeNode));
+        }
+        else
+        {
+            knn->ball_tree = malloc(2 * (size_t)n * sizeof(BallTreeNode));
+            knn->ball_centroids = malloc(2 * (size_t)n * num_features * sizeof(float));
+        }
+        if((knn->index_algorithm == KD_TREE && knn->kd_tree == NULL) ||
+            (knn->index_algorithm == BALL_TREE && (knn->ball_tree == NULL || knn->ball_centroids == NULL)))
+        {
+            ret = -1;
+            goto done;
+        }
+        knn->num_tree_nodes = 1;
+        ml_knn_build_node(knn, rows, indices, 0, 0, n);
+    }
+
+    /*Points are stored in tree order, the points of a leaf are one range of every column*/
+    knn->points = malloc((size_t)n * num_features * sizeof(float));
+    if(knn->distance_metric == COSINE_DISTANCE)
+    {
+        knn->point_norms = calloc(n, sizeof(float));
+    }
+    if(knn->points == NULL || (knn->distance_metric == COSINE_DISTANCE && knn->point_norms == NULL))
+    {
+        ret = -1;
+        goto done;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        const float *row = rows + (size_t)indices[i] * num_features;
+        for(uint32_t j = 0; j < num_features; j++)
+        {
+            knn->points[(size_t)j * n + i] = row[j];
+            if(knn->point_norms != NULL)
+            {
+                knn->point_norms[i] += row[j] * row[j];
+            }
+        }
+        if(knn->point_norms != NULL)
+        {
+            knn->point_norms[i] = sqrtf(knn->point_norms[i]);
+        }
+    }
+
+done:
+    arena_release(scratch, mark);
+    if(ret != 0)
+    {
+        ml_knn_free(knn);
+    }
+    return ret;
+}
+
+int ml_knn_query(const KNN *knn, const float *query, uint32_t indices[], float distances[])
+{
+    Arena *scratch;
+    ArenaMark mark;
+    uint32_t found;
+
+    if(knn == NULL || knn->points == NULL || query == NULL || indices == NULL || distances == NULL)
+    {
+        return -1;
+    }
+    scratch = arena_scratch();
+    mark = arena_mark(scratch);
+    found = ml_knn_find(knn, scratch, query, indices, distances);
+    arena_release(scratch, mark);
+    return (int)found;
+}
+
+static float ml_knn_weight(const KNN *knn, float distance)
+{
+    switch(knn->weight_function)
+    {
+        case DISTANCE_WEIGHTS:
+            return 1.0f / distance;
+        case GAUSSIAN_WEIGHTS:
+            return expf(-distance * distance / (2.0f * knn->gaussian_sigma * knn->gaussian_sigma));
+        default:
+            return 1.0f;
+    }
+}
+
+/*votes has num_classes entries for classifiers*/
+static float ml_knn_aggregate(const KNN *knn, const uint32_t indices[], const float distances[], uint32_t found, double *votes)
+{
+    /*With inverse distance weights exact matches take all the weight*/
+    uint8_t exact = knn->weight_function == DISTANCE_WEIGHTS && found > 0 && distances[0] == 0.0f;
+    double sum = 0.0, weights = 0.0, best = 0.0;
+    uint32_t label;
+
+    if(found == 0)
+    {
+        return 0.0f;
+    }
+    if(knn->is_classifier)
+    {
+        memset(votes, 0, knn->num_classes * sizeof(double));
+    }
+    for(uint32_t i = 0; i < found; i++)
+    {
+        float weight = exact ? (distances[i] == 0.0f) : ml_knn_weight(knn, distances[i]);
+        if(knn->is_classifier)
+        {
+            votes[knn->class_labels[indices[i]]] += weight;
+        }
+        sum += weight * knn->y_train->vector[indices[i]];
+        weights += weight;
+    }
+    if(!knn->is_classifier)
+    {
+        /*Gaussian weights of far neighbours can all round to zero, the nearest decides then*/
+        return weights > 0.0 ? (float)(sum / weights) : knn->y_train->vector[indices[0]];
+    }
+    label = knn->class_labels[indices[0]];
+    best = votes[label];
+    for(uint32_t c = 0; c < knn->num_classes; c++)
+    {
+        if(votes[c] > best)
+        {
+            best = votes[c];
+            label = c;
+        }
+    }
+    return (float)label;
+}
+
+int ml_knn_predict(const KNN *knn, const float *x, float *outputs, uint32_t n)
+{
+    Arena *scratch;
+    ArenaMark mark;
+    uint32_t *indices;
+    float *distances;
+    double *votes = NULL;
+    int ret = 0;
+
+    if(knn == NULL || knn->points == NULL || x == NULL || outputs == NULL)
+    {
+        return -1;
+    }
+    scratch = arena_scratch();
+    mark = arena_mark(scratch);
+    indices = arena_new(scratch, uint32_t, knn->k);
+    distances = arena_new(scratch, float, knn->k);
+    if(knn->is_classifier)
+    {
+        votes = arena_new(scratch, double, knn->num_classes);
+    }
+    if(indices == NULL || distances == NULL || (knn->is_classifier && votes == NULL))
+    {
+        ret = -1;
+    }
+    for(uint32_t i = 0; i < n && ret == 0; i++)
+    {
+        /*The query temporaries go back right away, the outputs stay put*/
+        ArenaMark row_mark = arena_mark(scratch);
+        uint32_t found = ml_knn_find(knn, scratch, x + (size_t)i * knn->num_features, indices, distances);
+        outputs[i] = ml_knn_aggregate(knn, indices, distances, found, votes);
+        arena_release(scratch, row_mark);
+    }
+    arena_release(scratch, mark);
+    return ret;
+}
+
+int ml_knn_free(KNN *knn)
+{
+    if(knn == NULL)
+    {
+        return -1;
+    }
+    free(knn->points);
+    free(knn->point_indices);
+    free(knn->point_norms);
+    free(knn->class_labels);
+    free(knn->kd_tree);
+    free(knn->ball_tree);
+    free(knn->ball_centroids);
+    ml_vector_float_free(knn->y_train);
+    ml_vector_float_free(knn->feature_means);
+    ml_vector_float_free(knn->feature_stds);
+    knn->points = NULL;
+    knn->point_indices = NULL;
+    knn->point_norms = NULL;
+    knn->class_labels = NULL;
+    knn->kd_tree = NULL;
+    knn->ball_tree = NULL;
+    knn->ball_centroids = NULL;
+    knn->y_train = NULL;
+    knn->feature_means = NULL;
+    knn->feature_stds = NULL;
+    knn->num_tree_nodes = 0;
+    knn->index_algorithm = BRUTE_FORCE;
+    return 0;
+}
@@ -62,13 +62,16 @@ int ml_nightcore_data_init(MLNightcoreData *ml_nightcore_data, float origin_bpm,
         json_object_set_double_member(json_object, "reverb_feedback", ml_nightcore_data->reverb_feedback);
         json_object_set_double_member(json_object, "reverb_value", ml_nightcore_data->reverb_value);
 
+        JsonNode *root = json_node_new(JSON_NODE_OBJECT);
+        json_node_take_object(root, json_object);
+
         JsonGenerator *generator = json_generator_new();
-        json_generator_set_root(generator, JSON_NODE(json_object));
+        json_generator_set_root(generator, root);
         
         gchar *json_string = json_generator_to_data(generator, NULL);
         
         g_object_unref(generator);
-        g_object_unref(json_object);
+        json_node_free(root);
         return json_string;
     }
 
@@ -87,10 +90,17 @@ int ml_nightcore_data_init(MLNightcoreData *ml_nightcore_data, float origin_bpm,
         {
             g_printerr("Error parsing JSON: %s\n", error->message);
             g_error_free(error);
+            g_object_unref(parser);
             return -1;
         }
 
         JsonNode *root = json_parser_get_root(parser);
+        if(root == NULL || !JSON_NODE_HOLDS_OBJECT(root))
+        {
+            g_printerr("JSON root is not an object\n");
+            g_object_unref(parser);
+            return -1;
+        }
         JsonObject *json_object = json_node_get_object(root);
 
         ml_nightcore_data->origin_bpm = json_object_get_double_member(json_object, "origin_bpm");
@@ -146,4 +156,244 @@ int ml_nightcore_data_init(MLNightcoreData *ml_nightcore_data, float origin_bpm,
         // Free the structure itself if it was dynamically allocated
         free(ml_nightcore_data);
         return 0;
-    }
\ No newline at end of file
+    }
+
+    int ml_nightcore_features(const MLNightcoreData *ml_nightcore_data, float features[])
+    {
+        if(ml_nightcore_data == NULL || features == NULL)
+        {
+            return -1;
+        }
+        features[0] = ml_nightcore_data->origin_bpm;
+        features[1] = ml_nightcore_data->input_pitch;
+        features[2] = ml_nightcore_data->input_bass;
+        return 0;
+    }
+
+    float ml_nightcore_target(const MLNightcoreData *ml_nightcore_data, MLNightcoreTarget target)
+    {
+        switch(target)
+        {
+            case ML_TARGET_OUTPUT_BPM:
+                return ml_nightcore_data->output_bpm;
+            case ML_TARGET_PITCH:
+                return ml_nightcore_data->pitch;
+            case ML_TARGET_OUTPUT_SPEED:
+                return ml_nightcore_data->output_speed;
+            case ML_TARGET_BASS_BOOST:
+                return ml_nightcore_data->bass_boost;
+        }
+        return 0.0f;
+    }
+
+    /*Songs are packed into one row major feature matrix, so the whole history is a single fit*/
+    static float *ml_nightcore_feature_matrix(Arena *arena, MLNightcoreData *ml_nightcore_data[], unsigned int n)
+    {
+        float *x = arena_new(arena, float, (size_t)n * ML_NIGHTCORE_NUM_FEATURES);
+        if(x == NULL)
+        {
+            return NULL;
+        }
+        for(unsigned int i = 0; i < n; i++)
+        {
+            if(ml_nightcore_features(ml_nightcore_data[i], x + (size_t)i * ML_NIGHTCORE_NUM_FEATURES) != 0)
+            {
+                return NULL;
+            }
+        }
+        return x;
+    }
+
+    /*Feature matrix and target column for fitting any of the models on the song history*/
+    static int ml_nightcore_training_set(Arena *arena, MLNightcoreData *ml_nightcore_data[], unsigned int n,
+                                            MLNightcoreTarget target, float **x, float **y)
+    {
+        *x = ml_nightcore_feature_matrix(arena, ml_nightcore_data, n);
+        *y = arena_new(arena, float, n);
+        if(*x == NULL || *y == NULL)
+        {
+            return -1;
+        }
+        for(unsigned int i = 0; i < n; i++)
+        {
+            (*y)[i] = ml_nightcore_target(ml_nightcore_data[i], target);
+        }
+        return 0;
+    }
+
+    int ml_nightcore_multi_linear_regression(MultiLinearRegressionData *model, MLNightcoreData *ml_nightcore_data[],
+                                                unsigned int n, MLNightcoreTarget target)
+    {
+        Arena *scratch = arena_scratch();
+        ArenaMark mark = arena_mark(scratch);
+        float *x, *y;
+        int ret;
+
+        if(model == NULL || ml_nightcore_data == NULL)
+        {
+            g_printerr("Invalid parameters for linear regression\n");
+            return -1;
+        }
+        ret = ml_multi_linear_regression_init(model, ML_NIGHTCORE_NUM_FEATURES);
+        if(ret != 0)
+        {
+            return ret;
+        }
+        if(ml_nightcore_training_set(scratch, ml_nightcore_data, n, target, &x, &y) != 0)
+        {
+            ml_multi_linear_regression_free(model);
+            arena_release(scratch, mark);
+            return -1;
+        }
+        ret = ml_multi_linear_regression_learn(model, x, y, n);
+        if(ret != 0)
+        {
+            g_printerr("Linear regression over %u songs failed (%d)\n", n, ret);
+            ml_multi_linear_regression_free(model);
+        }
+        arena_release(scratch, mark);
+        return ret;
+    }
+
+    int ml_nightcore_multi_linear_regression_predict(const MultiLinearRegressionData *model, MLNightcoreData *ml_nightcore_data[],
+                                                        unsigned int n, float outputs[])
+    {
+        Arena *scratch = arena_scratch();
+        ArenaMark mark = arena_mark(scratch);
+        float *x;
+        int ret;
+
+        if(model == NULL || ml_nightcore_data == NULL || outputs == NULL)
+        {
+            return -1;
+        }
+        x = ml_nightcore_feature_matrix(scratch, ml_nightcore_data, n);
+        ret = x != NULL ? ml_multi_linear_regression_predict(model, x, outputs, n) : -1;
+        arena_release(scratch, mark);
+        return ret;
+    }
+
+    int ml_polynomial_regression(PolyRegressionData *poly_regression_data, MLNightcoreData *ml_nightcore_data[], unsigned int n)
+    {
+        double *x, *y;
+        int ret;
+
+        if(poly_regression_data == NULL || ml_nightcore_data == NULL)
+        {
+            g_printerr("Invalid parameters for polynomial regression\n");
+            return -1;
+        }
+        x = g_new(double, n);
+        y = g_new(double, n);
+        for(unsigned int i = 0; i < n; i++)
+        {
+            x[i] = ml_nightcore_data[i]->origin_bpm;
+            y[i] = ml_nightcore_data[i]->output_bpm;
+        }
+        ret = ml_poly_regression_data_init(poly_regression_data, x, y, n, poly_regression_data->degree);
+        g_free(x);
+        g_free(y);
+        if(ret != 0)
+        {
+            return ret;
+        }
+        ret = ml_poly_regression_model_learn(poly_regression_data);
+        if(ret != 0)
+        {
+            g_printerr("Polynomial regression of degree %u over %u songs failed (%d)\n", poly_regression_data->degree, n, ret);
+        }
+        return ret;
+    }
+
+    int ml_nightcore_knn(KNN *knn, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target)
+    {
+        Arena *scratch = arena_scratch();
+        ArenaMark mark = arena_mark(scratch);
+        float *x, *y;
+        int ret;
+
+        if(knn == NULL || ml_nightcore_data == NULL)
+        {
+            g_printerr("Invalid parameters for KNN\n");
+            return -1;
+        }
+        if(ml_nightcore_training_set(scratch, ml_nightcore_data, n, target, &x, &y) != 0)
+        {
+            arena_release(scratch, mark);
+            return -1;
+        }
+        ret = ml_knn_fit(knn, x, y, n, ML_NIGHTCORE_NUM_FEATURES);
+        if(ret != 0)
+        {
+            g_printerr("KNN over %u songs failed (%d)\n", n, ret);
+        }
+        arena_release(scratch, mark);
+        return ret;
+    }
+
+    int ml_nightcore_knn_free(KNN *knn)
+    {
+        return ml_knn_free(knn);
+    }
+
+    int ml_nightcore_decision_tree(DecisionTree *tree, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target)
+    {
+        Arena *scratch = arena_scratch();
+        ArenaMark mark = arena_mark(scratch);
+        float *x, *y;
+        int ret;
+
+        if(tree == NULL || ml_nightcore_data == NULL)
+        {
+            g_printerr("Invalid parameters for decision tree\n");
+            return -1;
+        }
+        if(ml_nightcore_training_set(scratch, ml_nightcore_data, n, target, &x, &y) != 0)
+        {
+            arena_release(scratch, mark);
+            return -1;
+        }
+        ret = ml_decision_tree_fit(tree, x, y, n, ML_NIGHTCORE_NUM_FEATURES);
+        if(ret != 0)
+        {
+            g_printerr("Decision tree over %u songs failed (%d)\n", n, ret);
+        }
+        arena_release(scratch, mark);
+        return ret;
+    }
+
+    int ml_nightcore_decision_tree_free(DecisionTree *tree)
+    {
+        return ml_decision_tree_free(tree);
+    }
+
+    int ml_nightcore_random_forest(RandomForest *forest, MLNightcoreData *ml_nightcore_data[], unsigned int n, MLNightcoreTarget target)
+    {
+        Arena *scratch = arena_scratch();
+        ArenaMark mark = arena_mark(scratch);
+        float *x, *y;
+        int ret;
+
+        if(forest == NULL || ml_nightcore_data == NULL)
+        {
+            g_printerr("Invalid parameters for random forest\n");
+            return -1;
+        }
+        if(ml_nightcore_training_set(scratch, ml_nightcore_data, n, target, &x, &y) != 0)
+        {
+            arena_release(scratch, mark);
+            return -1;
+        }
+        ret = ml_random_forest_fit(forest, x, y, n, ML_NIGHTCORE_NUM_FEATURES);
+        if(ret != 0)
+        {
+            g_printerr("Random forest over %u songs failed (%d)\n", n, ret);
+        }
+        arena_release(scratch, mark);
+        return ret;
+    }
+
+    int ml_nightcore_random_forest_free(RandomForest *forest)
+    {
+        return ml_random_forest_free(forest);
+    }
@@ -0,0 +1,701 @@
+#include "ml.h"
+#include "utils.h"
+#include <math.h>
+#include <string.h>
+
+/*Regression bins keep count, sum and sum of squares of the targets minus the node mean*/
+#define ML_TREE_REGRESSION_WIDTH 3
+/*Splits have to gain at least this share of the node impurity*/
+#define ML_TREE_MIN_GAIN_RATIO 1e-9
+/*Regression impurity below this share of the root variance is rounding left by the
+  histogram subtraction, the node counts as pure*/
+#define ML_TREE_NOISE_RATIO 1e-10
+
+/*State of one training run*/
+typedef struct TreeBuilder_
+{
+    DecisionTree *tree;
+    const BinnedDataset *data;
+    uint32_t *samples;          /*partitioned in place, a node owns one range*/
+    DecisionTreeNode *nodes;
+    uint32_t *left_children;    /*child indices until the node array has its final size*/
+    uint32_t *right_children;
+    uint32_t num_nodes;
+    uint32_t width;             /*statistics per bin*/
+    uint32_t max_depth;
+    double noise;               /*impurity that is only rounding*/
+    uint32_t *features;         /*tried at a split are the first num_tried*/
+    uint32_t num_tried;
+    double *importance;         /*weighted impurity decrease of every feature*/
+    Arena *scratch;
+}TreeBuilder;
+
+typedef struct TreeSplit_
+{
+    uint32_t feature;
+    uint32_t bin;
+    double gain;
+}TreeSplit;
+
+/*Upper bin edges at the quantiles of a sorted column, repeated values share a bin*/
+static uint16_t ml_tree_bin_edges(const float *sorted, uint32_t n, float *edges)
+{
+    uint16_t bins = 0;
+    for(uint32_t b = 1; b <= ML_TREE_MAX_BINS; b++)
+    {
+        size_t position = (size_t)b * n / ML_TREE_MAX_BINS;
+        if(position == 0)
+        {
+            continue;
+        }
+        if(bins == 0 || sorted[position - 1] > edges[bins - 1])
+        {
+            edges[bins++] = sorted[position - 1];
+        }
+    }
+    return bins;
+}
+
+/*First bin whose edge is not below value*/
+static uint8_t ml_tree_bin_code(const float *edges, uint16_t bins, float value)
+{
+    uint32_t low = 0, high = bins - 1u;
+    while(low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if(value <= edges[middle])
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return (uint8_t)low;
+}
+
+int ml_binned_dataset_init(BinnedDataset *data, const float *x, const float *y, uint32_t n, uint32_t num_features, TreeType tree_type)
+{
+    Arena *scratch;
+    ArenaMark mark;
+    float *column;
+
+    if(data == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    if(n == 0 || num_features == 0)
+    {
+        return -2;
+    }
+    memset(data, 0, sizeof(BinnedDataset));
+    data->num_samples = n;
+    data->num_features = num_features;
+    data->tree_type = tree_type;
+    data->codes = malloc((size_t)n * num_features);
+    data->bin_edges = malloc((size_t)num_features * ML_TREE_MAX_BINS * sizeof(float));
+    data->num_bins = malloc(num_features * sizeof(uint16_t));
+    data->targets = malloc(n * sizeof(float));
+    if(tree_type == CLASSIFICATION_TREE)
+    {
+        data->class_labels = malloc(n * sizeof(uint32_t));
+    }
+    if(data->codes == NULL || data->bin_edges == NULL || data->num_bins == NULL || data->targets == NULL ||
+        (tree_type == CLASSIFICATION_TREE && data->class_labels == NULL))
+    {
+        ml_binned_dataset_free(data);
+        return -1;
+    }
+    memcpy(data->targets, y, n * sizeof(float));
+    if(tree_type == CLASSIFICATION_TREE)
+    {
+        for(uint32_t i = 0; i < n; i++)
+        {
+            if(y[i] < 0.0f || y[i] != floorf(y[i]))
+            {
+                ml_binned_dataset_free(data);
+                return -2;
+            }
+            data->class_labels[i] = (uint32_t)y[i];
+            data->num_classes = MAX(data->num_classes, data->class_labels[i] + 1);
+        }
+    }
+
+    scratch = arena_scratch();
+    mark = arena_mark(scratch);
+    column = arena_new(scratch, float, n);
+    if(column == NULL)
+    {
+        arena_release(scratch, mark);
+        ml_binned_dataset_free(data);
+        return -1;
+    }
+    for(uint32_t j = 0; j < num_features; j++)
+    {
+        float *edges = data->bin_edges + (size_t)j * ML_TREE_MAX_BINS;
+        uint8_t *codes = data->codes + (size_t)j * n;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            column[i] = x[(size_t)i * num_features + j];
+        }
+        utils_float_sort(column, n);
+        data->num_bins[j] = ml_tree_bin_edges(column, n, edges);
+        for(uint32_t i = 0; i < n; i++)
+        {
+            codes[i] = ml_tree_bin_code(edges, data->num_bins[j], x[(size_t)i * num_features + j]);
+        }
+    }
+    arena_release(scratch, mark);
+    return 0;
+}
+
+int ml_binned_dataset_free(BinnedDataset *data)
+{
+    if(data == NULL)
+    {
+        return -1;
+    }
+    free(data->codes);
+    free(data->bin_edges);
+    free(data->num_bins);
+    free(data->targets);
+    free(data->class_labels);
+    memset(data, 0, sizeof(BinnedDataset));
+    return 0;
+}
+
+/*Statistics of every bin of every feature over samples[0, count), regression targets
+  minus shift*/
+static void ml_tree_histogram(const TreeBuilder *builder, const uint32_t *samples, uint32_t count, double shift, double *histogram)
+{
+    const BinnedDataset *data = builder->data;
+    const uint32_t width = builder->width;
+
+    memset(histogram, 0, (size_t)data->num_features * ML_TREE_MAX_BINS * width * sizeof(double));
+    for(uint32_t j = 0; j < data->num_features; j++)
+    {
+        const uint8_t *codes = data->codes + (size_t)j * data->num_samples;
+        double *bins = histogram + (size_t)j * ML_TREE_MAX_BINS * width;
+        if(data->tree_type == CLASSIFICATION_TREE)
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                bins[codes[samples[i]] * width + data->class_labels[samples[i]]] += 1.0;
+            }
+        }
+        else
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                double *bin = bins + codes[samples[i]] * width;
+                double y = data->targets[samples[i]] - shift;
+                bin[0] += 1.0;
+                bin[1] += y;
+                bin[2] += y * y;
+            }
+        }
+    }
+}
+
+static double ml_tree_count(const TreeBuilder *builder, const double *statistics)
+{
+    double count = 0.0;
+    if(builder->data->tree_type != CLASSIFICATION_TREE)
+    {
+        return statistics[0];
+    }
+    for(uint32_t c = 0; c < builder->width; c++)
+    {
+        count += statistics[c];
+    }
+    return count;
+}
+
+/*Moves the regression statistics of a node from its parent mean to its own mean, so the
+  sums of squares hold the spread and not the offset of the targets. Returns the shift.*/
+static double ml_tree_recentre(const TreeBuilder *builder, double *histogram, double *total, double count)
+{
+    const size_t num_bins = (size_t)builder->data->num_features * ML_TREE_MAX_BINS;
+    const double shift = total[1] / count;
+
+    for(size_t b = 0; b < num_bins; b++)
+    {
+        double *bin = histogram + b * ML_TREE_REGRESSION_WIDTH;
+        bin[2] += shift * (shift * bin[0] - 2.0 * bin[1]);
+        bin[1] -= shift * bin[0];
+    }
+    total[2] += shift * (shift * total[0] - 2.0 * total[1]);
+    total[1] -= shift * total[0];
+    return shift;
+}
+
+static double ml_tree_impurity(const TreeBuilder *builder, const double *statistics, double count)
+{
+    double impurity = 0.0;
+
+    if(count <= 0.0)
+    {
+        return 0.0;
+    }
+    switch(builder->tree->criterion)
+    {
+        case GINI:
+            impurity = 1.0;
+            for(uint32_t c = 0; c < builder->width; c++)
+            {
+                double share = statistics[c] / count;
+                impurity -= share * share;
+            }
+            return impurity;
+        case ENTROPY:
+            for(uint32_t c = 0; c < builder->width; c++)
+            {
+                double share = statistics[c] / count;
+                if(share > 0.0)
+                {
+                    impurity -= share * log2(share);
+                }
+            }
+            return impurity;
+        default:
+            impurity = statistics[2] / count - (statistics[1] / count) * (statistics[1] / count);
+            return MAX(impurity, 0.0);
+    }
+}
+
+/*Scans the bins of every feature left to right, the right side is total minus left.
+  Returns 0 when no split keeps min_samples_leaf on both sides.*/
+static int ml_tree_best_split(const TreeBuilder *builder, const double *histogram, const double *total,
+                                double count, double impurity, TreeSplit *best)
+{
+    const BinnedDataset *data = builder->data;
+    const uint32_t width = builder->width;
+    const double min_leaf = builder->tree->min_samples_leaf;
+    double left[width], right[width];
+    int found = 0;
+
+    best->gain = MAX(ML_TREE_MIN_GAIN_RATIO * impurity, builder->noise);
+    for(uint32_t f = 0; f < builder->num_tried; f++)
+    {
+        const uint32_t j = builder->features[f];
+        const double *bins = histogram + (size_t)j * ML_TREE_MAX_BINS * width;
+        double left_count = 0.0;
+        memset(left, 0, sizeof(left));
+        for(uint32_t b = 0; b + 1 < data->num_bins[j]; b++)
+        {
+            double right_count, gain;
+            for(uint32_t s = 0; s < width; s++)
+            {
+                left[s] += bins[b * width + s];
+            }
+            left_count = ml_tree_count(builder, left);
+            right_count = count - left_count;
+            if(left_count < min_leaf)
+            {
+                continue;
+            }
+            if(right_count < min_leaf)
+            {
+                break;
+            }
+            for(uint32_t s = 0; s < width; s++)
+            {
+                right[s] = total[s] - left[s];
+            }
+            gain = impurity - (left_count * ml_tree_impurity(builder, left, left_count) +
+                                right_count * ml_tree_impurity(builder, right, right_count)) / count;
+            if(gain > best->gain)
+            {
+                best->feature = j;
+                best->bin = b;
+                best->gain = gain;
+                found = 1;
+            }
+        }
+    }
+    return found && best->gain >= builder->tree->min_impurity_decrease;
+}
+
+/*Partial Fisher-Yates shuffle, the features tried at this split end up in front*/
+static void ml_tree_draw_features(TreeBuilder *builder)
+{
+    DecisionTree *tree = builder->tree;
+    const uint32_t p = builder->data->num_features;
+
+    if(tree->max_features == 0 || tree->max_features >= p)
+    {
+        return;
+    }
+    for(uint32_t f = 0; f < builder->num_tried; f++)
+    {
+        uint32_t pick = f + ml_random_below(&tree->random, p - f);
+        uint32_t temp = builder->features[f];
+        builder->features[f] = builder->features[pick];
+        builder->features[pick] = temp;
+    }
+}
+
+/*Mean value or majority class of the node, regression statistics are centred on mean*/
+static void ml_tree_leaf_values(const TreeBuilder *builder, DecisionTreeNode *node, const double *total, double count, double mean)
+{
+    if(builder->data->tree_type == CLASSIFICATION_TREE)
+    {
+        uint32_t label = 0;
+        for(uint32_t c = 1; c < builder->width; c++)
+        {
+            if(total[c] > total[label])
+            {
+                label = c;
+            }
+        }
+        node->class_label = label;
+        node->prediction = (float)label;
+        node->confidence = (float)(total[label] / count);
+    }
+    else
+    {
+        node->prediction = (float)(mean + total[1] / count);
+        node->confidence = 1.0f;
+    }
+}
+
+/*Grows the node for samples[start, end), histogram holds their statistics around shift
+  and is reused for the larger child. Returns the index of the node.*/
+static uint32_t ml_tree_grow(TreeBuilder *builder, uint32_t start, uint32_t end, uint32_t depth, double shift, double *histogram)
+{
+    const BinnedDataset *data = builder->data;
+    const uint32_t width = builder->width;
+    const uint32_t node_index = builder->num_nodes++;
+    DecisionTreeNode *node = builder->nodes + node_index;
+    double total[width];
+    double count, impurity;
+    TreeSplit split;
+    ArenaMark mark;
+    double *smaller;
+    const uint8_t *codes;
+    uint32_t middle, left_index, right_index;
+
+    /*Every feature sees every sample, the first one gives the totals*/
+    memset(total, 0, sizeof(total));
+    for(uint32_t b = 0; b < data->num_bins[0]; b++)
+    {
+        for(uint32_t s = 0; s < width; s++)
+        {
+            total[s] += histogram[b * width + s];
+        }
+    }
+    count = end - start;
+    if(data->tree_type != CLASSIFICATION_TREE)
+    {
+        shift += ml_tree_recentre(builder, histogram, total, count);
+    }
+    impurity = ml_tree_impurity(builder, total, count);
+    if(impurity <= builder->noise)
+    {
+        impurity = 0.0;
+    }
+    memset(node, 0, sizeof(DecisionTreeNode));
+    node->node_type = LEAF_NODE;
+    node->num_samples = end - start;
+    node->impurity = (float)impurity;
+    ml_tree_leaf_values(builder, node, total, count, shift);
+    builder->left_children[node_index] = 0;
+    builder->right_children[node_index] = 0;
+    builder->tree->actual_depth = MAX(builder->tree->actual_depth, depth);
+
+    if(depth >= builder->max_depth || end - start < builder->tree->min_samples_split || impurity <= 0.0)
+    {
+        return node_index;
+    }
+    ml_tree_draw_features(builder);
+    if(!ml_tree_best_split(builder, histogram, total, count, impurity, &split))
+    {
+        return node_index;
+    }
+
+    codes = data->codes + (size_t)split.feature * data->num_samples;
+    middle = start;
+    for(uint32_t i = start; i < end; i++)
+    {
+        if(codes[builder->samples[i]] <= split.bin)
+        {
+            uint32_t temp = builder->samples[i];
+            builder->samples[i] = builder->samples[middle];
+            builder->samples[middle++] = temp;
+        }
+    }
+    node->node_type = INTERNAL_NODE;
+    node->feature_index = split.feature;
+    node->split_bin = (uint8_t)split.bin;
+    node->threshold = data->bin_edges[(size_t)split.feature * ML_TREE_MAX_BINS + split.bin];
+    node->gain = (float)split.gain;
+    builder->importance[split.feature] += split.gain * count;
+
+    /*Only the smaller child is counted, the parent histogram becomes the larger one*/
+    mark = arena_mark(builder->scratch);
+    smaller = arena_new(builder->scratch, double, (size_t)data->num_features * ML_TREE_MAX_BINS * width);
+    if(smaller == NULL)
+    {
+        arena_release(builder->scratch, mark);
+        node->node_type = LEAF_NODE;
+        return node_index;
+    }
+    if(middle - start <= end - middle)
+    {
+        ml_tree_histogram(builder, builder->samples + start, middle - start, shift, smaller);
+    }
+    else
+    {
+        ml_tree_histogram(builder, builder->samples + middle, end - middle, shift, smaller);
+    }
+    for(size_t i = 0; i < (size_t)data->num_features * ML_TREE_MAX_BINS * width; i++)
+    {
+        histogram[i] -= smaller[i];
+    }
+    if(middle - start <= end - middle)
+    {
+        left_index = ml_tree_grow(builder, start, middle, depth + 1, shift, smaller);
+        right_index = ml_tree_grow(builder, middle, end, depth + 1, shift, histogram);
+    }
+    else
+    {
+        left_index = ml_tree_grow(builder, start, middle, depth + 1, shift, histogram);
+        right_index = ml_tree_grow(builder, middle, end, depth + 1, shift, smaller);
+    }
+    builder->left_children[node_index] = left_index;
+    builder->right_children[node_index] = right_index;
+    arena_release(builder->scratch, mark);
+    return node_index;
+}
+
+int ml_decision_tree_init(DecisionTree *tree, TreeType tree_type)
+{
+    if(tree == NULL)
+    {
+        return -1;
+    }
+    memset(tree, 0, sizeof(DecisionTree));
+    tree->tree_type = tree_type;
+    tree->criterion = tree_type == CLASSIFICATION_TREE ? GINI : MSE;
+    tree->max_depth = 0;
+    tree->min_samples_split = 2;
+    tree->min_samples_leaf = 1;
+    return 0;
+}
+
+int ml_decision_tree_fit_binned(DecisionTree *tree, const BinnedDataset *data, const uint32_t *samples, uint32_t num_samples)
+{
+    TreeBuilder builder;
+    ArenaMark mark;
+    double *histogram;
+    uint32_t capacity;
+    double correct = 0.0, mean = 0.0, total = 0.0, residual = 0.0, importance_sum = 0.0;
+
+    if(tree == NULL || data == NULL || data->codes == NULL || samples == NULL)
+    {
+        return -1;
+    }
+    if(num_samples == 0 || tree->tree_type != data->tree_type ||
+        (tree->tree_type == CLASSIFICATION_TREE) == (tree->criterion == MSE))
+    {
+        return -2;
+    }
+    ml_decision_tree_free(tree);
+    memset(&builder, 0, sizeof(TreeBuilder));
+    builder.tree = tree;
+    builder.data = data;
+    builder.width = tree->tree_type == CLASSIFICATION_TREE ? MAX(data->num_classes, 1) : ML_TREE_REGRESSION_WIDTH;
+    builder.max_depth = tree->max_depth > 0 ? MIN(tree->max_depth, ML_TREE_MAX_DEPTH) : ML_TREE_MAX_DEPTH;
+    builder.scratch = arena_scratch();
+    tree->num_features = data->num_features;
+    tree->num_classes = data->num_classes;
+    tree->num_training_samples = num_samples;
+    tree->actual_depth = 0;
+
+    /*Every leaf keeps at least one sample*/
+    capacity = 2 * num_samples - 1;
+    if(builder.max_depth < 31)
+    {
+        capacity = MIN(capacity, (2u << builder.max_depth) - 1);
+    }
+    mark = arena_mark(builder.scratch);
+    builder.samples = arena_new(builder.scratch, uint32_t, num_samples);
+    builder.nodes = malloc((size_t)capacity * sizeof(DecisionTreeNode));
+    builder.left_children = arena_new(builder.scratch, uint32_t, capacity);
+    builder.right_children = arena_new(builder.scratch, uint32_t, capacity);
+    histogram = arena_new(builder.scratch, double, (size_t)data->num_features * ML_TREE_MAX_BINS * builder.width);
+    builder.features = arena_new(builder.scratch, uint32_t, data->num_features);
+    builder.importance = arena_new0(builder.scratch, double, data->num_features);
+    tree->feature_importance = calloc(data->num_features, sizeof(float));
+    if(builder.samples == NULL || builder.nodes == NULL || builder.left_children == NULL ||
+        builder.right_children == NULL || histogram == NULL || builder.features == NULL ||
+        builder.importance == NULL || tree->feature_importance == NULL)
+    {
+        free(builder.nodes);
+        ml_decision_tree_free(tree);
+        arena_release(builder.scratch, mark);
+        return -1;
+    }
+    memcpy(builder.samples, samples, num_samples * sizeof(uint32_t));
+    for(uint32_t j = 0; j < data->num_features; j++)
+    {
+        builder.features[j] = j;
+    }
+    builder.num_tried = tree->max_features > 0 ? MIN(tree->max_features, data->num_features) : data->num_features;
+    /*The root is binned around the target mean, every node then recentres on its own*/
+    for(uint32_t i = 0; i < num_samples; i++)
+    {
+        mean += data->targets[samples[i]];
+    }
+    mean /= num_samples;
+    if(tree->tree_type != CLASSIFICATION_TREE)
+    {
+        for(uint32_t i = 0; i < num_samples; i++)
+        {
+            double deviation = data->targets[samples[i]] - mean;
+            builder.noise += deviation * deviation;
+        }
+        builder.noise *= ML_TREE_NOISE_RATIO / num_samples;
+    }
+    ml_tree_histogram(&builder, builder.samples, num_samples, mean, histogram);
+    ml_tree_grow(&builder, 0, num_samples, 0, mean, histogram);
+
+    /*The array only shrinks, children are linked once it stopped moving*/
+    tree->root = realloc(builder.nodes, builder.num_nodes * sizeof(DecisionTreeNode));
+    if(tree->root == NULL)
+    {
+        tree->root = builder.nodes;
+    }
+    for(uint32_t i = 0; i < builder.num_nodes; i++)
+    {
+        if(tree->root[i].node_type == INTERNAL_NODE)
+        {
+            tree->root[i].left_child = tree->root + builder.left_children[i];
+            tree->root[i].right_child = tree->root + builder.right_children[i];
+        }
+    }
+    tree->num_nodes = builder.num_nodes;
+    for(uint32_t j = 0; j < data->num_features; j++)
+    {
+        importance_sum += builder.importance[j];
+    }
+    for(uint32_t j = 0; j < data->num_features && importance_sum > 0.0; j++)
+    {
+        tree->feature_importance[j] = (float)(builder.importance[j] / importance_sum);
+    }
+    arena_release(builder.scratch, mark);
+
+    /*Accuracy for classification, r squared for regression*/
+    for(uint32_t i = 0; i < num_samples; i++)
+    {
+        float y = data->targets[samples[i]];
+        float prediction = ml_decision_tree_predict_binned(tree, data, samples[i]);
+        correct += prediction == y;
+        residual += (double)(prediction - y) * (prediction - y);
+        total += (y - mean) * (y - mean);
+    }
+    if(tree->tree_type == CLASSIFICATION_TREE)
+    {
+        tree->training_accuracy = (float)(correct / num_samples);
+    }
+    else
+    {
+        tree->training_accuracy = total > 0.0 ? (float)(1.0 - residual / total) : 1.0f;
+    }
+    return 0;
+}
+
+int ml_decision_tree_fit(DecisionTree *tree, const float *x, const float *y, uint32_t n, uint32_t num_features)
+{
+    BinnedDataset data;
+    uint32_t *samples;
+    int ret;
+
+    if(tree == NULL || x == NULL || y == NULL)
+    {
+        return -1;
+    }
+    ret = ml_binned_dataset_init(&data, x, y, n, num_features, tree->tree_type);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    samples = malloc(n * sizeof(uint32_t));
+    if(samples == NULL)
+    {
+        ml_binned_dataset_free(&data);
+        return -1;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        samples[i] = i;
+    }
+    ret = ml_decision_tree_fit_binned(tree, &data, samples, n);
+    free(samples);
+    ml_binned_dataset_free(&data);
+    return ret;
+}
+
+static float ml_tree_leaf_output(const DecisionTree *tree, const DecisionTreeNode *node)
+{
+    return tree->tree_type == CLASSIFICATION_TREE ? (float)node->class_label : node->prediction;
+}
+
+const DecisionTreeNode *ml_decision_tree_leaf(const DecisionTree *tree, const float *row)
+{
+    const DecisionTreeNode *node = tree->root;
+    while(node->node_type == INTERNAL_NODE)
+    {
+        node = row[node->feature_index] <= node->threshold ? node->left_child : node->right_child;
+    }
+    return node;
+}
+
+const DecisionTreeNode *ml_decision_tree_leaf_binned(const DecisionTree *tree, const BinnedDataset *data, uint32_t sample)
+{
+    const DecisionTreeNode *node = tree->root;
+    while(node->node_type == INTERNAL_NODE)
+    {
+        uint8_t code = data->codes[(size_t)node->feature_index * data->num_samples + sample];
+        node = code <= node->split_bin ? node->left_child : node->right_child;
+    }
+    return node;
+}
+
+float ml_decision_tree_predict_one(const DecisionTree *tree, const float *row)
+{
+    return ml_tree_leaf_output(tree, ml_decision_tree_leaf(tree, row));
+}
+
+float ml_decision_tree_predict_binned(const DecisionTree *tree, const BinnedDataset *data, uint32_t sample)
+{
+    return ml_tree_leaf_output(tree, ml_decision_tree_leaf_binned(tree, data, sample));
+}
+
+int ml_decision_tree_predict(const DecisionTree *tree, const float *x, float *outputs, uint32_t n)
+{
+    if(tree == NULL || tree->root == NULL || x == NULL || outputs == NULL)
+    {
+        return -1;
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        outputs[i] = ml_decision_tree_predict_one(tree, x + (size_t)i * tree->num_features);
+    }
+    return 0;
+}
+
+int ml_decision_tree_free(DecisionTree *tree)
+{
+    if(tree == NULL)
+    {
+        return -1;
+    }
+    free(tree->root);
+    free(tree->feature_importance);
+    tree->root = NULL;
+    tree->feature_importance = NULL;
+    tree->num_nodes = 0;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "ml_forest.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+
+#define BENCH_REPEATS 2
+#define BENCH_FEATURES 3
+#define BENCH_SONGS 10000
+#define BENCH_TREES 50
+
+/*Best of BENCH_REPEATS fits of a regression forest on num_threads workers*/
+static gint64 bench_forest(const float *x, const float *y, uint32_t num_threads, float *oob_score)
+{
+    gint64 best = G_MAXINT64;
+
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        RandomForest forest;
+        ml_random_forest_init(&forest, BENCH_TREES, REGRESSION_TREE);
+        forest.num_threads = num_threads;
+        gint64 start = g_get_monotonic_time();
+        if(ml_random_forest_fit(&forest, x, y, BENCH_SONGS, BENCH_FEATURES) != 0)
+        {
+            g_printerr("fit failed\n");
+            exit(1);
+        }
+        best = MIN(best, g_get_monotonic_time() - start);
+        *oob_score = forest.oob_score;
+        ml_random_forest_free(&forest);
+    }
+    return best;
+}
+
+int main(void)
+{
+    float *x = g_new(float, (size_t)BENCH_SONGS * BENCH_FEATURES);
+    float *y = g_new(float, BENCH_SONGS);
+    uint32_t threads[] = {1, 2, 4, g_get_num_processors()};
+    uint32_t state = 1;
+    gint64 single = 0;
+
+    for(uint32_t i = 0; i < BENCH_SONGS; i++)
+    {
+        float *row = x + (size_t)i * BENCH_FEATURES;
+        row[0] = 80.0f + 100.0f * test_uniform(&state);
+        row[1] = 200.0f + 500.0f * test_uniform(&state);
+        row[2] = 40.0f * test_uniform(&state);
+        y[i] = (row[0] < 120.0f ? 1.5f : 1.2f) * row[0] + 0.2f * row[2] + test_uniform(&state) - 0.5f;
+    }
+    for(guint i = 0; i < G_N_ELEMENTS(threads); i++)
+    {
+        float oob_score;
+        gint64 elapsed = bench_forest(x, y, threads[i], &oob_score);
+        if(i == 0)
+        {
+            single = elapsed;
+        }
+        printf("random forest %u songs x %d trees  %2u threads  fit %9.3f ms  speedup %5.2fx  oob %.6f\n",
+                BENCH_SONGS, BENCH_TREES, threads[i], elapsed / 1000.0, (double)single / elapsed, oob_score);
+    }
+    g_free(x);
+    g_free(y);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "ml_knn.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <math.h>
+
+#define BENCH_QUERIES 500
+#define BENCH_CLUSTERS 32
+#define BENCH_MAX_SAMPLES 65536
+
+static const char *bench_algorithm_names[] = {"brute", "kd", "ball", "auto"};
+
+/*Points around BENCH_CLUSTERS centres, like songs grouped by genre*/
+static void bench_points(float *x, uint32_t n, uint32_t num_features, uint32_t *state)
+{
+    float *centres = g_new(float, (size_t)BENCH_CLUSTERS * num_features);
+
+    for(size_t i = 0; i < (size_t)BENCH_CLUSTERS * num_features; i++)
+    {
+        centres[i] = test_uniform(state);
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        const float *centre = centres + (size_t)(i % BENCH_CLUSTERS) * num_features;
+        for(uint32_t j = 0; j < num_features; j++)
+        {
+            x[(size_t)i * num_features + j] = centre[j] + 0.1f * (test_uniform(state) - 0.5f);
+        }
+    }
+    g_free(centres);
+}
+
+/*Fit plus BENCH_QUERIES queries, sum_nearest adds up the nearest distances to compare the indexes*/
+static gint64 bench_search(KNNAlgorithm algorithm, const float *x, const float *y, uint32_t n, uint32_t num_features,
+                            const float *queries, gint64 *fit_time, double *sum_nearest, KNNAlgorithm *picked)
+{
+    uint32_t indices[ML_KNN_DEFAULT_K];
+    float distances[ML_KNN_DEFAULT_K];
+    gint64 start, fitted;
+    KNN knn;
+
+    ml_knn_init(&knn, ML_KNN_DEFAULT_K, 0);
+    knn.algorithm = algorithm;
+    start = g_get_monotonic_time();
+    if(ml_knn_fit(&knn, x, y, n, num_features) != 0)
+    {
+        g_printerr("fit failed\n");
+        exit(1);
+    }
+    fitted = g_get_monotonic_time();
+    *sum_nearest = 0.0;
+    for(uint32_t q = 0; q < BENCH_QUERIES; q++)
+    {
+        if(ml_knn_query(&knn, queries + (size_t)q * num_features, indices, distances) > 0)
+        {
+            *sum_nearest += distances[0];
+        }
+    }
+    *fit_time = fitted - start;
+    *picked = knn.index_algorithm;
+    ml_knn_free(&knn);
+    return g_get_monotonic_time() - fitted;
+}
+
+static void bench_case(uint32_t n, uint32_t num_features, uint32_t *state)
+{
+    const KNNAlgorithm algorithms[] = {BRUTE_FORCE, KD_TREE, BALL_TREE, AUTO_ALGORITHM};
+    float *x = g_new(float, (size_t)n * num_features);
+    float *y = g_new(float, n);
+    float *queries = g_new(float, (size_t)BENCH_QUERIES * num_features);
+    double reference = 0.0;
+    gint64 best = G_MAXINT64;
+    guint fastest = 0;
+    KNNAlgorithm picked = AUTO_ALGORITHM;
+
+    bench_points(x, n, num_features, state);
+    bench_points(queries, BENCH_QUERIES, num_features, state);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        y[i] = test_uniform(state);
+    }
+    printf("%6u points %3u dims ", n, num_features);
+    for(guint a = 0; a < G_N_ELEMENTS(algorithms); a++)
+    {
+        gint64 fit_time;
+        double sum_nearest;
+        gint64 query_time = bench_search(algorithms[a], x, y, n, num_features, queries, &fit_time, &sum_nearest, &picked);
+
+        if(a == 0)
+        {
+            reference = sum_nearest;
+        }
+        else if(fabs(sum_nearest - reference) > 1e-3 * MAX(reference, 1.0))
+        {
+            g_printerr("%s found other neighbours than brute force\n", bench_algorithm_names[a]);
+            exit(1);
+        }
+        if(algorithms[a] != AUTO_ALGORITHM && fit_time + query_time < best)
+        {
+            best = fit_time + query_time;
+            fastest = a;
+        }
+        printf(" %s %7.3f ms + %8.2f us/query", bench_algorithm_names[a], fit_time / 1000.0,
+                (double)query_time / BENCH_QUERIES);
+        if(algorithms[a] == AUTO_ALGORITHM)
+        {
+            printf(" (%s)", bench_algorithm_names[picked]);
+        }
+    }
+    printf("  fastest %s\n", bench_algorithm_names[fastest]);
+    g_free(x);
+    g_free(y);
+    g_free(queries);
+}
+
+/*Fit in ms plus query cost for every index, the crossover is where brute force stops being fastest*/
+int main(void)
+{
+    const uint32_t dimensions[] = {3, 8, 16, 48, 96};
+    uint32_t state = 1;
+
+    for(guint d = 0; d < G_N_ELEMENTS(dimensions); d++)
+    {
+        for(uint32_t n = 256; n <= BENCH_MAX_SAMPLES; n *= 4)
+        {
+            bench_case(n, dimensions[d], &state);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "ml.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <math.h>
+
+#define BENCH_REPEATS 20
+#define BENCH_FEATURES 3
+#define BENCH_POLY_SAMPLES 100000
+#define BENCH_POLY_MAX_DEGREE 8
+
+/*Best of BENCH_REPEATS fits of a song history with the three nightcore features*/
+static void bench_multi_linear(uint32_t n)
+{
+    float *x = g_new(float, (size_t)n * BENCH_FEATURES);
+    float *y = g_new(float, n);
+    float *outputs = g_new(float, n);
+    uint32_t state = 1;
+    gint64 best_fit = G_MAXINT64, best_predict = G_MAXINT64;
+    MultiLinearRegressionData model;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        float *row = x + (size_t)i * BENCH_FEATURES;
+        row[0] = 80.0f + 100.0f * test_uniform(&state);
+        row[1] = 200.0f + 500.0f * test_uniform(&state);
+        row[2] = 40.0f * test_uniform(&state);
+        y[i] = 5.0f + 1.25f * row[0] - 0.01f * row[1] + 0.5f * row[2] + test_uniform(&state) - 0.5f;
+    }
+    ml_multi_linear_regression_init(&model, BENCH_FEATURES);
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        gint64 start = g_get_monotonic_time();
+        if(ml_multi_linear_regression_learn(&model, x, y, n) != 0)
+        {
+            g_printerr("fit failed\n");
+            exit(1);
+        }
+        gint64 fitted = g_get_monotonic_time();
+        ml_multi_linear_regression_predict(&model, x, outputs, n);
+        gint64 predicted = g_get_monotonic_time();
+        best_fit = MIN(best_fit, fitted - start);
+        best_predict = MIN(best_predict, predicted - fitted);
+    }
+    printf("multi linear  %7u songs x %d features  fit %8.3f ms  predict %8.3f ms  r2 %.4f\n",
+            n, BENCH_FEATURES, best_fit / 1000.0, best_predict / 1000.0, model.r_squared);
+    ml_multi_linear_regression_free(&model);
+    g_free(x);
+    g_free(y);
+    g_free(outputs);
+}
+
+/*Best of BENCH_REPEATS fits and batched predictions of output BPM over origin BPM*/
+static void bench_poly(uint32_t degree, double *x, double *y, const float *inputs, float *outputs)
+{
+    gint64 best_fit = G_MAXINT64, best_predict = G_MAXINT64;
+    PolyRegressionData model;
+
+    if(ml_poly_regression_data_init(&model, x, y, BENCH_POLY_SAMPLES, degree) != 0)
+    {
+        g_printerr("poly init failed\n");
+        exit(1);
+    }
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        gint64 start = g_get_monotonic_time();
+        if(ml_poly_regression_model_learn(&model) != 0)
+        {
+            g_printerr("poly fit failed\n");
+            exit(1);
+        }
+        gint64 fitted = g_get_monotonic_time();
+        ml_poly_regression_predict(&model, inputs, outputs, BENCH_POLY_SAMPLES);
+        gint64 predicted = g_get_monotonic_time();
+        best_fit = MIN(best_fit, fitted - start);
+        best_predict = MIN(best_predict, predicted - fitted);
+    }
+    printf("polynomial    %7u songs, degree %u  fit %8.3f ms  predict %8.3f ms  r2 %.4f\n",
+            BENCH_POLY_SAMPLES, degree, best_fit / 1000.0, best_predict / 1000.0, model.r_squared);
+    ml_poly_regression_data_free(&model);
+}
+
+int main(void)
+{
+    double *x = g_new(double, BENCH_POLY_SAMPLES);
+    double *y = g_new(double, BENCH_POLY_SAMPLES);
+    float *inputs = g_new(float, BENCH_POLY_SAMPLES);
+    float *outputs = g_new(float, BENCH_POLY_SAMPLES);
+    uint32_t state = 1;
+
+    bench_multi_linear(2000);
+    bench_multi_linear(20000);
+    bench_multi_linear(200000);
+
+    /*A curve no low degree fits, so r2 climbs with the degree*/
+    for(uint32_t i = 0; i < BENCH_POLY_SAMPLES; i++)
+    {
+        x[i] = 80.0 + 100.0 * test_uniform(&state);
+        y[i] = 1.25 * x[i] + 8.0 * sin(x[i] / 8.0) + test_uniform(&state) - 0.5;
+        inputs[i] = (float)x[i];
+    }
+    for(uint32_t degree = 1; degree <= BENCH_POLY_MAX_DEGREE; degree++)
+    {
+        bench_poly(degree, x, y, inputs, outputs);
+    }
+    g_free(x);
+    g_free(y);
+    g_free(inputs);
+    g_free(outputs);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "ml.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <math.h>
+#include <string.h>
+
+/*Every thread count has to train the same forest*/
+static void test_forest_thread_count(TreeType forest_type)
+{
+    const uint32_t n = 2000, p = 6;
+    float *x = g_new(float, n * p);
+    float *y = g_new(float, n);
+    float *outputs = g_new(float, n);
+    float *reference = g_new(float, n);
+    float reference_oob = 0.0f, reference_importance[6];
+    uint32_t threads[] = {1, 2, 4, 8};
+    uint32_t state = 11;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        for(uint32_t j = 0; j < p; j++)
+        {
+            x[i * p + j] = 100.0f * test_uniform(&state);
+        }
+        if(forest_type == CLASSIFICATION_TREE)
+        {
+            y[i] = (x[i * p] > 50.0f) ^ (x[i * p + 2] > 25.0f);
+        }
+        else
+        {
+            y[i] = (x[i * p] > 50.0f ? 10.0f : 0.0f) + sinf(x[i * p + 1] / 10.0f) * 3.0f + test_uniform(&state);
+        }
+    }
+    for(uint32_t t = 0; t < G_N_ELEMENTS(threads); t++)
+    {
+        RandomForest forest;
+        g_assert_cmpint(ml_random_forest_init(&forest, 16, forest_type), ==, 0);
+        forest.num_threads = threads[t];
+        forest.random_seed = 7;
+        forest.max_depth = 10;
+        g_assert_cmpint(ml_random_forest_fit(&forest, x, y, n, p), ==, 0);
+        g_assert_cmpint(ml_random_forest_predict(&forest, x, outputs, n), ==, 0);
+        g_assert_cmpfloat(forest.oob_score, >, 0.8f);
+        if(t == 0)
+        {
+            memcpy(reference, outputs, n * sizeof(float));
+            memcpy(reference_importance, forest.feature_importance, p * sizeof(float));
+            reference_oob = forest.oob_score;
+        }
+        else
+        {
+            g_assert_true(memcmp(reference, outputs, n * sizeof(float)) == 0);
+            g_assert_true(memcmp(reference_importance, forest.feature_importance, p * sizeof(float)) == 0);
+            g_assert_true(reference_oob == forest.oob_score);
+        }
+        ml_random_forest_free(&forest);
+    }
+    g_free(x);
+    g_free(y);
+    g_free(outputs);
+    g_free(reference);
+}
+
+static void test_forest_classification(void)
+{
+    test_forest_thread_count(CLASSIFICATION_TREE);
+}
+
+static void test_forest_regression(void)
+{
+    test_forest_thread_count(REGRESSION_TREE);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/ml/forest/classification", test_forest_classification);
+    g_test_add_func("/ml/forest/regression", test_forest_regression);
+    return g_test_run();
+}
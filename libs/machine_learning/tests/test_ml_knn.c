@@ -0,0 +1,98 @@
+#include "ml.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <math.h>
+
+/*An index has to find exactly the neighbours a full scan finds*/
+static void test_knn_index_matches_brute(KNNAlgorithm algorithm, uint32_t n, uint32_t p, DistanceMetric metric)
+{
+    float *x = g_new(float, n * p);
+    float *y = g_new(float, n);
+    float query[64];
+    uint32_t brute_indices[7], tree_indices[7];
+    float brute_distances[7], tree_distances[7];
+    uint32_t state = 7;
+    KNN brute, tree;
+
+    for(uint32_t i = 0; i < n * p; i++)
+    {
+        /*Repeated values put many points on the split planes*/
+        x[i] = i % 7 == 0 ? 0.5f : test_uniform(&state);
+    }
+    for(uint32_t i = 0; i < n; i++)
+    {
+        y[i] = i % 3;
+    }
+    g_assert_cmpint(ml_knn_init(&brute, 7, 1), ==, 0);
+    g_assert_cmpint(ml_knn_init(&tree, 7, 1), ==, 0);
+    brute.distance_metric = tree.distance_metric = metric;
+    brute.minkowski_p = tree.minkowski_p = 3.0f;
+    brute.algorithm = BRUTE_FORCE;
+    tree.algorithm = algorithm;
+    tree.leaf_size = 8;
+    g_assert_cmpint(ml_knn_fit(&brute, x, y, n, p), ==, 0);
+    g_assert_cmpint(ml_knn_fit(&tree, x, y, n, p), ==, 0);
+    g_assert_cmpint(tree.index_algorithm, ==, algorithm);
+
+    for(uint32_t q = 0; q < 200; q++)
+    {
+        for(uint32_t j = 0; j < p; j++)
+        {
+            query[j] = test_uniform(&state);
+        }
+        int found = ml_knn_query(&brute, query, brute_indices, brute_distances);
+        g_assert_cmpint(found, ==, 7);
+        g_assert_cmpint(ml_knn_query(&tree, query, tree_indices, tree_distances), ==, found);
+        for(int i = 0; i < found; i++)
+        {
+            g_assert_cmpfloat_with_epsilon(tree_distances[i], brute_distances[i], 1e-5);
+        }
+    }
+    ml_knn_free(&brute);
+    ml_knn_free(&tree);
+    g_free(x);
+    g_free(y);
+}
+
+static void test_knn_kd_tree(void)
+{
+    test_knn_index_matches_brute(KD_TREE, 3000, 3, EUCLIDEAN_DISTANCE);
+    test_knn_index_matches_brute(KD_TREE, 3000, 3, MANHATTAN_DISTANCE);
+    test_knn_index_matches_brute(KD_TREE, 3000, 3, CHEBYSHEV_DISTANCE);
+    test_knn_index_matches_brute(KD_TREE, 3000, 3, MINKOWSKI_DISTANCE);
+}
+
+static void test_knn_ball_tree(void)
+{
+    test_knn_index_matches_brute(BALL_TREE, 3000, 5, EUCLIDEAN_DISTANCE);
+    test_knn_index_matches_brute(BALL_TREE, 3000, 5, MANHATTAN_DISTANCE);
+    test_knn_index_matches_brute(BALL_TREE, 3000, 5, CHEBYSHEV_DISTANCE);
+    test_knn_index_matches_brute(BALL_TREE, 3000, 5, MINKOWSKI_DISTANCE);
+}
+
+static void test_knn_auto(void)
+{
+    float x[] = {0, 0, 1, 1, 10, 10, 11, 11};
+    float y[] = {1, 1, 2, 2};
+    float query[] = {0.2f, 0.1f, 10.5f, 10.5f};
+    float outputs[2];
+    KNN knn;
+
+    /*A handful of points is always scanned*/
+    g_assert_cmpint(ml_knn_init(&knn, 2, 0), ==, 0);
+    g_assert_cmpint(ml_knn_fit(&knn, x, y, 4, 2), ==, 0);
+    g_assert_cmpint(knn.index_algorithm, ==, BRUTE_FORCE);
+    g_assert_cmpint(ml_knn_predict(&knn, query, outputs, 2), ==, 0);
+    g_assert_cmpfloat_with_epsilon(outputs[0], 1.0, 1e-6);
+    g_assert_cmpfloat_with_epsilon(outputs[1], 2.0, 1e-6);
+    ml_knn_free(&knn);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/ml/knn/kd_tree", test_knn_kd_tree);
+    g_test_add_func("/ml/knn/ball_tree", test_knn_ball_tree);
+    g_test_add_func("/ml/knn/auto", test_knn_auto);
+    return g_test_run();
+}
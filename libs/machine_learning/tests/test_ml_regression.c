@@ -0,0 +1,138 @@
+#include "ml.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <math.h>
+
+static void test_multi_linear_recovers_coefficients(void)
+{
+    const uint32_t n = 2000;
+    float *x = g_new(float, n * 3);
+    float *y = g_new(float, n);
+    float outputs[4];
+    uint32_t state = 1;
+    MultiLinearRegressionData model;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        x[i * 3] = 80.0f + 100.0f * test_uniform(&state);
+        x[i * 3 + 1] = 200.0f + 500.0f * test_uniform(&state);
+        x[i * 3 + 2] = 40.0f * test_uniform(&state);
+        y[i] = 5.0f + 1.25f * x[i * 3] - 0.01f * x[i * 3 + 1] + 0.5f * x[i * 3 + 2];
+    }
+    g_assert_cmpint(ml_multi_linear_regression_init(&model, 3), ==, 0);
+    g_assert_cmpint(ml_multi_linear_regression_learn(&model, x, y, n), ==, 0);
+    g_assert_cmpfloat_with_epsilon(model.coefficients[0], 5.0, 1e-2);
+    g_assert_cmpfloat_with_epsilon(model.coefficients[1], 1.25, 1e-4);
+    g_assert_cmpfloat_with_epsilon(model.coefficients[2], -0.01, 1e-4);
+    g_assert_cmpfloat_with_epsilon(model.coefficients[3], 0.5, 1e-4);
+    g_assert_cmpfloat(model.r_squared, >, 0.9999);
+
+    g_assert_cmpint(ml_multi_linear_regression_predict(&model, x, outputs, 4), ==, 0);
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        g_assert_cmpfloat_with_epsilon(outputs[i], y[i], 1e-2);
+    }
+
+    /*A feature that is a multiple of another gets a ridge instead of failing*/
+    for(uint32_t i = 0; i < n; i++)
+    {
+        x[i * 3 + 2] = 2.0f * x[i * 3];
+    }
+    g_assert_cmpint(ml_multi_linear_regression_learn(&model, x, y, n), ==, 0);
+    g_assert_cmpfloat(model.r_squared, >, 0.9);
+
+    g_assert_cmpint(ml_multi_linear_regression_learn(&model, x, y, 3), ==, -2);
+    ml_multi_linear_regression_free(&model);
+    g_free(x);
+    g_free(y);
+}
+
+static void test_linear_regression(void)
+{
+    double x[] = {1, 2, 3, 4};
+    double y[] = {3, 5, 7, 9};
+    LinearRegressionData data;
+    double *outputs;
+
+    g_assert_cmpint(ml_linear_regression_data_init(&data, x, y, 4), ==, 0);
+    g_assert_cmpint(ml_linear_regression_model_learn(&data), ==, 0);
+    g_assert_cmpfloat_with_epsilon(data.slope, 2.0, 1e-9);
+    g_assert_cmpfloat_with_epsilon(data.intercept, 1.0, 1e-9);
+    outputs = ml_linear_regression_predict(&data, x, 4);
+    g_assert_nonnull(outputs);
+    g_assert_cmpfloat_with_epsilon(outputs[3], 9.0, 1e-9);
+    free(outputs);
+    ml_linear_regression_data_free(&data);
+}
+
+static void test_poly_exact(void)
+{
+    double x[] = {0, 1, 2};
+    double y[] = {1, 3, 7};
+    float inputs[] = {3.0f, 0.5f};
+    float outputs[2];
+    PolyRegressionData data;
+
+    /*y = x^2 + x + 1*/
+    g_assert_cmpint(ml_poly_regression_data_init(&data, x, y, 3, 2), ==, 0);
+    g_assert_cmpint(ml_poly_regression_model_learn(&data), ==, 0);
+    g_assert_cmpint(ml_poly_regression_predict(&data, inputs, outputs, 2), ==, 0);
+    g_assert_cmpfloat_with_epsilon(outputs[0], 13.0, 1e-4);
+    g_assert_cmpfloat_with_epsilon(outputs[1], 1.75, 1e-4);
+    g_assert_cmpfloat_with_epsilon(data.r_squared, 1.0, 1e-9);
+    ml_poly_regression_data_free(&data);
+}
+
+static void test_poly_high_degree(void)
+{
+    const uint32_t n = 10000;
+    double *x = g_new(double, n);
+    double *y = g_new(double, n);
+    float *inputs = g_new(float, n);
+    float *outputs = g_new(float, n);
+    PolyRegressionData data;
+
+    /*A degree 8 Vandermonde over BPM values is far past what the normal equations can solve*/
+    for(uint32_t i = 0; i < n; i++)
+    {
+        double t = (i - n / 2.0) / (n / 2.0);
+        x[i] = 130.0 + 70.0 * t;
+        y[i] = 100.0 + 3.0 * t - 2.0 * pow(t, 5) + 0.5 * pow(t, 8);
+        inputs[i] = x[i];
+    }
+    g_assert_cmpint(ml_poly_regression_data_init(&data, x, y, n, 8), ==, 0);
+    g_assert_cmpint(ml_poly_regression_model_learn(&data), ==, 0);
+    g_assert_cmpint(ml_poly_regression_predict(&data, inputs, outputs, n), ==, 0);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        g_assert_cmpfloat_with_epsilon(outputs[i], y[i], 1e-3);
+    }
+    g_assert_cmpfloat(data.r_squared, >, 0.999999);
+    ml_poly_regression_data_free(&data);
+    g_free(x);
+    g_free(y);
+    g_free(inputs);
+    g_free(outputs);
+}
+
+static void test_poly_too_few_distinct(void)
+{
+    double x[] = {1, 1, 2, 2, 3, 3};
+    double y[] = {1, 2, 3, 4, 5, 6};
+    PolyRegressionData data;
+
+    g_assert_cmpint(ml_poly_regression_data_init(&data, x, y, 6, 3), ==, 0);
+    g_assert_cmpint(ml_poly_regression_model_learn(&data), ==, -3);
+    ml_poly_regression_data_free(&data);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/ml/multi_linear/coefficients", test_multi_linear_recovers_coefficients);
+    g_test_add_func("/ml/linear/fit", test_linear_regression);
+    g_test_add_func("/ml/poly/exact", test_poly_exact);
+    g_test_add_func("/ml/poly/high_degree", test_poly_high_degree);
+    g_test_add_func("/ml/poly/too_few_distinct", test_poly_too_few_distinct);
+    return g_test_run();
+}
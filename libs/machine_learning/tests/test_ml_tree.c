@@ -0,0 +1,158 @@
+#include "ml.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <math.h>
+
+/*The children of every internal node split its samples between them*/
+static void test_tree_assert_consistent(const DecisionTree *tree)
+{
+    for(uint32_t i = 0; i < tree->num_nodes; i++)
+    {
+        const DecisionTreeNode *node = tree->root + i;
+        if(node->node_type == INTERNAL_NODE)
+        {
+            g_assert_cmpuint(node->left_child->num_samples + node->right_child->num_samples, ==, node->num_samples);
+        }
+    }
+}
+
+static void test_tree_classification(void)
+{
+    const uint32_t n = 20000;
+    float *x = g_new(float, n * 3);
+    float *y = g_new(float, n);
+    float *outputs = g_new(float, n);
+    uint32_t state = 3, correct = 0;
+    SplitCriterion criteria[] = {GINI, ENTROPY};
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        for(uint32_t j = 0; j < 3; j++)
+        {
+            x[i * 3 + j] = 100.0f * test_uniform(&state);
+        }
+        y[i] = (x[i * 3] > 50.0f) ^ (x[i * 3 + 2] > 25.0f);
+    }
+    for(uint32_t c = 0; c < G_N_ELEMENTS(criteria); c++)
+    {
+        DecisionTree tree;
+        g_assert_cmpint(ml_decision_tree_init(&tree, CLASSIFICATION_TREE), ==, 0);
+        tree.criterion = criteria[c];
+        tree.max_depth = 4;
+        g_assert_cmpint(ml_decision_tree_fit(&tree, x, y, n, 3), ==, 0);
+        g_assert_cmpint(ml_decision_tree_predict(&tree, x, outputs, n), ==, 0);
+        correct = 0;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            correct += outputs[i] == y[i];
+        }
+        g_assert_cmpfloat((float)correct / n, >, 0.99f);
+        test_tree_assert_consistent(&tree);
+        ml_decision_tree_free(&tree);
+    }
+    g_free(x);
+    g_free(y);
+    g_free(outputs);
+}
+
+static void test_tree_regression(void)
+{
+    const uint32_t n = 20000;
+    float *x = g_new(float, n * 3);
+    float *y = g_new(float, n);
+    uint32_t state = 5;
+    DecisionTree tree;
+
+    for(uint32_t i = 0; i < n; i++)
+    {
+        for(uint32_t j = 0; j < 3; j++)
+        {
+            x[i * 3 + j] = 100.0f * test_uniform(&state);
+        }
+        y[i] = (x[i * 3] > 50.0f ? 10.0f : 0.0f) + (x[i * 3 + 1] > 30.0f ? 5.0f : 0.0f) + test_uniform(&state);
+    }
+    g_assert_cmpint(ml_decision_tree_init(&tree, REGRESSION_TREE), ==, 0);
+    tree.max_depth = 8;
+    tree.min_samples_leaf = 5;
+    g_assert_cmpint(ml_decision_tree_fit(&tree, x, y, n, 3), ==, 0);
+    g_assert_cmpuint(tree.root->feature_index, ==, 0);
+    g_assert_cmpfloat_with_epsilon(tree.root->threshold, 50.0, 1.0);
+    g_assert_cmpfloat(tree.training_accuracy, >, 0.99f);
+    test_tree_assert_consistent(&tree);
+    ml_decision_tree_free(&tree);
+    g_free(x);
+    g_free(y);
+}
+
+/*Pure nodes must stop splitting however far the targets sit from zero, BPM scale targets
+  used to split on the rounding left by the histogram subtraction*/
+static void test_tree_offset_targets(void)
+{
+    const uint32_t n = 30000;
+    const float offsets[] = {0.0f, 150.0f, 1e5f};
+    float *x = g_new(float, n * 2);
+    float *y = g_new(float, n);
+    uint32_t state = 9;
+
+    for(uint32_t o = 0; o < G_N_ELEMENTS(offsets); o++)
+    {
+        DecisionTree tree;
+        for(uint32_t i = 0; i < n; i++)
+        {
+            /*Few distinct values, so every boundary is a bin edge*/
+            x[i * 2] = (float)(i % 30);
+            x[i * 2 + 1] = floorf(20.0f * test_uniform(&state));
+            y[i] = offsets[o] + (x[i * 2] < 10.0f ? 0.1f : x[i * 2] < 20.0f ? 0.7f : 0.3f);
+        }
+        g_assert_cmpint(ml_decision_tree_init(&tree, REGRESSION_TREE), ==, 0);
+        g_assert_cmpint(ml_decision_tree_fit(&tree, x, y, n, 2), ==, 0);
+        g_assert_cmpuint(tree.num_nodes, ==, 5);
+        g_assert_cmpuint(tree.actual_depth, ==, 2);
+        g_assert_cmpuint(tree.root->feature_index, ==, 0);
+        g_assert_cmpfloat_with_epsilon(tree.training_accuracy, 1.0, 1e-4);
+        for(uint32_t i = 0; i < tree.num_nodes; i++)
+        {
+            if(tree.root[i].node_type == LEAF_NODE)
+            {
+                g_assert_cmpfloat(tree.root[i].impurity, ==, 0.0f);
+            }
+        }
+        test_tree_assert_consistent(&tree);
+        ml_decision_tree_free(&tree);
+    }
+    g_free(x);
+    g_free(y);
+}
+
+static void test_tree_invalid(void)
+{
+    float x[] = {1, 2, 3};
+    float y[] = {0, 0, 0};
+    float fractional[] = {0, 0.5f, 1};
+    DecisionTree tree;
+
+    /*Pure targets leave a single leaf*/
+    g_assert_cmpint(ml_decision_tree_init(&tree, CLASSIFICATION_TREE), ==, 0);
+    g_assert_cmpint(ml_decision_tree_fit(&tree, x, y, 3, 1), ==, 0);
+    g_assert_cmpuint(tree.num_nodes, ==, 1);
+    ml_decision_tree_free(&tree);
+
+    g_assert_cmpint(ml_decision_tree_init(&tree, CLASSIFICATION_TREE), ==, 0);
+    g_assert_cmpint(ml_decision_tree_fit(&tree, x, fractional, 3, 1), ==, -2);
+    ml_decision_tree_free(&tree);
+
+    g_assert_cmpint(ml_decision_tree_init(&tree, REGRESSION_TREE), ==, 0);
+    tree.criterion = GINI;
+    g_assert_cmpint(ml_decision_tree_fit(&tree, x, y, 3, 1), ==, -2);
+    ml_decision_tree_free(&tree);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/ml/tree/classification", test_tree_classification);
+    g_test_add_func("/ml/tree/regression", test_tree_regression);
+    g_test_add_func("/ml/tree/offset_targets", test_tree_offset_targets);
+    g_test_add_func("/ml/tree/invalid", test_tree_invalid);
+    return g_test_run();
+}
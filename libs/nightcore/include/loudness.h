@@ -0,0 +1,89 @@
+#ifndef _LOUDNESS_H_
+#define _LOUDNESS_H_
+
+#include <glib-2.0/glib.h>
+
+#define LOUDNESS_LOOKAHEAD_MS_DEFAULT 5
+
+#define LOUDNESS_MAX_CHANNELS 8
+#define LOUDNESS_OVERSAMPLING 4
+#define LOUDNESS_INTERP_TAPS 12
+/*Frames from the newest sample to the centre of the interpolator, the peak estimate of
+  a frame is only complete this much later*/
+#define LOUDNESS_INTERP_DELAY (LOUDNESS_INTERP_TAPS / 2)
+/*Gating block histogram, -70 LUFS to +10 LUFS in 0.1 LU steps*/
+#define LOUDNESS_HIST_BINS 800
+
+typedef struct _LoudnessBiquad
+{
+    gdouble b0, b1, b2, a1, a2;
+}LoudnessBiquad;
+
+/*Streaming EBU R128 normaliser followed by a lookahead true peak limiter.
+  Works in one pass over interleaved float samples. The output lags the input by latency
+  frames, loudness_process holds them back and loudness_flush returns them at the end.*/
+typedef struct _LoudnessData
+{
+    guint rate;
+    guint channels;
+    gdouble target_lufs;
+    gdouble ceiling;            /*linear true peak ceiling*/
+
+    /*K-weighting, two biquads per channel*/
+    LoudnessBiquad shelf;
+    LoudnessBiquad highpass;
+    gdouble shelf_state[LOUDNESS_MAX_CHANNELS][2];
+    gdouble highpass_state[LOUDNESS_MAX_CHANNELS][2];
+
+    /*100 ms sub-blocks, four of them make one 400 ms gating block*/
+    guint subblock_len;
+    guint subblock_pos;
+    gdouble subblock_partial;
+    gdouble subblock_energy[4];
+    guint subblock_count;
+    guint64 hist_count[LOUDNESS_HIST_BINS];
+    gdouble hist_energy[LOUDNESS_HIST_BINS];
+    gdouble integrated_lufs;
+
+    /*normalisation gain, smoothed towards the gated estimate*/
+    gdouble gain;
+    gdouble gain_target;
+    gdouble gain_coef;
+
+    /*true peak interpolation*/
+    gfloat interp[LOUDNESS_OVERSAMPLING][LOUDNESS_INTERP_TAPS];
+    gfloat *history;            /*channels * LOUDNESS_INTERP_TAPS, newest sample last*/
+
+    /*lookahead limiter*/
+    guint lookahead;            /*frames*/
+    gfloat *delay;              /*lookahead * channels*/
+    guint delay_pos;
+    gfloat *min_values;         /*sliding minimum deque*/
+    guint64 *min_frames;
+    guint min_head;
+    guint min_size;
+    gfloat *avg_values;         /*moving average of the held gain*/
+    gdouble avg_sum;
+    guint avg_pos;
+    gdouble release;
+    gdouble release_coef;
+    guint64 frame;
+    guint latency;              /*lookahead + LOUDNESS_INTERP_DELAY frames*/
+}LoudnessData;
+
+int loudness_init(LoudnessData *loudness_data, guint rate, guint channels,
+                    gdouble target_lufs, gdouble true_peak_db, guint lookahead_ms);
+
+/*In place, returns the number of frames written to the start of samples. The first
+  latency frames of the stream produce no output.*/
+gsize loudness_process(LoudnessData *loudness_data, gfloat *samples, gsize frames);
+
+/*Writes the frames still delayed at the end of the stream, samples has to hold latency
+  frames. Returns the number of frames written.*/
+gsize loudness_flush(LoudnessData *loudness_data, gfloat *samples);
+
+gdouble loudness_get_integrated(LoudnessData *loudness_data);
+
+void loudness_free(LoudnessData *loudness_data);
+
+#endif
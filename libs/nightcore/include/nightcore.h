@@ -9,10 +9,25 @@
 #define REVERB_DELAY_MS_DEFAULT 0
 #define REVERB_INTENSITY_DEFAULT 0.0 
 #define REVERB_FEEDBACK_DEFAULT 0.0
+#define LOUDNESS_TARGET_DEFAULT -14.0
+#define TRUE_PEAK_DEFAULT -1.0
+/*Memory budget defaults, a queue blocks its producer once any limit is reached*/
+#define QUEUE_MAX_BYTES_DEFAULT (4 * 1024 * 1024)
+#define QUEUE_MAX_TIME_MS_DEFAULT 2000
+#define URI_BUFFER_BYTES_DEFAULT (2 * 1024 * 1024)
+#define URI_BUFFER_TIME_MS_DEFAULT 5000
 
 #include "night_error_codes.h"
 #include <gst/gst.h>
 
+typedef struct _NightcoreMemoryBudget
+{
+    guint queue_max_bytes;      /*Bytes kept in every queue of the pipeline*/
+    guint64 queue_max_time_ms;  /*Time kept in every queue of the pipeline*/
+    guint uri_buffer_bytes;     /*Encoded data buffered ahead of the decoder in uri mode*/
+    guint64 uri_buffer_time_ms; /*Encoded time buffered ahead of the decoder in uri mode*/
+}NightcoreMemoryBudget;
+
 typedef struct _NightcoreData
 {
     
@@ -22,6 +37,10 @@ typedef struct _NightcoreData
     guint64 reverb_delay_ms;
     gfloat reverb_intensity;
     gfloat reverb_feedback;
+    gboolean normalise;
+    gfloat loudness_target;   /*integrated loudness in LUFS*/
+    gfloat true_peak;         /*true peak ceiling in dBTP*/
+    NightcoreMemoryBudget memory_budget;
     //gboolean reverb_surround;
 } NightcoreData;
 
@@ -33,6 +52,17 @@ NightcoreErrorCodes nightcore_init( NightcoreData *nightcore_data,
                     gfloat reverb_intensity,
                     gfloat reverb_feedback);
 
+NightcoreErrorCodes nightcore_set_memory_budget(NightcoreData *nightcore_data,
+                                                guint queue_max_bytes,
+                                                guint64 queue_max_time_ms,
+                                                guint uri_buffer_bytes,
+                                                guint64 uri_buffer_time_ms);
+
+NightcoreErrorCodes nightcore_set_loudness(NightcoreData *nightcore_data,
+                                            gboolean normalise,
+                                            gfloat loudness_target,
+                                            gfloat true_peak);
+
 NightcoreErrorCodes nightcore_process_file(NightcoreData *nightcore_data, gchar *input_file, gchar *output_file);
 
 NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *nightcore_data, 
@@ -41,7 +71,7 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
                                                     gchar *output_file
                                                     );
 
-//NightcoreErrorCodes nightcore_process_url(NightcoreData *nightcore_data, gchar *input_url, gchar *output_file);
+NightcoreErrorCodes nightcore_process_url(NightcoreData *nightcore_data, gchar *input_url, gchar *output_file);
 
 NightcoreErrorCodes nightcore_process_video_to_speed_up_video(  NightcoreData *nightcore_data, 
                                                     gchar *input_video_file, 
@@ -0,0 +1,363 @@
+#include "loudness.h"
+#include <math.h>
+#include <string.h>
+
+#define LOUDNESS_ABSOLUTE_GATE -70.0
+#define LOUDNESS_RELATIVE_GATE -10.0
+#define LOUDNESS_MAX_BOOST_DB 12.0
+#define LOUDNESS_MAX_CUT_DB -24.0
+/*Time constants of the normalisation gain and of the limiter release*/
+#define LOUDNESS_GAIN_TAU_S 3.0
+#define LOUDNESS_RELEASE_TAU_S 0.05
+
+static void k_weighting_init(LoudnessData *loudness_data)
+{
+    /*BS.1770 pre-filter coefficients recomputed for the stream rate*/
+    gdouble f0 = 1681.974450955533;
+    gdouble gain_db = 3.999843853973347;
+    gdouble q = 0.7071752369554196;
+    gdouble k = tan(M_PI * f0 / loudness_data->rate);
+    gdouble vh = pow(10.0, gain_db / 20.0);
+    gdouble vb = pow(vh, 0.4996667741545416);
+    gdouble a0 = 1.0 + k / q + k * k;
+
+    loudness_data->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    loudness_data->shelf.b1 = 2.0 * (k * k - vh) / a0;
+    loudness_data->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    loudness_data->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    loudness_data->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / loudness_data->rate);
+    a0 = 1.0 + k / q + k * k;
+    loudness_data->highpass.b0 = 1.0;
+    loudness_data->highpass.b1 = -2.0;
+    loudness_data->highpass.b2 = 1.0;
+    loudness_data->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    loudness_data->highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static void interpolator_init(LoudnessData *loudness_data)
+{
+    /*Hann windowed sinc split into polyphase branches, each branch normalised to unity gain*/
+    const guint length = LOUDNESS_OVERSAMPLING * LOUDNESS_INTERP_TAPS;
+    const gdouble center = (length - 1) / 2.0;
+    for(guint phase = 0; phase < LOUDNESS_OVERSAMPLING; phase++)
+    {
+        gdouble sum = 0.0;
+        for(guint k = 0; k < LOUDNESS_INTERP_TAPS; k++)
+        {
+            guint i = k * LOUDNESS_OVERSAMPLING + phase;
+            gdouble t = (i - center) / LOUDNESS_OVERSAMPLING;
+            gdouble sinc = (fabs(t) < 1e-9) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            gdouble window = 0.5 - 0.5 * cos(2.0 * M_PI * (i + 0.5) / length);
+            loudness_data->interp[phase][k] = (gfloat)(sinc * window);
+            sum += sinc * window;
+        }
+        for(guint k = 0; k < LOUDNESS_INTERP_TAPS; k++)
+        {
+            loudness_data->interp[phase][k] /= (gfloat)sum;
+        }
+    }
+}
+
+static inline gdouble biquad_run(const LoudnessBiquad *bq, gdouble state[2], gdouble x)
+{
+    gdouble y = bq->b0 * x + state[0];
+    state[0] = bq->b1 * x - bq->a1 * y + state[1];
+    state[1] = bq->b2 * x - bq->a2 * y;
+    return y;
+}
+
+static void update_integrated(LoudnessData *loudness_data)
+{
+    gdouble energy = 0.0;
+    guint64 count = 0;
+    gdouble relative_gate;
+    guint first_bin;
+
+    for(guint i = 0; i < LOUDNESS_HIST_BINS; i++)
+    {
+        energy += loudness_data->hist_energy[i];
+        count += loudness_data->hist_count[i];
+    }
+    if(count == 0)
+    {
+        return;
+    }
+    relative_gate = -0.691 + 10.0 * log10(energy / count) + LOUDNESS_RELATIVE_GATE;
+    first_bin = 0;
+    if(relative_gate > LOUDNESS_ABSOLUTE_GATE)
+    {
+        first_bin = (guint)((relative_gate - LOUDNESS_ABSOLUTE_GATE) * 10.0);
+    }
+    energy = 0.0;
+    count = 0;
+    for(guint i = first_bin; i < LOUDNESS_HIST_BINS; i++)
+    {
+        energy += loudness_data->hist_energy[i];
+        count += loudness_data->hist_count[i];
+    }
+    if(count == 0)
+    {
+        return;
+    }
+    loudness_data->integrated_lufs = -0.691 + 10.0 * log10(energy / count);
+
+    gdouble gain_db = loudness_data->target_lufs - loudness_data->integrated_lufs;
+    gain_db = CLAMP(gain_db, LOUDNESS_MAX_CUT_DB, LOUDNESS_MAX_BOOST_DB);
+    loudness_data->gain_target = pow(10.0, gain_db / 20.0);
+}
+
+static void finish_subblock(LoudnessData *loudness_data, gdouble subblock_energy)
+{
+    gdouble block_energy = 0.0;
+    loudness_data->subblock_energy[loudness_data->subblock_count % 4] = subblock_energy;
+    loudness_data->subblock_count++;
+    if(loudness_data->subblock_count < 4)
+    {
+        return;
+    }
+    for(guint i = 0; i < 4; i++)
+    {
+        block_energy += loudness_data->subblock_energy[i];
+    }
+    block_energy /= 4.0 * loudness_data->subblock_len;
+    if(block_energy <= 0.0)
+    {
+        return;
+    }
+    gdouble block_lufs = -0.691 + 10.0 * log10(block_energy);
+    if(block_lufs < LOUDNESS_ABSOLUTE_GATE)
+    {
+        return;
+    }
+    guint bin = (guint)((block_lufs - LOUDNESS_ABSOLUTE_GATE) * 10.0);
+    bin = MIN(bin, LOUDNESS_HIST_BINS - 1);
+    loudness_data->hist_count[bin]++;
+    loudness_data->hist_energy[bin] += block_energy;
+    update_integrated(loudness_data);
+}
+
+static gfloat limiter_gain(LoudnessData *loudness_data, gfloat required)
+{
+    const guint window = loudness_data->lookahead + 1;
+    guint tail;
+    gfloat held;
+
+    /*Sliding minimum of the required gain over the lookahead window*/
+    while(loudness_data->min_size > 0)
+    {
+        tail = (loudness_data->min_head + loudness_data->min_size - 1) % window;
+        if(loudness_data->min_values[tail] < required)
+        {
+            break;
+        }
+        loudness_data->min_size--;
+    }
+    tail = (loudness_data->min_head + loudness_data->min_size) % window;
+    loudness_data->min_values[tail] = required;
+    loudness_data->min_frames[tail] = loudness_data->frame;
+    loudness_data->min_size++;
+    if(loudness_data->frame - loudness_data->min_frames[loudness_data->min_head] >= window)
+    {
+        loudness_data->min_head = (loudness_data->min_head + 1) % window;
+        loudness_data->min_size--;
+    }
+    held = loudness_data->min_values[loudness_data->min_head];
+
+    /*Release slowly, but never above what the window requires*/
+    loudness_data->release += (1.0 - loudness_data->release) * loudness_data->release_coef;
+    if(held < loudness_data->release)
+    {
+        loudness_data->release = held;
+    }
+
+    /*Moving average over the same window ramps the gain down before the peak leaves the delay line*/
+    loudness_data->avg_sum += loudness_data->release - loudness_data->avg_values[loudness_data->avg_pos];
+    loudness_data->avg_values[loudness_data->avg_pos] = (gfloat)loudness_data->release;
+    loudness_data->avg_pos = (loudness_data->avg_pos + 1) % window;
+    return (gfloat)(loudness_data->avg_sum / window);
+}
+
+int loudness_init(LoudnessData *loudness_data, guint rate, guint channels,
+                    gdouble target_lufs, gdouble true_peak_db, guint lookahead_ms)
+{
+    guint window;
+    if(loudness_data == NULL)
+    {
+        return -1;
+    }
+    if(rate == 0 || channels == 0 || channels > LOUDNESS_MAX_CHANNELS)
+    {
+        return -2;
+    }
+    if(true_peak_db > 0.0 || lookahead_ms == 0)
+    {
+        return -3;
+    }
+    memset(loudness_data, 0, sizeof(LoudnessData));
+    loudness_data->rate = rate;
+    loudness_data->channels = channels;
+    loudness_data->target_lufs = target_lufs;
+    loudness_data->ceiling = pow(10.0, true_peak_db / 20.0);
+    loudness_data->integrated_lufs = LOUDNESS_ABSOLUTE_GATE;
+    k_weighting_init(loudness_data);
+    interpolator_init(loudness_data);
+
+    loudness_data->subblock_len = MAX(rate / 10, 1);
+    loudness_data->gain = 1.0;
+    loudness_data->gain_target = 1.0;
+    loudness_data->gain_coef = 1.0 - exp(-1.0 / (LOUDNESS_GAIN_TAU_S * rate));
+    loudness_data->release = 1.0;
+    loudness_data->release_coef = 1.0 - exp(-1.0 / (LOUDNESS_RELEASE_TAU_S * rate));
+
+    loudness_data->lookahead = MAX(rate * lookahead_ms / 1000, 1);
+    loudness_data->latency = loudness_data->lookahead + LOUDNESS_INTERP_DELAY;
+    window = loudness_data->lookahead + 1;
+    loudness_data->history = g_new0(gfloat, channels * LOUDNESS_INTERP_TAPS);
+    loudness_data->delay = g_new0(gfloat, loudness_data->lookahead * channels);
+    loudness_data->min_values = g_new0(gfloat, window);
+    loudness_data->min_frames = g_new0(guint64, window);
+    loudness_data->avg_values = g_new0(gfloat, window);
+    for(guint i = 0; i < window; i++)
+    {
+        loudness_data->avg_values[i] = 1.0f;
+    }
+    loudness_data->avg_sum = window;
+    return 0;
+}
+
+/*Runs one normalised frame through the true peak estimate and the limiter. output gets the
+  frame from latency frames ago, returns FALSE while that is still before the stream start.
+  output may be input, it is written last.*/
+static gboolean limiter_run(LoudnessData *loudness_data, const gfloat *input, gfloat *output)
+{
+    const guint channels = loudness_data->channels;
+    gfloat *delayed = loudness_data->delay + loudness_data->delay_pos * channels;
+    gboolean primed = loudness_data->frame >= loudness_data->latency;
+    gfloat peak = 0.0f;
+    gfloat required = 1.0f;
+    gfloat gain;
+
+    for(guint c = 0; c < channels; c++)
+    {
+        gfloat *history = loudness_data->history + c * LOUDNESS_INTERP_TAPS;
+        memmove(history, history + 1, (LOUDNESS_INTERP_TAPS - 1) * sizeof(gfloat));
+        history[LOUDNESS_INTERP_TAPS - 1] = input[c];
+        /*The inter-sample peaks come out around the centre of the history, the frame
+          there is the one they belong to*/
+        peak = MAX(peak, fabsf(history[LOUDNESS_INTERP_TAPS - 1 - LOUDNESS_INTERP_DELAY]));
+        for(guint phase = 0; phase < LOUDNESS_OVERSAMPLING; phase++)
+        {
+            gfloat acc = 0.0f;
+            for(guint k = 0; k < LOUDNESS_INTERP_TAPS; k++)
+            {
+                acc += loudness_data->interp[phase][k] * history[LOUDNESS_INTERP_TAPS - 1 - k];
+            }
+            peak = MAX(peak, fabsf(acc));
+        }
+    }
+    if(peak > loudness_data->ceiling)
+    {
+        required = (gfloat)(loudness_data->ceiling / peak);
+    }
+    gain = limiter_gain(loudness_data, required);
+
+    /*Swap the centre frame with the one delayed by the lookahead*/
+    for(guint c = 0; c < channels; c++)
+    {
+        gfloat current = loudness_data->history[c * LOUDNESS_INTERP_TAPS + LOUDNESS_INTERP_TAPS - 1 - LOUDNESS_INTERP_DELAY];
+        output[c] = delayed[c] * gain;
+        delayed[c] = current;
+    }
+    loudness_data->delay_pos = (loudness_data->delay_pos + 1) % loudness_data->lookahead;
+    loudness_data->frame++;
+    return primed;
+}
+
+gsize loudness_process(LoudnessData *loudness_data, gfloat *samples, gsize frames)
+{
+    const guint channels = loudness_data->channels;
+    gdouble subblock_energy = loudness_data->subblock_partial;
+    gsize written = 0;
+
+    for(gsize n = 0; n < frames; n++)
+    {
+        gfloat *frame = samples + n * channels;
+        gfloat normalised[LOUDNESS_MAX_CHANNELS];
+
+        loudness_data->gain += (loudness_data->gain_target - loudness_data->gain) * loudness_data->gain_coef;
+        for(guint c = 0; c < channels; c++)
+        {
+            /*Loudness is measured on the input, the gain only follows the estimate*/
+            gdouble weighted = biquad_run(&loudness_data->shelf, loudness_data->shelf_state[c], frame[c]);
+            weighted = biquad_run(&loudness_data->highpass, loudness_data->highpass_state[c], weighted);
+            subblock_energy += weighted * weighted;
+            normalised[c] = frame[c] * (gfloat)loudness_data->gain;
+        }
+        /*Never ahead of n, so the output doesn't overwrite unread input*/
+        if(limiter_run(loudness_data, normalised, samples + written * channels))
+        {
+            written++;
+        }
+
+        loudness_data->subblock_pos++;
+        if(loudness_data->subblock_pos == loudness_data->subblock_len)
+        {
+            finish_subblock(loudness_data, subblock_energy);
+            loudness_data->subblock_pos = 0;
+            subblock_energy = 0.0;
+        }
+    }
+    loudness_data->subblock_partial = subblock_energy;
+    return written;
+}
+
+gsize loudness_flush(LoudnessData *loudness_data, gfloat *samples)
+{
+    const gfloat silence[LOUDNESS_MAX_CHANNELS] = {0.0f};
+    gsize written = 0;
+
+    if(loudness_data == NULL || samples == NULL)
+    {
+        return 0;
+    }
+    /*Silence pushes the delayed frames out, it is not measured*/
+    for(guint n = 0; n < loudness_data->latency; n++)
+    {
+        if(limiter_run(loudness_data, silence, samples + written * loudness_data->channels))
+        {
+            written++;
+        }
+    }
+    return written;
+}
+
+gdouble loudness_get_integrated(LoudnessData *loudness_data)
+{
+    if(loudness_data == NULL)
+    {
+        return LOUDNESS_ABSOLUTE_GATE;
+    }
+    return loudness_data->integrated_lufs;
+}
+
+void loudness_free(LoudnessData *loudness_data)
+{
+    if(loudness_data == NULL)
+    {
+        return;
+    }
+    g_free(loudness_data->history);
+    g_free(loudness_data->delay);
+    g_free(loudness_data->min_values);
+    g_free(loudness_data->min_frames);
+    g_free(loudness_data->avg_values);
+    loudness_data->history = NULL;
+    loudness_data->delay = NULL;
+    loudness_data->min_values = NULL;
+    loudness_data->min_frames = NULL;
+    loudness_data->avg_values = NULL;
+}
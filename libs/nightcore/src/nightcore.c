@@ -1,4 +1,7 @@
 #include "nightcore.h"
+#include "loudness.h"
+#include "decode_chain.h"
+#include "mapped_source.h"
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -8,6 +11,9 @@
 #define THUMBNAIL_EXTENSIONS_NUM 3
 #define VIDEO_EXTENSIONS_NUM 2
 #define REVERB_DELAY_MAX_MS 500
+#define QUEUE_MIN_BYTES (64 * 1024)
+#define QUEUE_MIN_TIME_MS 100
+#define LOUDNESS_TARGET_MIN -70.0
 //aac
 static const char * audio_files_ext[] = {"mp3", "flac", "wav", "mp4", "mov", "webm"};
 static const char * video_files_ext[] = {"mp4", "mov"};
@@ -63,6 +69,17 @@ typedef struct _NightcorePipeline
     GstElement *audio_resample;
     GstElement *audio_sink_enc;
     GstElement *audio_sink;
+    /*Loudness normalisation, NULL when disabled*/
+    GstElement *normalise_convert;
+    GstElement *normalise_caps;
+    LoudnessData loudness;
+    gboolean loudness_ready;
+    gfloat loudness_target;
+    gfloat true_peak;
+    /*Output clock of the normaliser, it holds back loudness.latency frames*/
+    GstClockTime normalise_start;
+    guint64 normalise_frames;
+    gboolean normalise_draining;
 }NightcorePipeline;
 
 typedef struct _NightcoreThumbnailPipeline
@@ -89,6 +106,9 @@ typedef struct _NightcoreThumbnailPipeline
     /**/
     GstElement *muxer_mp4;
     GstElement *file_sink;
+    /*imagefreeze repeats the picture until the audio has ended at audio_end*/
+    GstClockTime audio_end;
+    gint audio_done;
 }NightcoreThumbnailPipeline;
 
 
@@ -116,6 +136,8 @@ typedef struct _NightcoreVideoSpeedUpPipeline
 }NightcoreVideoSpeedUpPipeline;
 
 
+static const gchar *file_extension(const gchar *file_name);
+
 static AudioExt get_audio_extension(const gchar *file_name);
 
 static VideoExt get_video_extension(const gchar *file_name);
@@ -124,6 +146,31 @@ static ThumbnailExt get_thumbnail_extension(const gchar *file_name);
 
 static void pad_added_handler(GstElement *src, GstPad *new_pad, NightcorePipeline *data);
 
+static GstElement *make_audio_source(const gchar *file_name, const gchar *name, gboolean *mapped);
+
+static gboolean link_source_decoder(GstElement *pipeline, GstElement *source, gboolean mapped, GstElement *convert,
+                                    const gchar *file_name, GstElement **decoder, GCallback pad_handler, gpointer data);
+
+static gboolean link_nightcore_chain(NightcorePipeline *pipeline, AudioExt output_extension);
+
+static gboolean add_normaliser(NightcorePipeline *pipeline, NightcoreData *nightcore_data);
+
+static GstPadProbeReturn normaliser_probe(GstPad *pad, GstPadProbeInfo *info, NightcorePipeline *pipeline);
+
+static void normaliser_timestamp(NightcorePipeline *pipeline, GstBuffer *buffer, gsize frames);
+
+static void normaliser_drain(GstPad *pad, NightcorePipeline *pipeline);
+
+static void set_nightcore_effects(NightcorePipeline *pipeline, NightcoreData *nightcore_data);
+
+static void run_pipeline_until_end(GstElement *pipeline);
+
+static void set_queue_budget(GstElement *queue, NightcoreMemoryBudget *budget);
+
+static GstPadProbeReturn thumbnail_audio_probe(GstPad *pad, GstPadProbeInfo *info, NightcoreThumbnailPipeline *pipeline);
+
+static GstPadProbeReturn thumbnail_video_probe(GstPad *pad, GstPadProbeInfo *info, NightcoreThumbnailPipeline *pipeline);
+
 static void pad_thumbnail_added_handler(GstElement *src, GstPad *new_pad, NightcoreThumbnailPipeline *pipeline);
 
 
@@ -192,6 +239,63 @@ NightcoreErrorCodes nightcore_init( NightcoreData *nightcore_data,
     nightcore_data->reverb_delay_ms = reverb_delay_ms;
     nightcore_data->reverb_intensity = reverb_intensity;
     nightcore_data->reverb_feedback = reverb_feedback;
+    nightcore_data->normalise = TRUE;
+    nightcore_data->loudness_target = LOUDNESS_TARGET_DEFAULT;
+    nightcore_data->true_peak = TRUE_PEAK_DEFAULT;
+    return nightcore_set_memory_budget(nightcore_data, QUEUE_MAX_BYTES_DEFAULT, QUEUE_MAX_TIME_MS_DEFAULT,
+                                        URI_BUFFER_BYTES_DEFAULT, URI_BUFFER_TIME_MS_DEFAULT);
+}
+
+NightcoreErrorCodes nightcore_set_memory_budget(NightcoreData *nightcore_data,
+                                                guint queue_max_bytes,
+                                                guint64 queue_max_time_ms,
+                                                guint uri_buffer_bytes,
+                                                guint64 uri_buffer_time_ms)
+{
+    if(nightcore_data == NULL)
+    {
+        return ERROR_NULL_POINTER;
+    }
+    /*Too small queues starve the muxer, it needs some of both streams to interleave them*/
+    if(queue_max_bytes < QUEUE_MIN_BYTES || queue_max_time_ms < QUEUE_MIN_TIME_MS)
+    {
+        DEBUG_PRINT(g_print("Queue budget should be at least 64 kB and 100 ms"))
+        return ERROR_INVALID_VALUE_RANGE;
+    }
+    if(uri_buffer_bytes < QUEUE_MIN_BYTES || uri_buffer_time_ms < QUEUE_MIN_TIME_MS)
+    {
+        DEBUG_PRINT(g_print("Uri buffer budget should be at least 64 kB and 100 ms"))
+        return ERROR_INVALID_VALUE_RANGE;
+    }
+    nightcore_data->memory_budget.queue_max_bytes = queue_max_bytes;
+    nightcore_data->memory_budget.queue_max_time_ms = queue_max_time_ms;
+    nightcore_data->memory_budget.uri_buffer_bytes = uri_buffer_bytes;
+    nightcore_data->memory_budget.uri_buffer_time_ms = uri_buffer_time_ms;
+    return SUCCESS;
+}
+
+NightcoreErrorCodes nightcore_set_loudness(NightcoreData *nightcore_data,
+                                            gboolean normalise,
+                                            gfloat loudness_target,
+                                            gfloat true_peak)
+{
+    if(nightcore_data == NULL)
+    {
+        return ERROR_NULL_POINTER;
+    }
+    if(loudness_target <= LOUDNESS_TARGET_MIN || loudness_target >= 0.0)
+    {
+        DEBUG_PRINT(g_print("Loudness target should be between -70 and 0 LUFS"))
+        return ERROR_INVALID_VALUE_RANGE;
+    }
+    if(true_peak > 0.0)
+    {
+        DEBUG_PRINT(g_print("True peak ceiling should be lower than 0 dBTP"))
+        return ERROR_INVALID_VALUE_RANGE;
+    }
+    nightcore_data->normalise = normalise;
+    nightcore_data->loudness_target = loudness_target;
+    nightcore_data->true_peak = true_peak;
     return SUCCESS;
 }
 
@@ -199,10 +303,9 @@ NightcoreErrorCodes nightcore_process_file(NightcoreData *nightcore_data, gchar
 {
     AudioExt input_extension, output_extension;
     NightcorePipeline nightcore_pipeline;
-    GstBus *bus;
-    GstMessage *msg;
+    NightcoreErrorCodes status = SUCCESS;
     GstStateChangeReturn ret;
-    gboolean terminate = FALSE;
+    gboolean mapped;
     if(input_file == NULL)
     {
         DEBUG_PRINT(g_printerr("Input file is null"))
@@ -234,9 +337,10 @@ NightcoreErrorCodes nightcore_process_file(NightcoreData *nightcore_data, gchar
     }
     /*Create pipeline*/
     nightcore_pipeline.pipeline = gst_pipeline_new("nightcore_pipeline");
+    nightcore_pipeline.loudness_ready = FALSE;
     /*Create processing elements*/
-    nightcore_pipeline.audio_src = gst_element_factory_make("filesrc", "file_src");
-    nightcore_pipeline.audio_src_dec = gst_element_factory_make("decodebin", "source_decoder");
+    nightcore_pipeline.audio_src = make_audio_source(input_file, "file_src", &mapped);
+    nightcore_pipeline.audio_src_dec = NULL;
     nightcore_pipeline.audio_convert = gst_element_factory_make("audioconvert", "audio_converter");
     nightcore_pipeline.audio_flac_convert = gst_element_factory_make("audioconvert", "audio_flac_converter");
     nightcore_pipeline.audio_resample = gst_element_factory_make("audioresample", "audio_resampler");
@@ -257,118 +361,210 @@ NightcoreErrorCodes nightcore_process_file(NightcoreData *nightcore_data, gchar
         nightcore_pipeline.audio_sink_enc = gst_element_factory_make("wavenc", "wav_encoder");
     }
     if( !nightcore_pipeline.pipeline || !nightcore_pipeline.audio_src || 
-        !nightcore_pipeline.audio_src_dec || !nightcore_pipeline.audio_convert || 
+        !nightcore_pipeline.audio_convert || 
         !nightcore_pipeline.audio_flac_convert ||
         !nightcore_pipeline.audio_resample || !nightcore_pipeline.pitch || 
         !nightcore_pipeline.bass_boost || !nightcore_pipeline.audio_sink || 
         !nightcore_pipeline.audio_sink_enc)
     {
-        return ERROR_CANT_CREATE_ALL_ELEMENTS;
+        status = ERROR_CANT_CREATE_ALL_ELEMENTS;
+        goto exit;
     }
 
     gst_bin_add_many(GST_BIN(nightcore_pipeline.pipeline), nightcore_pipeline.audio_src, 
-                    nightcore_pipeline.audio_src_dec, nightcore_pipeline.audio_convert, nightcore_pipeline.audio_flac_convert,
+                    nightcore_pipeline.audio_convert, nightcore_pipeline.audio_flac_convert,
                     nightcore_pipeline.audio_resample, nightcore_pipeline.pitch, nightcore_pipeline.reverb,
                     nightcore_pipeline.bass_boost, nightcore_pipeline.audio_sink_enc, 
                     nightcore_pipeline.audio_sink, NULL);
-    if(!gst_element_link(nightcore_pipeline.audio_src, nightcore_pipeline.audio_src_dec))
+    if(!add_normaliser(&nightcore_pipeline, nightcore_data))
     {
-        DEBUG_PRINT(g_printerr("Cannot link elements starting from audio source"))
-        return ERROR_CANT_LINK_ALL_ELEMENTS;
+        status = ERROR_CANT_CREATE_ALL_ELEMENTS;
+        goto exit;
     }
-    if(output_extension == WAV)
+    if(!link_source_decoder(nightcore_pipeline.pipeline, nightcore_pipeline.audio_src, mapped, nightcore_pipeline.audio_convert,
+                            input_file, &nightcore_pipeline.audio_src_dec, G_CALLBACK(pad_added_handler), &nightcore_pipeline))
     {
-        if(!gst_element_link_many(nightcore_pipeline.audio_convert, nightcore_pipeline.audio_resample, 
-                             nightcore_pipeline.pitch, nightcore_pipeline.reverb, nightcore_pipeline.bass_boost, 
-                             nightcore_pipeline.audio_sink_enc, nightcore_pipeline.audio_sink, NULL))
-        {
-            DEBUG_PRINT(g_printerr("Cannot link elements starting from audio convert"))
-            return ERROR_CANT_LINK_ALL_ELEMENTS;
-        }
+        DEBUG_PRINT(g_printerr("Cannot link elements starting from audio source"))
+        status = ERROR_CANT_LINK_ALL_ELEMENTS;
+        goto exit;
     }
-    if(output_extension == FLAC)
+    if(!link_nightcore_chain(&nightcore_pipeline, output_extension))
     {
-      if(!gst_element_link_many(nightcore_pipeline.audio_convert, nightcore_pipeline.audio_resample, 
-                             nightcore_pipeline.pitch, nightcore_pipeline.reverb, nightcore_pipeline.bass_boost, nightcore_pipeline.audio_flac_convert,
-                             nightcore_pipeline.audio_sink_enc, nightcore_pipeline.audio_sink, NULL))
-        {
-            DEBUG_PRINT(g_printerr("Cannot link elements starting from audio convert"))
-            return ERROR_CANT_LINK_ALL_ELEMENTS;
-        }  
+        DEBUG_PRINT(g_printerr("Cannot link elements starting from audio convert"))
+        status = ERROR_CANT_LINK_ALL_ELEMENTS;
+        goto exit;
     }
 
     /**setting elements parameterss */
-    g_object_set(nightcore_pipeline.audio_src, "location", input_file, NULL);
-    g_object_set(nightcore_pipeline.pitch, "pitch", nightcore_data->pitch_val, "tempo", nightcore_data->speed_val, NULL);        
-    g_object_set(nightcore_pipeline.bass_boost, "band1", nightcore_data->bass_boost_val, NULL);
-    g_object_set(nightcore_pipeline.bass_boost, "band2", nightcore_data->bass_boost_val, NULL);
-    g_object_set(nightcore_pipeline.bass_boost, "band3", nightcore_data->bass_boost_val, NULL);
-    g_object_set(nightcore_pipeline.bass_boost, "band4", nightcore_data->bass_boost_val, NULL);
-    g_object_set(nightcore_pipeline.reverb, "delay", (nightcore_data->reverb_delay_ms*MS_TO_NS), NULL);
-    g_object_set(nightcore_pipeline.reverb, "intensity", (nightcore_data->reverb_intensity), NULL);
-    g_object_set(nightcore_pipeline.reverb, "feedback", (nightcore_data->reverb_feedback), NULL);
+    set_nightcore_effects(&nightcore_pipeline, nightcore_data);
     g_object_set(nightcore_pipeline.audio_sink, "location", output_file, NULL);
-    /** Connect to the pad-added signal  */
-    g_signal_connect(nightcore_pipeline.audio_src_dec, "pad-added", G_CALLBACK(pad_added_handler), &nightcore_pipeline);
 
     /* Start playing */
     ret = gst_element_set_state (nightcore_pipeline.pipeline, GST_STATE_PLAYING);
     if (ret == GST_STATE_CHANGE_FAILURE) {
         DEBUG_PRINT( g_printerr("Unable to set the pipeline to the playing state.\n"))
-        gst_object_unref (nightcore_pipeline.pipeline);
-        return ERROR_CANT_SET_PIPELINE_PLAYING;
+        status = ERROR_CANT_SET_PIPELINE_PLAYING;
+        goto exit;
     }
 
-    bus = gst_element_get_bus (nightcore_pipeline.pipeline);
-    do {
-        msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
-            GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    run_pipeline_until_end(nightcore_pipeline.pipeline);
 
-        /* Parse message */
-        if (msg != NULL) {
-        GError *err;
-        gchar *debug_info;
+exit:
+    if(nightcore_pipeline.pipeline != NULL)
+    {
+        gst_element_set_state(nightcore_pipeline.pipeline, GST_STATE_NULL);
+        gst_object_unref(nightcore_pipeline.pipeline);
+    }
+    /*The normaliser may have started on preroll even when the pipeline failed later*/
+    if(nightcore_pipeline.loudness_ready)
+    {
+        DEBUG_PRINT(g_print("Integrated loudness of input: %.1f LUFS\n", loudness_get_integrated(&nightcore_pipeline.loudness)))
+        loudness_free(&nightcore_pipeline.loudness);
+    }
+    return status;
+}
 
-        switch (GST_MESSAGE_TYPE (msg)) {
-            case GST_MESSAGE_ERROR:
-                gst_message_parse_error (msg, &err, &debug_info);
-                g_printerr ("Error received from element %s: %s\n", GST_OBJECT_NAME (msg->src), err->message);
-                g_printerr ("Debugging information: %s\n", debug_info ? debug_info : "none");
-                g_clear_error (&err);
-                g_free (debug_info);
-                terminate = TRUE;
-                break;
-            case GST_MESSAGE_EOS:
-                g_print ("End-Of-Stream reached.\n");
-                terminate = TRUE;
-                break;
-            case GST_MESSAGE_STATE_CHANGED:
-                /* We are only interested in state-changed messages from the pipeline */
-                if (GST_MESSAGE_SRC (msg) == GST_OBJECT (nightcore_pipeline.pipeline)) {
-                    GstState old_state, new_state, pending_state;
-                    gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
-                    g_print ("Pipeline state changed from %s to %s:\n",
-                        gst_element_state_get_name (old_state), gst_element_state_get_name (new_state));
-                }
-                break;
-            default:
-                /* We should not reach here */
-                g_printerr("Get message of name %s\n", GST_MESSAGE_TYPE_NAME(msg));
-                g_printerr ("Unexpected message received.\n");
-                break;
+
+NightcoreErrorCodes nightcore_process_url(NightcoreData *nightcore_data, gchar *input_url, gchar *output_file)
+{
+    AudioExt output_extension;
+    NightcorePipeline nightcore_pipeline;
+    NightcoreErrorCodes status = SUCCESS;
+    GstStateChangeReturn ret;
+    gchar *uri;
+    if(nightcore_data == NULL)
+    {
+        return ERROR_NULL_POINTER;
+    }
+    if(input_url == NULL)
+    {
+        DEBUG_PRINT(g_printerr("Input url is null"))
+        return ERROR_INVALID_INPUT_FILE_PATH;
+    }
+    if(output_file == NULL)
+    {
+        DEBUG_PRINT(g_printerr("Output file is null"))
+        return ERROR_INVALID_OUTPUT_FILE_PATH;
+    }
+    /*Plain paths are accepted too, they are turned into file:// uris*/
+    if(gst_uri_is_valid(input_url))
+    {
+        uri = g_strdup(input_url);
+    }
+    else
+    {
+        if(access((const char *)input_url, F_OK) != 0)
+        {
+            DEBUG_PRINT(g_printerr("Input is neither valid uri nor accessible file."))
+            return ERROR_INVALID_INPUT_FILE_PATH;
         }
-        gst_message_unref (msg);
+        uri = gst_filename_to_uri(input_url, NULL);
+        if(uri == NULL)
+        {
+            return ERROR_INVALID_INPUT_FILE_PATH;
         }
-    } while (!terminate);
+    }
+    if(file_valid_path((const char*)output_file) != 0)
+    {
+        g_free(uri);
+        return ERROR_INVALID_OUTPUT_FILE_PATH;
+    }
+    output_extension = get_audio_extension(output_file);
+    if(output_extension != MP3 && output_extension != FLAC && output_extension != WAV)
+    {
+        DEBUG_PRINT(g_printerr("Invalid output extension"))
+        g_free(uri);
+        return ERROR_INVALID_OUTPUT_EXTENSION;
+    }
+    /*Create pipeline*/
+    nightcore_pipeline.pipeline = gst_pipeline_new("nightcore_url_pipeline");
+    nightcore_pipeline.loudness_ready = FALSE;
+    /*uridecodebin pulls the data progressively, decoding starts on the first received bytes*/
+    nightcore_pipeline.audio_src = gst_element_factory_make("uridecodebin", "uri_src");
+    nightcore_pipeline.audio_src_dec = NULL;
+    nightcore_pipeline.audio_convert = gst_element_factory_make("audioconvert", "audio_converter");
+    nightcore_pipeline.audio_flac_convert = gst_element_factory_make("audioconvert", "audio_flac_converter");
+    nightcore_pipeline.audio_resample = gst_element_factory_make("audioresample", "audio_resampler");
+    nightcore_pipeline.pitch = gst_element_factory_make("pitch", "nightcore_pitch");
+    nightcore_pipeline.bass_boost = gst_element_factory_make("equalizer-10bands", "equalizer_bass_boost");
+    nightcore_pipeline.reverb = gst_element_factory_make("audioecho", "reverb");
+    nightcore_pipeline.audio_sink = gst_element_factory_make("filesink", "output_sink");
+    if(output_extension == MP3)
+    {
+        nightcore_pipeline.audio_sink_enc = gst_element_factory_make("lamemp3enc", "mp3_encoder");
+    }
+    else if(output_extension == FLAC)
+    {
+        nightcore_pipeline.audio_sink_enc = gst_element_factory_make("flacenc", "flac_encoder");
+    }
+    else
+    {
+        nightcore_pipeline.audio_sink_enc = gst_element_factory_make("wavenc", "wav_encoder");
+    }
+    if( !nightcore_pipeline.pipeline || !nightcore_pipeline.audio_src || 
+        !nightcore_pipeline.audio_convert || !nightcore_pipeline.audio_flac_convert ||
+        !nightcore_pipeline.audio_resample || !nightcore_pipeline.pitch || 
+        !nightcore_pipeline.bass_boost || !nightcore_pipeline.reverb ||
+        !nightcore_pipeline.audio_sink || !nightcore_pipeline.audio_sink_enc)
+    {
+        status = ERROR_CANT_CREATE_ALL_ELEMENTS;
+        goto exit;
+    }
+
+    gst_bin_add_many(GST_BIN(nightcore_pipeline.pipeline), nightcore_pipeline.audio_src, 
+                    nightcore_pipeline.audio_convert, nightcore_pipeline.audio_flac_convert,
+                    nightcore_pipeline.audio_resample, nightcore_pipeline.pitch, nightcore_pipeline.reverb,
+                    nightcore_pipeline.bass_boost, nightcore_pipeline.audio_sink_enc, 
+                    nightcore_pipeline.audio_sink, NULL);
+    if(!add_normaliser(&nightcore_pipeline, nightcore_data))
+    {
+        status = ERROR_CANT_CREATE_ALL_ELEMENTS;
+        goto exit;
+    }
+    if(!link_nightcore_chain(&nightcore_pipeline, output_extension))
+    {
+        DEBUG_PRINT(g_printerr("Cannot link elements starting from audio convert"))
+        status = ERROR_CANT_LINK_ALL_ELEMENTS;
+        goto exit;
+    }
 
+    /**setting elements parameterss */
+    /*Bounded buffering, the download is throttled by the processing speed instead of filling memory*/
+    g_object_set(nightcore_pipeline.audio_src, "uri", uri, 
+                "use-buffering", TRUE,
+                "download", FALSE,
+                "buffer-size", (gint)nightcore_data->memory_budget.uri_buffer_bytes,
+                "buffer-duration", (gint64)(nightcore_data->memory_budget.uri_buffer_time_ms * MS_TO_NS), NULL);
+    set_nightcore_effects(&nightcore_pipeline, nightcore_data);
+    g_object_set(nightcore_pipeline.audio_sink, "location", output_file, NULL);
+    /** Connect to the pad-added signal  */
+    g_signal_connect(nightcore_pipeline.audio_src, "pad-added", G_CALLBACK(pad_added_handler), &nightcore_pipeline);
 
+    /* Start playing */
+    ret = gst_element_set_state (nightcore_pipeline.pipeline, GST_STATE_PLAYING);
+    if (ret == GST_STATE_CHANGE_FAILURE) {
+        DEBUG_PRINT( g_printerr("Unable to set the pipeline to the playing state.\n"))
+        status = ERROR_CANT_SET_PIPELINE_PLAYING;
+        goto exit;
+    }
 
-    gst_object_unref(bus);
-    gst_element_set_state(nightcore_pipeline.pipeline, GST_STATE_NULL);
-    gst_object_unref(nightcore_pipeline.pipeline);
-    return SUCCESS;
-}
+    run_pipeline_until_end(nightcore_pipeline.pipeline);
 
+exit:
+    if(nightcore_pipeline.pipeline != NULL)
+    {
+        gst_element_set_state(nightcore_pipeline.pipeline, GST_STATE_NULL);
+        gst_object_unref(nightcore_pipeline.pipeline);
+    }
+    /*The normaliser may have started on preroll even when the pipeline failed later*/
+    if(nightcore_pipeline.loudness_ready)
+    {
+        DEBUG_PRINT(g_print("Integrated loudness of input: %.1f LUFS\n", loudness_get_integrated(&nightcore_pipeline.loudness)))
+        loudness_free(&nightcore_pipeline.loudness);
+    }
+    g_free(uri);
+    return status;
+}
 
 NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *nightcore_data, 
                                                     gchar *input_audio_file, 
@@ -385,6 +581,7 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
     GstMessage *msg;
     GstStateChangeReturn ret;
     GstPad *mux_audio_pad, *mux_video_pad;
+    gboolean mapped;
     GstPad *queue_audio_pad, *queue_video_pad;
     gboolean terminate = FALSE;
     
@@ -432,8 +629,8 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
     }
     nightcore_pipeline.pipeline = gst_pipeline_new("nightcore_pipeline");
     /*Create processing elements*/
-    nightcore_pipeline.audio_src = gst_element_factory_make("filesrc", "audio_file_src");
-    nightcore_pipeline.audio_src_dec = gst_element_factory_make("decodebin", "source_decoder");
+    nightcore_pipeline.audio_src = make_audio_source((const gchar *)input_audio_file, "audio_file_src", &mapped);
+    nightcore_pipeline.audio_src_dec = NULL;
     nightcore_pipeline.audio_convert = gst_element_factory_make("audioconvert", "audio_converter");
     nightcore_pipeline.audio_resample = gst_element_factory_make("audioresample", "audio_resampler");
     nightcore_pipeline.bass_boost = gst_element_factory_make("equalizer-10bands", "equalizer_bass_boost");
@@ -466,11 +663,11 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
         nightcore_pipeline.muxer_mp4 = gst_element_factory_make("mp4mux", "muxer");
     }
     
-    nightcore_pipeline.h264_enc = gst_element_factory_make("h264enc", "h264_encoder");
+    nightcore_pipeline.h264_enc = gst_element_factory_make("x264enc", "h264_encoder");
 
     nightcore_pipeline.file_sink = gst_element_factory_make("filesink", "mov_file_sink");
     if( !nightcore_pipeline.pipeline || !nightcore_pipeline.audio_src || 
-        !nightcore_pipeline.audio_src_dec || !nightcore_pipeline.audio_convert || 
+        !nightcore_pipeline.audio_convert || 
         !nightcore_pipeline.audio_resample || !nightcore_pipeline.pitch || 
         !nightcore_pipeline.bass_boost || !nightcore_pipeline.audio_sink_enc ||
         !nightcore_pipeline.audio_queue || 
@@ -482,7 +679,7 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
         return ERROR_CANT_CREATE_ALL_ELEMENTS;
     }
     gst_bin_add_many(GST_BIN(nightcore_pipeline.pipeline), nightcore_pipeline.audio_src, 
-                    nightcore_pipeline.audio_src_dec, nightcore_pipeline.audio_convert, 
+                    nightcore_pipeline.audio_convert, 
                     nightcore_pipeline.audio_resample, nightcore_pipeline.pitch, nightcore_pipeline.reverb,
                     nightcore_pipeline.bass_boost, nightcore_pipeline.audio_sink_enc,
                     nightcore_pipeline.audio_queue, 
@@ -491,7 +688,9 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
                     nightcore_pipeline.video_queue,  nightcore_pipeline.image_convert,
                     nightcore_pipeline.muxer_mp4, nightcore_pipeline.file_sink, nightcore_pipeline.h264_enc, 
                     NULL);
-    if(!gst_element_link(nightcore_pipeline.audio_src, nightcore_pipeline.audio_src_dec))
+    if(!link_source_decoder(nightcore_pipeline.pipeline, nightcore_pipeline.audio_src, mapped, nightcore_pipeline.audio_convert,
+                            (const gchar *)input_audio_file, &nightcore_pipeline.audio_src_dec,
+                            G_CALLBACK(pad_thumbnail_added_handler), &nightcore_pipeline))
     {
         DEBUG_PRINT(g_printerr("Cannot link elements starting from audio source"))
         return ERROR_CANT_LINK_ALL_ELEMENTS;
@@ -504,8 +703,9 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
         DEBUG_PRINT(g_printerr("Cannot link elements starting from audio convert"))
         return ERROR_CANT_LINK_ALL_ELEMENTS;
     }
+    /*The picture is encoded before the queue, the muxer only takes the audio raw*/
     if(!gst_element_link_many(nightcore_pipeline.image_src, nightcore_pipeline.image_src_dec, nightcore_pipeline.image_src_enc,
-                            nightcore_pipeline.image_freeze,
+                            nightcore_pipeline.image_freeze, nightcore_pipeline.image_convert, nightcore_pipeline.h264_enc,
                             nightcore_pipeline.video_queue, NULL))
     {
         DEBUG_PRINT(g_printerr("Cannot link elements starting from image source"))
@@ -524,13 +724,12 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
         DEBUG_PRINT(g_printerr("Muxer or file sink is null"))
         return ERROR_CANT_CREATE_ALL_ELEMENTS;
     }
-    if(!gst_element_link_many(nightcore_pipeline.muxer_mp4, nightcore_pipeline.h264_enc, nightcore_pipeline.file_sink, NULL))
+    if(!gst_element_link(nightcore_pipeline.muxer_mp4, nightcore_pipeline.file_sink))
     {
         DEBUG_PRINT(g_printerr("Cannot link muxer mp4 to file sink"))
         return ERROR_CANT_LINK_ALL_ELEMENTS;
     }
     /**setting elements parameterss */
-    g_object_set(nightcore_pipeline.audio_src, "location", input_audio_file, NULL);
     g_object_set(nightcore_pipeline.pitch, "pitch", nightcore_data->pitch_val, "tempo", nightcore_data->speed_val, NULL);        
     g_object_set(nightcore_pipeline.bass_boost, "band1", nightcore_data->bass_boost_val, NULL);
     g_object_set(nightcore_pipeline.bass_boost, "band2", nightcore_data->bass_boost_val, NULL);
@@ -540,11 +739,22 @@ NightcoreErrorCodes nightcore_process_file_to_thumbnail_video(  NightcoreData *n
     g_object_set(nightcore_pipeline.reverb, "feedback", (nightcore_data->reverb_feedback), NULL);
 
     g_object_set(nightcore_pipeline.image_src, "location", input_thumbnail, NULL);
-    g_object_set(nightcore_pipeline.image_freeze, "num-buffers", 2000, NULL);
+    /*imagefreeze would fill the video queue while the muxer waits for audio, the budget makes it block instead*/
+    set_queue_budget(nightcore_pipeline.audio_queue, &nightcore_data->memory_budget);
+    set_queue_budget(nightcore_pipeline.video_queue, &nightcore_data->memory_budget);
+    /*The picture is repeated as long as the processed audio lasts, whatever the song length*/
+    nightcore_pipeline.audio_end = 0;
+    nightcore_pipeline.audio_done = FALSE;
+    queue_audio_pad = gst_element_get_static_pad(nightcore_pipeline.audio_queue, "sink");
+    gst_pad_add_probe(queue_audio_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                        (GstPadProbeCallback)thumbnail_audio_probe, &nightcore_pipeline, NULL);
+    gst_object_unref(queue_audio_pad);
+    queue_video_pad = gst_element_get_static_pad(nightcore_pipeline.image_freeze, "src");
+    gst_pad_add_probe(queue_video_pad, GST_PAD_PROBE_TYPE_BUFFER,
+                        (GstPadProbeCallback)thumbnail_video_probe, &nightcore_pipeline, NULL);
+    gst_object_unref(queue_video_pad);
 
     g_object_set(nightcore_pipeline.file_sink, "location", output_file, NULL);
-    /*Connect signale*/
-    g_signal_connect(nightcore_pipeline.audio_src_dec, "pad-added", G_CALLBACK(pad_thumbnail_added_handler), &nightcore_pipeline);
     /* Start playing */
     ret = gst_element_set_state (nightcore_pipeline.pipeline, GST_STATE_PLAYING);
     if (ret == GST_STATE_CHANGE_FAILURE) {
@@ -678,73 +888,73 @@ const char * nightcore_get_error_name(NightcoreErrorCodes error_code)
     return night_error_names[error_code];
 }
 
+/*Text after the last dot of the file name, NULL without one*/
+static const gchar *file_extension(const gchar *file_name)
+{
+    const gchar *slash;
+    const gchar *dot;
+    if(file_name == NULL)
+    {
+        return NULL;
+    }
+    slash = strrchr(file_name, '/');
+    dot = strrchr(slash != NULL ? slash + 1 : file_name, '.');
+    if(dot == NULL || dot[1] == '\0')
+    {
+        return NULL;
+    }
+    return dot + 1;
+}
+
 static AudioExt get_audio_extension(const gchar *file_name)
 {
-    gchar *file_name_copy = g_strdup(file_name);
-    gchar *token = (gchar *)strtok((char *)file_name_copy, ".");
-    gchar *extenison_result;
-    while(token)
+    const gchar *extension = file_extension(file_name);
+    if(extension == NULL)
     {
-        extenison_result = token;
-        token = (gchar *)strtok(NULL, ".");
+        return INVALID;
     }
-    AudioExt result = INVALID;
     for(guint8 i = 0; i < AUDIO_EXTENSIONS_NUM; i++)
     {
-        if(strcmp(extenison_result, audio_files_ext[i]) == 0)
+        if(g_ascii_strcasecmp(extension, audio_files_ext[i]) == 0)
         {
-            result = (AudioExt)i;
+            return (AudioExt)i;
         }
     }
-    g_free(file_name_copy);
-    return result;
+    return INVALID;
 }
 
 static VideoExt get_video_extension(const gchar *file_name)
 {
-    
-    gchar *file_name_copy = g_strdup(file_name);
-    gchar *token = (gchar *)strtok((char *)file_name_copy, ".");
-    gchar *extension_result;
-    while(token)
+    const gchar *extension = file_extension(file_name);
+    if(extension == NULL)
     {
-        extension_result = token;
-        token = (gchar *)strtok(NULL, ".");
+        return V_INVALID;
     }
-    
-    VideoExt result = V_INVALID;
-    for(guint8 i=0;i < VIDEO_EXTENSIONS_NUM; i++)
+    for(guint8 i = 0; i < VIDEO_EXTENSIONS_NUM; i++)
     {
-        if(strcmp(extension_result, video_files_ext[i]) == 0)
+        if(g_ascii_strcasecmp(extension, video_files_ext[i]) == 0)
         {
-            result = (VideoExt)i;
+            return (VideoExt)i;
         }
     }
-    
-    g_free(file_name_copy);
-    return result;
+    return V_INVALID;
 }
 
 static ThumbnailExt get_thumbnail_extension(const gchar *file_name)
 {
-    gchar *file_name_copy = g_strdup(file_name);
-    gchar *token = (gchar *)strtok((char *)file_name_copy, ".");
-    gchar *extenison_result;
-    while(token)
+    const gchar *extension = file_extension(file_name);
+    if(extension == NULL)
     {
-        extenison_result = token;
-        token = (gchar *)strtok(NULL, ".");
+        return T_INVALID;
     }
-    ThumbnailExt result = T_INVALID;
     for(guint8 i = 0; i < THUMBNAIL_EXTENSIONS_NUM; i++)
     {
-        if(strcmp(extenison_result, thumbnail_files_ext[i]) == 0)
+        if(g_ascii_strcasecmp(extension, thumbnail_files_ext[i]) == 0)
         {
-            result = (ThumbnailExt)i;
+            return (ThumbnailExt)i;
         }
     }
-    g_free(file_name_copy);
-    return result;
+    return T_INVALID;
 }
 
 static void pad_added_handler(GstElement *src, GstPad *new_pad, NightcorePipeline *pipeline)
@@ -834,6 +1044,46 @@ exit:
     gst_object_unref (sink_pad);
 }
 
+/*PCM WAV is pushed from the memory mapped file without read copies, the rest is read by filesrc*/
+static GstElement *make_audio_source(const gchar *file_name, const gchar *name, gboolean *mapped)
+{
+    GstElement *source = mapped_source_new(file_name);
+
+    *mapped = source != NULL;
+    if(source == NULL)
+    {
+        source = gst_element_factory_make("filesrc", name);
+        if(source != NULL)
+        {
+            g_object_set(source, "location", file_name, NULL);
+        }
+    }
+    return source;
+}
+
+static gboolean link_source_decoder(GstElement *pipeline, GstElement *source, gboolean mapped, GstElement *convert,
+                                    const gchar *file_name, GstElement **decoder, GCallback pad_handler, gpointer data)
+{
+    *decoder = NULL;
+    /*The mapped source outputs raw audio already*/
+    if(mapped)
+    {
+        return gst_element_link(source, convert);
+    }
+    /*Probed formats get their parser and decoder directly, decodebin only for the rest*/
+    if(decode_chain_link_file(GST_BIN(pipeline), source, convert, file_name))
+    {
+        return TRUE;
+    }
+    *decoder = gst_element_factory_make("decodebin", "source_decoder");
+    if(*decoder == NULL || !gst_bin_add(GST_BIN(pipeline), *decoder) || !gst_element_link(source, *decoder))
+    {
+        return FALSE;
+    }
+    g_signal_connect(*decoder, "pad-added", pad_handler, data);
+    return TRUE;
+}
+
 static int file_valid_path(const char *file_name)
 {
     FILE *fp;
@@ -862,3 +1112,292 @@ link_to_multiplexer (GstPad * tolink_pad, GstElement * mux)
   g_free (sinkname);
   g_free (srcname);
 }
+
+
+static gboolean link_nightcore_chain(NightcorePipeline *pipeline, AudioExt output_extension)
+{
+    GstElement *last = pipeline->bass_boost;
+    if(!gst_element_link_many(pipeline->audio_convert, pipeline->audio_resample, 
+                             pipeline->pitch, pipeline->reverb, pipeline->bass_boost, NULL))
+    {
+        return FALSE;
+    }
+    /*Normaliser goes last, after everything that can add gain*/
+    if(pipeline->normalise_convert != NULL)
+    {
+        if(!gst_element_link_many(last, pipeline->normalise_convert, pipeline->normalise_caps, NULL))
+        {
+            return FALSE;
+        }
+        last = pipeline->normalise_caps;
+    }
+    /*flacenc and lamemp3enc accept only integer samples, so convert once more before encoding*/
+    if(output_extension != WAV)
+    {
+        if(!gst_element_link(last, pipeline->audio_flac_convert))
+        {
+            return FALSE;
+        }
+        last = pipeline->audio_flac_convert;
+    }
+    return gst_element_link_many(last, pipeline->audio_sink_enc, pipeline->audio_sink, NULL);
+}
+
+static gboolean add_normaliser(NightcorePipeline *pipeline, NightcoreData *nightcore_data)
+{
+    GstCaps *caps;
+    GstPad *pad;
+
+    pipeline->normalise_convert = NULL;
+    pipeline->normalise_caps = NULL;
+    pipeline->loudness_ready = FALSE;
+    pipeline->normalise_draining = FALSE;
+    if(!nightcore_data->normalise)
+    {
+        return TRUE;
+    }
+    pipeline->loudness_target = nightcore_data->loudness_target;
+    pipeline->true_peak = nightcore_data->true_peak;
+    pipeline->normalise_convert = gst_element_factory_make("audioconvert", "normalise_converter");
+    pipeline->normalise_caps = gst_element_factory_make("capsfilter", "normalise_caps");
+    if(!pipeline->normalise_convert || !pipeline->normalise_caps)
+    {
+        return FALSE;
+    }
+    /*The normaliser works in place on interleaved floats*/
+    caps = gst_caps_from_string("audio/x-raw,format=F32LE,layout=interleaved");
+    g_object_set(pipeline->normalise_caps, "caps", caps, NULL);
+    gst_caps_unref(caps);
+    gst_bin_add_many(GST_BIN(pipeline->pipeline), pipeline->normalise_convert, pipeline->normalise_caps, NULL);
+
+    /*On the sink pad, a source pad is already EOS when its probes see the event and
+      could not take the end of the song after it*/
+    pad = gst_element_get_static_pad(pipeline->normalise_caps, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                        (GstPadProbeCallback)normaliser_probe, pipeline, NULL);
+    gst_object_unref(pad);
+    return TRUE;
+}
+
+static GstPadProbeReturn normaliser_probe(GstPad *pad, GstPadProbeInfo *info, NightcorePipeline *pipeline)
+{
+    GstBuffer *buffer;
+    GstMapInfo map;
+    gsize frames;
+
+    if(GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+    {
+        if(pipeline->loudness_ready && GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+        {
+            normaliser_drain(pad, pipeline);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+    /*The tail pushed by normaliser_drain is already normalised*/
+    if(pipeline->normalise_draining)
+    {
+        return GST_PAD_PROBE_OK;
+    }
+    buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if(!pipeline->loudness_ready)
+    {
+        GstCaps *caps = gst_pad_get_current_caps(pad);
+        GstStructure *caps_struct;
+        gint rate = 0, channels = 0;
+        if(caps == NULL)
+        {
+            return GST_PAD_PROBE_OK;
+        }
+        caps_struct = gst_caps_get_structure(caps, 0);
+        gst_structure_get_int(caps_struct, "rate", &rate);
+        gst_structure_get_int(caps_struct, "channels", &channels);
+        gst_caps_unref(caps);
+        if(loudness_init(&pipeline->loudness, rate, channels, pipeline->loudness_target,
+                        pipeline->true_peak, LOUDNESS_LOOKAHEAD_MS_DEFAULT) != 0)
+        {
+            DEBUG_PRINT(g_printerr("Cannot normalise %d channels at %d Hz, passing through\n", channels, rate))
+            return GST_PAD_PROBE_REMOVE;
+        }
+        pipeline->normalise_start = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : 0;
+        pipeline->normalise_frames = 0;
+        pipeline->loudness_ready = TRUE;
+    }
+    buffer = gst_buffer_make_writable(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    if(!gst_buffer_map(buffer, &map, GST_MAP_READWRITE))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+    frames = loudness_process(&pipeline->loudness, (gfloat *)map.data, map.size / (sizeof(gfloat) * pipeline->loudness.channels));
+    gst_buffer_unmap(buffer, &map);
+    /*Only the start of the song is still in the lookahead*/
+    if(frames == 0)
+    {
+        return GST_PAD_PROBE_DROP;
+    }
+    gst_buffer_resize(buffer, 0, frames * sizeof(gfloat) * pipeline->loudness.channels);
+    normaliser_timestamp(pipeline, buffer, frames);
+    return GST_PAD_PROBE_OK;
+}
+
+/*The output is shorter than the input until the drain, so the timestamps are counted again*/
+static void normaliser_timestamp(NightcorePipeline *pipeline, GstBuffer *buffer, gsize frames)
+{
+    gint rate = (gint)pipeline->loudness.rate;
+
+    GST_BUFFER_PTS(buffer) = pipeline->normalise_start +
+                                gst_util_uint64_scale_int(pipeline->normalise_frames, GST_SECOND, rate);
+    GST_BUFFER_DURATION(buffer) = pipeline->normalise_start +
+                                    gst_util_uint64_scale_int(pipeline->normalise_frames + frames, GST_SECOND, rate) -
+                                    GST_BUFFER_PTS(buffer);
+    GST_BUFFER_OFFSET(buffer) = pipeline->normalise_frames;
+    GST_BUFFER_OFFSET_END(buffer) = pipeline->normalise_frames + frames;
+    pipeline->normalise_frames += frames;
+}
+
+/*Sends the end of the song still held by the limiter ahead of the EOS*/
+static void normaliser_drain(GstPad *pad, NightcorePipeline *pipeline)
+{
+    gsize frame_bytes = sizeof(gfloat) * pipeline->loudness.channels;
+    GstBuffer *buffer = gst_buffer_new_allocate(NULL, pipeline->loudness.latency * frame_bytes, NULL);
+    GstMapInfo map;
+    gsize frames = 0;
+
+    if(buffer == NULL)
+    {
+        return;
+    }
+    if(gst_buffer_map(buffer, &map, GST_MAP_WRITE))
+    {
+        frames = loudness_flush(&pipeline->loudness, (gfloat *)map.data);
+        gst_buffer_unmap(buffer, &map);
+    }
+    if(frames == 0)
+    {
+        gst_buffer_unref(buffer);
+        return;
+    }
+    gst_buffer_resize(buffer, 0, frames * frame_bytes);
+    normaliser_timestamp(pipeline, buffer, frames);
+    pipeline->normalise_draining = TRUE;
+    gst_pad_chain(pad, buffer);
+    pipeline->normalise_draining = FALSE;
+}
+
+static void set_nightcore_effects(NightcorePipeline *pipeline, NightcoreData *nightcore_data)
+{
+    g_object_set(pipeline->pitch, "pitch", nightcore_data->pitch_val, "tempo", nightcore_data->speed_val, NULL);        
+    g_object_set(pipeline->bass_boost, "band1", nightcore_data->bass_boost_val, NULL);
+    g_object_set(pipeline->bass_boost, "band2", nightcore_data->bass_boost_val, NULL);
+    g_object_set(pipeline->bass_boost, "band3", nightcore_data->bass_boost_val, NULL);
+    g_object_set(pipeline->bass_boost, "band4", nightcore_data->bass_boost_val, NULL);
+    g_object_set(pipeline->reverb, "delay", (nightcore_data->reverb_delay_ms*MS_TO_NS), NULL);
+    g_object_set(pipeline->reverb, "intensity", (nightcore_data->reverb_intensity), NULL);
+    g_object_set(pipeline->reverb, "feedback", (nightcore_data->reverb_feedback), NULL);
+}
+
+static void run_pipeline_until_end(GstElement *pipeline)
+{
+    GstBus *bus;
+    GstMessage *msg;
+    gboolean terminate = FALSE;
+
+    bus = gst_element_get_bus (pipeline);
+    do {
+        msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+            GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_BUFFERING);
+
+        /* Parse message */
+        if (msg != NULL) {
+        GError *err;
+        gchar *debug_info;
+        gint percent;
+
+        switch (GST_MESSAGE_TYPE (msg)) {
+            case GST_MESSAGE_ERROR:
+                gst_message_parse_error (msg, &err, &debug_info);
+                g_printerr ("Error received from element %s: %s\n", GST_OBJECT_NAME (msg->src), err->message);
+                g_printerr ("Debugging information: %s\n", debug_info ? debug_info : "none");
+                g_clear_error (&err);
+                g_free (debug_info);
+                terminate = TRUE;
+                break;
+            case GST_MESSAGE_EOS:
+                g_print ("End-Of-Stream reached.\n");
+                terminate = TRUE;
+                break;
+            case GST_MESSAGE_STATE_CHANGED:
+                /* We are only interested in state-changed messages from the pipeline */
+                if (GST_MESSAGE_SRC (msg) == GST_OBJECT (pipeline)) {
+                    GstState old_state, new_state, pending_state;
+                    gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
+                    g_print ("Pipeline state changed from %s to %s:\n",
+                        gst_element_state_get_name (old_state), gst_element_state_get_name (new_state));
+                }
+                break;
+            case GST_MESSAGE_BUFFERING:
+                /* Output goes to a file, so there is no need to pause while the buffer refills */
+                gst_message_parse_buffering (msg, &percent);
+                DEBUG_PRINT(g_print ("Buffering %d%%\n", percent))
+                break;
+            default:
+                /* We should not reach here */
+                g_printerr("Get message of name %s\n", GST_MESSAGE_TYPE_NAME(msg));
+                g_printerr ("Unexpected message received.\n");
+                break;
+        }
+        gst_message_unref (msg);
+        }
+    } while (!terminate);
+
+    gst_object_unref(bus);
+}
+
+/*Remembers where the processed audio ends, timestamps are taken after the tempo change*/
+static GstPadProbeReturn thumbnail_audio_probe(GstPad *pad, GstPadProbeInfo *info, NightcoreThumbnailPipeline *pipeline)
+{
+    if(info->type & GST_PAD_PROBE_TYPE_BUFFER)
+    {
+        GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        if(GST_BUFFER_PTS_IS_VALID(buffer))
+        {
+            GstClockTime end = GST_BUFFER_PTS(buffer) +
+                                (GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) : 0);
+            pipeline->audio_end = MAX(pipeline->audio_end, end);
+        }
+    }
+    else if(GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+    {
+        g_atomic_int_set(&pipeline->audio_done, TRUE);
+        return GST_PAD_PROBE_REMOVE;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+/*Ends the picture stream at the first frame past the audio. It runs in the imagefreeze thread,
+  so the end of stream goes out in order and imagefreeze stops on the returned flow.*/
+static GstPadProbeReturn thumbnail_video_probe(GstPad *pad, GstPadProbeInfo *info, NightcoreThumbnailPipeline *pipeline)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if(!g_atomic_int_get(&pipeline->audio_done) ||
+        (GST_BUFFER_PTS_IS_VALID(buffer) && GST_BUFFER_PTS(buffer) < pipeline->audio_end))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+    gst_pad_push_event(pad, gst_event_new_eos());
+    gst_buffer_unref(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = NULL;
+    GST_PAD_PROBE_INFO_FLOW_RETURN(info) = GST_FLOW_EOS;
+    return GST_PAD_PROBE_HANDLED;
+}
+
+static void set_queue_budget(GstElement *queue, NightcoreMemoryBudget *budget)
+{
+    /*Buffer count limit is disabled, raw video frames and audio chunks differ too much in size for it.
+      leaky = 0 keeps the backpressure, nothing gets dropped when the queue is full*/
+    g_object_set(queue, "max-size-buffers", 0,
+                        "max-size-bytes", budget->queue_max_bytes,
+                        "max-size-time", (guint64)(budget->queue_max_time_ms * MS_TO_NS),
+                        "leaky", 0, NULL);
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "loudness.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_RATE 48000
+#define TEST_CHANNELS 2
+#define TEST_TRUE_PEAK_DB -1.0
+/*Reference interpolator of the test, much longer than the limiter's*/
+#define TEST_REF_OVERSAMPLING 8
+#define TEST_REF_TAPS 64
+/*What 4x oversampling with LOUDNESS_INTERP_TAPS taps misses of the peaks of a sixth rate
+  tone and of the ringing where it starts*/
+#define TEST_TRUE_PEAK_TOLERANCE_DB 0.2
+
+/*Runs samples through in uneven chunks plus the flush, returns the output*/
+static gfloat *test_run(LoudnessData *loudness, const gfloat *samples, gsize num_frames, gsize *out_frames)
+{
+    const gsize chunks[] = {1, 441, 4096, 17, 1024};
+    gfloat *output = g_new(gfloat, (num_frames + loudness->latency) * TEST_CHANNELS);
+    gsize written = 0;
+
+    memcpy(output, samples, num_frames * TEST_CHANNELS * sizeof(gfloat));
+    for(gsize offset = 0, c = 0; offset < num_frames; c++)
+    {
+        gsize size = MIN(chunks[c % G_N_ELEMENTS(chunks)], num_frames - offset);
+        /*In place like the pipeline, the output lands before the input still to come*/
+        gsize frames = loudness_process(loudness, output + offset * TEST_CHANNELS, size);
+        memmove(output + written * TEST_CHANNELS, output + offset * TEST_CHANNELS, frames * TEST_CHANNELS * sizeof(gfloat));
+        written += frames;
+        offset += size;
+    }
+    written += loudness_flush(loudness, output + written * TEST_CHANNELS);
+    *out_frames = written;
+    return output;
+}
+
+static gfloat *test_noise(gsize num_frames, gfloat amplitude)
+{
+    gfloat *samples = g_new(gfloat, num_frames * TEST_CHANNELS);
+    guint32 state = 21;
+
+    for(gsize i = 0; i < num_frames * TEST_CHANNELS; i++)
+    {
+        samples[i] = amplitude * test_signed_uniform(&state);
+    }
+    return samples;
+}
+
+/*Every input frame comes out, and at the same position*/
+static void test_loudness_latency(void)
+{
+    const gsize num_frames = TEST_RATE * 2;
+    gfloat *samples = test_noise(num_frames, 0.05f);
+    gfloat *output;
+    gsize out_frames;
+    gint best_lag = G_MININT;
+    gdouble best = -1.0;
+    LoudnessData loudness;
+
+    g_assert_cmpint(loudness_init(&loudness, TEST_RATE, TEST_CHANNELS, -23.0, TEST_TRUE_PEAK_DB,
+                                    LOUDNESS_LOOKAHEAD_MS_DEFAULT), ==, 0);
+    output = test_run(&loudness, samples, num_frames, &out_frames);
+    g_assert_cmpuint(out_frames, ==, num_frames);
+    /*Quiet noise is never limited, the output is the input times a slow gain*/
+    for(gint lag = -(gint)loudness.latency; lag <= (gint)loudness.latency; lag++)
+    {
+        gdouble correlation = 0.0;
+        for(gsize i = loudness.latency; i < num_frames - loudness.latency; i++)
+        {
+            correlation += output[i * TEST_CHANNELS] * samples[(i + lag) * TEST_CHANNELS];
+        }
+        if(correlation > best)
+        {
+            best = correlation;
+            best_lag = lag;
+        }
+    }
+    g_assert_cmpint(best_lag, ==, 0);
+    g_assert_cmpfloat(fabsf(output[0] / samples[0] - 1.0f), <, 0.01f);
+    g_assert_cmpfloat(fabsf(output[(num_frames - 1) * TEST_CHANNELS] / samples[(num_frames - 1) * TEST_CHANNELS]), >, 0.5f);
+    loudness_free(&loudness);
+    g_free(samples);
+    g_free(output);
+}
+
+/*A song shorter than the lookahead comes out of the flush alone*/
+static void test_loudness_short(void)
+{
+    const gsize num_frames = 100;
+    gfloat *samples = test_noise(num_frames, 0.05f);
+    gfloat *output;
+    gsize out_frames;
+    LoudnessData loudness;
+
+    g_assert_cmpint(loudness_init(&loudness, TEST_RATE, TEST_CHANNELS, -23.0, TEST_TRUE_PEAK_DB,
+                                    LOUDNESS_LOOKAHEAD_MS_DEFAULT), ==, 0);
+    g_assert_cmpuint(num_frames, <, loudness.latency);
+    output = test_run(&loudness, samples, num_frames, &out_frames);
+    g_assert_cmpuint(out_frames, ==, num_frames);
+    for(gsize i = 0; i < num_frames * TEST_CHANNELS; i++)
+    {
+        g_assert_cmpfloat_with_epsilon(output[i], samples[i], 1e-3);
+    }
+    loudness_free(&loudness);
+    g_free(samples);
+    g_free(output);
+}
+
+/*Highest magnitude between the samples of one channel*/
+static gdouble test_true_peak(const gfloat *samples, gsize num_frames, guint channel)
+{
+    gdouble peak = 0.0;
+
+    for(gsize i = TEST_REF_TAPS; i + TEST_REF_TAPS < num_frames; i++)
+    {
+        for(guint phase = 0; phase < TEST_REF_OVERSAMPLING; phase++)
+        {
+            gdouble position = (gdouble)phase / TEST_REF_OVERSAMPLING;
+            gdouble value = 0.0;
+            for(gint k = -TEST_REF_TAPS / 2 + 1; k <= TEST_REF_TAPS / 2; k++)
+            {
+                gdouble t = position - k;
+                gdouble sinc = fabs(t) < 1e-9 ? 1.0 : sin(G_PI * t) / (G_PI * t);
+                gdouble window = 0.5 + 0.5 * cos(G_PI * t / (TEST_REF_TAPS / 2 + 1));
+                value += samples[(i + k) * TEST_CHANNELS + channel] * sinc * window;
+            }
+            peak = MAX(peak, fabs(value));
+        }
+    }
+    return peak;
+}
+
+/*A sixth rate tone with its peaks halfway between samples, the samples are 1.25 dB under
+  them and under the ceiling. Bursts start abruptly, the gain has to be down before their
+  first sample passes.*/
+static void test_loudness_true_peak(void)
+{
+    const gsize num_frames = TEST_RATE / 2;
+    const gsize burst = TEST_RATE / 20;
+    gfloat *samples = g_new0(gfloat, num_frames * TEST_CHANNELS);
+    gfloat *output;
+    gsize out_frames;
+    gdouble ceiling = pow(10.0, TEST_TRUE_PEAK_DB / 20.0);
+    gdouble sample_peak = 0.0;
+    LoudnessData loudness;
+
+    for(gsize i = 0; i < num_frames; i++)
+    {
+        gfloat value = (i / burst) % 2 == 1 ? (gfloat)sin(G_PI / 3.0 * i + G_PI / 3.0) : 0.0f;
+        samples[i * TEST_CHANNELS] = value;
+        samples[i * TEST_CHANNELS + 1] = value;
+    }
+    g_assert_cmpfloat(test_true_peak(samples, num_frames, 0), >, 0.99);
+    /*No boost or cut, only the limiter acts*/
+    g_assert_cmpint(loudness_init(&loudness, TEST_RATE, TEST_CHANNELS, -23.0, TEST_TRUE_PEAK_DB,
+                                    LOUDNESS_LOOKAHEAD_MS_DEFAULT), ==, 0);
+    loudness.gain_coef = 0.0;
+    output = test_run(&loudness, samples, num_frames, &out_frames);
+    g_assert_cmpuint(out_frames, ==, num_frames);
+    for(gsize i = 0; i < num_frames * TEST_CHANNELS; i++)
+    {
+        sample_peak = MAX(sample_peak, fabsf(output[i]));
+    }
+    g_assert_cmpfloat(sample_peak, >, 0.5 * ceiling);
+    g_test_message("true peak %.3f dBTP, ceiling %.1f", 20.0 * log10(test_true_peak(output, num_frames, 0)), TEST_TRUE_PEAK_DB);
+    g_assert_cmpfloat(test_true_peak(output, num_frames, 0), <=, ceiling * pow(10.0, TEST_TRUE_PEAK_TOLERANCE_DB / 20.0));
+    loudness_free(&loudness);
+    g_free(samples);
+    g_free(output);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/nightcore/loudness/latency", test_loudness_latency);
+    g_test_add_func("/nightcore/loudness/short", test_loudness_short);
+    g_test_add_func("/nightcore/loudness/true_peak", test_loudness_true_peak);
+    return g_test_run();
+}
@@ -0,0 +1,187 @@
+#include "nightcore.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <gst/gst.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_HOURS 3
+/*3 hours of it are 337500 kB, more than the ceiling, so a run holding the whole song fails*/
+#define TEST_RATE 16000
+/*Peak RSS allowed for a whole run. The mapped input doesn't count, its pages are dropped once pushed.*/
+#define TEST_RSS_CEILING_KB (256 * 1024)
+
+G_STATIC_ASSERT((guint64)TEST_HOURS * 3600 * TEST_RATE * 2 / 1024 > TEST_RSS_CEILING_KB);
+
+static gchar *test_directory;
+
+/*Silent 16 bit mono WAV, the samples are a hole in a sparse file so nothing is written*/
+static gchar *test_write_wav(gsize *file_size)
+{
+    gchar *path = g_build_filename(test_directory, "input.wav", NULL);
+    guint32 data_bytes = (guint32)TEST_HOURS * 3600 * TEST_RATE * 2;
+    guchar header[TEST_WAV_HEADER_BYTES];
+    FILE *file;
+
+    test_wav_header(header, TEST_RATE, 1, data_bytes);
+
+    file = fopen(path, "wb");
+    g_assert_nonnull(file);
+    g_assert_cmpuint(fwrite(header, 1, TEST_WAV_HEADER_BYTES, file), ==, TEST_WAV_HEADER_BYTES);
+    g_assert_cmpint(ftruncate(fileno(file), TEST_WAV_HEADER_BYTES + (off_t)data_bytes), ==, 0);
+    fclose(file);
+    *file_size = TEST_WAV_HEADER_BYTES + (gsize)data_bytes;
+    return path;
+}
+
+static gchar *test_write_png(void)
+{
+    gchar *path = g_build_filename(test_directory, "thumbnail.png", NULL);
+    gchar *description = g_strdup_printf("videotestsrc num-buffers=1 ! video/x-raw,width=64,height=64 ! "
+                                        "pngenc ! filesink location=\"%s\"", path);
+    GstElement *pipeline = gst_parse_launch(description, NULL);
+    GstBus *bus;
+    GstMessage *msg;
+
+    g_assert_nonnull(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    bus = gst_element_get_bus(pipeline);
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    g_assert_cmpint(GST_MESSAGE_TYPE(msg), ==, GST_MESSAGE_EOS);
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    g_free(description);
+    return path;
+}
+
+/*Peak resident set of this process in kB*/
+static gsize test_peak_rss_kb(void)
+{
+    gchar *status = NULL;
+    gsize peak = 0;
+
+    g_assert_true(g_file_get_contents("/proc/self/status", &status, NULL, NULL));
+    for(gchar *line = status; line != NULL && *line != '\0'; line = strchr(line, '\n'))
+    {
+        if(*line == '\n')
+        {
+            line++;
+        }
+        if(g_str_has_prefix(line, "VmHWM:"))
+        {
+            peak = g_ascii_strtoull(line + strlen("VmHWM:"), NULL, 10);
+            break;
+        }
+    }
+    g_free(status);
+    g_assert_cmpuint(peak, >, 0);
+    return peak;
+}
+
+static gboolean test_have_elements(const gchar *const *names)
+{
+    for(guint i = 0; names[i] != NULL; i++)
+    {
+        GstElementFactory *factory = gst_element_factory_find(names[i]);
+        if(factory == NULL)
+        {
+            gchar *message = g_strdup_printf("GStreamer element %s is not installed", names[i]);
+            g_test_skip(message);
+            g_free(message);
+            return FALSE;
+        }
+        gst_object_unref(factory);
+    }
+    return TRUE;
+}
+
+static void test_nightcore_init(NightcoreData *nightcore_data)
+{
+    g_assert_cmpint(nightcore_init(nightcore_data, 2.0f, 1.25f, 1.1f, 100, 0.2f, 0.2f), ==, SUCCESS);
+}
+
+/*Every run goes in its own process, so the peak belongs to that pipeline alone*/
+static void test_memory_file(void)
+{
+    const gchar *const elements[] = {"pitch", "equalizer-10bands", "audioecho", "flacenc", NULL};
+    NightcoreData nightcore_data;
+    gchar *input, *output;
+    gsize input_size, peak;
+
+    if(!g_test_subprocess())
+    {
+        if(test_have_elements(elements))
+        {
+            g_test_trap_subprocess(NULL, 0, G_TEST_SUBPROCESS_INHERIT_STDOUT | G_TEST_SUBPROCESS_INHERIT_STDERR);
+            g_test_trap_assert_passed();
+        }
+        return;
+    }
+    input = test_write_wav(&input_size);
+    output = g_build_filename(test_directory, "output.flac", NULL);
+    test_nightcore_init(&nightcore_data);
+    g_assert_cmpint(nightcore_process_file(&nightcore_data, input, output), ==, SUCCESS);
+    peak = test_peak_rss_kb();
+    g_test_message("file: peak rss %" G_GSIZE_FORMAT " kB for %" G_GSIZE_FORMAT " kB of input", peak, input_size / 1024);
+    g_assert_cmpuint(peak, <, TEST_RSS_CEILING_KB);
+    remove(input);
+    remove(output);
+    g_free(input);
+    g_free(output);
+}
+
+static void test_memory_thumbnail(void)
+{
+    const gchar *const elements[] = {"pitch", "equalizer-10bands", "audioecho", "videotestsrc", "pngenc", "pngdec",
+                                     "imagefreeze", "x264enc", "qtmux", NULL};
+    NightcoreData nightcore_data;
+    gchar *input, *thumbnail, *output;
+    gsize input_size, peak;
+
+    if(!g_test_subprocess())
+    {
+        if(test_have_elements(elements))
+        {
+            g_test_trap_subprocess(NULL, 0, G_TEST_SUBPROCESS_INHERIT_STDOUT | G_TEST_SUBPROCESS_INHERIT_STDERR);
+            g_test_trap_assert_passed();
+        }
+        return;
+    }
+    input = test_write_wav(&input_size);
+    thumbnail = test_write_png();
+    output = g_build_filename(test_directory, "output.mov", NULL);
+    test_nightcore_init(&nightcore_data);
+    g_assert_cmpint(nightcore_process_file_to_thumbnail_video(&nightcore_data, input, thumbnail, output), ==, SUCCESS);
+    peak = test_peak_rss_kb();
+    g_test_message("thumbnail: peak rss %" G_GSIZE_FORMAT " kB for %" G_GSIZE_FORMAT " kB of input", peak, input_size / 1024);
+    g_assert_cmpuint(peak, <, TEST_RSS_CEILING_KB);
+    remove(input);
+    remove(thumbnail);
+    remove(output);
+    g_free(input);
+    g_free(thumbnail);
+    g_free(output);
+}
+
+int main(int argc, char *argv[])
+{
+    int ret;
+
+    gst_init(&argc, &argv);
+    g_test_init(&argc, &argv, NULL);
+    /*Subprocesses are started with the same arguments, so they find the same directory*/
+    test_directory = g_build_filename(g_get_tmp_dir(), "test_nightcore_memory", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(test_directory, 0700), ==, 0);
+    g_test_add_func("/nightcore/memory/file", test_memory_file);
+    g_test_add_func("/nightcore/memory/thumbnail", test_memory_thumbnail);
+    ret = g_test_run();
+    if(!g_test_subprocess())
+    {
+        rmdir(test_directory);
+    }
+    g_free(test_directory);
+    return ret;
+}
@@ -0,0 +1,255 @@
+#include "nightcore.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <math.h>
+
+#define TEST_RATE 44100
+#define TEST_CHANNELS 2
+#define TEST_SECONDS 8
+/*About 4 s for the whole download, far slower than decoding it*/
+#define TEST_CHUNK_BYTES (32 * 1024)
+#define TEST_CHUNK_DELAY_US (100 * 1000)
+#define TEST_REQUEST_MAX 4096
+#define TEST_POLL_US (10 * 1000)
+
+/*Serves one WAV over HTTP, throttled to TEST_CHUNK_BYTES every TEST_CHUNK_DELAY_US*/
+typedef struct _TestServer
+{
+    GSocketService *service;
+    GMainContext *context;      /*accepts connections, the pipeline runs in the main thread*/
+    GMainLoop *loop;
+    GThread *thread;
+    guint16 port;
+    guchar *wav;
+    gsize wav_size;
+    GMutex lock;
+    gint64 finished;            /*monotonic time the last byte went out, 0 before*/
+}TestServer;
+
+/*Polls the size of the output file while the pipeline runs*/
+typedef struct _TestWatch
+{
+    const gchar *path;
+    gint stop;
+    gint64 first_output;        /*monotonic time the file first had data, 0 before*/
+}TestWatch;
+
+static gchar *test_directory;
+
+static void test_server_wav(TestServer *server)
+{
+    guint32 data_bytes = TEST_RATE * TEST_SECONDS * TEST_CHANNELS * 2;
+
+    server->wav_size = TEST_WAV_HEADER_BYTES + data_bytes;
+    server->wav = g_malloc(server->wav_size);
+    test_wav_header(server->wav, TEST_RATE, TEST_CHANNELS, data_bytes);
+    for(guint32 i = 0; i < TEST_RATE * TEST_SECONDS; i++)
+    {
+        gint16 sample = (gint16)(8000.0 * sin(2.0 * G_PI * 440.0 * i / TEST_RATE));
+        for(guint c = 0; c < TEST_CHANNELS; c++)
+        {
+            test_put_le(server->wav + TEST_WAV_HEADER_BYTES + (i * TEST_CHANNELS + c) * 2, (guint16)sample, 2);
+        }
+    }
+}
+
+static gboolean test_server_run(GThreadedSocketService *service, GSocketConnection *connection,
+                                GObject *source_object, gpointer user_data)
+{
+    TestServer *server = user_data;
+    GInputStream *input = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+    GOutputStream *output = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+    gchar request[TEST_REQUEST_MAX + 1];
+    gsize received = 0;
+    gchar *header;
+    gsize sent = 0;
+
+    /*The request itself doesn't matter, there is only one file*/
+    while(received < TEST_REQUEST_MAX)
+    {
+        gssize length = g_input_stream_read(input, request + received, TEST_REQUEST_MAX - received, NULL, NULL);
+        if(length <= 0)
+        {
+            return TRUE;
+        }
+        received += length;
+        request[received] = '\0';
+        if(strstr(request, "\r\n\r\n") != NULL)
+        {
+            break;
+        }
+    }
+    /*Without ranges the source can't seek, so the file is read front to back*/
+    header = g_strdup_printf("HTTP/1.1 200 OK\r\nContent-Type: audio/x-wav\r\nContent-Length: %" G_GSIZE_FORMAT
+                            "\r\nAccept-Ranges: none\r\nConnection: close\r\n\r\n", server->wav_size);
+    if(g_output_stream_write_all(output, header, strlen(header), NULL, NULL, NULL))
+    {
+        while(sent < server->wav_size)
+        {
+            gsize chunk = MIN(TEST_CHUNK_BYTES, server->wav_size - sent);
+            if(!g_output_stream_write_all(output, server->wav + sent, chunk, NULL, NULL, NULL))
+            {
+                break;
+            }
+            sent += chunk;
+            if(sent == server->wav_size)
+            {
+                g_mutex_lock(&server->lock);
+                server->finished = g_get_monotonic_time();
+                g_mutex_unlock(&server->lock);
+                break;
+            }
+            g_usleep(TEST_CHUNK_DELAY_US);
+        }
+    }
+    g_free(header);
+    return TRUE;
+}
+
+static gpointer test_server_loop(gpointer data)
+{
+    g_main_loop_run(data);
+    return NULL;
+}
+
+static void test_server_start(TestServer *server)
+{
+    GInetAddress *loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress *address = g_inet_socket_address_new(loopback, 0);
+    GSocketAddress *effective = NULL;
+    GError *error = NULL;
+
+    memset(server, 0, sizeof(TestServer));
+    g_mutex_init(&server->lock);
+    test_server_wav(server);
+    server->context = g_main_context_new();
+    /*The service waits for connections on the context current when it starts listening*/
+    g_main_context_push_thread_default(server->context);
+    server->service = g_threaded_socket_service_new(4);
+    g_socket_listener_add_address(G_SOCKET_LISTENER(server->service), address, G_SOCKET_TYPE_STREAM,
+                                    G_SOCKET_PROTOCOL_TCP, NULL, &effective, &error);
+    g_assert_no_error(error);
+    server->port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(effective));
+    g_signal_connect(server->service, "run", G_CALLBACK(test_server_run), server);
+    g_socket_service_start(server->service);
+    g_main_context_pop_thread_default(server->context);
+    server->loop = g_main_loop_new(server->context, FALSE);
+    server->thread = g_thread_new("server", test_server_loop, server->loop);
+    g_object_unref(effective);
+    g_object_unref(address);
+    g_object_unref(loopback);
+}
+
+static void test_server_stop(TestServer *server)
+{
+    g_socket_service_stop(server->service);
+    g_socket_listener_close(G_SOCKET_LISTENER(server->service));
+    g_main_loop_quit(server->loop);
+    g_thread_join(server->thread);
+    g_main_loop_unref(server->loop);
+    g_main_context_unref(server->context);
+    g_object_unref(server->service);
+    g_mutex_clear(&server->lock);
+    g_free(server->wav);
+}
+
+static gpointer test_watch_output(gpointer data)
+{
+    TestWatch *watch = data;
+    struct stat status;
+
+    while(!g_atomic_int_get(&watch->stop))
+    {
+        if(watch->first_output == 0 && stat(watch->path, &status) == 0 && status.st_size > 0)
+        {
+            watch->first_output = g_get_monotonic_time();
+        }
+        g_usleep(TEST_POLL_US);
+    }
+    return NULL;
+}
+
+static gboolean test_have_elements(const gchar *const *names)
+{
+    for(guint i = 0; names[i] != NULL; i++)
+    {
+        GstElementFactory *factory = gst_element_factory_find(names[i]);
+        if(factory == NULL)
+        {
+            gchar *message = g_strdup_printf("GStreamer element %s is not installed", names[i]);
+            g_test_skip(message);
+            g_free(message);
+            return FALSE;
+        }
+        gst_object_unref(factory);
+    }
+    return TRUE;
+}
+
+/*Decoding starts on the first bytes, the output grows while the song is still downloading*/
+static void test_url_progressive(void)
+{
+    const gchar *const elements[] = {"uridecodebin", "souphttpsrc", "wavparse", "audioconvert", "audioresample",
+                                     "capsfilter", "pitch", "equalizer-10bands", "audioecho", "wavenc", "filesink", NULL};
+    NightcoreData nightcore_data;
+    NightcoreErrorCodes status;
+    TestServer server;
+    TestWatch watch;
+    GThread *watcher;
+    gchar *url, *output;
+    gint64 start;
+
+    if(!test_have_elements(elements))
+    {
+        return;
+    }
+    test_server_start(&server);
+    url = g_strdup_printf("http://127.0.0.1:%u/input.wav", server.port);
+    output = g_build_filename(test_directory, "output.wav", NULL);
+    remove(output);
+    g_assert_cmpint(nightcore_init(&nightcore_data, 2.0f, 1.25f, 1.1f, 100, 0.2f, 0.2f), ==, SUCCESS);
+
+    memset(&watch, 0, sizeof(TestWatch));
+    watch.path = output;
+    watcher = g_thread_new("watch", test_watch_output, &watch);
+    start = g_get_monotonic_time();
+    status = nightcore_process_url(&nightcore_data, url, output);
+    g_atomic_int_set(&watch.stop, 1);
+    g_thread_join(watcher);
+
+    g_assert_cmpint(status, ==, SUCCESS);
+    g_mutex_lock(&server.lock);
+    g_test_message("first output after %.3f s, download done after %.3f s, run %.3f s",
+                    (watch.first_output - start) / 1e6, (server.finished - start) / 1e6,
+                    (g_get_monotonic_time() - start) / 1e6);
+    g_assert_cmpint(server.finished, >, 0);
+    g_assert_cmpint(watch.first_output, >, 0);
+    g_assert_cmpint(watch.first_output, <, server.finished);
+    g_mutex_unlock(&server.lock);
+
+    test_server_stop(&server);
+    remove(output);
+    g_free(output);
+    g_free(url);
+}
+
+int main(int argc, char *argv[])
+{
+    int ret;
+
+    gst_init(&argc, &argv);
+    g_test_init(&argc, &argv, NULL);
+    test_directory = g_dir_make_tmp("test_nightcore_url_XXXXXX", NULL);
+    g_assert_nonnull(test_directory);
+    g_test_add_func("/nightcore/url/progressive", test_url_progressive);
+    ret = g_test_run();
+    rmdir(test_directory);
+    g_free(test_directory);
+    return ret;
+}
@@ -0,0 +1,91 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <glib-2.0/glib.h>
+
+/*Every allocation starts on a cache line, enough for AVX-512 loads*/
+#define ARENA_ALIGN 64
+#define ARENA_DEFAULT_BLOCK_SIZE (256 * 1024)
+/*Slots a pool takes from the system at once*/
+#define POOL_DEFAULT_SLOTS 256
+
+typedef struct _ArenaBlock ArenaBlock;
+
+/*How much work the allocator saved. Allocations minus mallocs is the number of
+  system allocations avoided.*/
+typedef struct _ArenaStats
+{
+    guint64 allocations;    /*requests served*/
+    guint64 mallocs;        /*requests that needed memory from the system*/
+    gsize capacity;         /*bytes held from the system*/
+    gsize in_use;
+    gsize peak;             /*most bytes in use at once*/
+}ArenaStats;
+
+/*Bump allocator over a chain of blocks. Nothing is freed on its own, arena_reset
+  releases everything at once and keeps the blocks for the next job.
+  Arenas and pools don't lock, each job or thread uses its own.*/
+typedef struct _Arena
+{
+    ArenaBlock *blocks;     /*block in use first*/
+    ArenaBlock *spare;      /*blocks kept by reset or release*/
+    gsize block_size;
+    ArenaStats stats;
+}Arena;
+
+/*Position to release back to, for scratch memory with stack lifetime*/
+typedef struct _ArenaMark
+{
+    ArenaBlock *block;
+    gsize used;
+}ArenaMark;
+
+/*Fixed size slots with a free list, for objects released one by one*/
+typedef struct _Pool
+{
+    gsize slot_size;
+    guint slots_per_block;
+    gpointer free_slots;    /*singly linked through the slots*/
+    GSList *blocks;
+    ArenaStats stats;
+}Pool;
+
+/*block_size 0 uses ARENA_DEFAULT_BLOCK_SIZE*/
+void arena_init(Arena *arena, gsize block_size);
+
+/*Aligned to ARENA_ALIGN. Returns NULL when size is 0 or the system is out of memory.*/
+gpointer arena_alloc(Arena *arena, gsize size);
+
+gpointer arena_alloc0(Arena *arena, gsize size);
+
+#define arena_new(arena, type, count) ((type *)arena_alloc((arena), sizeof(type) * (count)))
+#define arena_new0(arena, type, count) ((type *)arena_alloc0((arena), sizeof(type) * (count)))
+
+ArenaMark arena_mark(Arena *arena);
+
+/*Releases everything allocated after mark, the blocks are kept*/
+void arena_release(Arena *arena, ArenaMark mark);
+
+/*Releases every allocation without giving memory back*/
+void arena_reset(Arena *arena);
+
+/*Gives all blocks back to the system, counters are kept*/
+void arena_free(Arena *arena);
+
+/*Arena of the calling thread for temporaries. Callers take a mark on entry and
+  release it before returning, so the blocks live as long as the thread.*/
+Arena *arena_scratch(void);
+
+/*slots_per_block 0 uses POOL_DEFAULT_SLOTS*/
+void pool_init(Pool *pool, gsize slot_size, guint slots_per_block);
+
+gpointer pool_alloc(Pool *pool);
+
+void pool_release(Pool *pool, gpointer slot);
+
+/*Every slot becomes free, blocks are kept*/
+void pool_reset(Pool *pool);
+
+void pool_free(Pool *pool);
+
+#endif
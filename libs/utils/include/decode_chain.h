@@ -0,0 +1,22 @@
+#ifndef _DECODE_CHAIN_H_
+#define _DECODE_CHAIN_H_
+
+#include <gst/gst.h>
+#include <glib-2.0/glib.h>
+#include "media_probe.h"
+
+/*Tag demuxer, parser and decoder at most*/
+#define DECODE_CHAIN_MAX_ELEMENTS 3
+
+/*Builds the parser and decoder chain for a probed format between source and sink,
+  both have to be in bin already. This skips the typefinding and factory ranking decodebin
+  does for every file. Demuxers link their first audio pad once it shows up, WAV, MP4 and Matroska
+  pick the decoder from the caps of that pad when it isn't raw audio already.
+  Returns FALSE with bin untouched when the format has no direct chain or a plugin is missing,
+  the caller falls back to decodebin then.*/
+gboolean decode_chain_link(GstBin *bin, GstElement *source, GstElement *sink, const MediaProbe *probe);
+
+/*Probes path and builds its direct chain*/
+gboolean decode_chain_link_file(GstBin *bin, GstElement *source, GstElement *sink, const gchar *path);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _MAPPED_SOURCE_H_
+#define _MAPPED_SOURCE_H_
+
+#include <gst/gst.h>
+#include <glib-2.0/glib.h>
+
+/*Bytes pushed per buffer, rounded down to whole frames*/
+#define MAPPED_SOURCE_CHUNK_BYTES (64 * 1024)
+/*Positioned layouts above stereo would need the channel mask*/
+#define MAPPED_SOURCE_MAX_CHANNELS 2
+
+/*appsrc pushing the samples of a memory mapped WAV file as raw audio. Every buffer wraps
+  a slice of the mapping and holds a reference to it, nothing is read or copied up front
+  and pages that were played can be dropped by the kernel. Seeking is supported and no
+  parser is needed behind the source.
+  Returns NULL when the file can't be mapped or isn't integer or float PCM,
+  filesrc with a parser has to be used then.*/
+GstElement *mapped_source_new(const gchar *path);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _MEDIA_PROBE_H_
+#define _MEDIA_PROBE_H_
+
+#include <glib-2.0/glib.h>
+
+/*Bytes read from the start of the file, tags in front of the audio are skipped*/
+#define MEDIA_PROBE_HEAD_BYTES 4096
+/*Bytes read from the end of Ogg files for the last granule position*/
+#define MEDIA_PROBE_TAIL_BYTES 65536
+/*Top level MP4 atoms walked looking for moov*/
+#define MEDIA_PROBE_MAX_ATOMS 64
+
+typedef enum _MediaContainer
+{
+    MEDIA_CONTAINER_UNKNOWN = 0,
+    MEDIA_CONTAINER_MP3 = 1,
+    MEDIA_CONTAINER_FLAC = 2,
+    MEDIA_CONTAINER_WAV = 3,
+    MEDIA_CONTAINER_OGG = 4,
+    MEDIA_CONTAINER_MP4 = 5,
+    MEDIA_CONTAINER_MATROSKA = 6,
+    MEDIA_CONTAINER_NUM = 7
+}MediaContainer;
+
+typedef enum _MediaCodec
+{
+    MEDIA_CODEC_UNKNOWN = 0,
+    MEDIA_CODEC_MP3 = 1,
+    MEDIA_CODEC_FLAC = 2,
+    MEDIA_CODEC_PCM = 3,
+    MEDIA_CODEC_VORBIS = 4,
+    MEDIA_CODEC_OPUS = 5
+}MediaCodec;
+
+/*Everything the headers tell without decoding, unknown values are 0*/
+typedef struct _MediaProbe
+{
+    MediaContainer container;
+    MediaCodec codec;
+    guint rate;
+    guint channels;
+    guint bits;                 /*PCM and FLAC only*/
+    guint bitrate;              /*bits per second*/
+    gdouble duration;           /*seconds*/
+    guint64 offset;             /*bytes of ID3v2 tags in front of the stream*/
+    guint64 size;
+    gint64 mtime;
+}MediaProbe;
+
+/*Sniffs the container by magic bytes and reads format and duration from the headers.
+  Results are cached per path and reused while size and modification time match.
+  Returns 0 on success, -1 for NULL arguments, -2 when the file can't be read
+  and -3 when it is not a supported media file or its header is broken.*/
+int media_probe_file(const gchar *path, MediaProbe *probe);
+
+/*TRUE for containers that only carry audio*/
+gboolean media_probe_is_audio(const MediaProbe *probe);
+
+const gchar *media_probe_container_name(MediaContainer container);
+
+void media_probe_cache_clear(void);
+
+#endif
@@ -8,6 +8,13 @@
 #define VIDEO_EXTENSIONS_NUM 2
 #define INPUT_EXTENSIONS_NUM 6
 
+/*Hot loops marked with it are compiled for several instruction sets, picked at load time*/
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+    #define UTILS_TARGET_CLONES __attribute__((target_clones("avx2", "sse4.2", "default")))
+#else
+    #define UTILS_TARGET_CLONES
+#endif
+
 typedef enum _AudioExt
 {
     MP3,
@@ -44,16 +51,31 @@ typedef enum _InputExt
 
 int utils_file_valid_path(const char *file_name);
 
+/*Sort, select and statistics kernels, see utils_sort.c.
+  Sorting is introsort, large arrays go through a radix sort.
+  select, mediana and percentile run in O(n) and reorder the array.*/
 float utils_float_mean(float array[], unsigned int n);
 
+float utils_float_variance(float array[], unsigned int n);
+
 float utils_float_mediana(float array[], unsigned int n);
 
+/*k-th smallest element, 0 based*/
+float utils_float_select(float array[], unsigned int n, unsigned int k);
+
+/*percentile in 0 - 100, interpolated between the closest ranks*/
+float utils_float_percentile(float array[], unsigned int n, float percentile);
+
 void utils_float_sort(float array[], unsigned int n);
 
 int utils_int_mean(int array[], unsigned int n);
 
+float utils_int_variance(int array[], unsigned int n);
+
 int utils_int_mediana(int array[], unsigned int n);
 
+int utils_int_select(int array[], unsigned int n, unsigned int k);
+
 void utils_int_sort(int array[], unsigned int n);
 
 AudioExt utils_get_audio_extension(const char *file_name);
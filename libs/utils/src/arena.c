@@ -0,0 +1,242 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(gsize)(ARENA_ALIGN - 1))
+/*Pool slots hold the free list link and keep malloc alignment*/
+#define POOL_SLOT_ALIGN (2 * sizeof(gpointer))
+
+struct _ArenaBlock
+{
+    ArenaBlock *next;
+    gsize size;             /*usable bytes*/
+    gsize used;
+};
+
+/*Data starts after the header, on the next aligned address*/
+#define ARENA_HEADER ARENA_ROUND(sizeof(ArenaBlock))
+
+static void arena_scratch_destroy(gpointer data);
+
+static GPrivate scratch_arena = G_PRIVATE_INIT(arena_scratch_destroy);
+
+static void stats_allocated(ArenaStats *stats, gsize size)
+{
+    stats->allocations++;
+    stats->in_use += size;
+    stats->peak = MAX(stats->peak, stats->in_use);
+}
+
+void arena_init(Arena *arena, gsize block_size)
+{
+    memset(arena, 0, sizeof(Arena));
+    arena->block_size = ARENA_ROUND(block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE);
+}
+
+/*Makes a block with at least size free bytes the current one, spare blocks first*/
+static ArenaBlock *arena_take_block(Arena *arena, gsize size)
+{
+    ArenaBlock **link = &arena->spare;
+    ArenaBlock *block;
+    void *memory;
+
+    while(*link != NULL && (*link)->size < size)
+    {
+        link = &(*link)->next;
+    }
+    block = *link;
+    if(block != NULL)
+    {
+        *link = block->next;
+    }
+    else
+    {
+        /*Oversized requests get a block of their own*/
+        gsize block_size = MAX(arena->block_size, size);
+        if(posix_memalign(&memory, ARENA_ALIGN, ARENA_HEADER + block_size) != 0)
+        {
+            return NULL;
+        }
+        block = memory;
+        block->size = block_size;
+        arena->stats.mallocs++;
+        arena->stats.capacity += block_size;
+    }
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+gpointer arena_alloc(Arena *arena, gsize size)
+{
+    ArenaBlock *block;
+    gpointer memory;
+
+    if(arena == NULL || size == 0)
+    {
+        return NULL;
+    }
+    size = ARENA_ROUND(size);
+    block = arena->blocks;
+    if(block == NULL || block->used + size > block->size)
+    {
+        block = arena_take_block(arena, size);
+        if(block == NULL)
+        {
+            return NULL;
+        }
+    }
+    memory = (guchar *)block + ARENA_HEADER + block->used;
+    block->used += size;
+    stats_allocated(&arena->stats, size);
+    return memory;
+}
+
+gpointer arena_alloc0(Arena *arena, gsize size)
+{
+    gpointer memory = arena_alloc(arena, size);
+    if(memory != NULL)
+    {
+        memset(memory, 0, size);
+    }
+    return memory;
+}
+
+ArenaMark arena_mark(Arena *arena)
+{
+    ArenaMark mark = {arena->blocks, arena->blocks != NULL ? arena->blocks->used : 0};
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark)
+{
+    /*Blocks started after the mark go back to the spare list*/
+    while(arena->blocks != NULL && arena->blocks != mark.block)
+    {
+        ArenaBlock *block = arena->blocks;
+        arena->blocks = block->next;
+        arena->stats.in_use -= block->used;
+        block->used = 0;
+        block->next = arena->spare;
+        arena->spare = block;
+    }
+    if(arena->blocks != NULL && arena->blocks->used > mark.used)
+    {
+        arena->stats.in_use -= arena->blocks->used - mark.used;
+        arena->blocks->used = mark.used;
+    }
+}
+
+void arena_reset(Arena *arena)
+{
+    ArenaMark start = {NULL, 0};
+    arena_release(arena, start);
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *lists[2] = {arena->blocks, arena->spare};
+    for(guint i = 0; i < 2; i++)
+    {
+        while(lists[i] != NULL)
+        {
+            ArenaBlock *next = lists[i]->next;
+            free(lists[i]);
+            lists[i] = next;
+        }
+    }
+    arena->blocks = NULL;
+    arena->spare = NULL;
+    arena->stats.capacity = 0;
+    arena->stats.in_use = 0;
+}
+
+static void arena_scratch_destroy(gpointer data)
+{
+    arena_free((Arena *)data);
+    g_free(data);
+}
+
+Arena *arena_scratch(void)
+{
+    Arena *arena = g_private_get(&scratch_arena);
+    if(arena == NULL)
+    {
+        arena = g_new(Arena, 1);
+        arena_init(arena, 0);
+        g_private_set(&scratch_arena, arena);
+    }
+    return arena;
+}
+
+void pool_init(Pool *pool, gsize slot_size, guint slots_per_block)
+{
+    memset(pool, 0, sizeof(Pool));
+    slot_size = MAX(slot_size, sizeof(gpointer));
+    pool->slot_size = (slot_size + POOL_SLOT_ALIGN - 1) & ~(POOL_SLOT_ALIGN - 1);
+    pool->slots_per_block = slots_per_block > 0 ? slots_per_block : POOL_DEFAULT_SLOTS;
+}
+
+/*Threads the slots of block onto the free list*/
+static void pool_link_block(Pool *pool, guchar *block)
+{
+    for(guint i = pool->slots_per_block; i > 0; i--)
+    {
+        gpointer slot = block + (gsize)(i - 1) * pool->slot_size;
+        *(gpointer *)slot = pool->free_slots;
+        pool->free_slots = slot;
+    }
+}
+
+gpointer pool_alloc(Pool *pool)
+{
+    gpointer slot;
+
+    if(pool == NULL)
+    {
+        return NULL;
+    }
+    if(pool->free_slots == NULL)
+    {
+        guchar *block = g_malloc(pool->slot_size * pool->slots_per_block);
+        pool->blocks = g_slist_prepend(pool->blocks, block);
+        pool->stats.mallocs++;
+        pool->stats.capacity += pool->slot_size * pool->slots_per_block;
+        pool_link_block(pool, block);
+    }
+    slot = pool->free_slots;
+    pool->free_slots = *(gpointer *)slot;
+    stats_allocated(&pool->stats, pool->slot_size);
+    return slot;
+}
+
+void pool_release(Pool *pool, gpointer slot)
+{
+    if(pool == NULL || slot == NULL)
+    {
+        return;
+    }
+    *(gpointer *)slot = pool->free_slots;
+    pool->free_slots = slot;
+    pool->stats.in_use -= pool->slot_size;
+}
+
+void pool_reset(Pool *pool)
+{
+    pool->free_slots = NULL;
+    for(GSList *block = pool->blocks; block != NULL; block = block->next)
+    {
+        pool_link_block(pool, block->data);
+    }
+    pool->stats.in_use = 0;
+}
+
+void pool_free(Pool *pool)
+{
+    g_slist_free_full(pool->blocks, g_free);
+    pool->blocks = NULL;
+    pool->free_slots = NULL;
+    pool->stats.capacity = 0;
+    pool->stats.in_use = 0;
+}
@@ -0,0 +1,248 @@
+#include "decode_chain.h"
+
+static void decode_chain_pad_added(GstElement *src, GstPad *new_pad, GstElement *next);
+
+static void decode_chain_autoplug_pad_added(GstElement *src, GstPad *new_pad, GstElement *sink);
+
+/*Decoder of every codec, indexed by MediaCodec. PCM needs none.*/
+static const gchar *codec_decoders[] = {NULL, "mpg123audiodec", "flacdec", NULL, "vorbisdec", "opusdec"};
+
+/*Fills names with the elements for the probed format. Returns how many, 0 when there is no direct chain.*/
+static guint decode_chain_names(const MediaProbe *probe, const gchar **names)
+{
+    const gchar *decoder = (guint)probe->codec < G_N_ELEMENTS(codec_decoders) ? codec_decoders[probe->codec] : NULL;
+    guint num = 0;
+
+    switch(probe->container)
+    {
+        case MEDIA_CONTAINER_WAV:
+            names[num++] = "wavparse";
+            break;
+        case MEDIA_CONTAINER_MP3:
+        case MEDIA_CONTAINER_FLAC:
+            if(decoder == NULL)
+            {
+                return 0;
+            }
+            /*Parsers would only resync behind the tag*/
+            if(probe->offset > 0)
+            {
+                names[num++] = "id3demux";
+            }
+            names[num++] = probe->container == MEDIA_CONTAINER_MP3 ? "mpegaudioparse" : "flacparse";
+            names[num++] = decoder;
+            break;
+        case MEDIA_CONTAINER_OGG:
+            if(decoder == NULL)
+            {
+                return 0;
+            }
+            names[num++] = "oggdemux";
+            names[num++] = decoder;
+            break;
+        /*The probe doesn't read the codec of these, it is taken from the demuxer pad*/
+        case MEDIA_CONTAINER_MP4:
+            names[num++] = "qtdemux";
+            break;
+        case MEDIA_CONTAINER_MATROSKA:
+            names[num++] = "matroskademux";
+            break;
+        default:
+            break;
+    }
+    return num;
+}
+
+gboolean decode_chain_link(GstBin *bin, GstElement *source, GstElement *sink, const MediaProbe *probe)
+{
+    const gchar *names[DECODE_CHAIN_MAX_ELEMENTS];
+    GstElement *elements[DECODE_CHAIN_MAX_ELEMENTS];
+    GstElement *previous;
+    gboolean autoplug;
+    gboolean linked = TRUE;
+    guint num;
+
+    if(bin == NULL || source == NULL || sink == NULL || probe == NULL)
+    {
+        return FALSE;
+    }
+    num = decode_chain_names(probe, names);
+    if(num == 0)
+    {
+        return FALSE;
+    }
+    /*WAV is usually PCM, but the header may name any codec*/
+    autoplug = probe->container == MEDIA_CONTAINER_WAV || probe->container == MEDIA_CONTAINER_MP4 ||
+                probe->container == MEDIA_CONTAINER_MATROSKA;
+    for(guint i = 0; i < num; i++)
+    {
+        elements[i] = gst_element_factory_make(names[i], NULL);
+        if(elements[i] == NULL)
+        {
+            for(guint j = 0; j < i; j++)
+            {
+                gst_object_unref(gst_object_ref_sink(elements[j]));
+            }
+            return FALSE;
+        }
+    }
+    for(guint i = 0; i < num; i++)
+    {
+        gst_bin_add(bin, elements[i]);
+    }
+    /*Always pads are linked now, sometimes pads of parsers and demuxers when they appear*/
+    previous = source;
+    for(guint i = 0; i <= num && linked; i++)
+    {
+        GstElement *next = i < num ? elements[i] : sink;
+        GstPad *src_pad = gst_element_get_static_pad(previous, "src");
+        if(src_pad != NULL)
+        {
+            linked = gst_element_link(previous, next);
+            gst_object_unref(src_pad);
+        }
+        else if(autoplug && i == num)
+        {
+            g_signal_connect(previous, "pad-added", G_CALLBACK(decode_chain_autoplug_pad_added), next);
+        }
+        else
+        {
+            g_signal_connect(previous, "pad-added", G_CALLBACK(decode_chain_pad_added), next);
+        }
+        previous = next;
+    }
+    if(!linked)
+    {
+        /*Removing unlinks and releases them*/
+        for(guint i = 0; i < num; i++)
+        {
+            gst_bin_remove(bin, elements[i]);
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean decode_chain_link_file(GstBin *bin, GstElement *source, GstElement *sink, const gchar *path)
+{
+    MediaProbe probe;
+
+    if(media_probe_file(path, &probe) != 0)
+    {
+        return FALSE;
+    }
+    return decode_chain_link(bin, source, sink, &probe);
+}
+
+/*Returns the caps type of the pad when it carries audio, NULL otherwise. caps has to be unreffed.*/
+static const gchar *decode_chain_audio_type(GstPad *pad, GstCaps **caps)
+{
+    const gchar *type;
+
+    *caps = gst_pad_get_current_caps(pad);
+    if(*caps == NULL)
+    {
+        *caps = gst_pad_query_caps(pad, NULL);
+    }
+    if(*caps == NULL || gst_caps_is_empty(*caps) || gst_caps_is_any(*caps))
+    {
+        return NULL;
+    }
+    type = gst_structure_get_name(gst_caps_get_structure(*caps, 0));
+    return g_str_has_prefix(type, "audio/") ? type : NULL;
+}
+
+static void decode_chain_pad_added(GstElement *src, GstPad *new_pad, GstElement *next)
+{
+    GstPad *sink_pad = gst_element_get_static_pad(next, "sink");
+    GstCaps *caps = NULL;
+    const gchar *type;
+
+    /*Demuxers expose every stream, the first audio one is decoded*/
+    if(gst_pad_is_linked(sink_pad) || (type = decode_chain_audio_type(new_pad, &caps)) == NULL)
+    {
+        goto exit;
+    }
+    if(GST_PAD_LINK_FAILED(gst_pad_link(new_pad, sink_pad)))
+    {
+        g_printerr("ERROR: Cant link '%s' from %s.\n", type, GST_ELEMENT_NAME(src));
+    }
+
+exit:
+    if(caps != NULL)
+    {
+        gst_caps_unref(caps);
+    }
+    gst_object_unref(sink_pad);
+}
+
+/*Highest ranked audio decoder accepting caps, NULL when none is installed*/
+static GstElement *decode_chain_make_decoder(GstCaps *caps)
+{
+    GList *factories = gst_element_factory_list_get_elements(GST_ELEMENT_FACTORY_TYPE_DECODER |
+                                                            GST_ELEMENT_FACTORY_TYPE_MEDIA_AUDIO, GST_RANK_MARGINAL);
+    GList *usable = gst_element_factory_list_filter(factories, caps, GST_PAD_SINK, FALSE);
+    GstElement *decoder = NULL;
+
+    usable = g_list_sort(usable, gst_plugin_feature_rank_compare_func);
+    if(usable != NULL)
+    {
+        decoder = gst_element_factory_create(GST_ELEMENT_FACTORY(usable->data), NULL);
+    }
+    gst_plugin_feature_list_free(usable);
+    gst_plugin_feature_list_free(factories);
+    return decoder;
+}
+
+static void decode_chain_autoplug_pad_added(GstElement *src, GstPad *new_pad, GstElement *sink)
+{
+    GstPad *sink_pad = gst_element_get_static_pad(sink, "sink");
+    GstObject *bin = NULL;
+    GstElement *decoder;
+    GstCaps *caps = NULL;
+    GstPad *decoder_pad;
+    const gchar *type;
+
+    if(gst_pad_is_linked(sink_pad) || (type = decode_chain_audio_type(new_pad, &caps)) == NULL)
+    {
+        goto exit;
+    }
+    if(g_str_has_prefix(type, "audio/x-raw"))
+    {
+        if(GST_PAD_LINK_FAILED(gst_pad_link(new_pad, sink_pad)))
+        {
+            g_printerr("ERROR: Cant link '%s' from %s.\n", type, GST_ELEMENT_NAME(src));
+        }
+        goto exit;
+    }
+    bin = gst_object_get_parent(GST_OBJECT(src));
+    decoder = decode_chain_make_decoder(caps);
+    if(bin == NULL || decoder == NULL)
+    {
+        g_printerr("ERROR: No decoder for '%s' from %s.\n", type, GST_ELEMENT_NAME(src));
+        if(decoder != NULL)
+        {
+            gst_object_unref(gst_object_ref_sink(decoder));
+        }
+        goto exit;
+    }
+    gst_bin_add(GST_BIN(bin), decoder);
+    decoder_pad = gst_element_get_static_pad(decoder, "sink");
+    if(GST_PAD_LINK_FAILED(gst_pad_link(new_pad, decoder_pad)) || !gst_element_link(decoder, sink))
+    {
+        g_printerr("ERROR: Cant link '%s' from %s.\n", type, GST_ELEMENT_NAME(src));
+    }
+    gst_object_unref(decoder_pad);
+    gst_element_sync_state_with_parent(decoder);
+
+exit:
+    if(bin != NULL)
+    {
+        gst_object_unref(bin);
+    }
+    if(caps != NULL)
+    {
+        gst_caps_unref(caps);
+    }
+    gst_object_unref(sink_pad);
+}
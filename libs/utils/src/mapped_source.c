@@ -0,0 +1,240 @@
+#include "mapped_source.h"
+#include <gst/app/gstappsrc.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xfffe
+
+typedef struct _MappedSource
+{
+    GMappedFile *file;
+    const gchar *data;          /*first sample*/
+    gsize size;                 /*bytes of whole frames*/
+    gsize position;             /*next byte to push*/
+    guint frame_bytes;
+    guint rate;
+}MappedSource;
+
+/*Mapped bytes one buffer wraps, dropped from memory once the buffer is gone*/
+typedef struct _MappedChunk
+{
+    GMappedFile *file;
+    const gchar *data;
+    gsize size;
+}MappedChunk;
+
+/*Layout of the PCM in a WAV file, filled by mapped_source_parse*/
+typedef struct _MappedWav
+{
+    const gchar *format;
+    guint rate;
+    guint channels;
+    guint frame_bytes;
+    gsize data_offset;
+    gsize data_size;
+}MappedWav;
+
+static guint32 read_le16(const guchar *data)
+{
+    return data[0] | data[1] << 8;
+}
+
+static guint32 read_le32(const guchar *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (guint32)data[3] << 24;
+}
+
+static const gchar *wav_sample_format(guint format, guint bits)
+{
+    if(format == WAV_FORMAT_PCM)
+    {
+        switch(bits)
+        {
+            case 8:
+                return "U8";
+            case 16:
+                return "S16LE";
+            case 24:
+                return "S24LE";
+            case 32:
+                return "S32LE";
+        }
+    }
+    else if(format == WAV_FORMAT_FLOAT)
+    {
+        switch(bits)
+        {
+            case 32:
+                return "F32LE";
+            case 64:
+                return "F64LE";
+        }
+    }
+    return NULL;
+}
+
+/*Walks the RIFF chunks up to data. Returns FALSE for anything but plain PCM.*/
+static gboolean mapped_source_parse(const guchar *head, gsize length, MappedWav *wav)
+{
+    gsize offset = 12;
+    gboolean have_format = FALSE;
+
+    if(length < 12 || memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0)
+    {
+        return FALSE;
+    }
+    while(offset + 8 <= length)
+    {
+        guint32 size = read_le32(head + offset + 4);
+        if(memcmp(head + offset, "fmt ", 4) == 0)
+        {
+            guint format, bits;
+            if(size < 16 || offset + 8 + size > length)
+            {
+                return FALSE;
+            }
+            format = read_le16(head + offset + 8);
+            wav->channels = read_le16(head + offset + 10);
+            wav->rate = read_le32(head + offset + 12);
+            wav->frame_bytes = read_le16(head + offset + 20);
+            bits = read_le16(head + offset + 22);
+            /*The real format code is the start of the sub format GUID*/
+            if(format == WAV_FORMAT_EXTENSIBLE && size >= 40)
+            {
+                format = read_le16(head + offset + 32);
+            }
+            wav->format = wav_sample_format(format, bits);
+            have_format = wav->format != NULL && wav->rate > 0 && wav->channels > 0 &&
+                            wav->channels <= MAPPED_SOURCE_MAX_CHANNELS && wav->frame_bytes == wav->channels * bits / 8;
+            if(!have_format)
+            {
+                return FALSE;
+            }
+        }
+        else if(memcmp(head + offset, "data", 4) == 0)
+        {
+            if(!have_format)
+            {
+                return FALSE;
+            }
+            wav->data_offset = offset + 8;
+            /*Streamed files leave the size empty or too big, the rest of the file is data then*/
+            wav->data_size = size == 0 || wav->data_offset + size > length ? length - wav->data_offset : size;
+            wav->data_size -= wav->data_size % wav->frame_bytes;
+            return wav->data_size > 0;
+        }
+        offset += 8 + (gsize)size + (size & 0x01);
+    }
+    return FALSE;
+}
+
+/*The file is read front to back, pages a finished buffer covered won't be needed again.
+  Without this every page stays resident until the file is unmapped and the RSS grows
+  with the size of the song. Dropping a page a neighbouring buffer still reads only
+  makes it fault back in from the file.*/
+static void mapped_chunk_free(gpointer data)
+{
+    MappedChunk *chunk = (MappedChunk *)data;
+    guintptr page = (guintptr)sysconf(_SC_PAGESIZE);
+    guintptr start = (guintptr)chunk->data & ~(page - 1);
+    guintptr end = ((guintptr)chunk->data + chunk->size + page - 1) & ~(page - 1);
+
+    madvise((gpointer)start, end - start, MADV_DONTNEED);
+    g_mapped_file_unref(chunk->file);
+    g_free(chunk);
+}
+
+static void mapped_source_need_data(GstAppSrc *src, guint length, gpointer user_data)
+{
+    MappedSource *source = (MappedSource *)user_data;
+    gsize chunk = MIN(source->size - source->position, MAPPED_SOURCE_CHUNK_BYTES / source->frame_bytes * source->frame_bytes);
+    guint64 frame = source->position / source->frame_bytes;
+    guint64 frames = chunk / source->frame_bytes;
+    MappedChunk *mapped;
+    GstBuffer *buffer;
+
+    if(chunk == 0)
+    {
+        gst_app_src_end_of_stream(src);
+        return;
+    }
+    mapped = g_new(MappedChunk, 1);
+    mapped->file = g_mapped_file_ref(source->file);
+    mapped->data = source->data + source->position;
+    mapped->size = chunk;
+    /*Read only, writers downstream get a copy*/
+    buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, (gpointer)source->data, source->size,
+                                            source->position, chunk, mapped, mapped_chunk_free);
+    GST_BUFFER_PTS(buffer) = gst_util_uint64_scale_int(frame, GST_SECOND, source->rate);
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale_int(frame + frames, GST_SECOND, source->rate) - GST_BUFFER_PTS(buffer);
+    GST_BUFFER_OFFSET(buffer) = frame;
+    GST_BUFFER_OFFSET_END(buffer) = frame + frames;
+    source->position += chunk;
+    gst_app_src_push_buffer(src, buffer);
+}
+
+/*The source runs in time format, offset is the start of the new segment*/
+static gboolean mapped_source_seek_data(GstAppSrc *src, guint64 offset, gpointer user_data)
+{
+    MappedSource *source = (MappedSource *)user_data;
+    guint64 frame = gst_util_uint64_scale_int(offset, source->rate, GST_SECOND);
+
+    source->position = MIN(frame * source->frame_bytes, source->size);
+    return TRUE;
+}
+
+static void mapped_source_free(gpointer user_data)
+{
+    MappedSource *source = (MappedSource *)user_data;
+    /*Buffers still in flight keep their own reference*/
+    g_mapped_file_unref(source->file);
+    g_free(source);
+}
+
+GstElement *mapped_source_new(const gchar *path)
+{
+    GstAppSrcCallbacks callbacks = {mapped_source_need_data, NULL, mapped_source_seek_data};
+    GMappedFile *file;
+    MappedSource *source;
+    MappedWav wav;
+    GstElement *element;
+    GstCaps *caps;
+
+    if(path == NULL)
+    {
+        return NULL;
+    }
+    file = g_mapped_file_new(path, FALSE, NULL);
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    if(!mapped_source_parse((const guchar *)g_mapped_file_get_contents(file), g_mapped_file_get_length(file), &wav) ||
+        (element = gst_element_factory_make("appsrc", NULL)) == NULL)
+    {
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+    source = g_new0(MappedSource, 1);
+    source->file = file;
+    source->data = g_mapped_file_get_contents(file) + wav.data_offset;
+    source->size = wav.data_size;
+    source->frame_bytes = wav.frame_bytes;
+    source->rate = wav.rate;
+
+    caps = gst_caps_new_simple("audio/x-raw",
+                                "format", G_TYPE_STRING, wav.format,
+                                "layout", G_TYPE_STRING, "interleaved",
+                                "rate", G_TYPE_INT, (gint)wav.rate,
+                                "channels", G_TYPE_INT, (gint)wav.channels, NULL);
+    g_object_set(element, "caps", caps, "format", GST_FORMAT_TIME,
+                    "stream-type", GST_APP_STREAM_TYPE_SEEKABLE, NULL);
+    gst_caps_unref(caps);
+    gst_app_src_set_duration(GST_APP_SRC(element),
+                                gst_util_uint64_scale_int(wav.data_size / wav.frame_bytes, GST_SECOND, wav.rate));
+    gst_app_src_set_callbacks(GST_APP_SRC(element), &callbacks, source, mapped_source_free);
+    return element;
+}
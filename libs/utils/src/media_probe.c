@@ -0,0 +1,478 @@
+#include "media_probe.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ID3_HEADER_BYTES 10
+#define MP3_SYNC_SEARCH_BYTES 2048
+#define FLAC_STREAMINFO_BYTES 34
+#define OGG_PAGE_HEADER_BYTES 27
+#define OPUS_RATE 48000
+
+typedef struct _MediaProbeEntry
+{
+    MediaProbe probe;
+    int error;
+}MediaProbeEntry;
+
+static const gchar *container_names[] = {"unknown", "mp3", "flac", "wav", "ogg", "mp4", "matroska"};
+
+static GHashTable *probe_cache = NULL;
+static GMutex probe_cache_lock;
+
+/*MPEG audio layer III tables, index 0 is MPEG 1, index 1 MPEG 2 and 2.5*/
+static const guint mp3_bitrates[2][16] = {
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}
+};
+static const guint mp3_rates[3] = {44100, 48000, 32000};
+
+static guint32 read_le16(const guchar *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static guint32 read_le32(const guchar *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((guint32)data[3] << 24);
+}
+
+static guint64 read_le64(const guchar *data)
+{
+    return read_le32(data) | ((guint64)read_le32(data + 4) << 32);
+}
+
+static guint32 read_be32(const guchar *data)
+{
+    return ((guint32)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static guint64 read_be64(const guchar *data)
+{
+    return ((guint64)read_be32(data) << 32) | read_be32(data + 4);
+}
+
+static gsize read_at(FILE *file, guint64 offset, guchar *buffer, gsize size)
+{
+    if(fseeko(file, (off_t)offset, SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    return fread(buffer, 1, size, file);
+}
+
+/*ID3v2 tags are written in front of MP3 and sometimes FLAC streams*/
+static guint64 id3_size(const guchar *head, gsize length)
+{
+    if(length < ID3_HEADER_BYTES || memcmp(head, "ID3", 3) != 0)
+    {
+        return 0;
+    }
+    /*Synchsafe integer, 7 bits per byte, plus the footer flag*/
+    return ID3_HEADER_BYTES + ((head[6] & 0x7f) << 21 | (head[7] & 0x7f) << 14 | (head[8] & 0x7f) << 7 | (head[9] & 0x7f)) +
+            ((head[5] & 0x10) ? ID3_HEADER_BYTES : 0);
+}
+
+typedef struct _Mp3Header
+{
+    gboolean mpeg1;
+    guint bitrate;
+    guint rate;
+    guint channels;
+    guint frame_bytes;
+    guint samples;
+}Mp3Header;
+
+static gboolean mp3_parse_header(const guchar *data, Mp3Header *header)
+{
+    guint version, bitrate_index, rate_index;
+
+    /*11 bit sync, layer III only*/
+    if(data[0] != 0xff || (data[1] & 0xe0) != 0xe0 || ((data[1] >> 1) & 0x03) != 0x01)
+    {
+        return FALSE;
+    }
+    version = (data[1] >> 3) & 0x03;
+    bitrate_index = data[2] >> 4;
+    rate_index = (data[2] >> 2) & 0x03;
+    if(version == 0x01 || bitrate_index == 0 || bitrate_index == 0x0f || rate_index == 0x03)
+    {
+        return FALSE;
+    }
+    header->mpeg1 = version == 0x03;
+    header->bitrate = mp3_bitrates[header->mpeg1 ? 0 : 1][bitrate_index] * 1000;
+    /*MPEG 2 halves the rate, MPEG 2.5 quarters it*/
+    header->rate = mp3_rates[rate_index] >> (header->mpeg1 ? 0 : (version == 0x02 ? 1 : 2));
+    header->channels = (data[3] >> 6) == 0x03 ? 1 : 2;
+    header->samples = header->mpeg1 ? 1152 : 576;
+    header->frame_bytes = (header->samples / 8) * header->bitrate / header->rate + ((data[2] >> 1) & 0x01);
+    return TRUE;
+}
+
+/*Frame count of the Xing/Info or VBRI header of VBR files, 0 without one*/
+static guint32 mp3_vbr_frames(const guchar *frame, gsize length, const Mp3Header *header)
+{
+    gsize xing = 4 + (header->mpeg1 ? (header->channels == 1 ? 17 : 32) : (header->channels == 1 ? 9 : 17));
+    if(xing + 12 <= length && (memcmp(frame + xing, "Xing", 4) == 0 || memcmp(frame + xing, "Info", 4) == 0) &&
+        (read_be32(frame + xing + 4) & 0x01))
+    {
+        return read_be32(frame + xing + 8);
+    }
+    if(36 + 18 <= length && memcmp(frame + 36, "VBRI", 4) == 0)
+    {
+        return read_be32(frame + 36 + 14);
+    }
+    return 0;
+}
+
+static int probe_mp3(FILE *file, guint64 offset, MediaProbe *probe)
+{
+    guchar data[MEDIA_PROBE_HEAD_BYTES];
+    gsize length = read_at(file, offset, data, sizeof(data));
+    Mp3Header header, next;
+    guint32 frames;
+
+    /*A frame is only trusted when the next one follows where it says*/
+    for(gsize i = 0; i + 4 <= MIN(length, MP3_SYNC_SEARCH_BYTES); i++)
+    {
+        if(!mp3_parse_header(data + i, &header))
+        {
+            continue;
+        }
+        if(i + header.frame_bytes + 4 <= length && !mp3_parse_header(data + i + header.frame_bytes, &next))
+        {
+            continue;
+        }
+        probe->container = MEDIA_CONTAINER_MP3;
+        probe->codec = MEDIA_CODEC_MP3;
+        probe->rate = header.rate;
+        probe->channels = header.channels;
+        probe->bitrate = header.bitrate;
+        frames = mp3_vbr_frames(data + i, length - i, &header);
+        if(frames > 0)
+        {
+            probe->duration = (gdouble)frames * header.samples / header.rate;
+            probe->bitrate = (guint)((probe->size - offset - i) * 8 / MAX(probe->duration, 1e-3));
+        }
+        else
+        {
+            probe->duration = (gdouble)(probe->size - offset - i) * 8 / header.bitrate;
+        }
+        return 0;
+    }
+    return -3;
+}
+
+static int probe_flac(const guchar *data, gsize length, MediaProbe *probe)
+{
+    const guchar *info = data + 8;
+    guint64 total;
+
+    /*STREAMINFO is always the first metadata block*/
+    if(length < 8 + FLAC_STREAMINFO_BYTES || (data[4] & 0x7f) != 0)
+    {
+        return -3;
+    }
+    probe->container = MEDIA_CONTAINER_FLAC;
+    probe->codec = MEDIA_CODEC_FLAC;
+    probe->rate = (info[10] << 12) | (info[11] << 4) | (info[12] >> 4);
+    probe->channels = ((info[12] >> 1) & 0x07) + 1;
+    probe->bits = (((info[12] & 0x01) << 4) | (info[13] >> 4)) + 1;
+    total = ((guint64)(info[13] & 0x0f) << 32) | read_be32(info + 14);
+    if(probe->rate == 0)
+    {
+        return -3;
+    }
+    probe->duration = (gdouble)total / probe->rate;
+    probe->bitrate = probe->duration > 0 ? (guint)(probe->size * 8 / probe->duration) : 0;
+    return 0;
+}
+
+static int probe_wav(FILE *file, MediaProbe *probe)
+{
+    guchar chunk[24];
+    guint64 offset = 12;
+    guint32 byte_rate = 0;
+
+    /*fmt comes before data, anything else is skipped*/
+    while(read_at(file, offset, chunk, 8) == 8)
+    {
+        guint32 size = read_le32(chunk + 4);
+        if(memcmp(chunk, "fmt ", 4) == 0)
+        {
+            if(size < 16 || read_at(file, offset + 8, chunk, 16) != 16)
+            {
+                return -3;
+            }
+            probe->channels = read_le16(chunk + 2);
+            probe->rate = read_le32(chunk + 4);
+            byte_rate = read_le32(chunk + 8);
+            probe->bits = read_le16(chunk + 14);
+        }
+        else if(memcmp(chunk, "data", 4) == 0)
+        {
+            guint64 data_size = offset + 8 + size <= probe->size ? size : probe->size - offset - 8;
+            if(byte_rate == 0 || probe->rate == 0 || probe->channels == 0)
+            {
+                return -3;
+            }
+            probe->container = MEDIA_CONTAINER_WAV;
+            probe->codec = MEDIA_CODEC_PCM;
+            probe->bitrate = byte_rate * 8;
+            /*Streamed files leave the size empty, the rest of the file is data then*/
+            probe->duration = (gdouble)(size == 0 || size == 0xffffffff ? probe->size - offset - 8 : data_size) / byte_rate;
+            return 0;
+        }
+        offset += 8 + size + (size & 0x01);
+    }
+    return -3;
+}
+
+/*Last page of the stream carries the total granule position*/
+static guint64 ogg_last_granule(FILE *file, guint64 size)
+{
+    guchar *tail = g_malloc(MEDIA_PROBE_TAIL_BYTES);
+    guint64 start = size > MEDIA_PROBE_TAIL_BYTES ? size - MEDIA_PROBE_TAIL_BYTES : 0;
+    gsize length = read_at(file, start, tail, MEDIA_PROBE_TAIL_BYTES);
+    guint64 granule = 0;
+
+    for(gsize i = length >= OGG_PAGE_HEADER_BYTES ? length - OGG_PAGE_HEADER_BYTES + 1 : 0; i > 0; i--)
+    {
+        if(memcmp(tail + i - 1, "OggS", 4) == 0)
+        {
+            granule = read_le64(tail + i - 1 + 6);
+            break;
+        }
+    }
+    g_free(tail);
+    return granule;
+}
+
+static int probe_ogg(FILE *file, const guchar *data, gsize length, MediaProbe *probe)
+{
+    gsize packet;
+    guint64 granule;
+    guint pre_skip = 0;
+
+    if(length < OGG_PAGE_HEADER_BYTES)
+    {
+        return -3;
+    }
+    packet = OGG_PAGE_HEADER_BYTES + data[26];
+    if(packet + 19 > length)
+    {
+        return -3;
+    }
+    probe->container = MEDIA_CONTAINER_OGG;
+    if(memcmp(data + packet, "\x01vorbis", 7) == 0)
+    {
+        probe->codec = MEDIA_CODEC_VORBIS;
+        probe->channels = data[packet + 11];
+        probe->rate = read_le32(data + packet + 12);
+    }
+    else if(memcmp(data + packet, "OpusHead", 8) == 0)
+    {
+        /*Opus always decodes at 48 kHz, the input rate is informational*/
+        probe->codec = MEDIA_CODEC_OPUS;
+        probe->channels = data[packet + 9];
+        pre_skip = read_le16(data + packet + 10);
+        probe->rate = OPUS_RATE;
+    }
+    else
+    {
+        return 0;
+    }
+    granule = ogg_last_granule(file, probe->size);
+    if(probe->rate > 0 && granule > pre_skip && granule != G_MAXUINT64)
+    {
+        probe->duration = (gdouble)(granule - pre_skip) / probe->rate;
+        probe->bitrate = (guint)(probe->size * 8 / probe->duration);
+    }
+    return 0;
+}
+
+/*Duration from the movie header, moov is often at the end so top level atoms are walked*/
+static int probe_mp4(FILE *file, MediaProbe *probe)
+{
+    guchar header[32];
+    guint64 offset = 0;
+
+    probe->container = MEDIA_CONTAINER_MP4;
+    for(guint atom = 0; atom < MEDIA_PROBE_MAX_ATOMS && offset + 8 <= probe->size; atom++)
+    {
+        guint64 size;
+        guint header_size = 8;
+        if(read_at(file, offset, header, 16) < 8)
+        {
+            break;
+        }
+        size = read_be32(header);
+        if(size == 1)
+        {
+            size = read_be64(header + 8);
+            header_size = 16;
+        }
+        else if(size == 0)
+        {
+            size = probe->size - offset;
+        }
+        if(size < header_size)
+        {
+            return -3;
+        }
+        /*mvhd is the first child of moov in every muxer we care about*/
+        if(memcmp(header + 4, "moov", 4) == 0 &&
+            read_at(file, offset + header_size, header, sizeof(header)) == sizeof(header) &&
+            memcmp(header + 4, "mvhd", 4) == 0)
+        {
+            gboolean version1 = header[8] == 1;
+            guchar mvhd[32];
+            guint32 timescale;
+            guint64 duration;
+            if(read_at(file, offset + header_size + 12, mvhd, sizeof(mvhd)) != sizeof(mvhd))
+            {
+                break;
+            }
+            timescale = read_be32(mvhd + (version1 ? 16 : 8));
+            duration = version1 ? read_be64(mvhd + 20) : read_be32(mvhd + 12);
+            if(timescale > 0)
+            {
+                probe->duration = (gdouble)duration / timescale;
+            }
+            break;
+        }
+        offset += size;
+    }
+    return 0;
+}
+
+static int probe_head(FILE *file, MediaProbe *probe)
+{
+    guchar head[MEDIA_PROBE_HEAD_BYTES];
+    gsize length = read_at(file, 0, head, sizeof(head));
+    guint64 skip = id3_size(head, length);
+
+    if(skip > 0)
+    {
+        probe->offset = skip;
+        /*Tags can hold cover art far bigger than the head*/
+        length = read_at(file, skip, head, sizeof(head));
+        if(length >= 4 && memcmp(head, "fLaC", 4) == 0)
+        {
+            return probe_flac(head, length, probe);
+        }
+        return probe_mp3(file, skip, probe);
+    }
+    if(length < 12)
+    {
+        return -3;
+    }
+    if(memcmp(head, "fLaC", 4) == 0)
+    {
+        return probe_flac(head, length, probe);
+    }
+    if(memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "WAVE", 4) == 0)
+    {
+        return probe_wav(file, probe);
+    }
+    if(memcmp(head, "OggS", 4) == 0)
+    {
+        return probe_ogg(file, head, length, probe);
+    }
+    if(memcmp(head + 4, "ftyp", 4) == 0 || memcmp(head + 4, "moov", 4) == 0)
+    {
+        return probe_mp4(file, probe);
+    }
+    if(read_be32(head) == 0x1a45dfa3)
+    {
+        probe->container = MEDIA_CONTAINER_MATROSKA;
+        return 0;
+    }
+    /*Raw MPEG audio without tags*/
+    return probe_mp3(file, 0, probe);
+}
+
+int media_probe_file(const gchar *path, MediaProbe *probe)
+{
+    MediaProbeEntry *entry;
+    struct stat info;
+    FILE *file;
+    int error;
+
+    if(path == NULL || probe == NULL)
+    {
+        return -1;
+    }
+    memset(probe, 0, sizeof(MediaProbe));
+    if(stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        return -2;
+    }
+    g_mutex_lock(&probe_cache_lock);
+    entry = probe_cache != NULL ? g_hash_table_lookup(probe_cache, path) : NULL;
+    if(entry != NULL && entry->probe.size == (guint64)info.st_size && entry->probe.mtime == (gint64)info.st_mtime)
+    {
+        memcpy(probe, &entry->probe, sizeof(MediaProbe));
+        error = entry->error;
+        g_mutex_unlock(&probe_cache_lock);
+        return error;
+    }
+    g_mutex_unlock(&probe_cache_lock);
+
+    probe->size = (guint64)info.st_size;
+    probe->mtime = (gint64)info.st_mtime;
+    file = fopen(path, "rb");
+    if(file == NULL)
+    {
+        return -2;
+    }
+    error = probe_head(file, probe);
+    fclose(file);
+    if(error != 0)
+    {
+        probe->container = MEDIA_CONTAINER_UNKNOWN;
+    }
+
+    /*Broken files are cached too, they are rejected without reading them again*/
+    entry = g_new(MediaProbeEntry, 1);
+    memcpy(&entry->probe, probe, sizeof(MediaProbe));
+    entry->error = error;
+    g_mutex_lock(&probe_cache_lock);
+    if(probe_cache == NULL)
+    {
+        probe_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+    g_hash_table_replace(probe_cache, g_strdup(path), entry);
+    g_mutex_unlock(&probe_cache_lock);
+    return error;
+}
+
+gboolean media_probe_is_audio(const MediaProbe *probe)
+{
+    if(probe == NULL)
+    {
+        return FALSE;
+    }
+    return probe->container == MEDIA_CONTAINER_MP3 || probe->container == MEDIA_CONTAINER_FLAC ||
+            probe->container == MEDIA_CONTAINER_WAV || probe->container == MEDIA_CONTAINER_OGG;
+}
+
+const gchar *media_probe_container_name(MediaContainer container)
+{
+    if(container >= MEDIA_CONTAINER_NUM)
+    {
+        return container_names[MEDIA_CONTAINER_UNKNOWN];
+    }
+    return container_names[container];
+}
+
+void media_probe_cache_clear(void)
+{
+    g_mutex_lock(&probe_cache_lock);
+    if(probe_cache != NULL)
+    {
+        g_hash_table_destroy(probe_cache);
+        probe_cache = NULL;
+    }
+    g_mutex_unlock(&probe_cache_lock);
+}
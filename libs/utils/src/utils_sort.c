@@ -0,0 +1,524 @@
+#include "utils.h"
+#include "arena.h"
+#include <stdint.h>
+#include <string.h>
+
+/*Ranges this small are finished by insertion sort*/
+#define UTILS_INSERTION_THRESHOLD 16
+/*From this size on a 4 pass LSD radix sort beats comparisons*/
+#define UTILS_RADIX_THRESHOLD 1024
+#define UTILS_RADIX_BITS 8
+#define UTILS_RADIX_BUCKETS (1 << UTILS_RADIX_BITS)
+/*Independent partial sums, lets the compiler vectorise without reassociating*/
+#define UTILS_SUM_LANES 8
+
+/*Introsort and quickselect are the same for every element type, the
+  macro expands them once for float and once for int.
+  Quicksort with a median of three pivot, recursing only into the smaller
+  part, heapsort once the depth passes 2 log2 n and insertion sort for
+  small ranges, so sorted and adversarial inputs stay O(n log n).*/
+#define UTILS_SORT_KERNELS(type, name)                                              \
+static void name##_swap(type *a, type *b)                                          \
+{                                                                                   \
+    type temp = *a;                                                                 \
+    *a = *b;                                                                        \
+    *b = temp;                                                                      \
+}                                                                                   \
+                                                                                    \
+static void name##_insertion_sort(type array[], size_t n)                          \
+{                                                                                   \
+    for(size_t i = 1; i < n; i++)                                                   \
+    {                                                                               \
+        type value = array[i];                                                      \
+        size_t j = i;                                                               \
+        while(j > 0 && value < array[j - 1])                                        \
+        {                                                                           \
+            array[j] = array[j - 1];                                                \
+            j--;                                                                    \
+        }                                                                           \
+        array[j] = value;                                                           \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+static void name##_sift_down(type array[], size_t root, size_t n)                  \
+{                                                                                   \
+    while(2 * root + 1 < n)                                                         \
+    {                                                                               \
+        size_t child = 2 * root + 1;                                                \
+        if(child + 1 < n && array[child] < array[child + 1])                        \
+        {                                                                           \
+            child++;                                                                \
+        }                                                                           \
+        if(!(array[root] < array[child]))                                           \
+        {                                                                           \
+            return;                                                                 \
+        }                                                                           \
+        name##_swap(&array[root], &array[child]);                                   \
+        root = child;                                                               \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+static void name##_heap_sort(type array[], size_t n)                               \
+{                                                                                   \
+    for(size_t i = n / 2; i > 0; i--)                                               \
+    {                                                                               \
+        name##_sift_down(array, i - 1, n);                                          \
+    }                                                                               \
+    for(size_t end = n - 1; end > 0; end--)                                         \
+    {                                                                               \
+        name##_swap(&array[0], &array[end]);                                        \
+        name##_sift_down(array, 0, end);                                            \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+/*Hoare partition around the median of the first, middle and last element,    \
+  returns the first index of the upper part*/                                      \
+static size_t name##_partition(type array[], size_t n)                             \
+{                                                                                   \
+    size_t mid = (n - 1) / 2;                                                       \
+    size_t i = 0, j = n - 1;                                                        \
+    type pivot;                                                                     \
+    if(array[mid] < array[0])                                                       \
+    {                                                                               \
+        name##_swap(&array[mid], &array[0]);                                        \
+    }                                                                               \
+    if(array[n - 1] < array[0])                                                     \
+    {                                                                               \
+        name##_swap(&array[n - 1], &array[0]);                                      \
+    }                                                                               \
+    if(array[n - 1] < array[mid])                                                   \
+    {                                                                               \
+        name##_swap(&array[n - 1], &array[mid]);                                    \
+    }                                                                               \
+    pivot = array[mid];                                                             \
+    while(1)                                                                        \
+    {                                                                               \
+        while(array[i] < pivot)                                                     \
+        {                                                                           \
+            i++;                                                                    \
+        }                                                                           \
+        while(pivot < array[j])                                                     \
+        {                                                                           \
+            j--;                                                                    \
+        }                                                                           \
+        if(i >= j)                                                                  \
+        {                                                                           \
+            return j + 1;                                                           \
+        }                                                                           \
+        name##_swap(&array[i], &array[j]);                                          \
+        i++;                                                                        \
+        j--;                                                                        \
+    }                                                                               \
+}                                                                                   \
+                                                                                    \
+static void name##_introsort(type array[], size_t n, unsigned int depth)           \
+{                                                                                   \
+    while(n > UTILS_INSERTION_THRESHOLD)                                            \
+    {                                                                               \
+        size_t split;                                                               \
+        if(depth == 0)                                                              \
+        {                                                                           \
+            name##_heap_sort(array, n);                                             \
+            return;                                                                 \
+        }                                                                           \
+        depth--;                                                                    \
+        split = name##_partition(array, n);                                         \
+        if(split < n - split)                                                       \
+        {                                                                           \
+            name##_introsort(array, split, depth);                                  \
+            array += split;                                                         \
+            n -= split;                                                             \
+        }                                                                           \
+        else                                                                        \
+        {                                                                           \
+            name##_introsort(array + split, n - split, depth);                      \
+            n = split;                                                              \
+        }                                                                           \
+    }                                                                               \
+    name##_insertion_sort(array, n);                                                \
+}                                                                                   \
+                                                                                    \
+/*Moves the k-th smallest element to array[k], smaller ones before it*/           \
+static type name##_select_kernel(type array[], size_t n, size_t k)                 \
+{                                                                                   \
+    type *base = array;                                                             \
+    size_t offset = 0;                                                              \
+    unsigned int depth = 2 * utils_log2(n);                                         \
+    while(n > UTILS_INSERTION_THRESHOLD)                                            \
+    {                                                                               \
+        size_t split;                                                               \
+        if(depth == 0)                                                              \
+        {                                                                           \
+            name##_heap_sort(base, n);                                              \
+            return array[k];                                                        \
+        }                                                                           \
+        depth--;                                                                    \
+        split = name##_partition(base, n);                                          \
+        if(k - offset < split)                                                      \
+        {                                                                           \
+            n = split;                                                              \
+        }                                                                           \
+        else                                                                        \
+        {                                                                           \
+            base += split;                                                          \
+            offset += split;                                                        \
+            n -= split;                                                             \
+        }                                                                           \
+    }                                                                               \
+    name##_insertion_sort(base, n);                                                 \
+    return array[k];                                                                \
+}
+
+static unsigned int utils_log2(size_t n)
+{
+    unsigned int log2n = 0;
+    while(n > 1)
+    {
+        n >>= 1;
+        log2n++;
+    }
+    return log2n;
+}
+
+UTILS_SORT_KERNELS(float, utils_float)
+UTILS_SORT_KERNELS(int, utils_int)
+
+/*Order preserving map to unsigned keys, negative floats have every bit flipped*/
+static uint32_t float_key(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+static float float_from_key(uint32_t key)
+{
+    uint32_t bits = (key & 0x80000000u) ? key & 0x7fffffffu : ~key;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*Stable LSD passes over 8 bits, keys end up back in keys. FALSE without memory.*/
+static int radix_sort_keys(Arena *arena, uint32_t *keys, size_t n)
+{
+    uint32_t *scratch = arena_new(arena, uint32_t, n);
+    size_t counts[sizeof(uint32_t)][UTILS_RADIX_BUCKETS];
+
+    if(scratch == NULL)
+    {
+        return 0;
+    }
+    /*All histograms in a single read of the keys*/
+    memset(counts, 0, sizeof(counts));
+    for(size_t i = 0; i < n; i++)
+    {
+        for(unsigned int pass = 0; pass < sizeof(uint32_t); pass++)
+        {
+            counts[pass][(keys[i] >> (pass * UTILS_RADIX_BITS)) & (UTILS_RADIX_BUCKETS - 1)]++;
+        }
+    }
+    for(unsigned int pass = 0; pass < sizeof(uint32_t); pass++)
+    {
+        const unsigned int shift = pass * UTILS_RADIX_BITS;
+        size_t offset = 0;
+        uint32_t *temp;
+        for(unsigned int bucket = 0; bucket < UTILS_RADIX_BUCKETS; bucket++)
+        {
+            size_t count = counts[pass][bucket];
+            counts[pass][bucket] = offset;
+            offset += count;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            scratch[counts[pass][(keys[i] >> shift) & (UTILS_RADIX_BUCKETS - 1)]++] = keys[i];
+        }
+        temp = keys;
+        keys = scratch;
+        scratch = temp;
+    }
+    /*An even number of passes leaves the result in the caller's buffer*/
+    return 1;
+}
+
+void utils_float_sort(float array[], unsigned int n)
+{
+    /*Keys and radix buffers come from the thread scratch arena, repeated sorts don't malloc*/
+    Arena *arena = arena_scratch();
+    ArenaMark mark = arena_mark(arena);
+    uint32_t *keys;
+
+    if(n <= 1)
+    {
+        return;
+    }
+    if(n >= UTILS_RADIX_THRESHOLD && (keys = arena_new(arena, uint32_t, n)) != NULL)
+    {
+        for(unsigned int i = 0; i < n; i++)
+        {
+            keys[i] = float_key(array[i]);
+        }
+        if(radix_sort_keys(arena, keys, n))
+        {
+            for(unsigned int i = 0; i < n; i++)
+            {
+                array[i] = float_from_key(keys[i]);
+            }
+            arena_release(arena, mark);
+            return;
+        }
+        arena_release(arena, mark);
+    }
+    utils_float_introsort(array, n, 2 * utils_log2(n));
+}
+
+void utils_int_sort(int array[], unsigned int n)
+{
+    Arena *arena = arena_scratch();
+    ArenaMark mark = arena_mark(arena);
+    uint32_t *keys;
+
+    if(n <= 1)
+    {
+        return;
+    }
+    if(n >= UTILS_RADIX_THRESHOLD && (keys = arena_new(arena, uint32_t, n)) != NULL)
+    {
+        /*Flipping the sign bit orders two's complement as unsigned*/
+        for(unsigned int i = 0; i < n; i++)
+        {
+            keys[i] = (uint32_t)array[i] ^ 0x80000000u;
+        }
+        if(radix_sort_keys(arena, keys, n))
+        {
+            for(unsigned int i = 0; i < n; i++)
+            {
+                array[i] = (int)(keys[i] ^ 0x80000000u);
+            }
+            arena_release(arena, mark);
+            return;
+        }
+        arena_release(arena, mark);
+    }
+    utils_int_introsort(array, n, 2 * utils_log2(n));
+}
+
+float utils_float_select(float array[], unsigned int n, unsigned int k)
+{
+    if(n == 0 || k >= n)
+    {
+        return 0.0;
+    }
+    return utils_float_select_kernel(array, n, k);
+}
+
+/*The upper middle element is the smallest of the part above the lower one*/
+static float float_min(const float array[], size_t n)
+{
+    float min = array[0];
+    for(size_t i = 1; i < n; i++)
+    {
+        min = array[i] < min ? array[i] : min;
+    }
+    return min;
+}
+
+static int int_min(const int array[], size_t n)
+{
+    int min = array[0];
+    for(size_t i = 1; i < n; i++)
+    {
+        min = array[i] < min ? array[i] : min;
+    }
+    return min;
+}
+
+float utils_float_mediana(float array[], unsigned int n)
+{
+    float lower;
+
+    if(n == 0)
+    {
+        return 0.0;
+    }
+    lower = utils_float_select_kernel(array, n, (n - 1) / 2);
+    if(n % 2)
+    {
+        return lower;
+    }
+    return (lower + float_min(array + n / 2, n / 2)) / 2.0;
+}
+
+float utils_float_percentile(float array[], unsigned int n, float percentile)
+{
+    double position;
+    unsigned int index;
+    float lower;
+
+    if(n == 0)
+    {
+        return 0.0;
+    }
+    percentile = percentile < 0.0 ? 0.0 : (percentile > 100.0 ? 100.0 : percentile);
+    /*Linear interpolation between the closest ranks*/
+    position = percentile / 100.0 * (n - 1);
+    index = (unsigned int)position;
+    lower = utils_float_select_kernel(array, n, index);
+    if(index + 1 >= n)
+    {
+        return lower;
+    }
+    return lower + (float)(position - index) * (float_min(array + index + 1, n - index - 1) - lower);
+}
+
+int utils_int_select(int array[], unsigned int n, unsigned int k)
+{
+    if(n == 0 || k >= n)
+    {
+        return 0;
+    }
+    return utils_int_select_kernel(array, n, k);
+}
+
+int utils_int_mediana(int array[], unsigned int n)
+{
+    int lower;
+
+    if(n == 0)
+    {
+        return 0;
+    }
+    lower = utils_int_select_kernel(array, n, (n - 1) / 2);
+    if(n % 2)
+    {
+        return lower;
+    }
+    /*Wide sum, two large ints would overflow*/
+    return (int)(((long long)lower + int_min(array + n / 2, n / 2)) / 2);
+}
+
+float utils_float_mean(float array[], unsigned int n)
+{
+    double lanes[UTILS_SUM_LANES] = {0};
+    double sum = 0.0;
+    unsigned int vector_n = n - n % UTILS_SUM_LANES;
+
+    if(n == 0)
+    {
+        return 0.0;
+    }
+    for(unsigned int i = 0; i < vector_n; i += UTILS_SUM_LANES)
+    {
+        for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+        {
+            lanes[l] += array[i + l];
+        }
+    }
+    for(unsigned int i = vector_n; i < n; i++)
+    {
+        sum += array[i];
+    }
+    for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return (float)(sum / n);
+}
+
+/*Two passes around the mean, no cancellation like with sum of squares*/
+float utils_float_variance(float array[], unsigned int n)
+{
+    double lanes[UTILS_SUM_LANES] = {0};
+    double sum = 0.0;
+    double mean;
+    unsigned int vector_n = n - n % UTILS_SUM_LANES;
+
+    if(n == 0)
+    {
+        return 0.0;
+    }
+    mean = utils_float_mean(array, n);
+    for(unsigned int i = 0; i < vector_n; i += UTILS_SUM_LANES)
+    {
+        for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+        {
+            double diff = array[i + l] - mean;
+            lanes[l] += diff * diff;
+        }
+    }
+    for(unsigned int i = vector_n; i < n; i++)
+    {
+        double diff = array[i] - mean;
+        sum += diff * diff;
+    }
+    for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return (float)(sum / n);
+}
+
+int utils_int_mean(int array[], unsigned int n)
+{
+    long long lanes[UTILS_SUM_LANES] = {0};
+    long long sum = 0;
+    unsigned int vector_n = n - n % UTILS_SUM_LANES;
+
+    if(n == 0)
+    {
+        return 0;
+    }
+    for(unsigned int i = 0; i < vector_n; i += UTILS_SUM_LANES)
+    {
+        for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+        {
+            lanes[l] += array[i + l];
+        }
+    }
+    for(unsigned int i = vector_n; i < n; i++)
+    {
+        sum += array[i];
+    }
+    for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return (int)(sum / (long long)n);
+}
+
+float utils_int_variance(int array[], unsigned int n)
+{
+    double lanes[UTILS_SUM_LANES] = {0};
+    double sum = 0.0;
+    double mean = 0.0;
+    unsigned int vector_n = n - n % UTILS_SUM_LANES;
+
+    if(n == 0)
+    {
+        return 0.0;
+    }
+    /*The exact mean, utils_int_mean truncates*/
+    for(unsigned int i = 0; i < n; i++)
+    {
+        mean += array[i];
+    }
+    mean /= n;
+    for(unsigned int i = 0; i < vector_n; i += UTILS_SUM_LANES)
+    {
+        for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+        {
+            double diff = array[i + l] - mean;
+            lanes[l] += diff * diff;
+        }
+    }
+    for(unsigned int i = vector_n; i < n; i++)
+    {
+        double diff = array[i] - mean;
+        sum += diff * diff;
+    }
+    for(unsigned int l = 0; l < UTILS_SUM_LANES; l++)
+    {
+        sum += lanes[l];
+    }
+    return (float)(sum / n);
+}
@@ -0,0 +1,259 @@
+#include "decode_chain.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <gst/gst.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#define BENCH_REPEATS 10
+#define BENCH_RATE 44100
+#define BENCH_SECONDS 30
+
+typedef struct _BenchFormat
+{
+    const gchar *name;
+    const gchar *file_name;
+    const gchar *encoder;       /*gst-launch description from the WAV, NULL for the WAV itself*/
+    const gchar *elements[3];   /*needed to make the file*/
+    const gchar *chain[3];      /*the direct chain, without them there is nothing to compare*/
+}BenchFormat;
+
+static const BenchFormat bench_formats[] = {
+    {"wav", "bench.wav", NULL, {NULL}, {"wavparse", NULL}},
+    {"flac", "bench.flac", "flacenc", {"wavparse", "flacenc", NULL}, {"flacparse", "flacdec", NULL}},
+    {"mp3", "bench.mp3", "lamemp3enc", {"wavparse", "lamemp3enc", NULL}, {"mpegaudioparse", "mpg123audiodec", NULL}},
+    {"ogg vorbis", "bench.ogg", "vorbisenc ! oggmux", {"wavparse", "vorbisenc", "oggmux"}, {"oggdemux", "vorbisdec", NULL}},
+};
+
+/*16 bit stereo 440 Hz sine*/
+static gboolean bench_write_wav(const gchar *path)
+{
+    guint32 frames = BENCH_RATE * BENCH_SECONDS;
+    guint32 data_bytes = frames * 4;
+    guchar *data = g_malloc(TEST_WAV_HEADER_BYTES + data_bytes);
+    gboolean written;
+
+    test_wav_header(data, BENCH_RATE, 2, data_bytes);
+    for(guint32 i = 0; i < frames; i++)
+    {
+        gint16 sample = (gint16)(8000.0 * sin(2.0 * G_PI * 440.0 * i / BENCH_RATE));
+        test_put_le(data + TEST_WAV_HEADER_BYTES + 4 * i, (guint16)sample, 2);
+        test_put_le(data + TEST_WAV_HEADER_BYTES + 2 + 4 * i, (guint16)sample, 2);
+    }
+    written = g_file_set_contents(path, (const gchar *)data, TEST_WAV_HEADER_BYTES + data_bytes, NULL);
+    g_free(data);
+    return written;
+}
+
+/*First of names that is not installed, NULL when all are*/
+static const gchar *bench_missing_element(const gchar *const *names, guint num)
+{
+    for(guint i = 0; i < num && names[i] != NULL; i++)
+    {
+        GstElementFactory *factory = gst_element_factory_find(names[i]);
+        if(factory == NULL)
+        {
+            return names[i];
+        }
+        gst_object_unref(factory);
+    }
+    return NULL;
+}
+
+/*Runs pipeline until EOS, FALSE on errors*/
+static gboolean bench_run_to_end(GstElement *pipeline)
+{
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg;
+    gboolean ok;
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    return ok;
+}
+
+static gboolean bench_encode(const gchar *wav_path, const BenchFormat *format, const gchar *path)
+{
+    gchar *description = g_strdup_printf("filesrc location=\"%s\" ! wavparse ! audioconvert ! %s ! filesink location=\"%s\"",
+                                        wav_path, format->encoder, path);
+    GstElement *pipeline = gst_parse_launch(description, NULL);
+    gboolean ok = pipeline != NULL && bench_run_to_end(pipeline);
+
+    if(pipeline != NULL)
+    {
+        gst_object_unref(pipeline);
+    }
+    g_free(description);
+    return ok;
+}
+
+static GstPadProbeReturn bench_first_buffer(GstPad *pad, GstPadProbeInfo *info, GstElement *pipeline)
+{
+    gst_element_post_message(pipeline, gst_message_new_application(GST_OBJECT(pipeline), gst_structure_new_empty("first-buffer")));
+    return GST_PAD_PROBE_REMOVE;
+}
+
+static void bench_decodebin_pad_added(GstElement *src, GstPad *new_pad, GstElement *convert)
+{
+    GstPad *sink_pad = gst_element_get_static_pad(convert, "sink");
+    if(!gst_pad_is_linked(sink_pad))
+    {
+        gst_pad_link(new_pad, sink_pad);
+    }
+    gst_object_unref(sink_pad);
+}
+
+/*Microseconds from building the pipeline to the first decoded buffer, -1 when it fails.
+  The probe cache is cleared so the direct chain pays for its probe every time.*/
+static gint64 bench_first_buffer_time(const gchar *path, gboolean direct)
+{
+    gint64 start = g_get_monotonic_time();
+    gint64 elapsed = -1;
+    GstElement *pipeline = gst_pipeline_new("bench");
+    GstElement *source = gst_element_factory_make("filesrc", NULL);
+    GstElement *convert = gst_element_factory_make("audioconvert", NULL);
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+    GstElement *decoder = NULL;
+    GstBus *bus;
+    GstMessage *msg;
+    GstPad *pad;
+
+    g_object_set(source, "location", path, NULL);
+    g_object_set(sink, "sync", FALSE, NULL);
+    gst_bin_add_many(GST_BIN(pipeline), source, convert, sink, NULL);
+    gst_element_link(convert, sink);
+    media_probe_cache_clear();
+    if(direct)
+    {
+        if(!decode_chain_link_file(GST_BIN(pipeline), source, convert, path))
+        {
+            gst_object_unref(pipeline);
+            return -1;
+        }
+    }
+    else
+    {
+        decoder = gst_element_factory_make("decodebin", NULL);
+        gst_bin_add(GST_BIN(pipeline), decoder);
+        gst_element_link(source, decoder);
+        g_signal_connect(decoder, "pad-added", G_CALLBACK(bench_decodebin_pad_added), convert);
+    }
+    pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)bench_first_buffer, pipeline, NULL);
+    gst_object_unref(pad);
+
+    bus = gst_element_get_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                    GST_MESSAGE_APPLICATION | GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+    if(GST_MESSAGE_TYPE(msg) == GST_MESSAGE_APPLICATION)
+    {
+        elapsed = g_get_monotonic_time() - start;
+    }
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return elapsed;
+}
+
+static gint64 bench_best(const gchar *path, gboolean direct)
+{
+    gint64 best = G_MAXINT64;
+
+    /*The first run loads the plugins*/
+    if(bench_first_buffer_time(path, direct) < 0)
+    {
+        return -1;
+    }
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        gint64 elapsed = bench_first_buffer_time(path, direct);
+        if(elapsed < 0)
+        {
+            return -1;
+        }
+        best = MIN(best, elapsed);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    const gchar *const base[] = {"filesrc", "audioconvert", "fakesink"};
+    const gchar *const playback[] = {"decodebin"};
+    gchar *bench_directory, *wav_path;
+    const gchar *missing;
+
+    gst_init(&argc, &argv);
+    missing = bench_missing_element(base, G_N_ELEMENTS(base));
+    if(missing != NULL)
+    {
+        printf("skipped, %s is not installed\n", missing);
+        return 0;
+    }
+    bench_directory = g_dir_make_tmp("bench_decode_chain_XXXXXX", NULL);
+    if(bench_directory == NULL)
+    {
+        g_printerr("Cannot make a temporary directory\n");
+        return 1;
+    }
+    wav_path = g_build_filename(bench_directory, bench_formats[0].file_name, NULL);
+    if(!bench_write_wav(wav_path))
+    {
+        g_printerr("Cannot write the test file\n");
+        return 1;
+    }
+    for(guint i = 0; i < G_N_ELEMENTS(bench_formats); i++)
+    {
+        const BenchFormat *format = &bench_formats[i];
+        gchar *path = g_build_filename(bench_directory, format->file_name, NULL);
+        gint64 direct, decodebin;
+
+        missing = bench_missing_element(format->chain, G_N_ELEMENTS(format->chain));
+        if(missing == NULL && format->encoder != NULL)
+        {
+            missing = bench_missing_element(format->elements, G_N_ELEMENTS(format->elements));
+        }
+        if(missing != NULL)
+        {
+            printf("%-11s skipped, %s is not installed\n", format->name, missing);
+            g_free(path);
+            continue;
+        }
+        if(format->encoder != NULL && !bench_encode(wav_path, format, path))
+        {
+            printf("%-11s skipped, encoding the file failed\n", format->name);
+            g_free(path);
+            continue;
+        }
+        direct = bench_best(path, TRUE);
+        decodebin = bench_missing_element(playback, G_N_ELEMENTS(playback)) == NULL ? bench_best(path, FALSE) : -1;
+        if(direct < 0 || decodebin < 0)
+        {
+            printf("%-11s direct %s  decodebin %s\n", format->name,
+                    direct < 0 ? "failed" : "ok", decodebin < 0 ? "failed" : "ok");
+        }
+        else
+        {
+            printf("%-11s first buffer  direct %7.3f ms  decodebin %7.3f ms  speedup %5.2fx\n", format->name,
+                    direct / 1000.0, decodebin / 1000.0, (double)decodebin / MAX(direct, 1));
+        }
+        if(format->encoder != NULL)
+        {
+            remove(path);
+        }
+        g_free(path);
+    }
+    remove(wav_path);
+    rmdir(bench_directory);
+    g_free(wav_path);
+    g_free(bench_directory);
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "utils.h"
+#include "test_util.h"
+#include <glib-2.0/glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_REPEATS 5
+#define BENCH_LARGE 1000000
+#define BENCH_SORTED 50000
+
+/*The kernels utils_sort.c replaced: Lomuto quicksort on the last element, a full
+  sort for the median and a float accumulator for the mean*/
+static void old_float_swap(float *a, float *b)
+{
+    float temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+static int old_float_partition(float array[], int low, int high)
+{
+    float pivot = array[high];
+    int i = low - 1;
+    for(int j = low; j <= high - 1; j++)
+    {
+        if(array[j] < pivot)
+        {
+            i++;
+            old_float_swap(&array[i], &array[j]);
+        }
+    }
+    old_float_swap(&array[i + 1], &array[high]);
+    return i + 1;
+}
+
+static void old_float_quicksort(float array[], int low, int high)
+{
+    if(low < high)
+    {
+        int pivot_index = old_float_partition(array, low, high);
+        old_float_quicksort(array, low, pivot_index - 1);
+        old_float_quicksort(array, pivot_index + 1, high);
+    }
+}
+
+static void old_float_sort(float array[], unsigned int n)
+{
+    if(n > 1)
+    {
+        old_float_quicksort(array, 0, (int)n - 1);
+    }
+}
+
+static float old_float_mediana(float array[], unsigned int n)
+{
+    old_float_sort(array, n);
+    if(n % 2 == 0)
+    {
+        return (array[n / 2 - 1] + array[n / 2]) / 2.0f;
+    }
+    return array[n / 2];
+}
+
+static float old_float_mean(float array[], unsigned int n)
+{
+    float sum = 0.0f;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        sum += array[i];
+    }
+    return sum / n;
+}
+
+typedef enum _BenchKernel
+{
+    BENCH_SORT,
+    BENCH_MEDIANA,
+    BENCH_MEAN
+}BenchKernel;
+
+/*Best of BENCH_REPEATS runs on a fresh copy of input, result gets what the kernel returned*/
+static gint64 bench_run(BenchKernel kernel, gboolean old, const float *input, float *work, unsigned int n, float *result)
+{
+    gint64 best = G_MAXINT64;
+
+    for(int r = 0; r < BENCH_REPEATS; r++)
+    {
+        memcpy(work, input, n * sizeof(float));
+        gint64 start = g_get_monotonic_time();
+        switch(kernel)
+        {
+            case BENCH_SORT:
+                if(old)
+                {
+                    old_float_sort(work, n);
+                }
+                else
+                {
+                    utils_float_sort(work, n);
+                }
+                *result = work[n / 2];
+                break;
+            case BENCH_MEDIANA:
+                *result = old ? old_float_mediana(work, n) : utils_float_mediana(work, n);
+                break;
+            case BENCH_MEAN:
+                *result = old ? old_float_mean(work, n) : utils_float_mean(work, n);
+                break;
+        }
+        best = MIN(best, g_get_monotonic_time() - start);
+    }
+    return best;
+}
+
+static void bench_compare(const gchar *name, BenchKernel kernel, const float *input, unsigned int n)
+{
+    float *work = g_new(float, n);
+    float old_result, new_result;
+    gint64 old_time = bench_run(kernel, TRUE, input, work, n, &old_result);
+    gint64 new_time = bench_run(kernel, FALSE, input, work, n, &new_result);
+
+    printf("%-22s %8u floats  old %10.3f ms  new %8.3f ms  speedup %7.1fx  result %g / %g\n",
+            name, n, old_time / 1000.0, new_time / 1000.0, (double)old_time / MAX(new_time, 1),
+            old_result, new_result);
+    g_free(work);
+}
+
+int main(void)
+{
+    float *random = g_new(float, BENCH_LARGE);
+    float *sorted = g_new(float, BENCH_SORTED);
+    guint32 state = 1;
+
+    for(unsigned int i = 0; i < BENCH_LARGE; i++)
+    {
+        random[i] = 1000.0f * test_uniform(&state) - 500.0f;
+    }
+    for(unsigned int i = 0; i < BENCH_SORTED; i++)
+    {
+        sorted[i] = (float)i;
+    }
+    bench_compare("sort random", BENCH_SORT, random, BENCH_LARGE);
+    bench_compare("sort random", BENCH_SORT, random, 1000);
+    bench_compare("sort already sorted", BENCH_SORT, sorted, BENCH_SORTED);
+    bench_compare("mediana random", BENCH_MEDIANA, random, BENCH_LARGE);
+    bench_compare("mean random", BENCH_MEAN, random, BENCH_LARGE);
+    g_free(random);
+    g_free(sorted);
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "catalog.h"
+#include "analyse.h"
+#include "utils.h"
+#include "media_probe.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define CATALOG_NUMBER_LEN 32
+
+typedef struct _Catalog
+{
+    FILE *output;
+    GMutex lock;
+    guint total;
+    guint done;
+    guint failed;
+    guint rejected;             /*files the pre-flight probe found no audio in*/
+    gint64 start_time;
+    gdouble audio_seconds;
+}Catalog;
+
+static void catalog_collect(const gchar *directory, GPtrArray *files, guint *rejected);
+
+static void catalog_worker(gpointer data, gpointer user_data);
+
+static gchar *catalog_record(const gchar *path, int error, const AnalyseResult *result, gdouble analysis_time);
+
+int catalog_analyse_directory(const gchar *directory, const gchar *output_path,
+                                const gchar *cache_path, guint jobs)
+{
+    Catalog catalog;
+    AnalyseCache cache;
+    GPtrArray *files;
+    GThreadPool *pool;
+    GError *error = NULL;
+    gdouble elapsed;
+
+    if(directory == NULL || !g_file_test(directory, G_FILE_TEST_IS_DIR))
+    {
+        printf("[ERR] Catalog input is not a directory\n");
+        return -1;
+    }
+    memset(&catalog, 0, sizeof(Catalog));
+    catalog.output = output_path != NULL ? fopen(output_path, "w") : stdout;
+    if(catalog.output == NULL)
+    {
+        printf("[ERR] Could not open catalog output: %s\n", output_path);
+        return -1;
+    }
+    if(cache_path != NULL)
+    {
+        if(analyse_cache_open(&cache, cache_path) != 0)
+        {
+            printf("[ERR] Could not open analysis cache: %s\n", cache_path);
+            if(output_path != NULL)
+            {
+                fclose(catalog.output);
+            }
+            return -1;
+        }
+        analyse_set_cache(&cache);
+    }
+    files = g_ptr_array_new_with_free_func(g_free);
+    catalog_collect(directory, files, &catalog.rejected);
+    catalog.total = files->len;
+    g_mutex_init(&catalog.lock);
+    if(jobs == 0)
+    {
+        jobs = g_get_num_processors();
+    }
+    g_printerr("[LOG] Analysing %u tracks on %u workers, %u files without readable audio skipped\n",
+                catalog.total, jobs, catalog.rejected);
+    catalog.start_time = g_get_monotonic_time();
+    pool = g_thread_pool_new(catalog_worker, &catalog, (gint)jobs, TRUE, &error);
+    if(pool == NULL)
+    {
+        printf("[ERR] Could not start workers: %s\n", error->message);
+        g_clear_error(&error);
+    }
+    else
+    {
+        for(guint i = 0; i < files->len; i++)
+        {
+            g_thread_pool_push(pool, files->pdata[i], NULL);
+        }
+        /*Waits for every queued track*/
+        g_thread_pool_free(pool, FALSE, TRUE);
+    }
+    elapsed = (g_get_monotonic_time() - catalog.start_time) / (gdouble)G_USEC_PER_SEC;
+    g_printerr("\n[LOG] %u tracks (%u failed) in %.1f s, %.2f tracks/s, %.0fx realtime\n",
+                catalog.done, catalog.failed, elapsed,
+                elapsed > 0 ? catalog.done / elapsed : 0.0,
+                elapsed > 0 ? catalog.audio_seconds / elapsed : 0.0);
+
+    g_mutex_clear(&catalog.lock);
+    g_ptr_array_free(files, TRUE);
+    if(cache_path != NULL)
+    {
+        analyse_set_cache(NULL);
+        analyse_cache_close(&cache);
+    }
+    if(output_path != NULL)
+    {
+        fclose(catalog.output);
+    }
+    return pool != NULL ? 0 : -1;
+}
+
+static void catalog_collect(const gchar *directory, GPtrArray *files, guint *rejected)
+{
+    GDir *dir = g_dir_open(directory, 0, NULL);
+    const gchar *name;
+    MediaProbe probe;
+
+    if(dir == NULL)
+    {
+        return;
+    }
+    while((name = g_dir_read_name(dir)) != NULL)
+    {
+        gchar *path = g_build_filename(directory, name, NULL);
+        if(g_file_test(path, G_FILE_TEST_IS_DIR))
+        {
+            catalog_collect(path, files, rejected);
+            g_free(path);
+        }
+        else if(!g_file_test(path, G_FILE_TEST_IS_REGULAR))
+        {
+            g_free(path);
+        }
+        /*The magic bytes decide, not the name. Only the headers are read,
+          broken files never reach a decoder*/
+        else if(media_probe_file(path, &probe) != 0 || !media_probe_is_audio(&probe))
+        {
+            (*rejected)++;
+            g_free(path);
+        }
+        else
+        {
+            g_ptr_array_add(files, path);
+        }
+    }
+    g_dir_close(dir);
+}
+
+static void catalog_worker(gpointer data, gpointer user_data)
+{
+    const gchar *path = data;
+    Catalog *catalog = user_data;
+    BPMData bpm_data;
+    PitchData pitch_data;
+    FrequencyVolData freq_vol_data;
+    AnalyseResult result;
+    gint64 start = g_get_monotonic_time();
+    gdouble elapsed, analysis_time;
+    gchar *record;
+    int error;
+
+    analyse_init_bpm_data(&bpm_data, MEDIANA);
+    analyse_set_bpm_detector(&bpm_data, BPM_DETECTOR_NATIVE);
+    analyse_init_pitch_data(&pitch_data, AUTOCORELATION, AUDIO_FREQUENCY, CATALOG_PITCH_FRAME);
+    analyse_init_freq_vol_data(&freq_vol_data, CATALOG_LOW_FREQ_START, CATALOG_MEDIUM_FREQ_START,
+                                CATALOG_HIGH_FREQ_START, AUDIO_FREQUENCY, CATALOG_BAND_FRAME);
+    error = analyse_song((gchar *)path, &bpm_data, &pitch_data, &freq_vol_data, &result);
+    analysis_time = (g_get_monotonic_time() - start) / (gdouble)G_USEC_PER_SEC;
+    record = catalog_record(path, error, &result, analysis_time);
+
+    g_mutex_lock(&catalog->lock);
+    fputs(record, catalog->output);
+    fputc('\n', catalog->output);
+    fflush(catalog->output);
+    catalog->done++;
+    if(error != 0)
+    {
+        catalog->failed++;
+    }
+    else
+    {
+        catalog->audio_seconds += result.duration;
+    }
+    elapsed = (g_get_monotonic_time() - catalog->start_time) / (gdouble)G_USEC_PER_SEC;
+    g_printerr("\r[LOG] %u/%u tracks, %.2f tracks/s", catalog->done, catalog->total,
+                elapsed > 0 ? catalog->done / elapsed : 0.0);
+    g_mutex_unlock(&catalog->lock);
+    g_free(record);
+}
+
+static void json_append_string(GString *json, const gchar *value)
+{
+    g_string_append_c(json, '"');
+    for(const gchar *c = value; *c != '\0'; c++)
+    {
+        if(*c == '"' || *c == '\\')
+        {
+            g_string_append_c(json, '\\');
+            g_string_append_c(json, *c);
+        }
+        else if((guchar)*c < 0x20)
+        {
+            g_string_append_printf(json, "\\u%04x", (guchar)*c);
+        }
+        else
+        {
+            g_string_append_c(json, *c);
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+/*Locale independent, JSON needs a dot as decimal separator*/
+static void json_append_number(GString *json, const gchar *key, gdouble value)
+{
+    gchar number[CATALOG_NUMBER_LEN];
+    g_ascii_formatd(number, sizeof(number), "%.4f", value);
+    g_string_append_printf(json, ",\"%s\":%s", key, number);
+}
+
+/*Low band RMS over medium band RMS as a linear ratio, 1.0 when both are equally loud.
+  MLNightcoreData only takes non negative bass values.*/
+static gdouble catalog_input_bass(const AnalyseResult *result)
+{
+    return pow(10.0, (result->volume[BAND_LOW].rms_db - result->volume[BAND_MEDIUM].rms_db) / 20.0);
+}
+
+/*Field names follow MLNightcoreData so the records can feed the training set*/
+static gchar *catalog_record(const gchar *path, int error, const AnalyseResult *result, gdouble analysis_time)
+{
+    GString *json = g_string_new("{\"path\":");
+    json_append_string(json, path);
+    if(error != 0)
+    {
+        g_string_append_printf(json, ",\"error\":%d", error);
+        json_append_number(json, "analysis_time", analysis_time);
+        g_string_append_c(json, '}');
+        return g_string_free(json, FALSE);
+    }
+    json_append_number(json, "duration", result->duration);
+    json_append_number(json, "origin_bpm", result->bpm);
+    json_append_number(json, "bpm_confidence", result->bpm_confidence);
+    json_append_number(json, "input_pitch", result->pitch);
+    json_append_number(json, "pitch_confidence", result->pitch_confidence);
+    json_append_number(json, "input_bass", catalog_input_bass(result));
+    json_append_number(json, "low_rms_db", result->volume[BAND_LOW].rms_db);
+    json_append_number(json, "low_peak_db", result->volume[BAND_LOW].peak_db);
+    json_append_number(json, "medium_rms_db", result->volume[BAND_MEDIUM].rms_db);
+    json_append_number(json, "medium_peak_db", result->volume[BAND_MEDIUM].peak_db);
+    json_append_number(json, "high_rms_db", result->volume[BAND_HIGH].rms_db);
+    json_append_number(json, "high_peak_db", result->volume[BAND_HIGH].peak_db);
+    json_append_number(json, "analysis_time", analysis_time);
+    g_string_append_c(json, '}');
+    return g_string_free(json, FALSE);
+}
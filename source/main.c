@@ -1,5 +1,7 @@
 #include "nightcore.h"
 #include "main.h"
+#include "catalog.h"
+#include "media_probe.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <gst/gst.h>
@@ -9,7 +11,8 @@ typedef enum _modes{
     MODE_FILE_TO_FILE,
     MODE_URI_TO_FILE,
     MODE_FILE_TO_THUMBNAIL_VIDEO,
-    MODE_FILE_TO_SPEEDUP_VIDEO
+    MODE_FILE_TO_SPEEDUP_VIDEO,
+    MODE_CATALOG
 }MODES;
 
 
@@ -22,24 +25,36 @@ static gdouble bass_boost_val = BASS_BOOST_DEFAULT;
 static guint64 reverb_delay_ms_val = REVERB_DELAY_MS_DEFAULT;
 static gdouble reverb_intensity_val = REVERB_INTENSITY_DEFAULT;
 static gdouble reverb_feedback_val = REVERB_FEEDBACK_DEFAULT;
+static gdouble loudness_val = LOUDNESS_TARGET_DEFAULT;
+static gdouble true_peak_val = TRUE_PEAK_DEFAULT;
+static gboolean no_normalise = FALSE;
 static gboolean ai_save_data = FALSE;
 static gchar * input_thumbnail = NULL;
 static gint mode = 0;
 static gchar *config_path = "./";
 static gint save_config = 0;
+static gchar *cache_file = NULL;
+static gint jobs = 0;
+
+static int preflight_input(const gchar *path);
 
 static GOptionEntry entries[] =
 {
-    {"input", 'i', 0, G_OPTION_ARG_FILENAME, &input_file, "Input file", NULL},
-    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file, "Output file", NULL},
+    {"input", 'i', 0, G_OPTION_ARG_FILENAME, &input_file, "Input file, uri (mode 1) or directory (mode 4)", NULL},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file, "Output file, JSONL in mode 4 (stdout if not set)", NULL},
     {"pitch", 'p', 0, G_OPTION_ARG_DOUBLE, &pitch_val, "Value of pitch. P >= 1.0", "P"},
     {"speed", 's', 0, G_OPTION_ARG_DOUBLE, &tempo_val, "Value of speed. S >= 1.0", "S"},
     {"bass", 'b', 0, G_OPTION_ARG_DOUBLE, &bass_boost_val, "Value in dB of boost of bass frequency, 12.0 B >= 0.0", "B"},
     {"reverb_delay", 'd', 0, G_OPTION_ARG_INT64, &reverb_delay_ms_val, "Value of reverb delay in ms, 500 >  D >= 0", "D"},
     {"reverb_intensity", 'r', 0, G_OPTION_ARG_DOUBLE, &reverb_intensity_val, "Value of reverb instensity.  R >= 0.0", "R"},
     {"reverb_feedback", 'f', 0, G_OPTION_ARG_DOUBLE, &reverb_feedback_val, "Value of feedback instensity.  F >= 0.0", "F"},
+    {"loudness", 'l', 0, G_OPTION_ARG_DOUBLE, &loudness_val, "Target integrated loudness in LUFS. 0.0 > L > -70.0", "L"},
+    {"true_peak", 0, 0, G_OPTION_ARG_DOUBLE, &true_peak_val, "True peak ceiling in dBTP. 0.0 >= T", "T"},
+    {"no_normalise", 0, 0, G_OPTION_ARG_NONE, &no_normalise, "Disable loudness normalisation", NULL},
     {"thumbnail", 't', 0, G_OPTION_ARG_FILENAME, &input_thumbnail, "Input thumbnail file", "T"},
-    {"mode", 'm', 0, G_OPTION_ARG_INT, &mode, "Mode. 0: Standard file to file\n1: URL to file\n2: File to thumbnail video file\nFile to sped up video", "M"},
+    {"mode", 'm', 0, G_OPTION_ARG_INT, &mode, "Mode. 0: Standard file to file\n1: URL to file\n2: File to thumbnail video file\n3: File to sped up video\n4: Analyse directory catalog", "M"},
+    {"cache", 'c', 0, G_OPTION_ARG_FILENAME, &cache_file, "Analysis cache file (mode 4)", NULL},
+    {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs, "Analysis worker threads, 0 uses every core (mode 4)", "J"},
     {"ai_save", 'a', 0, G_OPTION_ARG_NONE, &ai_save_data, "Allow to save parameters", NULL},
     {"ai_dir", 0, 0, G_OPTION_ARG_STRING, &ai_data_dir, "Parameters data directory", NULL},
     G_OPTION_ENTRY_NULL
@@ -67,6 +82,10 @@ int main(int argc, char *argv[])
     NightcoreErrorCodes nightcore_error = SUCCESS;
     
     nightcore_error = nightcore_init(nightcore_data, bass_boost_val, tempo_val, pitch_val, reverb_delay_ms_val, reverb_intensity_val, reverb_feedback_val);
+    if(nightcore_error == SUCCESS)
+    {
+        nightcore_error = nightcore_set_loudness(nightcore_data, !no_normalise, loudness_val, true_peak_val);
+    }
     if(nightcore_error != SUCCESS)
     {
         printf("[ERR] Error during nightcore data initialization\n");
@@ -83,12 +102,21 @@ int main(int argc, char *argv[])
         
     }
     
+    /*Broken inputs are rejected before any pipeline is built*/
+    if((mode == MODE_FILE_TO_FILE || mode == MODE_FILE_TO_THUMBNAIL_VIDEO || mode == MODE_FILE_TO_SPEEDUP_VIDEO) &&
+        preflight_input(input_file) != 0)
+    {
+        g_option_context_free(context);
+        free(nightcore_data);
+        return -1;
+    }
     switch(mode)
     {
         case(MODE_FILE_TO_FILE):
             nightcore_error = nightcore_process_file(nightcore_data, input_file, output_file);
             break;
         case(MODE_URI_TO_FILE):
+            nightcore_error = nightcore_process_url(nightcore_data, input_file, output_file);
             break;
         case(MODE_FILE_TO_THUMBNAIL_VIDEO):
             
@@ -97,6 +125,14 @@ int main(int argc, char *argv[])
         case(MODE_FILE_TO_SPEEDUP_VIDEO):
 
             break;    
+        case(MODE_CATALOG):
+            if(catalog_analyse_directory(input_file, output_file, cache_file, (guint)MAX(jobs, 0)) != 0)
+            {
+                g_option_context_free(context);
+                free(nightcore_data);
+                return -1;
+            }
+            break;
         default:
             break;
     };
@@ -154,4 +190,23 @@ void save_parameters_to_file(NightcoreData *nightcore_data, gchar *ai_data_dir,
     fclose(file);
     g_free(file_path);
 }
-}
\ No newline at end of file
+}
+
+static int preflight_input(const gchar *path)
+{
+    MediaProbe probe;
+    int error = media_probe_file(path, &probe);
+    if(error == -1 || error == -2)
+    {
+        printf("[ERR] Could not read input file: %s\n", path != NULL ? path : "(null)");
+        return -1;
+    }
+    if(error != 0)
+    {
+        printf("[ERR] Input is not a supported media file: %s\n", path);
+        return -1;
+    }
+    printf("[LOG] Input %s: %s, %u Hz, %u channels, %.1f s\n", path, media_probe_container_name(probe.container),
+            probe.rate, probe.channels, probe.duration);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef _TEST_UTIL_H_
+#define _TEST_UTIL_H_
+
+#include <glib-2.0/glib.h>
+#include <string.h>
+
+/*Bytes of a canonical PCM WAV header*/
+#define TEST_WAV_HEADER_BYTES 44
+
+/*Numerical Recipes LCG, the same stream on every platform. 0.0 - 1.0*/
+static inline gfloat test_uniform(guint32 *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (gfloat)(*state >> 8) / (gfloat)(1u << 24);
+}
+
+/*-1.0 - 1.0*/
+static inline gfloat test_signed_uniform(guint32 *state)
+{
+    return 2.0f * test_uniform(state) - 1.0f;
+}
+
+static inline void test_put_le(guchar *out, guint32 value, guint bytes)
+{
+    for(guint i = 0; i < bytes; i++)
+    {
+        out[i] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+/*Header of a 16 bit PCM WAV with data_bytes of samples after it*/
+static inline void test_wav_header(guchar header[TEST_WAV_HEADER_BYTES], guint rate, guint channels, guint32 data_bytes)
+{
+    memcpy(header, "RIFF", 4);
+    test_put_le(header + 4, 36 + data_bytes, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    test_put_le(header + 16, 16, 4);
+    test_put_le(header + 20, 1, 2);
+    test_put_le(header + 22, channels, 2);
+    test_put_le(header + 24, rate, 4);
+    test_put_le(header + 28, rate * channels * 2, 4);
+    test_put_le(header + 32, channels * 2, 2);
+    test_put_le(header + 34, 16, 2);
+    memcpy(header + 36, "data", 4);
+    test_put_le(header + 40, data_bytes, 4);
+}
+
+#endif